@@ -0,0 +1,115 @@
+/*
+ * include/simple_snmpd/admission_control.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_ADMISSION_CONTROL_HPP
+#define SIMPLE_SNMPD_ADMISSION_CONTROL_HPP
+
+#include "request_context.hpp"
+#include "snmp_packet.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace simple_snmpd {
+
+// Request priority classes, most important first. Under overload the
+// classes are shed from the back; CRITICAL is never shed.
+enum class RequestClass : uint8_t {
+  CRITICAL = 0,    // communities or users in priority_communities
+  INTERACTIVE = 1, // GET, GET-NEXT and SET within the cost budget
+  BULK = 2,        // GET-BULK and requests above shed_bulk_cost
+  BACKGROUND = 3,  // communities or users in low_priority_communities
+};
+
+constexpr size_t SNMP_REQUEST_CLASSES = 4;
+
+// "critical", "interactive", "bulk", "background"
+const char *request_class_name(RequestClass request_class);
+
+// CoDel-style admission control in front of request processing. The
+// sojourn time of each request (kernel arrival to admission) is tracked
+// per interval; while the smallest sojourn seen in an interval stays above
+// the target, one more priority class is shed per interval, and classes
+// are readmitted one at a time once the queue drains below the target.
+// admit() is called concurrently from shard and worker threads.
+class AdmissionController {
+public:
+  struct Statistics {
+    uint32_t shed_level;
+    std::array<uint64_t, SNMP_REQUEST_CLASSES> admitted;
+    std::array<uint64_t, SNMP_REQUEST_CLASSES> shed;
+
+    Statistics() : shed_level(0), admitted(), shed() {}
+  };
+
+  AdmissionController();
+
+  void configure(bool enabled, std::chrono::microseconds target,
+                 std::chrono::microseconds interval, uint32_t bulk_cost,
+                 const std::vector<std::string> &priority_communities,
+                 const std::vector<std::string> &low_priority_communities);
+
+  bool is_enabled() const { return enabled_; }
+
+  // Estimated cost in variable bindings the response will carry
+  static uint32_t estimate_cost(const SNMPPacketView &request);
+
+  // SNMPv1/v2c requests are matched against the priority lists by
+  // community, SNMPv3 requests by USM user name
+  RequestClass classify(const SNMPPacketView &request) const;
+  RequestClass classify(const SNMPPacketView &request,
+                        const std::string &user_name) const;
+
+  // Returns false when the request should be dropped unanswered.
+  // now_ns is CLOCK_REALTIME, the clock of context.arrival_ns.
+  bool admit(const RequestContext &context, const SNMPPacketView &request,
+             uint64_t now_ns);
+  bool admit(const RequestContext &context, const SNMPPacketView &request,
+             const std::string &user_name, uint64_t now_ns);
+
+  Statistics get_statistics() const;
+
+private:
+  bool admit(const RequestContext &context, RequestClass request_class,
+             uint64_t now_ns);
+  void end_interval();
+
+  bool enabled_;
+  uint64_t target_ns_;
+  uint64_t interval_ns_;
+  uint32_t bulk_cost_;
+  std::set<std::string> priority_communities_;
+  std::set<std::string> low_priority_communities_;
+
+  // Number of classes currently shed, counted from BACKGROUND upwards
+  std::atomic<uint32_t> shed_level_;
+  // Smallest sojourn time seen in the current interval and its end
+  std::atomic<uint64_t> interval_min_ns_;
+  std::atomic<uint64_t> interval_end_ns_;
+
+  std::array<std::atomic<uint64_t>, SNMP_REQUEST_CLASSES> admitted_;
+  std::array<std::atomic<uint64_t>, SNMP_REQUEST_CLASSES> shed_;
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_ADMISSION_CONTROL_HPP
@@ -0,0 +1,89 @@
+/*
+ * include/simple_snmpd/ber_encoder.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_BER_ENCODER_HPP
+#define SIMPLE_SNMPD_BER_ENCODER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_snmpd {
+
+// Largest TLV header: tag, 0x84 and four length octets
+constexpr size_t BER_MAX_HEADER_SIZE = 6;
+
+// Single-pass BER writer that fills a caller-provided buffer from the end
+// towards the front. A constructed value is written contents first, so
+// its length is known when the header goes in front of it and is always
+// emitted in minimal definite form; nothing is ever moved or reallocated.
+// Running out of space is sticky: later writes are ignored and ok()
+// returns false.
+//
+//   BerEncoder encoder(buffer, sizeof(buffer));
+//   size_t mark = encoder.size();
+//   encoder.write_integer(0x02, 42);
+//   encoder.wrap(0x30, mark); // SEQUENCE { INTEGER 42 }
+//   send(encoder.data(), encoder.size());
+class BerEncoder {
+public:
+  BerEncoder(uint8_t *buffer, size_t capacity);
+
+  bool ok() const { return !overflow_; }
+
+  // Bytes written so far; also the mark passed to wrap()
+  size_t size() const { return capacity_ - start_; }
+
+  // First byte of the encoding, which ends at the end of the buffer
+  const uint8_t *data() const { return buffer_ + start_; }
+
+  void write_byte(uint8_t byte);
+  void write_bytes(const uint8_t *bytes, size_t length);
+
+  // Tag and minimal definite length for contents already written
+  void write_header(uint8_t tag, size_t length);
+
+  // Close everything written since mark as a single TLV
+  void wrap(uint8_t tag, size_t mark) { write_header(tag, size() - mark); }
+
+  void write_tlv(uint8_t tag, const uint8_t *contents, size_t length);
+
+  // Minimal two's complement INTEGER (or an application type with the
+  // same encoding, such as Counter32 or TimeTicks)
+  void write_integer(uint8_t tag, int64_t value);
+
+  // Size of the header write_header() emits for length
+  static size_t header_size(size_t length);
+
+  // Size of a whole TLV with length content octets
+  static size_t tlv_size(size_t length) {
+    return header_size(length) + length;
+  }
+
+  // Content octets write_integer() emits for value
+  static size_t integer_length(int64_t value);
+
+private:
+  uint8_t *buffer_;
+  size_t capacity_;
+  size_t start_;
+  bool overflow_;
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_BER_ENCODER_HPP
@@ -0,0 +1,147 @@
+/*
+ * include/simple_snmpd/datagram_batch.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_DATAGRAM_BATCH_HPP
+#define SIMPLE_SNMPD_DATAGRAM_BATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <sys/types.h>
+#endif
+
+#ifdef __linux__
+#include <sys/uio.h>
+#include <time.h>
+#endif
+
+namespace simple_snmpd {
+
+// Largest payload a single UDP datagram can carry over IPv4
+constexpr size_t SNMP_MAX_UDP_PAYLOAD = 65507;
+
+// Receive buffer size for a single SNMP request datagram
+constexpr size_t SNMP_RECEIVE_BUFFER_SIZE = 4096;
+
+#ifdef __linux__
+// Ancillary data received with each datagram: the SO_RXQ_OVFL drop
+// counter and a SO_TIMESTAMPING (or SO_TIMESTAMPNS) arrival time
+constexpr size_t SNMP_RECEIVE_CONTROL_SIZE =
+    CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(3 * sizeof(struct timespec));
+#endif
+
+// A single datagram slot inside a batch
+struct Datagram {
+  uint8_t *data;
+  size_t length;
+  struct sockaddr_storage address;
+  socklen_t address_length;
+
+  // Arrival time in CLOCK_REALTIME nanoseconds, taken from the kernel
+  // receive timestamp when the socket provides one (0 when unknown)
+  uint64_t timestamp_ns;
+  // Datagrams the kernel dropped on this socket so far (SO_RXQ_OVFL)
+  uint32_t drops;
+  bool has_drops;
+
+  Datagram()
+      : data(nullptr), length(0), address(), address_length(0),
+        timestamp_ns(0), drops(0), has_drops(false) {}
+};
+
+#ifdef __linux__
+// Fill the datagram's timestamp and drop counter from received ancillary
+// data
+void read_datagram_control(const struct msghdr &msg, Datagram &datagram);
+#endif
+
+// Fixed-capacity set of datagram buffers that can be filled or flushed with
+// a single recvmmsg/sendmmsg call. On platforms without the mmsg syscalls
+// the batch degrades to one recvfrom/sendto per datagram.
+class DatagramBatch {
+public:
+  DatagramBatch(size_t capacity, size_t slot_size);
+  ~DatagramBatch();
+
+  DatagramBatch(const DatagramBatch &) = delete;
+  DatagramBatch &operator=(const DatagramBatch &) = delete;
+
+  // Batch geometry
+  size_t capacity() const { return datagrams_.size(); }
+  size_t slot_size() const { return slot_size_; }
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  bool full() const { return count_ == datagrams_.size(); }
+
+  // Slot access
+  Datagram &operator[](size_t index) { return datagrams_[index]; }
+  const Datagram &operator[](size_t index) const { return datagrams_[index]; }
+
+  // Claim the next free slot for an outgoing datagram. The caller writes the
+  // payload into data (up to slot_size() bytes) and sets length and address.
+  Datagram &append();
+
+  // Release the most recently appended slot (e.g. when encoding failed)
+  void discard_last();
+
+  // Reset the batch to empty without touching the buffers
+  void clear() {
+    count_ = 0;
+    oversized_ = 0;
+  }
+
+  // Datagrams dropped since the last receive() or clear() because they
+  // were larger than a slot. Engines that fill the batch themselves report
+  // theirs with drop_oversized().
+  size_t oversized() const { return oversized_; }
+  void drop_oversized() { ++oversized_; }
+
+  // Receive up to capacity() datagrams. Blocks until at least one datagram
+  // is available, then takes whatever else is already queued. Datagrams
+  // larger than a slot are dropped and counted in oversized(). Returns the
+  // number of datagrams kept or -1 on error.
+  int receive(int socket_fd);
+
+  // Send every datagram in the batch and clear it. Returns the number of
+  // datagrams handed to the kernel; syscalls is set to the number of send
+  // calls that were needed.
+  size_t send(int socket_fd, size_t &syscalls);
+
+private:
+  size_t slot_size_;
+  size_t count_;
+  size_t oversized_;
+  std::vector<uint8_t> storage_;
+  std::vector<Datagram> datagrams_;
+
+#ifdef __linux__
+  std::vector<struct mmsghdr> headers_;
+  std::vector<struct iovec> iovecs_;
+  std::vector<uint8_t> control_;
+#endif
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_DATAGRAM_BATCH_HPP
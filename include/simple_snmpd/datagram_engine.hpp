@@ -0,0 +1,78 @@
+/*
+ * include/simple_snmpd/datagram_engine.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_DATAGRAM_ENGINE_HPP
+#define SIMPLE_SNMPD_DATAGRAM_ENGINE_HPP
+
+#include "datagram_batch.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace simple_snmpd {
+
+// I/O backend that moves datagram batches between a UDP socket and the
+// server loop. Each listener shard owns one engine; engines are not
+// thread-safe.
+class DatagramEngine {
+public:
+  virtual ~DatagramEngine() = default;
+
+  // Backend name as used by the io_backend configuration key
+  virtual const char *name() const = 0;
+
+  // Fill the batch with received datagrams. Blocks until at least one
+  // datagram is available or the engine's wait interval elapses. Returns
+  // the number of datagrams received (0 on timeout) or -1 on error;
+  // syscalls is set to the number of system calls that were made.
+  virtual int receive(DatagramBatch &batch, size_t &syscalls) = 0;
+
+  // Send every datagram in the batch and clear it. Returns the number of
+  // datagrams sent; syscalls is set to the number of system calls made.
+  virtual size_t send(DatagramBatch &batch, size_t &syscalls) = 0;
+};
+
+// recvmmsg/sendmmsg (or recvfrom/sendto) engine
+class SocketDatagramEngine : public DatagramEngine {
+public:
+  explicit SocketDatagramEngine(int socket_fd) : socket_fd_(socket_fd) {}
+
+  const char *name() const override { return "socket"; }
+  int receive(DatagramBatch &batch, size_t &syscalls) override;
+  size_t send(DatagramBatch &batch, size_t &syscalls) override;
+
+private:
+  int socket_fd_;
+};
+
+// Create the engine selected by backend ("socket" or "io_uring") for a
+// socket. Falls back to the socket engine, with a warning, when the
+// requested backend is not compiled in or not supported by the kernel.
+std::unique_ptr<DatagramEngine>
+create_datagram_engine(const std::string &backend, int socket_fd,
+                       size_t batch_size);
+
+// io_uring engine using multishot recvmsg over a provided-buffer ring and
+// batched sendmsg submissions. Returns nullptr when the build or the
+// running kernel lacks the required io_uring features.
+std::unique_ptr<DatagramEngine>
+create_io_uring_datagram_engine(int socket_fd, size_t batch_size);
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_DATAGRAM_ENGINE_HPP
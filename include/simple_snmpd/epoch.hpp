@@ -0,0 +1,111 @@
+/*
+ * include/simple_snmpd/epoch.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_EPOCH_HPP
+#define SIMPLE_SNMPD_EPOCH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace simple_snmpd {
+
+// Epoch-based reclamation for read-copy-update structures. A reader pins
+// the current epoch with a Guard before loading a published pointer and
+// may use what it loaded until the guard goes away. A writer swaps in a
+// new version and retires the old one, which is freed once every reader
+// pinned at or before the retirement has left.
+//
+// Readers touch only their own cache line (one slot per thread, claimed
+// on first use and released when the thread exits), so they never
+// contend with each other. Guards nest; only the outermost one pins.
+// Past MAX_READERS threads, further readers fall back to a shared count
+// that holds back all reclamation while it is non-zero.
+class EpochManager {
+public:
+  static constexpr size_t MAX_READERS = 256;
+
+  class Guard {
+  public:
+    Guard();
+    Guard(const Guard &other);
+    Guard &operator=(const Guard &) = default;
+    ~Guard();
+  };
+
+  struct Statistics {
+    uint64_t epoch;
+    uint64_t retired;   // retired and not yet freed
+    uint64_t reclaimed; // freed since start
+    uint64_t readers;   // threads holding a slot
+  };
+
+  static EpochManager &get_instance();
+
+  // Run deleter once no reader can still hold what it frees
+  void retire(std::function<void()> deleter);
+
+  // Free whatever has become unreachable since the last retire()
+  void reclaim();
+
+  Statistics get_statistics() const;
+
+private:
+  EpochManager();
+  ~EpochManager();
+  EpochManager(const EpochManager &) = delete;
+  EpochManager &operator=(const EpochManager &) = delete;
+
+  // Pinned epoch of one reader thread; 0 while it is outside any guard
+  struct alignas(64) Slot {
+    std::atomic<bool> in_use;
+    std::atomic<uint64_t> pinned;
+  };
+
+  struct Retired {
+    uint64_t epoch;
+    std::function<void()> deleter;
+  };
+
+  friend class Guard;
+  friend struct ThreadReader;
+
+  void enter();
+  void leave();
+  size_t claim_slot();
+  void release_slot(size_t slot);
+
+  // Caller holds retired_mutex_
+  void reclaim_locked();
+
+  Slot slots_[MAX_READERS];
+  std::atomic<uint64_t> epoch_;
+  std::atomic<uint64_t> overflow_readers_;
+  std::atomic<uint64_t> readers_;
+
+  mutable std::mutex retired_mutex_;
+  std::vector<Retired> retired_;
+  uint64_t reclaimed_;
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_EPOCH_HPP
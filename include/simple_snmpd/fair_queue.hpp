@@ -0,0 +1,116 @@
+/*
+ * include/simple_snmpd/fair_queue.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_FAIR_QUEUE_HPP
+#define SIMPLE_SNMPD_FAIR_QUEUE_HPP
+
+#include "request_context.hpp"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace simple_snmpd {
+
+// Deficit round robin scheduler between the listener shards and the
+// workers. Requests are queued per source address; every round a source
+// may dequeue up to quantum * weight bytes of requests, so a manager that
+// polls far more often than the others only lengthens its own queue. Each
+// source may hold at most flow_depth * weight queued requests; beyond
+// that its requests are refused and the caller drops them.
+class FairQueue {
+public:
+  struct FlowStatistics {
+    NetworkAddress source;
+    uint32_t weight;
+    size_t depth;
+  };
+
+  struct Statistics {
+    uint64_t enqueued;
+    uint64_t dropped;
+    size_t depth;
+    size_t active_flows;
+
+    Statistics() : enqueued(0), dropped(0), depth(0), active_flows(0) {}
+  };
+
+  FairQueue();
+
+  // weights holds "address[/prefix]=weight" rules, first match wins;
+  // unmatched sources get weight 1. Returns false on an invalid rule.
+  bool configure(uint32_t quantum, uint32_t flow_depth,
+                 const std::vector<std::string> &weights);
+
+  // Queue item for source, with cost in bytes. Returns false when the
+  // source already has its full share of queued requests.
+  bool push(const NetworkAddress &source, uint32_t item, uint32_t cost);
+
+  // Next item in deficit round robin order; false when nothing is queued
+  bool pop(uint32_t &item);
+
+  size_t size() const;
+
+  Statistics get_statistics() const;
+
+  // The count sources with the deepest queues, deepest first
+  std::vector<FlowStatistics> top_flows(size_t count) const;
+
+private:
+  struct WeightRule {
+    NetworkAddress network;
+    uint32_t prefix_length;
+    uint32_t weight;
+  };
+
+  struct Entry {
+    uint32_t item;
+    uint32_t cost;
+  };
+
+  struct Flow {
+    NetworkAddress source;
+    uint32_t weight;
+    uint64_t deficit;
+    bool active;
+    std::deque<Entry> entries;
+  };
+
+  uint32_t weight_for(const NetworkAddress &source) const;
+
+  uint32_t quantum_;
+  uint32_t flow_depth_;
+  std::vector<WeightRule> rules_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<NetworkAddress, std::unique_ptr<Flow>, NetworkAddressHash>
+      flows_;
+  // Flows with queued requests in round robin order; the front flow is
+  // the one being served
+  std::deque<Flow *> active_;
+  size_t depth_;
+  uint64_t enqueued_;
+  uint64_t dropped_;
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_FAIR_QUEUE_HPP
@@ -0,0 +1,48 @@
+/*
+ * include/simple_snmpd/hash.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_HASH_HPP
+#define SIMPLE_SNMPD_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_snmpd {
+
+// 64-bit FNV-1a, used for cache keys and lock stripes
+constexpr uint64_t FNV1A_OFFSET = 14695981039346656037ULL;
+constexpr uint64_t FNV1A_PRIME = 1099511628211ULL;
+
+// Mix one value into hash in a single step, for lengths and fixed-width
+// fields
+inline uint64_t fnv1a(uint64_t hash, uint64_t value) {
+  return (hash ^ value) * FNV1A_PRIME;
+}
+
+// Mix length bytes into hash one at a time
+inline uint64_t fnv1a(const uint8_t *data, size_t length,
+                      uint64_t hash = FNV1A_OFFSET) {
+  for (size_t i = 0; i < length; ++i) {
+    hash = fnv1a(hash, data[i]);
+  }
+  return hash;
+}
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_HASH_HPP
@@ -0,0 +1,65 @@
+/*
+ * include/simple_snmpd/listen_endpoint.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_LISTEN_ENDPOINT_HPP
+#define SIMPLE_SNMPD_LISTEN_ENDPOINT_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <sys/types.h>
+#endif
+
+namespace simple_snmpd {
+
+// Local address the server listens on
+struct ListenEndpoint {
+  struct sockaddr_storage address;
+  socklen_t address_length;
+  bool v6_only;          // IPV6_V6ONLY for AF_INET6 sockets
+  std::string interface; // bind to this device when not empty
+
+  ListenEndpoint() : address(), address_length(0), v6_only(true) {}
+
+  int family() const { return address.ss_family; }
+};
+
+// Parse one bind_address entry:
+//   "*"                  all IPv4 and IPv6 addresses on one dual-stack socket
+//   "0.0.0.0", "10.0.0.5:1161"
+//   "::", "[2001:db8::1]", "[::]:1161"
+// optionally followed by "@<interface>" to bind to a network device.
+// The port defaults to default_port.
+bool parse_listen_endpoint(const std::string &spec, uint16_t default_port,
+                           ListenEndpoint &endpoint);
+
+// Split a comma separated bind_address value into trimmed entries
+std::vector<std::string> split_listen_addresses(const std::string &value);
+
+// "[::]:161", "10.0.0.5:161@eth1"
+std::string listen_endpoint_to_string(const ListenEndpoint &endpoint);
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_LISTEN_ENDPOINT_HPP
@@ -0,0 +1,49 @@
+/*
+ * include/simple_snmpd/lock_stripes.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_LOCK_STRIPES_HPP
+#define SIMPLE_SNMPD_LOCK_STRIPES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_snmpd {
+
+// The shards of a concurrent cache. Each Stripe holds its own mutex and
+// the entries whose hash selects it, so threads working on different keys
+// rarely wait for each other; a bounded cache gives each stripe an equal
+// share of its entries.
+template <typename Stripe> class LockStripes {
+public:
+  static constexpr size_t COUNT = 16;
+
+  Stripe &operator[](uint64_t hash) { return stripes_[hash % COUNT]; }
+
+  typename std::array<Stripe, COUNT>::iterator begin() {
+    return stripes_.begin();
+  }
+  typename std::array<Stripe, COUNT>::iterator end() { return stripes_.end(); }
+
+private:
+  std::array<Stripe, COUNT> stripes_;
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_LOCK_STRIPES_HPP
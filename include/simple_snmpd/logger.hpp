@@ -19,6 +19,9 @@
 #ifndef SIMPLE_SNMPD_LOGGER_HPP
 #define SIMPLE_SNMPD_LOGGER_HPP
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <mutex>
 #include <string>
@@ -43,16 +46,40 @@ public:
   LogLevel get_level() const;
   bool is_initialized() const;
 
+  // True when a message at this level would be written; lets callers skip
+  // building messages on hot paths
+  bool is_enabled(LogLevel level) const;
+
   // Singleton access
   static Logger &get_instance();
 
 private:
-  LogLevel level_;
-  bool initialized_;
+  std::atomic<LogLevel> level_;
+  std::atomic<bool> initialized_;
   std::ofstream log_file_;
   mutable std::mutex mutex_;
 };
 
+// Rate limit for messages triggered by remote input, such as malformed
+// packets: at most burst messages per interval, the rest are counted and
+// reported with the next message let through. Lock-free, so a flood costs
+// one atomic increment per suppressed message.
+class LogSampler {
+public:
+  LogSampler(uint32_t burst, std::chrono::milliseconds interval);
+
+  // True when a message may be written now; suppressed receives the
+  // number of messages dropped since the last one allowed
+  bool allow(uint64_t &suppressed);
+
+private:
+  const uint32_t burst_;
+  const int64_t interval_ns_;
+  std::atomic<int64_t> window_start_ns_;
+  std::atomic<uint32_t> window_count_;
+  std::atomic<uint64_t> suppressed_;
+};
+
 // Convenience macros
 #define LOG_DEBUG(msg) Logger::get_instance().log(LogLevel::DEBUG, msg)
 #define LOG_INFO(msg) Logger::get_instance().log(LogLevel::INFO, msg)
@@ -0,0 +1,183 @@
+/*
+ * include/simple_snmpd/mib_cache.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_MIB_CACHE_HPP
+#define SIMPLE_SNMPD_MIB_CACHE_HPP
+
+#include "lock_stripes.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace simple_snmpd {
+
+// How long values under a MIB subtree are served from memory. A value
+// younger than ttl is served as it is; for max_stale after that it is
+// still served while one background refresh loads a new one, and past
+// that the first request to need it loads it while the others wait.
+struct MIBCachePolicy {
+  std::chrono::milliseconds ttl;
+  std::chrono::milliseconds max_stale;
+  std::string name; // statistics label; the subtree OID when empty
+
+  MIBCachePolicy() : ttl(1000), max_stale(0) {}
+  MIBCachePolicy(std::chrono::milliseconds t, std::chrono::milliseconds s,
+                 const std::string &n = std::string())
+      : ttl(t), max_stale(s), name(n) {}
+};
+
+// Values of one MIB subtree kept in memory, for getters and row
+// providers too slow to run on every request (reading /proc, system
+// calls). Entries are keyed by instance OID, or by entry OID for a whole
+// table's rows. Safe for concurrent use by request threads; refreshes run
+// on one shared background thread.
+class MIBCache : public std::enable_shared_from_this<MIBCache> {
+public:
+  // log2 microsecond buckets of load and refresh latency (<=1us, <=2us,
+  // ..., <=262ms, above), as for request latency
+  static constexpr size_t LATENCY_BUCKETS = 20;
+
+  struct Statistics {
+    uint64_t hits;       // served fresh
+    uint64_t stale_hits; // served stale while a refresh ran
+    uint64_t misses;     // loaded by the request
+    uint64_t waits;      // waited for another request's load
+    uint64_t refreshes;  // loaded in the background
+    uint64_t entries;
+    uint64_t load_us; // time spent in misses and refreshes
+    std::array<uint64_t, LATENCY_BUCKETS> load_latency;
+
+    Statistics()
+        : hits(0), stale_hits(0), misses(0), waits(0), refreshes(0),
+          entries(0), load_us(0), load_latency() {}
+  };
+
+  // Loads one value; null when there is none, which is cached as well
+  using Loader = std::function<std::shared_ptr<const void>()>;
+
+  MIBCache(const std::vector<uint8_t> &subtree, const MIBCachePolicy &policy);
+
+  // Parse a mib_cache rule, OID=ttl_ms[/max_stale_ms]
+  static bool parse_rule(const std::string &rule,
+                         std::vector<uint8_t> &subtree,
+                         MIBCachePolicy &policy);
+
+  const std::vector<uint8_t> &subtree() const { return subtree_; }
+  const MIBCachePolicy &policy() const { return policy_; }
+
+  // The policy's name, or the subtree as a dotted OID
+  std::string label() const;
+
+  // Value cached under key, loaded with the loader make_loader() returns
+  // when it is missing or too stale. make_loader is only called then, by
+  // one request at a time per key; the loader is kept for background
+  // refreshes, so it must own whatever it uses.
+  template <typename T, typename MakeLoader>
+  std::shared_ptr<const T> get(const std::vector<uint8_t> &key,
+                               MakeLoader &&make_loader) {
+    std::shared_ptr<const void> value;
+    std::shared_ptr<Flight> flight;
+    Lookup found = lookup(key, value, flight);
+    if (found == Lookup::WAIT) {
+      value = flight->value.get();
+    } else if (found == Lookup::LOAD) {
+      value = load(key, make_loader(), flight);
+    }
+    return std::static_pointer_cast<const T>(value);
+  }
+
+  // Drop key and every entry under it, after a SET or a new registration
+  void invalidate(const std::vector<uint8_t> &prefix);
+
+  Statistics get_statistics() const;
+
+private:
+  struct KeyHash {
+    size_t operator()(const std::vector<uint8_t> &key) const;
+  };
+
+  // A load run by one request, which others missing the same key wait on
+  struct Flight {
+    std::promise<std::shared_ptr<const void>> promise;
+    std::shared_future<std::shared_ptr<const void>> value;
+
+    Flight() : value(promise.get_future().share()) {}
+  };
+
+  struct Entry {
+    std::shared_ptr<const void> value;
+    std::chrono::steady_clock::time_point loaded;
+    Loader loader;
+    bool refreshing;
+    std::shared_ptr<Flight> flight; // set while a request loads the value
+
+    Entry() : refreshing(false) {}
+  };
+
+  enum class Lookup {
+    HIT,  // served from memory
+    WAIT, // another request is loading it
+    LOAD  // the caller loads it and completes flight
+  };
+
+  struct Stripe {
+    std::mutex mutex;
+    std::unordered_map<std::vector<uint8_t>, Entry, KeyHash> entries;
+  };
+
+  // HIT with value when key can be served from memory, scheduling a
+  // refresh if it is stale; otherwise flight is the load to wait on or,
+  // for LOAD, the one the caller now owns
+  Lookup lookup(const std::vector<uint8_t> &key,
+                std::shared_ptr<const void> &value,
+                std::shared_ptr<Flight> &flight);
+  std::shared_ptr<const void> load(const std::vector<uint8_t> &key,
+                                   Loader loader,
+                                   const std::shared_ptr<Flight> &flight);
+  void refresh(const std::vector<uint8_t> &key, const Loader &loader);
+  void record_load(std::chrono::steady_clock::duration elapsed);
+
+  Stripe &stripe(const std::vector<uint8_t> &key) {
+    return stripes_[KeyHash()(key)];
+  }
+
+  std::vector<uint8_t> subtree_;
+  MIBCachePolicy policy_;
+  LockStripes<Stripe> stripes_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> stale_hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> waits_;
+  std::atomic<uint64_t> refreshes_;
+  std::atomic<uint64_t> entries_;
+  std::atomic<uint64_t> load_us_;
+  std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> load_latency_;
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_MIB_CACHE_HPP
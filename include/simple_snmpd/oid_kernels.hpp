@@ -0,0 +1,63 @@
+/*
+ * include/simple_snmpd/oid_kernels.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_OID_KERNELS_HPP
+#define SIMPLE_SNMPD_OID_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_snmpd {
+
+// Instruction set tiers of the OID kernels, in increasing order
+enum class OIDKernelLevel { SCALAR = 0, SSE42, AVX2 };
+
+// Byte and arc kernels behind OID comparison and decoding, in one table
+// per instruction set tier. The vector tiers are compiled with function
+// target attributes and picked at runtime from the CPU's features, so the
+// binary needs no special compiler flags and runs anywhere. Every tier
+// returns the same results; the scalar tier is used off x86 and still
+// steps eight bytes at a time where it can.
+struct OIDKernels {
+  // Index of the first byte at which a and b differ, or length
+  size_t (*mismatch)(const uint8_t *a, const uint8_t *b, size_t length);
+
+  // Index of the first arc at which a and b differ, or length
+  size_t (*mismatch_arcs)(const uint32_t *a, const uint32_t *b,
+                          size_t length);
+
+  // Decode BER sub-identifiers into arcs, which needs room for length
+  // entries. False for a truncated sub-identifier or one over 32 bits.
+  bool (*decode)(const uint8_t *oid, size_t length, uint32_t *arcs,
+                 size_t &count);
+
+  // Best tier this CPU supports, detected once
+  static OIDKernelLevel detected_level();
+
+  // Kernels of level, or of the best supported tier below it
+  static const OIDKernels &get(OIDKernelLevel level);
+
+  // Kernels of the detected tier
+  static const OIDKernels &active();
+
+  static const char *level_name(OIDKernelLevel level);
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_OID_KERNELS_HPP
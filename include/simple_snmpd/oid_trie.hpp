@@ -0,0 +1,114 @@
+/*
+ * include/simple_snmpd/oid_trie.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_OID_TRIE_HPP
+#define SIMPLE_SNMPD_OID_TRIE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace simple_snmpd {
+
+// Ordered set of BER-encoded OIDs in a radix trie over decoded arcs.
+// Chains of single-child nodes are collapsed into one edge labelled with
+// all of their arcs, so a lookup or successor search visits at most one
+// node per branching point and compares arcs, not bytes, in OID order.
+// Each OID gets a slot number on insertion (0, 1, 2, ... in insertion
+// order) that callers use to index their own storage; slots are also
+// linked in OID order, so stepping forward or back is constant time.
+//
+// Inserting shifts the children of the node the OID lands under, so it
+// costs O(depth + fanout); registering in OID order only ever appends.
+//
+// Lookups are const and may run concurrently; insertion is not
+// synchronized with them.
+class OIDTrie {
+public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  OIDTrie();
+  ~OIDTrie();
+
+  // Deep copy, for building a changed version next to a published one
+  OIDTrie(const OIDTrie &other);
+  OIDTrie &operator=(const OIDTrie &) = delete;
+
+  // Slot of oid, adding it with slot size() first if it is new
+  size_t insert(const std::vector<uint8_t> &oid);
+
+  // Slot of oid, or npos
+  size_t find(const std::vector<uint8_t> &oid) const;
+
+  // Slot of the first OID ordered after oid, or npos
+  size_t upper_bound(const std::vector<uint8_t> &oid) const;
+
+  // Neighbours in OID order, npos past either end; prev(npos) is the
+  // last slot
+  size_t first() const { return head_; }
+  size_t next(size_t slot) const { return entries_[slot].next; }
+  size_t prev(size_t slot) const {
+    return slot == npos ? tail_ : entries_[slot].prev;
+  }
+
+  const std::vector<uint8_t> &oid(size_t slot) const {
+    return entries_[slot].oid;
+  }
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+
+private:
+  struct Node {
+    std::vector<uint32_t> label; // arcs from the parent to this node
+
+    // Children ordered by the first arc of their label, which is kept
+    // apart so the binary search runs over a dense array
+    std::vector<uint32_t> arcs;
+    std::vector<std::unique_ptr<Node>> children;
+    size_t slot; // npos unless an OID ends here
+
+    Node() : slot(npos) {}
+
+    // Index of the first child whose arc is not below arc
+    size_t lower_bound(uint32_t arc) const;
+  };
+
+  struct Entry {
+    std::vector<uint8_t> oid;
+    size_t prev;
+    size_t next;
+  };
+
+  // First slot in node's subtree
+  static size_t leftmost(const Node *node);
+  static std::unique_ptr<Node> clone(const Node &node);
+
+  // Node whose path spells arcs exactly, or null
+  const Node *find_node(const uint32_t *arcs, size_t count) const;
+  size_t upper_bound(const uint32_t *arcs, size_t count) const;
+
+  std::unique_ptr<Node> root_;
+  std::vector<Entry> entries_;
+  size_t head_;
+  size_t tail_;
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_OID_TRIE_HPP
@@ -0,0 +1,94 @@
+/*
+ * include/simple_snmpd/request_context.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_REQUEST_CONTEXT_HPP
+#define SIMPLE_SNMPD_REQUEST_CONTEXT_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <sys/types.h>
+#endif
+
+namespace simple_snmpd {
+
+// Binary IPv4 or IPv6 address used by access control and rate limiting.
+// IPv4-mapped IPv6 addresses are stored as IPv4 so that a dual-stack
+// socket matches the same rules as an IPv4 one.
+struct NetworkAddress {
+  uint8_t family; // AF_INET, AF_INET6 or AF_UNSPEC
+  uint8_t length; // 4 or 16 significant bytes
+  uint8_t bytes[16];
+
+  NetworkAddress() : family(AF_UNSPEC), length(0), bytes() {}
+
+  // Build from a socket address; returns false for unsupported families
+  static bool from_sockaddr(const struct sockaddr_storage &address,
+                            socklen_t address_length, NetworkAddress &result);
+
+  // Parse a numeric IPv4 or IPv6 address
+  static bool parse(const std::string &text, NetworkAddress &result);
+
+  // True when the first prefix_length bits equal those of network
+  bool in_network(const NetworkAddress &network, uint32_t prefix_length) const;
+
+  std::string to_string() const;
+
+  bool operator==(const NetworkAddress &other) const;
+  bool operator!=(const NetworkAddress &other) const {
+    return !(*this == other);
+  }
+};
+
+struct NetworkAddressHash {
+  size_t operator()(const NetworkAddress &address) const;
+};
+
+// Per-datagram request state. It is built on the stack by the thread that
+// processes the datagram and passed by reference through the security and
+// PDU processing paths. Addresses stay binary; text is produced only when
+// a log line is actually written.
+struct RequestContext {
+  struct sockaddr_storage address;
+  socklen_t address_length;
+  NetworkAddress source;
+  std::chrono::steady_clock::time_point received;
+  // Kernel arrival time in CLOCK_REALTIME nanoseconds (0 when unknown)
+  uint64_t arrival_ns;
+  uint32_t shard_id;
+
+  RequestContext(const struct sockaddr_storage &peer, socklen_t peer_length,
+                 std::chrono::steady_clock::time_point received_at,
+                 uint32_t shard);
+
+  uint16_t port() const;
+
+  // "192.0.2.1" or "2001:db8::1"
+  std::string address_string() const;
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_REQUEST_CONTEXT_HPP
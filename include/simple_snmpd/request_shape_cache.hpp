@@ -0,0 +1,105 @@
+/*
+ * include/simple_snmpd/request_shape_cache.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_REQUEST_SHAPE_CACHE_HPP
+#define SIMPLE_SNMPD_REQUEST_SHAPE_CACHE_HPP
+
+#include "lock_stripes.hpp"
+#include "snmp_mib.hpp"
+#include "snmp_packet.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace simple_snmpd {
+
+// MIB handles resolved for the variable binding lists of GET requests.
+// Pollers send the same list of OIDs every interval; a repeated list is
+// answered through the handles resolved the first time, skipping OID
+// decoding and the MIB search for every binding. Entries record the MIB
+// generation they were resolved against and are dropped once it changes.
+// Safe for concurrent use by shard and worker threads.
+class RequestShapeCache {
+public:
+  struct Statistics {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t invalidations;
+    uint64_t evictions;
+    uint64_t entries;
+
+    Statistics()
+        : hits(0), misses(0), insertions(0), invalidations(0), evictions(0),
+          entries(0) {}
+  };
+
+  RequestShapeCache();
+
+  // Zero entries disables the cache
+  void configure(size_t max_entries);
+
+  bool is_enabled() const { return stripe_capacity_ != 0; }
+
+  // Hash of the OIDs of a request's variable bindings; values are ignored
+  static uint64_t hash(const SNMPPacketView &request);
+
+  // Copy the handles cached for exactly these OIDs into handles. A miss
+  // when there are none, or when they were resolved against an older
+  // generation, in which case the entry is dropped.
+  bool lookup(uint64_t hash, const SNMPPacketView &request,
+              uint64_t generation, std::vector<MIBManager::Handle> &handles);
+
+  void insert(uint64_t hash, const SNMPPacketView &request,
+              uint64_t generation,
+              const std::vector<MIBManager::Handle> &handles);
+
+  Statistics get_statistics() const;
+
+private:
+  struct Entry {
+    uint64_t generation;
+    std::vector<std::vector<uint8_t>> oids;
+    std::vector<MIBManager::Handle> handles;
+  };
+
+  // A full stripe evicts an arbitrary entry, since the shapes a
+  // deployment polls with are few and long-lived
+  struct Stripe {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+  };
+
+  static bool same_oids(const Entry &entry, const SNMPPacketView &request);
+
+  size_t stripe_capacity_;
+  LockStripes<Stripe> stripes_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> insertions_;
+  std::atomic<uint64_t> invalidations_;
+  std::atomic<uint64_t> evictions_;
+  std::atomic<uint64_t> entries_;
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_REQUEST_SHAPE_CACHE_HPP
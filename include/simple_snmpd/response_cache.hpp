@@ -0,0 +1,125 @@
+/*
+ * include/simple_snmpd/response_cache.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_RESPONSE_CACHE_HPP
+#define SIMPLE_SNMPD_RESPONSE_CACHE_HPP
+
+#include "lock_stripes.hpp"
+#include "request_context.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace simple_snmpd {
+
+// Short-lived cache of encoded responses for manager retransmissions. A
+// manager that times out resends the same message with the same
+// request-id; the cached response is sent again instead of processing the
+// request a second time, which also makes a retransmitted SET idempotent.
+// Lookups read the message header straight from the datagram, so a hit
+// costs neither a full parse nor a MIB walk. Safe for concurrent use by
+// shard and worker threads.
+class ResponseCache {
+public:
+  struct Key {
+    NetworkAddress source;
+    uint16_t port;
+    uint32_t request_id;
+    uint64_t community_hash;
+
+    bool operator==(const Key &other) const {
+      return port == other.port && request_id == other.request_id &&
+             community_hash == other.community_hash &&
+             source == other.source;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+
+  struct Statistics {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;
+    uint64_t entries;
+
+    Statistics()
+        : hits(0), misses(0), insertions(0), evictions(0), entries(0) {}
+  };
+
+  ResponseCache();
+
+  // A zero ttl disables the cache
+  void configure(std::chrono::milliseconds ttl, size_t max_entries);
+
+  bool is_enabled() const { return ttl_ns_ != 0; }
+
+  // Build the cache key of an SNMPv1/v2c request and a digest of the whole
+  // message. Returns false for other versions, PDUs that are not requests,
+  // and anything that does not decode.
+  static bool make_key(const RequestContext &context, const uint8_t *data,
+                       size_t length, Key &key, uint64_t &digest);
+
+  // Copy the cached response of a retransmitted request into buffer and
+  // return its length, or 0 when there is no live entry for the same
+  // message (a reused request-id with a different digest is a miss)
+  size_t lookup(const Key &key, uint64_t digest, uint8_t *buffer,
+                size_t capacity);
+
+  void insert(const Key &key, uint64_t digest, const uint8_t *response,
+              size_t length);
+
+  Statistics get_statistics() const;
+
+private:
+  struct Entry {
+    uint64_t digest;
+    std::chrono::steady_clock::time_point expires;
+    std::vector<uint8_t> response;
+  };
+
+  // Each stripe evicts in insertion order, which is also expiry order
+  // since every entry lives for the same ttl
+  struct Stripe {
+    std::mutex mutex;
+    std::unordered_map<Key, Entry, KeyHash> entries;
+    std::deque<std::pair<Key, std::chrono::steady_clock::time_point>> order;
+  };
+
+  void evict(Stripe &stripe, std::chrono::steady_clock::time_point now);
+
+  uint64_t ttl_ns_;
+  size_t stripe_capacity_;
+  LockStripes<Stripe> stripes_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> insertions_;
+  std::atomic<uint64_t> evictions_;
+  std::atomic<uint64_t> entries_;
+};
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_RESPONSE_CACHE_HPP
@@ -21,6 +21,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace simple_snmpd {
 
@@ -34,6 +35,7 @@ public:
 
   // Getters
   uint16_t get_port() const;
+  const std::vector<std::string> &get_bind_addresses() const;
   const std::string &get_community() const;
   uint32_t get_max_connections() const;
   uint32_t get_timeout_seconds() const;
@@ -41,9 +43,36 @@ public:
   bool is_ipv6_enabled() const;
   bool is_trap_enabled() const;
   uint16_t get_trap_port() const;
+  uint32_t get_io_batch_size() const;
+  uint32_t get_listener_shards() const;
+  bool is_shard_cpu_affinity_enabled() const;
+  const std::string &get_io_backend() const;
+  uint32_t get_worker_threads() const;
+  uint32_t get_dispatch_queue_depth() const;
+  bool is_tcp_enabled() const;
+  uint32_t get_tcp_max_message_size() const;
+  uint32_t get_max_response_size() const;
+  uint32_t get_receive_buffer_size() const;
+  bool is_receive_buffer_auto() const;
+  uint32_t get_receive_buffer_max() const;
+  bool is_load_shedding_enabled() const;
+  uint32_t get_shed_target_us() const;
+  uint32_t get_shed_interval_ms() const;
+  uint32_t get_shed_bulk_cost() const;
+  const std::vector<std::string> &get_priority_communities() const;
+  const std::vector<std::string> &get_low_priority_communities() const;
+  uint32_t get_response_cache_ttl_ms() const;
+  uint32_t get_response_cache_entries() const;
+  uint32_t get_shape_cache_entries() const;
+  bool is_fair_queueing_enabled() const;
+  uint32_t get_fair_queue_quantum() const;
+  uint32_t get_fair_queue_flow_depth() const;
+  const std::vector<std::string> &get_fair_queue_weights() const;
+  const std::vector<std::string> &get_mib_cache_rules() const;
 
   // Setters
   void set_port(uint16_t port);
+  void set_bind_addresses(const std::vector<std::string> &addresses);
   void set_community(const std::string &community);
   void set_max_connections(uint32_t max_connections);
   void set_timeout_seconds(uint32_t timeout_seconds);
@@ -51,12 +80,40 @@ public:
   void set_ipv6_enabled(bool enabled);
   void set_trap_enabled(bool enabled);
   void set_trap_port(uint16_t port);
+  void set_io_batch_size(uint32_t batch_size);
+  void set_listener_shards(uint32_t shards);
+  void set_shard_cpu_affinity(bool enabled);
+  void set_io_backend(const std::string &backend);
+  void set_worker_threads(uint32_t threads);
+  void set_dispatch_queue_depth(uint32_t depth);
+  void set_tcp_enabled(bool enabled);
+  void set_tcp_max_message_size(uint32_t max_size);
+  void set_max_response_size(uint32_t max_size);
+  void set_receive_buffer_size(uint32_t size);
+  void set_receive_buffer_auto(bool enabled);
+  void set_receive_buffer_max(uint32_t size);
+  void set_load_shedding_enabled(bool enabled);
+  void set_shed_target_us(uint32_t target_us);
+  void set_shed_interval_ms(uint32_t interval_ms);
+  void set_shed_bulk_cost(uint32_t cost);
+  void set_priority_communities(const std::vector<std::string> &communities);
+  void
+  set_low_priority_communities(const std::vector<std::string> &communities);
+  void set_response_cache_ttl_ms(uint32_t ttl_ms);
+  void set_response_cache_entries(uint32_t entries);
+  void set_shape_cache_entries(uint32_t entries);
+  void set_fair_queueing_enabled(bool enabled);
+  void set_fair_queue_quantum(uint32_t quantum);
+  void set_fair_queue_flow_depth(uint32_t depth);
+  void set_fair_queue_weights(const std::vector<std::string> &weights);
+  void set_mib_cache_rules(const std::vector<std::string> &rules);
 
 private:
   bool parse_config_value(const std::string &key, const std::string &value);
 
   // Configuration parameters
   uint16_t port_;
+  std::vector<std::string> bind_addresses_;
   std::string community_;
   uint32_t max_connections_;
   uint32_t timeout_seconds_;
@@ -64,6 +121,32 @@ private:
   bool enable_ipv6_;
   bool enable_trap_;
   uint16_t trap_port_;
+  uint32_t io_batch_size_;
+  uint32_t listener_shards_;
+  bool shard_cpu_affinity_;
+  std::string io_backend_;
+  uint32_t worker_threads_;
+  uint32_t dispatch_queue_depth_;
+  bool enable_tcp_;
+  uint32_t tcp_max_message_size_;
+  uint32_t max_response_size_;
+  uint32_t receive_buffer_size_;
+  bool receive_buffer_auto_;
+  uint32_t receive_buffer_max_;
+  bool load_shedding_;
+  uint32_t shed_target_us_;
+  uint32_t shed_interval_ms_;
+  uint32_t shed_bulk_cost_;
+  std::vector<std::string> priority_communities_;
+  std::vector<std::string> low_priority_communities_;
+  uint32_t response_cache_ttl_ms_;
+  uint32_t response_cache_entries_;
+  uint32_t shape_cache_entries_;
+  bool fair_queueing_;
+  uint32_t fair_queue_quantum_;
+  uint32_t fair_queue_flow_depth_;
+  std::vector<std::string> fair_queue_weights_;
+  std::vector<std::string> mib_cache_rules_;
 };
 
 } // namespace simple_snmpd
@@ -23,6 +23,15 @@
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <sys/types.h>
+#endif
 
 namespace simple_snmpd {
 
@@ -30,6 +39,8 @@ class SNMPConnection {
 public:
   SNMPConnection(int socket_fd, const std::string &client_address,
                  uint16_t client_port);
+  SNMPConnection(int socket_fd, const struct sockaddr_storage &peer,
+                 socklen_t peer_length);
   ~SNMPConnection();
 
   // Connection management
@@ -37,10 +48,25 @@ public:
   bool receive_request(SNMPPacket &packet);
   void close();
 
+  // Stream transport (RFC 3430): non-blocking reads and writes with BER
+  // framing, so several requests can be pipelined on one connection.
+  // read_available returns false once the connection should be closed.
+  bool read_available();
+  // 1 when a complete message is available, 0 when more data is needed,
+  // -1 when the stream is not valid BER or the message is too large
+  int next_message(const uint8_t *&data, size_t &length);
+  void consume_message();
+  void queue_output(const uint8_t *data, size_t length);
+  bool flush_output();
+  size_t pending_output() const;
+  void set_max_message_size(size_t max_size);
+
   // Connection information
   bool is_connected() const;
   const std::string &get_client_address() const;
   uint16_t get_client_port() const;
+  const struct sockaddr_storage &get_peer_address() const;
+  socklen_t get_peer_address_length() const;
   std::chrono::steady_clock::time_point get_last_activity() const;
   bool is_timeout(uint32_t timeout_seconds) const;
 
@@ -55,6 +81,16 @@ private:
   uint16_t client_port_;
   bool connected_;
   std::chrono::steady_clock::time_point last_activity_;
+  struct sockaddr_storage peer_;
+  socklen_t peer_length_;
+
+  // Stream buffers; consumed bytes are compacted away lazily
+  std::vector<uint8_t> input_;
+  size_t input_start_;
+  size_t message_length_;
+  std::vector<uint8_t> output_;
+  size_t output_start_;
+  size_t max_message_size_;
 };
 
 } // namespace simple_snmpd
@@ -19,10 +19,14 @@
 #ifndef SIMPLE_SNMPD_SNMP_MIB_HPP
 #define SIMPLE_SNMPD_SNMP_MIB_HPP
 
+#include "simple_snmpd/epoch.hpp"
+#include "simple_snmpd/mib_cache.hpp"
+#include "simple_snmpd/oid_trie.hpp"
+#include <atomic>
 #include <cstdint>
 #include <functional>
-#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -34,10 +38,17 @@ enum class SNMPDataType {
   OCTET_STRING = 0x04,
   NULL_TYPE = 0x05,
   OBJECT_IDENTIFIER = 0x06,
+  IP_ADDRESS = 0x40,
   COUNTER32 = 0x41,
   GAUGE32 = 0x42,
   TIME_TICKS = 0x43,
-  COUNTER64 = 0x46
+  OPAQUE = 0x44,
+  COUNTER64 = 0x46,
+
+  // SNMPv2 exceptions: NULL contents in place of a value (RFC 3416)
+  NO_SUCH_OBJECT = 0x80,
+  NO_SUCH_INSTANCE = 0x81,
+  END_OF_MIB_VIEW = 0x82
 };
 
 // MIB value structure
@@ -93,14 +104,150 @@ struct MIBTableEntry {
       : oid(o), name(n), type(t), read_only(ro) {}
 };
 
-// MIB manager class
+// Index of a table row: the sub-identifiers that follow a column OID in
+// an instance name (RFC 2578 section 7.7)
+using MIBIndex = std::vector<uint32_t>;
+
+// One row of a MIBTable: its index and a value per column, in column
+// order. A NULL_TYPE value marks a cell the row does not have.
+struct MIBRow {
+  MIBIndex index;
+  std::vector<MIBValue> values;
+};
+
+// Supplies the rows of a MIBTable a whole row, or a batch of rows, per
+// call. Called from request threads concurrently.
+class MIBRowProvider {
+public:
+  virtual ~MIBRowProvider() = default;
+
+  // The row with exactly this index; false when there is none
+  virtual bool get_row(const MIBIndex &index, MIBRow &row) const = 0;
+
+  // Fill rows with up to limit rows whose indexes come after *after
+  // (from the first row when after is null), in increasing index order,
+  // resizing it to the number found. Assigning over the rows it already
+  // holds reuses their storage from one batch to the next.
+  virtual void get_rows(const MIBIndex *after, size_t limit,
+                        std::vector<MIBRow> &rows) const = 0;
+
+  // Write one cell; tables are read-only unless this is overridden
+  virtual bool set_cell(const MIBIndex &index, size_t column,
+                        const MIBValue &value);
+};
+
+// A column of a MIBTable, by its arc under the table's entry OID
+struct MIBColumn {
+  uint32_t arc;
+  std::string name;
+  SNMPDataType type;
+  bool read_only;
+
+  MIBColumn() : arc(0), type(SNMPDataType::NULL_TYPE), read_only(true) {}
+  MIBColumn(uint32_t a, const std::string &n, SNMPDataType t, bool ro = true)
+      : arc(a), name(n), type(t), read_only(ro) {}
+};
+
+// Table with sparse or multi-component indexes (IP addresses, strings,
+// compound keys), registered once for all of its columns
+struct MIBTable {
+  std::vector<uint8_t> entry_oid; // the conceptual row, e.g. ipAddrEntry
+  std::string name;
+  std::vector<MIBColumn> columns;
+  std::shared_ptr<MIBRowProvider> provider;
+};
+
+// Row provider over rows kept sorted by index in one contiguous array,
+// for tables refreshed as a whole. Lookups are binary searches; set_rows()
+// publishes a new array the way MIBManager publishes versions, so readers
+// never lock.
+class SortedRowProvider : public MIBRowProvider {
+public:
+  SortedRowProvider();
+  ~SortedRowProvider() override;
+  SortedRowProvider(const SortedRowProvider &) = delete;
+  SortedRowProvider &operator=(const SortedRowProvider &) = delete;
+
+  // Replace all rows; they need not be in order, and a later row replaces
+  // an earlier one with the same index
+  void set_rows(std::vector<MIBRow> rows);
+  size_t size() const;
+
+  bool get_row(const MIBIndex &index, MIBRow &row) const override;
+  void get_rows(const MIBIndex *after, size_t limit,
+                std::vector<MIBRow> &rows) const override;
+
+private:
+  std::atomic<const std::vector<MIBRow> *> rows_;
+};
+
+// Index components to and from sub-identifiers (RFC 2578 section 7.7)
+class IndexUtils {
+public:
+  static void append_integer(MIBIndex &index, uint32_t value);
+
+  // Four arcs, most significant octet first
+  static void append_ip_address(MIBIndex &index, uint32_t address);
+
+  // The length, then one arc per octet. Implied strings (the IMPLIED last
+  // component, or a fixed-size one) leave out the length.
+  static void append_string(MIBIndex &index, const std::string &value,
+                            bool implied = false);
+
+  // Read the component at position and move past it; false when the
+  // index ends early or an arc is out of range for the component
+  static bool read_integer(const MIBIndex &index, size_t &position,
+                           uint32_t &value);
+  static bool read_ip_address(const MIBIndex &index, size_t &position,
+                              uint32_t &address);
+  static bool read_string(const MIBIndex &index, size_t &position,
+                          std::string &value, bool implied = false);
+};
+
+// Orders BER-encoded OIDs by their sub-identifiers. Plain byte order
+// differs once sub-identifiers of different encoded lengths meet (arc 256
+// encodes as 82 00 but arc 16384 as 81 80 00).
+struct OIDLess {
+  bool operator()(const std::vector<uint8_t> &oid1,
+                  const std::vector<uint8_t> &oid2) const;
+};
+
+// MIB manager class. Scalars are registered by instance OID and tables by
+// column OID, with rows 1..max_index or rows from a MIBRowProvider, all in
+// one trie over decoded arcs, so a lookup or GETNEXT costs O(OID depth)
+// however many objects are registered. Walking a provider's column reads
+// rows in batches that grow as the walk goes on, so a long walk makes one
+// provider call per batch rather than one per cell.
+//
+// Readers never lock. Registrations publish a new immutable version of
+// the MIB with read-copy-update: the writer copies the current version,
+// changes the copy and swaps it in atomically, and the old version is
+// freed through EpochManager once no reader can still be using it. Every
+// lookup pins an epoch for its own duration; a Cursor pins one for its
+// lifetime, and Handles are read under a guard (see resolve()).
 class MIBManager {
 public:
+  class Cursor;
+  class Handle;
+  class Update;
+
   static MIBManager &get_instance();
 
   // MIB registration
   void register_scalar(const MIBEntry &entry);
   void register_table(const MIBTableEntry &entry, uint32_t max_index);
+  void register_table(const MIBTable &table);
+
+  // Serve values under subtree (a scalar, a column, a table or any
+  // subtree holding them) from a MIBCache with this policy, replacing any
+  // policy set for the same subtree. Applies to objects registered before
+  // and after; the most specific policy covering an object wins. A
+  // MIBTable is cached as a whole, one provider call per refresh.
+  void set_cache_policy(const std::vector<uint8_t> &subtree,
+                        const MIBCachePolicy &policy);
+
+  // Caches of the published MIB, for their statistics
+  std::vector<std::shared_ptr<const MIBCache>> get_caches() const;
 
   // MIB lookup
   bool get_value(const std::vector<uint8_t> &oid, MIBValue &value) const;
@@ -108,35 +255,219 @@ public:
   bool get_next_oid(const std::vector<uint8_t> &oid,
                     std::vector<uint8_t> &next_oid) const;
 
+  // Resolve oid once and read it through the handle afterwards, without
+  // decoding or searching again. Handles stay valid until generation()
+  // changes, and a thread reading one must hold an EpochManager::Guard
+  // taken before it read generation() or resolved the handle, so the
+  // version the handle points into cannot be freed under it. resolve()
+  // leaves an invalid handle when oid names no instance; in a MIBTable
+  // column the handle is valid for any index, and reading it fails when
+  // the provider has no such row.
+  void resolve(const std::vector<uint8_t> &oid, Handle &handle) const;
+  bool get_value(const Handle &handle, MIBValue &value) const;
+
+  // Version of the published MIB, incremented by every Update
+  uint64_t generation() const;
+
   // MIB information
   bool is_scalar(const std::vector<uint8_t> &oid) const;
   bool is_table(const std::vector<uint8_t> &oid) const;
+
+  // True when oid is an existing instance that set_value() can write:
+  // not read-only, and a scalar or column with a setter or provider
+  bool is_writable(const std::vector<uint8_t> &oid) const;
+
+  // True when oid falls under a registered object type, whether or not
+  // the instance exists: noSuchInstance rather than noSuchObject
+  bool has_object(const std::vector<uint8_t> &oid) const;
   uint32_t get_table_size(const std::vector<uint8_t> &table_oid) const;
 
   // Initialize standard MIBs
   void initialize_standard_mibs();
 
 private:
-  MIBManager() = default;
-  ~MIBManager() = default;
+  MIBManager();
+  ~MIBManager();
   MIBManager(const MIBManager &) = delete;
   MIBManager &operator=(const MIBManager &) = delete;
 
-  // MIB storage
-  std::map<std::vector<uint8_t>, MIBEntry> scalar_entries_;
-  std::map<std::vector<uint8_t>, MIBTableEntry> table_entries_;
-  std::map<std::vector<uint8_t>, uint32_t> table_sizes_;
+  // A registered scalar instance or table column. Columns of a MIBTable
+  // also carry the table and their position in it, and have no rows.
+  // cache is set when a cache policy covers the object.
+  struct Object {
+    bool table;
+    MIBEntry scalar;
+    MIBTableEntry column;
+    uint32_t rows;
+    std::shared_ptr<const MIBTable> indexed;
+    size_t column_index;
+    std::shared_ptr<MIBCache> cache;
+
+    Object() : table(false), rows(0), column_index(0) {}
+  };
 
-  // Helper functions
-  bool oid_matches(const std::vector<uint8_t> &oid,
-                   const std::vector<uint8_t> &pattern) const;
-  bool oid_less_than(const std::vector<uint8_t> &oid1,
-                     const std::vector<uint8_t> &oid2) const;
+  // One published state of the MIB, never changed after publication.
+  // Scalars and table columns share one OID-ordered index, so lookups
+  // and walks search a single structure; objects is indexed by trie slot.
+  // Objects are shared between versions, so copying a version to change
+  // it copies the index and pointers but no registrations.
+  struct Version {
+    OIDTrie index;
+    std::vector<std::shared_ptr<const Object>> objects;
+    std::vector<std::shared_ptr<MIBCache>> caches;
+    uint64_t generation;
+
+    Version() : generation(0) {}
+  };
+
+  std::atomic<const Version *> version_;
+
+  // Held by the open Update; pending_ is the copy it is changing
+  std::recursive_mutex update_mutex_;
+  std::unique_ptr<Version> pending_;
+  unsigned update_depth_;
+
+  // Caller holds an EpochManager::Guard
+  const Version &current() const {
+    return *version_.load(std::memory_order_acquire);
+  }
+
+  static bool read_object(const Object &object, uint32_t row,
+                          const MIBIndex &index, MIBValue &value);
+  static bool read_cached(const Object &object, uint32_t row,
+                          MIBValue &value);
+
+  // Rows of a MIBTable column's table, from the cached copy of the whole
+  // table when the column has a cache
+  static bool get_row(const Object &object, const MIBIndex &index,
+                      MIBRow &row);
+  static void get_rows(const Object &object, const MIBIndex *after,
+                       size_t limit, std::vector<MIBRow> &rows);
+
+  // Most specific cache covering oid, or null
+  static std::shared_ptr<MIBCache> cache_for(const Version &version,
+                                             const std::vector<uint8_t> &oid);
+
+  void register_object(const std::vector<uint8_t> &oid,
+                       const Object &object);
+
+  // Slot of the registration holding oid (a scalar instance or a row of
+  // a column) and the row it names, or OIDTrie::npos; rows start at 1
+  // and scalars report 0. For a MIBTable column this is the index, and
+  // the row it names may not exist.
+  static size_t find_instance(const Version &version,
+                              const std::vector<uint8_t> &oid,
+                              uint32_t &row, MIBIndex &row_index);
   void initialize_system_mib();
   void initialize_interface_mib();
+  void initialize_ip_mib();
   void initialize_snmp_mib();
 };
 
+// Registrations made while an Update is open, on the thread that opened
+// it, are published together as one new version when the outermost
+// Update closes; concurrent writers wait for it. register_scalar() and
+// register_table() open their own, so a lone call publishes at once.
+// SETs go through the registered setters and publish nothing.
+class MIBManager::Update {
+public:
+  explicit Update(MIBManager &mib);
+  ~Update();
+  Update(const Update &) = delete;
+  Update &operator=(const Update &) = delete;
+
+private:
+  MIBManager &mib_;
+};
+
+// A registered instance resolved by MIBManager::resolve(): the
+// registration holding it and its row, or its index in a MIBTable
+class MIBManager::Handle {
+public:
+  Handle() : object_(nullptr), row_(0) {}
+
+  bool valid() const { return object_ != nullptr; }
+
+private:
+  friend class MIBManager;
+
+  const Object *object_;
+  uint32_t row_;
+  MIBIndex index_;
+};
+
+// Forward walk over registered instances in OID order. Positioning costs
+// one trie search; every step after that is constant time, so a GETBULK
+// repeater walks a table column without searching again for each row.
+// Each stop yields the instance OID, its registration and its value.
+// A cursor walks the version published when it was created and keeps
+// it pinned, so it should not outlive the request that made it.
+class MIBManager::Cursor {
+public:
+  // Where a cursor stood, to continue the walk later. resume() restores
+  // it directly while the MIB generation is unchanged and searches for
+  // the OID again otherwise, or when it was in a MIBTable.
+  struct Position {
+    std::vector<uint8_t> oid;
+    uint64_t generation;
+    size_t slot;
+    uint32_t row;
+
+    Position() : generation(0), slot(OIDTrie::npos), row(0) {}
+  };
+
+  explicit Cursor(const MIBManager &mib);
+
+  // Position on the first instance after oid; false past the last one
+  bool seek_after(const std::vector<uint8_t> &oid);
+
+  // Step to the following instance; false past the last one
+  bool next();
+
+  // Value of the current instance, stepping over instances that cannot
+  // be read; false once the walk is past the last one
+  bool read(MIBValue &value);
+
+  bool valid() const { return valid_; }
+  const std::vector<uint8_t> &oid() const { return oid_; }
+  bool get_value(MIBValue &value) const;
+
+  // Registration of the current instance
+  const std::string &name() const;
+  SNMPDataType type() const;
+  Handle handle() const;
+
+  Position save() const;
+
+  // Back on the saved instance, or the first one after it if it has
+  // gone; false past the last one
+  bool resume(const Position &position);
+
+private:
+  // Stop on the first instance at or after slot_
+  bool settle();
+  void set_row(uint32_t row);
+
+  // MIBTable columns: fetch the next batch of rows after *after, then
+  // stop on the first one with a cell in this column, fetching further
+  // batches as needed; false when the column has no more
+  void fetch_rows(const MIBIndex *after);
+  bool skip_absent();
+  const MIBValue &cell() const;
+
+  EpochManager::Guard guard_;
+  const Version *version_;
+  size_t slot_;
+  uint32_t row_;
+  std::vector<uint8_t> oid_;
+  bool valid_;
+
+  // Current batch of a MIBTable column and the position in it
+  std::vector<MIBRow> rows_;
+  size_t position_;
+  size_t batch_;
+};
+
 // OID utility functions
 class OIDUtils {
 public:
@@ -156,6 +487,17 @@ public:
   // Compare two OIDs
   static int compare_oids(const std::vector<uint8_t> &oid1,
                           const std::vector<uint8_t> &oid2);
+
+  // Sub-identifiers of oid as 32-bit arcs (the first holds the first two
+  // arcs, as encoded); false for a truncated or over-wide sub-identifier
+  static bool decode_arcs(const std::vector<uint8_t> &oid,
+                          std::vector<uint32_t> &arcs);
+
+  // compare_oids and is_prefix over decoded arcs
+  static int compare_arcs(const std::vector<uint32_t> &arcs1,
+                          const std::vector<uint32_t> &arcs2);
+  static bool is_arc_prefix(const std::vector<uint32_t> &arcs1,
+                            const std::vector<uint32_t> &arcs2);
 };
 
 } // namespace simple_snmpd
@@ -25,6 +25,8 @@
 
 namespace simple_snmpd {
 
+class BerEncoder;
+
 // SNMP version constants
 constexpr uint8_t SNMP_VERSION_1 = 0;
 constexpr uint8_t SNMP_VERSION_2C = 1;
@@ -62,6 +64,150 @@ constexpr uint8_t SNMP_ERROR_AUTHORIZATION_ERROR = 16;
 constexpr uint8_t SNMP_ERROR_NOT_WRITABLE = 17;
 constexpr uint8_t SNMP_ERROR_INCONSISTENT_NAME = 18;
 
+// Why a message was rejected by parse()
+enum class ParseError : uint8_t {
+  NONE = 0,
+  EMPTY,          // no data at all
+  TRUNCATED,      // a length runs past the end of its enclosing value
+  BAD_LENGTH,     // indefinite or over-long length encoding
+  UNEXPECTED_TAG, // a field does not have the type SNMP requires there
+  BAD_VERSION,    // version is not a one-octet INTEGER
+  BAD_INTEGER,    // a PDU header INTEGER empty or wider than 32 bits
+  TRAILING_DATA   // bytes after a complete message or variable binding
+};
+
+constexpr size_t SNMP_PARSE_ERRORS = 8;
+
+// Short lowercase name, used as a metric label
+const char *parse_error_name(ParseError error);
+
+// Outcome of parse(): the error and the offset of the TLV or byte it was
+// found at. Tests true on success.
+struct ParseResult {
+  ParseError error;
+  size_t offset;
+
+  ParseResult() : error(ParseError::NONE), offset(0) {}
+  ParseResult(ParseError e, size_t at) : error(e), offset(at) {}
+
+  explicit operator bool() const { return error == ParseError::NONE; }
+};
+
+// Message version without decoding the rest of the message: the outer
+// SEQUENCE must span the buffer and open with a one-octet INTEGER. Lets a
+// receiver pick the SNMPv1/v2c or SNMPv3 parser before parsing anything.
+ParseResult peek_message_version(const uint8_t *data, size_t length,
+                                 uint8_t &version);
+
+// Non-owning reference to a byte range inside a message buffer
+struct ByteSpan {
+  const uint8_t *data;
+  size_t length;
+
+  ByteSpan() : data(nullptr), length(0) {}
+  ByteSpan(const uint8_t *bytes, size_t size) : data(bytes), length(size) {}
+
+  const uint8_t *begin() const { return data; }
+  const uint8_t *end() const { return data + length; }
+  bool empty() const { return length == 0; }
+
+  bool operator==(const ByteSpan &other) const;
+  bool operator!=(const ByteSpan &other) const { return !(*this == other); }
+
+  std::vector<uint8_t> to_vector() const;
+  std::string to_string() const;
+};
+
+// Zero-copy parse of an SNMPv1/v2c message. parse() validates the whole
+// message without allocating; the community, OIDs and values it exposes
+// are spans into the parsed buffer and are valid only as long as that
+// buffer is alive and unmodified. Copy into an SNMPPacket to keep a
+// message beyond the lifetime of its receive buffer.
+class SNMPPacketView {
+public:
+  struct VariableBinding {
+    ByteSpan oid;
+    uint8_t value_type;
+    ByteSpan value;
+
+    VariableBinding() : value_type(0) {}
+  };
+
+  // Forward iterator decoding one variable binding at a time
+  class Iterator {
+  public:
+    const VariableBinding &operator*() const { return current_; }
+    const VariableBinding *operator->() const { return &current_; }
+    Iterator &operator++();
+    bool operator==(const Iterator &other) const {
+      return position_ == other.position_;
+    }
+    bool operator!=(const Iterator &other) const {
+      return position_ != other.position_;
+    }
+
+  private:
+    friend class SNMPPacketView;
+    Iterator(const uint8_t *position, const uint8_t *end);
+
+    const uint8_t *position_;
+    const uint8_t *next_;
+    const uint8_t *end_;
+    VariableBinding current_;
+  };
+
+  SNMPPacketView();
+
+  ParseResult parse(const uint8_t *data, size_t length);
+
+  // SNMPv3 message (RFC 3412 6) whose scoped PDU is in plaintext. The
+  // header and USM parameters are skipped, the message processor checks
+  // those; the PDU is read in place with the context fields standing in
+  // for the community. An encrypted scoped PDU fails with UNEXPECTED_TAG.
+  ParseResult parse_v3(const uint8_t *data, size_t length);
+
+  // A ScopedPDU SEQUENCE on its own, such as a decrypted one
+  ParseResult parse_scoped_pdu(const uint8_t *data, size_t length);
+
+  uint8_t get_version() const { return version_; }
+  uint8_t get_pdu_type() const { return pdu_type_; }
+  ByteSpan get_community() const { return community_; }
+  ByteSpan get_context_engine_id() const { return context_engine_id_; }
+  ByteSpan get_context_name() const { return context_name_; }
+  int32_t get_request_id() const { return request_id_; }
+  int32_t get_error_status() const { return error_status_; }
+  int32_t get_error_index() const { return error_index_; }
+  size_t get_variable_binding_count() const { return varbind_count_; }
+
+  // GETBULK carries non-repeaters and max-repetitions in the error status
+  // and index fields (RFC 3416 4.2.3); negative values count as zero
+  uint32_t get_non_repeaters() const;
+  uint32_t get_max_repetitions() const;
+
+  Iterator begin() const;
+  Iterator end() const;
+
+private:
+  void reset();
+  ParseResult parse_scoped(const uint8_t *base, const uint8_t *position,
+                           const uint8_t *end);
+  ParseResult parse_pdu(const uint8_t *base, const uint8_t *position,
+                        const uint8_t *end);
+
+  uint8_t version_;
+  uint8_t pdu_type_;
+  ByteSpan community_;
+  ByteSpan context_engine_id_;
+  ByteSpan context_name_;
+  int32_t request_id_;
+  int32_t error_status_;
+  int32_t error_index_;
+  ByteSpan varbinds_;
+  size_t varbind_count_;
+};
+
+// Owning SNMP message. parse() is a copying layer over SNMPPacketView for
+// code that keeps a message or builds a response from scratch.
 class SNMPPacket {
 public:
   struct VariableBinding {
@@ -74,50 +220,74 @@ public:
   ~SNMPPacket();
 
   // Packet parsing and serialization
-  bool parse(const uint8_t *data, size_t length);
+  ParseResult parse(const uint8_t *data, size_t length);
   bool serialize(std::vector<uint8_t> &buffer) const;
 
+  // Encode back to front into encoder's buffer in a single pass; false
+  // when the message does not fit
+  bool serialize(BerEncoder &encoder) const;
+
+  // The PDU alone, for an envelope other than the community message such
+  // as the SNMPv3 scoped PDU
+  bool serialize_pdu(BerEncoder &encoder) const;
+
+  // Exact size of the encoded message, kept up to date as variable
+  // bindings are added so responses can be built against a size budget
+  size_t encoded_size() const;
+
+  // Encoded size of one VarBind SEQUENCE
+  static size_t encoded_size(const VariableBinding &varbind);
+
+  // Copy every field of a parsed view
+  void assign(const SNMPPacketView &view);
+
   // Getters
   uint8_t get_version() const;
   uint8_t get_pdu_type() const;
   const std::string &get_community() const;
-  uint32_t get_request_id() const;
-  uint8_t get_error_status() const;
-  uint8_t get_error_index() const;
+  int32_t get_request_id() const;
+  int32_t get_error_status() const;
+  int32_t get_error_index() const;
   const std::vector<VariableBinding> &get_variable_bindings() const;
 
+  // GETBULK only; encoded in place of the error status and index
+  uint32_t get_non_repeaters() const;
+  uint32_t get_max_repetitions() const;
+
   // Setters
   void set_version(uint8_t version);
   void set_pdu_type(uint8_t pdu_type);
   void set_community(const std::string &community);
-  void set_request_id(uint32_t request_id);
-  void set_error_status(uint8_t error_status);
-  void set_error_index(uint8_t error_index);
+  void set_request_id(int32_t request_id);
+  void set_error_status(int32_t error_status);
+  void set_error_index(int32_t error_index);
+  void set_non_repeaters(uint32_t non_repeaters);
+  void set_max_repetitions(uint32_t max_repetitions);
   void add_variable_binding(const VariableBinding &varbind);
   void clear_variable_bindings();
 
+  // Drop the variable bindings after the first count
+  void truncate_variable_bindings(size_t count);
+
+  // Append varbind only if the encoded message stays within max_size
+  // bytes; otherwise leave the packet unchanged and return false
+  bool add_variable_binding(const VariableBinding &varbind, size_t max_size);
+
 private:
-  // ASN.1 parsing helpers
-  bool parse_length(const uint8_t *data, size_t length, size_t &offset,
-                    size_t &len);
-  bool parse_pdu_fields(const uint8_t *data, size_t &offset, size_t length);
-  bool parse_variable_bindings(const uint8_t *data, size_t &offset,
-                               size_t length);
-  bool parse_variable_binding(const uint8_t *data, size_t &offset,
-                              size_t length, VariableBinding &varbind);
-
-  // ASN.1 serialization helpers
-  bool serialize_pdu_fields(std::vector<uint8_t> &buffer) const;
-  bool serialize_variable_bindings(std::vector<uint8_t> &buffer) const;
+  size_t encoded_size_with(size_t variable_bindings_size) const;
 
   // Packet fields
   uint8_t version_;
   uint8_t pdu_type_;
   std::string community_;
-  uint32_t request_id_;
-  uint8_t error_status_;
-  uint8_t error_index_;
+  int32_t request_id_;
+  int32_t error_status_;
+  int32_t error_index_;
+  uint32_t non_repeaters_;
+  uint32_t max_repetitions_;
   std::vector<VariableBinding> variable_bindings_;
+  // Sum of encoded_size() over variable_bindings_
+  size_t variable_bindings_size_;
 };
 
 } // namespace simple_snmpd
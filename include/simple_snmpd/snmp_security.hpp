@@ -19,11 +19,13 @@
 #ifndef SIMPLE_SNMPD_SNMP_SECURITY_HPP
 #define SIMPLE_SNMPD_SNMP_SECURITY_HPP
 
+#include "request_context.hpp"
 #include <chrono>
 #include <map>
 #include <mutex>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace simple_snmpd {
@@ -64,12 +66,15 @@ public:
   // Access control
   bool is_access_allowed(const std::string &community,
                          const std::string &source_ip) const;
+  bool is_access_allowed(const std::string &community,
+                         const RequestContext &context) const;
   bool is_oid_allowed(const std::string &community,
                       const std::string &oid) const;
   bool is_write_allowed(const std::string &community) const;
 
   // Rate limiting
   bool check_rate_limit(const std::string &source_ip);
+  bool check_rate_limit(const RequestContext &context);
   void reset_rate_limit(const std::string &source_ip);
 
   // Configuration
@@ -87,6 +92,7 @@ public:
   void add_allowed_subnet(const std::string &subnet);
   void add_denied_subnet(const std::string &subnet);
   bool is_ip_allowed(const std::string &ip) const;
+  bool is_ip_allowed(const RequestContext &context) const;
 
   // Community string validation
   void add_valid_community(const std::string &community, bool read_only = true);
@@ -97,24 +103,36 @@ public:
   void initialize_defaults();
 
 private:
-  SecurityManager() = default;
+  SecurityManager();
   ~SecurityManager() = default;
   SecurityManager(const SecurityManager &) = delete;
   SecurityManager &operator=(const SecurityManager &) = delete;
 
-  // Access control storage
+  // Address or network parsed once when a rule is added, so requests are
+  // matched against binary addresses without any string handling
+  struct AddressRule {
+    bool any;
+    bool valid;
+    NetworkAddress network;
+    uint32_t prefix_length;
+
+    AddressRule() : any(false), valid(false), prefix_length(0) {}
+    bool matches(const NetworkAddress &address) const;
+  };
+
+  // Access control storage; rules are parallel to the entries
   std::vector<AccessControlEntry> access_control_entries_;
+  std::vector<AddressRule> access_control_rules_;
   mutable std::mutex access_control_mutex_;
 
   // Rate limiting storage
-  std::map<std::string, RateLimitEntry> rate_limits_;
+  std::unordered_map<NetworkAddress, RateLimitEntry, NetworkAddressHash>
+      rate_limits_;
   mutable std::mutex rate_limit_mutex_;
 
-  // IP filtering
-  std::set<std::string> allowed_ips_;
-  std::set<std::string> denied_ips_;
-  std::set<std::string> allowed_subnets_;
-  std::set<std::string> denied_subnets_;
+  // IP filtering (addresses and subnets)
+  std::vector<AddressRule> allowed_rules_;
+  std::vector<AddressRule> denied_rules_;
   mutable std::mutex ip_filter_mutex_;
 
   // Community strings
@@ -126,11 +144,15 @@ private:
   std::chrono::seconds default_window_duration_;
 
   // Helper functions
-  bool is_ip_in_subnet(const std::string &ip, const std::string &subnet) const;
-  bool is_ip_in_list(const std::string &ip,
-                     const std::set<std::string> &ip_list) const;
-  bool is_ip_in_subnet_list(const std::string &ip,
-                            const std::set<std::string> &subnet_list) const;
+  static AddressRule parse_address_rule(const std::string &address,
+                                        const std::string &mask);
+  static bool matches_any(const NetworkAddress &address,
+                          const std::vector<AddressRule> &rules);
+  bool is_address_allowed(const NetworkAddress &address) const;
+  bool is_community_access_allowed(const std::string &community,
+                                   const NetworkAddress &address) const;
+  bool check_address_rate_limit(const NetworkAddress &address,
+                                std::chrono::steady_clock::time_point now);
 };
 
 } // namespace simple_snmpd
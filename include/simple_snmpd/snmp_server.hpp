@@ -19,19 +19,42 @@
 #ifndef SIMPLE_SNMPD_SNMP_SERVER_HPP
 #define SIMPLE_SNMPD_SNMP_SERVER_HPP
 
+#include "admission_control.hpp"
+#include "datagram_batch.hpp"
+#include "datagram_engine.hpp"
+#include "fair_queue.hpp"
+#include "listen_endpoint.hpp"
+#include "logger.hpp"
+#include "request_context.hpp"
+#include "request_shape_cache.hpp"
+#include "response_cache.hpp"
 #include "snmp_config.hpp"
-#include "snmp_connection.hpp"
 #include "snmp_packet.hpp"
+#include "tcp_transport.hpp"
+#include "thread_pool.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
-// Forward declarations for socket structures
-struct sockaddr_in;
-
 namespace simple_snmpd {
 
+class SNMPv3Packet;
+
+// Number of log2 buckets used for the receive batch fill histogram
+// (1, 2-3, 4-7, ..., 128+ datagrams per receive call)
+constexpr size_t SNMP_BATCH_FILL_BUCKETS = 8;
+
+// Number of log2 microsecond buckets used for the queueing delay and
+// service time histograms (<=1us, <=2us, ..., <=262ms, above)
+constexpr size_t SNMP_LATENCY_BUCKETS = 20;
+
 class SNMPServer {
 public:
   SNMPServer(const SNMPConfig &config);
@@ -46,45 +69,307 @@ public:
   // Configuration
   const SNMPConfig &get_config() const;
 
+  // Statistics
+  struct Statistics {
+    uint64_t rx_syscalls;
+    uint64_t rx_datagrams;
+    uint64_t rx_errors;
+    // Requests dropped unread because they were larger than a receive slot
+    uint64_t rx_oversized;
+    uint64_t tx_syscalls;
+    uint64_t tx_datagrams;
+    uint64_t tx_errors;
+    uint64_t requests_processed;
+    uint64_t parse_errors;
+    uint64_t dispatched;
+    uint64_t dispatch_drops;
+    uint64_t queue_wait_us;
+    std::array<uint64_t, SNMP_BATCH_FILL_BUCKETS> batch_fill;
+
+    // Kernel receive queue: datagrams dropped because the socket buffer
+    // was full (SO_RXQ_OVFL) and the current buffer size
+    uint64_t kernel_drops;
+    uint64_t receive_buffer_bytes;
+
+    // Kernel arrival to receive call, and kernel arrival to send call
+    uint64_t queue_delay_us;
+    uint64_t service_time_us;
+    std::array<uint64_t, SNMP_LATENCY_BUCKETS> queue_delay;
+    std::array<uint64_t, SNMP_LATENCY_BUCKETS> service_time;
+
+    // Responses that did not fit the response size limit: answered with
+    // tooBig, and GETBULK responses cut short
+    uint64_t too_big;
+    uint64_t truncated;
+
+    // parse_errors broken down by ParseError, indexed by its value
+    std::array<uint64_t, SNMP_PARSE_ERRORS> parse_error_reasons;
+
+    Statistics()
+        : rx_syscalls(0), rx_datagrams(0), rx_errors(0), rx_oversized(0),
+          tx_syscalls(0), tx_datagrams(0), tx_errors(0), requests_processed(0),
+          parse_errors(0), dispatched(0), dispatch_drops(0), queue_wait_us(0),
+          batch_fill(), kernel_drops(0), receive_buffer_bytes(0),
+          queue_delay_us(0), service_time_us(0), queue_delay(),
+          service_time(), too_big(0), truncated(0), parse_error_reasons() {}
+  };
+
+  // Totals across all listener shards
+  Statistics get_statistics() const;
+
+  // Per-shard statistics, indexed by shard id
+  std::vector<Statistics> get_shard_statistics() const;
+
+  // Datagrams waiting in the dispatch queue for a worker thread
+  size_t get_dispatch_queue_depth() const;
+
+  // Per-source scheduling between shards and workers (all zero and no
+  // flows unless fair_queueing is set and workers are running)
+  FairQueue::Statistics get_fair_queue_statistics() const;
+  std::vector<FairQueue::FlowStatistics> get_top_sources(size_t count) const;
+
+  // SNMP over TCP connection statistics (all zero when TCP is disabled)
+  TcpTransport::Statistics get_tcp_statistics() const;
+
+  // Admitted and shed request counts per priority class
+  AdmissionController::Statistics get_admission_statistics() const;
+
+  // Retransmission response cache hits, misses and occupancy
+  ResponseCache::Statistics get_response_cache_statistics() const;
+
+  // Resolved GET variable binding lists: hits, misses and invalidations
+  RequestShapeCache::Statistics get_shape_cache_statistics() const;
+
+  // Publish statistics to the Prometheus registry
+  void publish_metrics() const;
+
 private:
+  // I/O counters, updated with relaxed atomics from the owning shard and
+  // from the workers processing its datagrams
+  struct Counters {
+    std::atomic<uint64_t> rx_syscalls;
+    std::atomic<uint64_t> rx_datagrams;
+    std::atomic<uint64_t> rx_errors;
+    std::atomic<uint64_t> rx_oversized;
+    std::atomic<uint64_t> tx_syscalls;
+    std::atomic<uint64_t> tx_datagrams;
+    std::atomic<uint64_t> tx_errors;
+    std::atomic<uint64_t> requests_processed;
+    std::atomic<uint64_t> parse_errors;
+    std::array<std::atomic<uint64_t>, SNMP_PARSE_ERRORS> parse_error_reasons;
+    std::atomic<uint64_t> dispatched;
+    std::atomic<uint64_t> dispatch_drops;
+    std::atomic<uint64_t> queue_wait_us;
+    std::array<std::atomic<uint64_t>, SNMP_BATCH_FILL_BUCKETS> batch_fill;
+    std::atomic<uint64_t> kernel_drops;
+    std::atomic<uint64_t> receive_buffer_bytes;
+    std::atomic<uint64_t> queue_delay_us;
+    std::atomic<uint64_t> service_time_us;
+    std::array<std::atomic<uint64_t>, SNMP_LATENCY_BUCKETS> queue_delay;
+    std::array<std::atomic<uint64_t>, SNMP_LATENCY_BUCKETS> service_time;
+
+    Counters();
+    Statistics snapshot() const;
+  };
+
+  // Responses produced by one thread and the engine they are sent with
+  struct Transmitter {
+    std::unique_ptr<DatagramBatch> responses;
+    DatagramEngine *engine;
+    Counters *counters;
+
+    Transmitter() : engine(nullptr), counters(nullptr) {}
+  };
+
+  // A listener shard owns one SO_REUSEPORT socket on one endpoint and the
+  // thread that receives every datagram the kernel steers to it. Without
+  // workers the shard thread also processes and answers them.
+  struct Shard {
+    uint32_t id;
+    uint32_t endpoint;
+    int socket_fd;
+    std::thread thread;
+    std::unique_ptr<DatagramEngine> engine;
+    std::unique_ptr<DatagramBatch> requests;
+    Transmitter transmitter;
+    Counters counters;
+
+    // Kernel drop tracking and receive buffer tuning, only touched by the
+    // shard thread
+    uint32_t drops_seen;
+    uint32_t drops_reported;
+    std::chrono::steady_clock::time_point last_drop_report;
+    int receive_buffer_request;
+    std::chrono::steady_clock::time_point last_buffer_change;
+
+    Shard(uint32_t shard_id, uint32_t endpoint_index, int fd)
+        : id(shard_id), endpoint(endpoint_index), socket_fd(fd),
+          drops_seen(0), drops_reported(0), receive_buffer_request(0) {}
+  };
+
+  // A worker parses and answers datagrams handed over by the shards. It
+  // sends through the receiving shard's socket with its own socket engine
+  // because shard engines are not thread-safe.
+  struct Worker {
+    uint32_t id;
+    std::thread thread;
+    std::vector<std::unique_ptr<DatagramEngine>> engines;
+    Transmitter transmitter;
+
+    explicit Worker(uint32_t worker_id) : id(worker_id) {}
+  };
+
+  // Datagram copied out of a shard's receive batch, waiting for a worker
+  struct DispatchSlot {
+    Datagram datagram;
+    uint32_t shard_id;
+    std::chrono::steady_clock::time_point received;
+  };
+
+  // Socket setup
+  bool resolve_endpoints();
+  int open_listener_socket(const ListenEndpoint &endpoint, bool reuse_port,
+                           int socket_type = SOCK_DGRAM);
+  bool start_tcp_transport();
+  void enable_receive_metadata(int socket_fd, const std::string &name);
+  void record_kernel_drops(Shard &shard, uint32_t drops);
+  void grow_receive_buffer(Shard &shard);
+  void close_listener_sockets();
+
   // Server threads
-  void server_loop();
-  void worker_thread();
+  void server_loop(Shard &shard);
+  void worker_loop(Worker &worker);
+
+  // Dispatch pipeline
+  bool initialize_dispatch(size_t depth);
+  void dispatch_datagram(const Datagram &datagram,
+                         std::chrono::steady_clock::time_point received_at,
+                         Shard &shard);
+  bool next_dispatched(uint32_t &index);
+  size_t dispatch_pending() const;
+  void wake_workers();
+  void wait_for_dispatch();
 
   // Request processing
-  void process_snmp_request(std::shared_ptr<SNMPConnection> connection,
-                            const SNMPPacket &request,
-                            const struct sockaddr_in &client_addr);
-
-  // PDU processing
-  void process_get_request(const SNMPPacket &request, SNMPPacket &response);
-  void process_get_next_request(const SNMPPacket &request,
-                                SNMPPacket &response);
-  void process_get_bulk_request(const SNMPPacket &request,
-                                SNMPPacket &response);
-  void process_set_request(const SNMPPacket &request, SNMPPacket &response);
-  void process_trap_v1(const SNMPPacket &request, SNMPPacket &response);
-  void process_trap_v2(const SNMPPacket &request, SNMPPacket &response);
+  void handle_datagram(const Datagram &datagram, uint32_t shard_id,
+                       std::chrono::steady_clock::time_point received_at,
+                       Transmitter &transmitter);
+  void process_snmp_request(const RequestContext &context,
+                            const SNMPPacketView &request,
+                            Transmitter &transmitter,
+                            const ResponseCache::Key *cache_key = nullptr,
+                            uint64_t cache_digest = 0);
+  bool handle_stream_message(const RequestContext &context,
+                             const uint8_t *data, size_t length,
+                             std::vector<uint8_t> &response);
+  bool build_response(const RequestContext &context,
+                      const SNMPPacketView &request, SNMPPacket &response,
+                      size_t max_size);
+  // Rate limit and IP filter, applied once per message before anything
+  // else, including the response cache
+  bool check_source(const RequestContext &context);
+  bool process_pdu(const RequestContext &context,
+                   const SNMPPacketView &request, SNMPPacket &response,
+                   size_t max_size);
+
+  // SNMPv3 messages go through SNMPv3MessageProcessor for security and
+  // access control; their PDUs are answered by process_pdu() like any
+  // other on the same threads, read from pdu, a view of the scoped PDU.
+  // receive_limit is the msgMaxSize announced in the response.
+  void handle_v3_datagram(const RequestContext &context,
+                          const Datagram &datagram, Transmitter &transmitter);
+  bool decode_v3_message(const RequestContext &context, const uint8_t *data,
+                         size_t length, const char *transport,
+                         SNMPv3Packet &request);
+  bool build_v3_response(const RequestContext &context,
+                         const SNMPv3Packet &request,
+                         const SNMPPacketView &pdu, size_t max_size,
+                         size_t receive_limit,
+                         std::vector<uint8_t> &message);
+  void log_parse_error(const RequestContext &context,
+                       const ParseResult &result, const char *transport);
+
+  // PDU processing. Requests are read in place from the received message;
+  // responses are kept within max_size encoded bytes, and GET, GETNEXT and
+  // SET return false when theirs would not fit
+  bool process_get_request(const SNMPPacketView &request,
+                           SNMPPacket &response, size_t max_size);
+  bool process_get_next_request(const SNMPPacketView &request,
+                                SNMPPacket &response, size_t max_size);
+  void process_get_bulk_request(const SNMPPacketView &request,
+                                SNMPPacket &response, size_t max_size);
+  bool process_set_request(const SNMPPacketView &request,
+                           SNMPPacket &response, size_t max_size);
+  bool set_too_big(const SNMPPacketView &request, SNMPPacket &response,
+                   size_t max_size);
+  void process_trap_v1(const SNMPPacketView &request, SNMPPacket &response);
+  void process_trap_v2(const SNMPPacketView &request, SNMPPacket &response);
 
   // Response handling
-  void send_response(const SNMPPacket &response,
-                     const struct sockaddr_in &client_addr);
+  bool answer_from_cache(const ResponseCache::Key &key, uint64_t digest,
+                         const RequestContext &context,
+                         Transmitter &transmitter);
+  void queue_response(const SNMPPacket &response,
+                      const RequestContext &context, Transmitter &transmitter,
+                      const ResponseCache::Key *cache_key = nullptr,
+                      uint64_t cache_digest = 0);
+  void queue_message(const std::vector<uint8_t> &message,
+                     const RequestContext &context, Transmitter &transmitter);
+  void flush_responses(Transmitter &transmitter);
 
   // Server configuration
   SNMPConfig config_;
-  int server_socket_;
-  bool running_;
+  std::atomic<bool> running_;
+
+  // Listener endpoints and their shards, listener_shards per endpoint
+  std::vector<ListenEndpoint> endpoints_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // Worker threads and the slots/queues that feed them. Free slot indices
+  // circulate from the workers back to the shards, so the receive path
+  // never allocates.
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<uint8_t> dispatch_storage_;
+  std::vector<DispatchSlot> dispatch_slots_;
+  std::unique_ptr<BoundedQueue<uint32_t>> dispatch_free_;
+  std::unique_ptr<BoundedQueue<uint32_t>> dispatch_ready_;
+
+  // Replaces dispatch_ready_ as the ready queue when fair_queueing is set
+  std::unique_ptr<FairQueue> fair_queue_;
+
+  // Idle workers sleep here until a shard dispatches new datagrams
+  std::mutex dispatch_mutex_;
+  std::condition_variable dispatch_condition_;
+  std::atomic<uint32_t> idle_workers_;
 
-  // Threading
-  std::thread server_thread_;
-  std::vector<std::thread> worker_threads_;
-  size_t thread_pool_size_;
+  // Load shedding in front of request processing, when load_shedding is set
+  AdmissionController admission_;
 
-  // Connection management
-  std::vector<std::shared_ptr<SNMPConnection>> connections_;
-  mutable std::mutex connections_mutex_;
+  // Encoded responses kept for retransmitted requests
+  ResponseCache response_cache_;
+
+  // MIB handles kept for repeated GET variable binding lists
+  RequestShapeCache shape_cache_;
+
+  // SNMP over TCP listeners and connections, when enable_tcp is set
+  std::unique_ptr<TcpTransport> tcp_transport_;
+  std::atomic<uint64_t> tcp_requests_processed_;
+  std::atomic<uint64_t> tcp_parse_errors_;
+  std::array<std::atomic<uint64_t>, SNMP_PARSE_ERRORS>
+      tcp_parse_error_reasons_;
+
+  // Malformed messages are counted by reason; only a sample is logged
+  LogSampler parse_error_log_;
+
+  // Size budget of UDP responses: max_response_size, at most one datagram
+  size_t max_response_size_;
+  std::atomic<uint64_t> too_big_responses_;
+  std::atomic<uint64_t> truncated_responses_;
 };
 
+// Utility functions
+std::string server_statistics_to_string(const SNMPServer::Statistics &stats);
+
 } // namespace simple_snmpd
 
 #endif // SIMPLE_SNMPD_SNMP_SERVER_HPP
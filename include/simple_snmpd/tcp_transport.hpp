@@ -0,0 +1,119 @@
+/*
+ * include/simple_snmpd/tcp_transport.hpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_SNMPD_TCP_TRANSPORT_HPP
+#define SIMPLE_SNMPD_TCP_TRANSPORT_HPP
+
+#include "request_context.hpp"
+#include "snmp_connection.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace simple_snmpd {
+
+// SNMP over TCP (RFC 3430). One thread multiplexes every listening socket
+// and manager connection with epoll. Each connection carries a stream of
+// BER encoded messages; partial reads are reassembled and pipelined
+// requests are answered in order. Responses are not limited by the UDP
+// receive buffer size.
+class TcpTransport {
+public:
+  // Process one complete message and fill response with the encoded reply.
+  // Returns false when there is nothing to send back.
+  using RequestHandler =
+      std::function<bool(const RequestContext &context, const uint8_t *data,
+                         size_t length, std::vector<uint8_t> &response)>;
+
+  struct Statistics {
+    uint64_t accepted;
+    uint64_t rejected;
+    uint64_t closed_idle;
+    uint64_t active;
+    uint64_t messages;
+    uint64_t responses;
+    uint64_t framing_errors;
+    uint64_t bytes_received;
+    uint64_t bytes_sent;
+
+    Statistics()
+        : accepted(0), rejected(0), closed_idle(0), active(0), messages(0),
+          responses(0), framing_errors(0), bytes_received(0), bytes_sent(0) {}
+  };
+
+  TcpTransport(RequestHandler handler, uint32_t max_connections,
+               uint32_t idle_timeout_seconds, size_t max_message_size);
+  ~TcpTransport();
+
+  // Take ownership of bound stream sockets and start the event loop.
+  // listen_fds[i] reports shard id i in the request context.
+  bool start(const std::vector<int> &listen_fds);
+  void stop();
+
+  Statistics get_statistics() const;
+
+private:
+  TcpTransport(const TcpTransport &) = delete;
+  TcpTransport &operator=(const TcpTransport &) = delete;
+
+  struct Connection {
+    std::unique_ptr<SNMPConnection> stream;
+    uint32_t listener;
+    uint32_t events;
+  };
+
+  void event_loop();
+  void accept_connections(size_t listener);
+  void handle_readable(Connection &connection);
+  void process_messages(Connection &connection);
+  bool update_interest(Connection &connection);
+  void close_connection(int fd);
+  void close_idle_connections();
+
+  RequestHandler handler_;
+  uint32_t max_connections_;
+  uint32_t idle_timeout_seconds_;
+  size_t max_message_size_;
+
+  int epoll_fd_;
+  std::vector<int> listen_fds_;
+  std::unordered_map<int, Connection> connections_;
+  std::thread thread_;
+  std::atomic<bool> running_;
+
+  std::atomic<uint64_t> accepted_;
+  std::atomic<uint64_t> rejected_;
+  std::atomic<uint64_t> closed_idle_;
+  std::atomic<uint64_t> active_;
+  std::atomic<uint64_t> messages_;
+  std::atomic<uint64_t> responses_;
+  std::atomic<uint64_t> framing_errors_;
+  std::atomic<uint64_t> bytes_received_;
+  std::atomic<uint64_t> bytes_sent_;
+};
+
+std::string tcp_statistics_to_string(const TcpTransport::Statistics &stats);
+
+} // namespace simple_snmpd
+
+#endif // SIMPLE_SNMPD_TCP_TRANSPORT_HPP
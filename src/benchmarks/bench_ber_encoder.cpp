@@ -0,0 +1,212 @@
+/*
+ * src/benchmarks/bench_ber_encoder.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Response serialization throughput: the previous forward serializer
+// (push_back with one-byte length placeholders widened in place) against
+// the reverse BER encoder, through the vector API and straight into a
+// preallocated send buffer as the server does.
+
+#include "simple_snmpd/ber_encoder.hpp"
+#include "simple_snmpd/snmp_packet.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace simple_snmpd {
+namespace benchmarks {
+
+namespace legacy {
+
+void fill_length(std::vector<uint8_t> &buffer, size_t pos) {
+  size_t length = buffer.size() - pos - 1;
+  if (length < 0x80) {
+    buffer[pos] = static_cast<uint8_t>(length);
+    return;
+  }
+
+  uint8_t encoded[sizeof(size_t)];
+  size_t count = 0;
+  for (size_t value = length; value > 0; value >>= 8) {
+    encoded[sizeof(encoded) - ++count] = static_cast<uint8_t>(value & 0xFF);
+  }
+  buffer[pos] = static_cast<uint8_t>(0x80 | count);
+  buffer.insert(buffer.begin() + pos + 1, encoded + sizeof(encoded) - count,
+                encoded + sizeof(encoded));
+}
+
+void serialize(const SNMPPacket &packet, std::vector<uint8_t> &buffer) {
+  buffer.clear();
+  buffer.push_back(0x30);
+  size_t length_pos = buffer.size();
+  buffer.push_back(0x00);
+
+  buffer.push_back(0x02);
+  buffer.push_back(0x01);
+  buffer.push_back(packet.get_version());
+
+  buffer.push_back(0x04);
+  size_t community_pos = buffer.size();
+  buffer.push_back(0x00);
+  const std::string &community = packet.get_community();
+  buffer.insert(buffer.end(), community.begin(), community.end());
+  fill_length(buffer, community_pos);
+
+  buffer.push_back(packet.get_pdu_type());
+  size_t pdu_pos = buffer.size();
+  buffer.push_back(0x00);
+
+  uint32_t request_id = static_cast<uint32_t>(packet.get_request_id());
+  buffer.push_back(0x02);
+  buffer.push_back(0x04);
+  buffer.push_back((request_id >> 24) & 0xFF);
+  buffer.push_back((request_id >> 16) & 0xFF);
+  buffer.push_back((request_id >> 8) & 0xFF);
+  buffer.push_back(request_id & 0xFF);
+  for (int32_t field : {packet.get_error_status(), packet.get_error_index()}) {
+    uint32_t value = static_cast<uint32_t>(field);
+    buffer.push_back(0x02);
+    buffer.push_back(0x04);
+    buffer.push_back((value >> 24) & 0xFF);
+    buffer.push_back((value >> 16) & 0xFF);
+    buffer.push_back((value >> 8) & 0xFF);
+    buffer.push_back(value & 0xFF);
+  }
+
+  buffer.push_back(0x30);
+  size_t varbinds_pos = buffer.size();
+  buffer.push_back(0x00);
+  for (const auto &varbind : packet.get_variable_bindings()) {
+    buffer.push_back(0x30);
+    size_t varbind_pos = buffer.size();
+    buffer.push_back(0x00);
+
+    buffer.push_back(0x06);
+    size_t oid_pos = buffer.size();
+    buffer.push_back(0x00);
+    buffer.insert(buffer.end(), varbind.oid.begin(), varbind.oid.end());
+    fill_length(buffer, oid_pos);
+
+    buffer.push_back(varbind.value_type);
+    size_t value_pos = buffer.size();
+    buffer.push_back(0x00);
+    buffer.insert(buffer.end(), varbind.value.begin(), varbind.value.end());
+    fill_length(buffer, value_pos);
+
+    fill_length(buffer, varbind_pos);
+  }
+  fill_length(buffer, varbinds_pos);
+  fill_length(buffer, pdu_pos);
+  fill_length(buffer, length_pos);
+}
+
+} // namespace legacy
+
+SNMPPacket make_response(size_t varbinds, size_t value_size) {
+  SNMPPacket packet;
+  packet.set_version(SNMP_VERSION_2C);
+  packet.set_pdu_type(SNMP_PDU_GET_RESPONSE);
+  packet.set_community("public");
+  packet.set_request_id(123456789);
+
+  SNMPPacket::VariableBinding varbind;
+  varbind.value_type = 0x04; // OCTET STRING
+  varbind.value.assign(value_size, 'x');
+  for (size_t i = 0; i < varbinds; ++i) {
+    // ifDescr.<i>
+    varbind.oid = {0x2b, 0x06, 0x01, 0x02, 0x01, 0x02, 0x02, 0x01, 0x02,
+                   static_cast<uint8_t>(1 + i % 127)};
+    packet.add_variable_binding(varbind);
+  }
+  return packet;
+}
+
+// Nanoseconds per call, best of five runs
+double measure(size_t iterations, const std::function<size_t()> &body) {
+  volatile size_t sink = 0;
+  double best = 0;
+  for (int run = 0; run < 5; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      sink = sink + body();
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(
+                       std::chrono::steady_clock::now() - start)
+                       .count() /
+                   static_cast<double>(iterations);
+    if (run == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+void run_case(const char *name, size_t varbinds, size_t value_size) {
+  SNMPPacket packet = make_response(varbinds, value_size);
+  size_t iterations = std::max<size_t>(1000, 2000000 / (varbinds + 1));
+
+  // The encoder writes the same bytes through both paths
+  std::vector<uint8_t> buffer;
+  packet.serialize(buffer);
+  std::vector<uint8_t> slot(65536);
+  BerEncoder check(slot.data(), slot.size());
+  if (!packet.serialize(check) ||
+      std::memcmp(check.data(), buffer.data(), buffer.size()) != 0) {
+    std::printf("%-22s encoder output mismatch\n", name);
+    return;
+  }
+
+  double legacy_ns = measure(iterations, [&] {
+    std::vector<uint8_t> out;
+    legacy::serialize(packet, out);
+    return out.size();
+  });
+  double vector_ns = measure(iterations, [&] {
+    std::vector<uint8_t> out;
+    packet.serialize(out);
+    return out.size();
+  });
+  double slot_ns = measure(iterations, [&] {
+    BerEncoder encoder(slot.data(), slot.size());
+    packet.serialize(encoder);
+    return encoder.size();
+  });
+
+  std::printf("%-22s %7zu B %11.0f %11.0f %11.0f %8.2fx\n", name,
+              buffer.size(), legacy_ns, vector_ns, slot_ns,
+              legacy_ns / slot_ns);
+}
+
+} // namespace benchmarks
+} // namespace simple_snmpd
+
+int main() {
+  using simple_snmpd::benchmarks::run_case;
+
+  std::printf("%-22s %9s %11s %11s %11s %9s\n", "response", "size",
+              "legacy ns", "vector ns", "encoder ns", "speedup");
+  run_case("1 varbind", 1, 16);
+  run_case("10 varbinds", 10, 16);
+  run_case("50 varbinds", 50, 16);
+  run_case("50 varbinds, 200 B", 50, 200);
+  run_case("200 varbinds", 200, 20);
+  return 0;
+}
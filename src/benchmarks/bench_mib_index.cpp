@@ -0,0 +1,299 @@
+/*
+ * src/benchmarks/bench_mib_index.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// MIB index lookups at 10k to 1M registered OIDs: the OIDTrie behind
+// MIBManager against the OID-ordered std::map it replaced. The OIDs are
+// enterprise table instances (arcs past 127, so byte order is not OID
+// order) spread over several subtrees and columns, registered in OID
+// order as MIB modules do. Each size reports the time to register them,
+// exact lookups of registered OIDs, lookups that miss, and successor
+// searches (GETNEXT) from points between registered OIDs, all in random
+// order. The last part measures MIBManager GETs from 1 to 8 reader
+// threads, alone and with a writer publishing a new version every
+// millisecond; readers pin an epoch instead of taking a lock, so on a
+// machine with enough cores the rate grows with the thread count. Last,
+// a full walk of a 50k-row, 5-column table, once with a getter per cell
+// and once from a SortedRowProvider that hands over rows in batches.
+
+#include "simple_snmpd/oid_trie.hpp"
+#include "simple_snmpd/snmp_mib.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <atomic>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace simple_snmpd {
+namespace benchmarks {
+
+using OIDMap = std::map<std::vector<uint8_t>, size_t, OIDLess>;
+
+// count instances over 4 enterprise subtrees of 8 columns each
+std::vector<std::vector<uint8_t>> make_oids(size_t count) {
+  static const char *subtrees[] = {"1.3.6.1.4.1.8072.1.3.2.3.1",
+                                   "1.3.6.1.4.1.2021.9.1",
+                                   "1.3.6.1.4.1.9.9.109.1.1.1.1",
+                                   "1.3.6.1.4.1.40310.1.2"};
+  std::vector<std::vector<uint8_t>> oids;
+  oids.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    size_t column = i % 32;
+    size_t row = i / 32;
+    oids.push_back(OIDUtils::string_to_oid(
+        std::string(subtrees[column / 8]) + "." +
+        std::to_string(2 + column % 8) + "." + std::to_string(1 + row * 3)));
+  }
+  return oids;
+}
+
+// Nanoseconds per call, best of three runs
+double measure(size_t iterations, const std::function<size_t(size_t)> &body) {
+  volatile size_t sink = 0;
+  double best = 0;
+  for (int run = 0; run < 3; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      sink = sink + body(i);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(
+                       std::chrono::steady_clock::now() - start)
+                       .count() /
+                   static_cast<double>(iterations);
+    if (run == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+void run_case(size_t count) {
+  std::vector<std::vector<uint8_t>> oids = make_oids(count);
+  std::sort(oids.begin(), oids.end(), OIDLess());
+  std::mt19937 random(42);
+
+  auto start = std::chrono::steady_clock::now();
+  OIDMap map;
+  for (size_t i = 0; i < oids.size(); ++i) {
+    map[oids[i]] = i;
+  }
+  double map_build =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  start = std::chrono::steady_clock::now();
+  OIDTrie trie;
+  for (const auto &oid : oids) {
+    trie.insert(oid);
+  }
+  double trie_build =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  // Misses and GETNEXT starting points: row 2 lies between rows 1 and 4
+  std::vector<std::vector<uint8_t>> hits;
+  std::vector<std::vector<uint8_t>> between;
+  const size_t queries = 1 << 16;
+  for (size_t i = 0; i < queries; ++i) {
+    const std::vector<uint8_t> &oid = oids[random() % oids.size()];
+    hits.push_back(oid);
+    std::vector<uint8_t> gap = oid;
+    gap.back() ^= 0x01;
+    between.push_back(gap);
+  }
+
+  // Both indexes agree on every successor
+  for (const auto &oid : between) {
+    auto it = map.upper_bound(oid);
+    size_t slot = trie.upper_bound(oid);
+    if ((it == map.end()) != (slot == OIDTrie::npos) ||
+        (slot != OIDTrie::npos && trie.oid(slot) != it->first)) {
+      std::printf("%8zu successor mismatch\n", count);
+      return;
+    }
+  }
+
+  const size_t mask = queries - 1;
+  double map_find = measure(queries, [&](size_t i) {
+    return map.find(hits[i & mask])->second;
+  });
+  double trie_find =
+      measure(queries, [&](size_t i) { return trie.find(hits[i & mask]); });
+  double map_miss = measure(queries, [&](size_t i) {
+    return map.find(between[i & mask]) == map.end();
+  });
+  double trie_miss =
+      measure(queries, [&](size_t i) { return trie.find(between[i & mask]); });
+  double map_next = measure(queries, [&](size_t i) {
+    auto it = map.upper_bound(between[i & mask]);
+    return it == map.end() ? 0 : it->second;
+  });
+  double trie_next = measure(
+      queries, [&](size_t i) { return trie.upper_bound(between[i & mask]); });
+
+  std::printf("%8zu %7.2f/%-7.2f %7.1f/%-7.1f %7.1f/%-7.1f %7.1f/%-7.1f\n",
+              count, map_build, trie_build, map_find, trie_find, map_miss,
+              trie_miss, map_next, trie_next);
+}
+
+// Million GETs per second across threads readers over 100k instances
+double run_readers(const std::vector<std::vector<uint8_t>> &oids,
+                   size_t threads, bool writer) {
+  MIBManager &mib = MIBManager::get_instance();
+  std::atomic<bool> stop(false);
+  std::atomic<uint64_t> reads(0);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      std::mt19937 random(static_cast<uint32_t>(t));
+      uint64_t count = 0;
+      MIBValue value;
+      while (!stop.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < 256; ++i) {
+          count += mib.get_value(oids[random() % oids.size()], value);
+        }
+      }
+      reads.fetch_add(count);
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::milliseconds(500);
+  MIBEntry entry(oids.front(), "bench", SNMPDataType::INTEGER);
+  entry.getter = []() {
+    return MIBValue(SNMPDataType::INTEGER, static_cast<uint32_t>(1));
+  };
+  while (std::chrono::steady_clock::now() < end) {
+    if (writer) {
+      mib.register_scalar(entry);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  stop.store(true);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  return static_cast<double>(reads.load()) / seconds / 1e6;
+}
+
+// Nanoseconds per instance for a walk of every column of the table
+double walk_table(const std::vector<uint8_t> &entry_oid) {
+  MIBManager &mib = MIBManager::get_instance();
+  std::vector<uint8_t> end = entry_oid;
+  end.push_back(0x06);
+  return measure(1, [&](size_t) {
+           MIBManager::Cursor cursor(mib);
+           MIBValue value;
+           size_t count = 0;
+           for (cursor.seek_after(entry_oid);
+                cursor.read(value) && OIDUtils::compare_oids(cursor.oid(),
+                                                             end) < 0;
+                cursor.next()) {
+             ++count;
+           }
+           return count;
+         }) /
+         (50000.0 * 5);
+}
+
+void run_table_walk() {
+  const size_t rows = 50000;
+  MIBManager &mib = MIBManager::get_instance();
+
+  std::vector<uint8_t> dense = OIDUtils::string_to_oid("1.3.6.1.4.1.99.10.1");
+  {
+    MIBManager::Update update(mib);
+    for (uint32_t column = 1; column <= 5; ++column) {
+      std::vector<uint8_t> oid = dense;
+      oid.push_back(static_cast<uint8_t>(column));
+      MIBTableEntry entry(oid, "bench", SNMPDataType::INTEGER);
+      entry.getter = [column](uint32_t row) {
+        return MIBValue(SNMPDataType::INTEGER, row * column);
+      };
+      mib.register_table(entry, rows);
+    }
+  }
+
+  // The same values under IpAddress indexes
+  MIBTable table;
+  table.entry_oid = OIDUtils::string_to_oid("1.3.6.1.4.1.99.11.1");
+  table.name = "bench";
+  std::vector<MIBRow> contents(rows);
+  for (uint32_t column = 1; column <= 5; ++column) {
+    table.columns.push_back(MIBColumn(column, "bench", SNMPDataType::INTEGER));
+  }
+  for (uint32_t row = 1; row <= rows; ++row) {
+    MIBRow &cells = contents[row - 1];
+    IndexUtils::append_ip_address(cells.index, 0x0A000000 + row);
+    for (uint32_t column = 1; column <= 5; ++column) {
+      cells.values.push_back(MIBValue(SNMPDataType::INTEGER, row * column));
+    }
+  }
+  std::shared_ptr<SortedRowProvider> provider =
+      std::make_shared<SortedRowProvider>();
+  provider->set_rows(std::move(contents));
+  table.provider = provider;
+  mib.register_table(table);
+
+  std::printf("\n%8s %15s %15s\n", "rows", "getter ns/cell",
+              "provider ns/cell");
+  std::printf("%8zu %15.1f %15.1f\n", rows, walk_table(dense),
+              walk_table(table.entry_oid));
+}
+
+} // namespace benchmarks
+} // namespace simple_snmpd
+
+int main() {
+  using namespace simple_snmpd;
+  using namespace simple_snmpd::benchmarks;
+
+  std::printf("%8s %15s %15s %15s %15s\n", "oids", "build s map/trie",
+              "find ns", "miss ns", "getnext ns");
+  for (size_t count : {10000, 100000, 1000000}) {
+    run_case(count);
+  }
+
+  std::vector<std::vector<uint8_t>> oids = make_oids(100000);
+  {
+    MIBManager::Update update(MIBManager::get_instance());
+    for (const auto &oid : oids) {
+      MIBEntry entry(oid, "bench", SNMPDataType::INTEGER);
+      entry.getter = []() {
+        return MIBValue(SNMPDataType::INTEGER, static_cast<uint32_t>(1));
+      };
+      MIBManager::get_instance().register_scalar(entry);
+    }
+  }
+  std::printf("\n%8s %15s %15s   (%u hardware threads)\n", "readers",
+              "M gets/s", "with writer", std::thread::hardware_concurrency());
+  for (size_t threads : {1, 2, 4, 8}) {
+    std::printf("%8zu %15.2f %15.2f\n", threads,
+                run_readers(oids, threads, false),
+                run_readers(oids, threads, true));
+  }
+
+  run_table_walk();
+  return 0;
+}
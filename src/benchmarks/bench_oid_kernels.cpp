@@ -0,0 +1,219 @@
+/*
+ * src/benchmarks/bench_oid_kernels.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// OID comparison and decoding on the instance OIDs of typical walks:
+// neighbouring instances of IF-MIB and HOST-RESOURCES-MIB columns, which
+// share long prefixes as in a MIB map search, and a long string-indexed
+// instance. Compares the previous arc-by-arc compare_oids with the kernel
+// version, and each instruction set tier of the kernels on their own.
+
+#include "simple_snmpd/oid_kernels.hpp"
+#include "simple_snmpd/snmp_mib.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace simple_snmpd {
+namespace benchmarks {
+
+namespace legacy {
+
+uint64_t read_arc(const std::vector<uint8_t> &oid, size_t &position) {
+  uint64_t arc = 0;
+  while (position < oid.size()) {
+    uint8_t byte = oid[position++];
+    arc = (arc << 7) | (byte & 0x7F);
+    if ((byte & 0x80) == 0) {
+      break;
+    }
+  }
+  return arc;
+}
+
+int compare_oids(const std::vector<uint8_t> &oid1,
+                 const std::vector<uint8_t> &oid2) {
+  size_t position1 = 0;
+  size_t position2 = 0;
+  while (position1 < oid1.size() && position2 < oid2.size()) {
+    uint64_t arc1 = read_arc(oid1, position1);
+    uint64_t arc2 = read_arc(oid2, position2);
+    if (arc1 != arc2) {
+      return arc1 < arc2 ? -1 : 1;
+    }
+  }
+  if (position1 < oid1.size()) {
+    return 1;
+  }
+  return position2 < oid2.size() ? -1 : 0;
+}
+
+} // namespace legacy
+
+// Consecutive instances of column, indexed by the given suffixes
+std::vector<std::vector<uint8_t>>
+make_walk(const std::string &column, const std::vector<std::string> &indexes) {
+  std::vector<std::vector<uint8_t>> oids;
+  for (const auto &index : indexes) {
+    oids.push_back(OIDUtils::string_to_oid(column + "." + index));
+  }
+  return oids;
+}
+
+std::vector<std::string> numeric_indexes(uint32_t first, uint32_t step,
+                                         size_t count) {
+  std::vector<std::string> indexes;
+  for (size_t i = 0; i < count; ++i) {
+    indexes.push_back(std::to_string(first + i * step));
+  }
+  return indexes;
+}
+
+// A 32 character DisplayString index, as in a process or mount name
+std::vector<std::string> string_indexes(size_t count) {
+  std::vector<std::string> indexes;
+  for (size_t i = 0; i < count; ++i) {
+    std::string index = "32";
+    std::string name = "/usr/lib/systemd/systemd-worker" +
+                       std::to_string(10 + i % 90);
+    for (char c : name) {
+      index += "." + std::to_string(static_cast<int>(c));
+    }
+    indexes.push_back(index);
+  }
+  return indexes;
+}
+
+// Nanoseconds per call, best of five runs
+double measure(size_t iterations, const std::function<size_t()> &body) {
+  volatile size_t sink = 0;
+  double best = 0;
+  for (int run = 0; run < 5; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      sink = sink + body();
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(
+                       std::chrono::steady_clock::now() - start)
+                       .count() /
+                   static_cast<double>(iterations);
+    if (run == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+void run_case(const char *name,
+              const std::vector<std::vector<uint8_t>> &oids) {
+  const size_t rounds = 20000;
+  size_t bytes = 0;
+  for (const auto &oid : oids) {
+    bytes += oid.size();
+  }
+
+  // Both comparisons order every neighbouring pair the same way
+  for (size_t i = 1; i < oids.size(); ++i) {
+    if (legacy::compare_oids(oids[i - 1], oids[i]) !=
+        OIDUtils::compare_oids(oids[i - 1], oids[i])) {
+      std::printf("%-24s compare mismatch\n", name);
+      return;
+    }
+  }
+
+  auto compare_all = [&oids](int (*compare)(const std::vector<uint8_t> &,
+                                            const std::vector<uint8_t> &)) {
+    size_t less = 0;
+    for (size_t i = 1; i < oids.size(); ++i) {
+      less += compare(oids[i - 1], oids[i]) < 0;
+    }
+    return less;
+  };
+  double legacy_ns =
+      measure(rounds, [&] { return compare_all(legacy::compare_oids); }) /
+      (oids.size() - 1);
+  double kernel_ns =
+      measure(rounds, [&] { return compare_all(OIDUtils::compare_oids); }) /
+      (oids.size() - 1);
+  std::printf("%-24s %5.1f B %9.1f %9.1f", name,
+              static_cast<double>(bytes) / oids.size(), legacy_ns,
+              kernel_ns);
+
+  // Decoding, then comparing neighbouring arc arrays, per tier
+  std::vector<uint32_t> arcs(256);
+  std::vector<std::vector<uint32_t>> decoded(oids.size());
+  for (size_t i = 0; i < oids.size(); ++i) {
+    OIDUtils::decode_arcs(oids[i], decoded[i]);
+  }
+  for (int tier = 0; tier <= static_cast<int>(OIDKernelLevel::AVX2); ++tier) {
+    OIDKernelLevel level = static_cast<OIDKernelLevel>(tier);
+    const OIDKernels &kernels = OIDKernels::get(level);
+    double decode_ns = measure(rounds, [&] {
+      size_t total = 0;
+      for (const auto &oid : oids) {
+        size_t count = 0;
+        kernels.decode(oid.data(), oid.size(), arcs.data(), count);
+        total += count;
+      }
+      return total;
+    }) / oids.size();
+    double arcs_ns = measure(rounds, [&] {
+      size_t total = 0;
+      for (size_t i = 1; i < decoded.size(); ++i) {
+        total += kernels.mismatch_arcs(
+            decoded[i - 1].data(), decoded[i].data(),
+            std::min(decoded[i - 1].size(), decoded[i].size()));
+      }
+      return total;
+    }) / (oids.size() - 1);
+    if (OIDKernels::detected_level() >= level) {
+      std::printf(" %7.1f/%-5.1f", decode_ns, arcs_ns);
+    } else {
+      std::printf(" %13s", "-");
+    }
+  }
+  std::printf("\n");
+}
+
+} // namespace benchmarks
+} // namespace simple_snmpd
+
+int main() {
+  using namespace simple_snmpd;
+  using namespace simple_snmpd::benchmarks;
+
+  std::printf("kernels: %s\n",
+              OIDKernels::level_name(OIDKernels::detected_level()));
+  std::printf("%-24s %7s %9s %9s %13s %13s %13s\n", "walk", "oid",
+              "legacy ns", "kernel ns", "scalar dec/cmp", "sse4.2",
+              "avx2");
+  run_case("ifInOctets.1-64",
+           make_walk("1.3.6.1.2.1.2.2.1.10", numeric_indexes(1, 1, 64)));
+  run_case("ifHCInOctets.1000-",
+           make_walk("1.3.6.1.2.1.31.1.1.1.6", numeric_indexes(1000, 7, 64)));
+  run_case("hrSWRunName.<pid>",
+           make_walk("1.3.6.1.2.1.25.4.2.1.2",
+                     numeric_indexes(400000, 131, 64)));
+  run_case("hrStorageUsed.1-64",
+           make_walk("1.3.6.1.2.1.25.2.3.1.6", numeric_indexes(1, 1, 64)));
+  run_case("string index (34 arcs)",
+           make_walk("1.3.6.1.4.1.8072.1.3.2.3.1.2", string_indexes(64)));
+  return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * src/core/admission_control.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/admission_control.hpp"
+#include "simple_snmpd/logger.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace simple_snmpd {
+
+namespace {
+
+constexpr uint64_t NO_SAMPLE = std::numeric_limits<uint64_t>::max();
+
+} // namespace
+
+const char *request_class_name(RequestClass request_class) {
+  switch (request_class) {
+  case RequestClass::CRITICAL:
+    return "critical";
+  case RequestClass::INTERACTIVE:
+    return "interactive";
+  case RequestClass::BULK:
+    return "bulk";
+  case RequestClass::BACKGROUND:
+    return "background";
+  }
+  return "unknown";
+}
+
+AdmissionController::AdmissionController()
+    : enabled_(false), target_ns_(5000000), interval_ns_(100000000),
+      bulk_cost_(64), shed_level_(0), interval_min_ns_(NO_SAMPLE),
+      interval_end_ns_(0) {
+  for (size_t i = 0; i < SNMP_REQUEST_CLASSES; ++i) {
+    admitted_[i].store(0, std::memory_order_relaxed);
+    shed_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void AdmissionController::configure(
+    bool enabled, std::chrono::microseconds target,
+    std::chrono::microseconds interval, uint32_t bulk_cost,
+    const std::vector<std::string> &priority_communities,
+    const std::vector<std::string> &low_priority_communities) {
+  enabled_ = enabled;
+  target_ns_ = static_cast<uint64_t>(target.count()) * 1000;
+  interval_ns_ = static_cast<uint64_t>(interval.count()) * 1000;
+  bulk_cost_ = bulk_cost;
+  priority_communities_.clear();
+  priority_communities_.insert(priority_communities.begin(),
+                               priority_communities.end());
+  low_priority_communities_.clear();
+  low_priority_communities_.insert(low_priority_communities.begin(),
+                                   low_priority_communities.end());
+}
+
+uint32_t AdmissionController::estimate_cost(const SNMPPacketView &request) {
+  uint32_t varbinds =
+      static_cast<uint32_t>(request.get_variable_binding_count());
+  if (request.get_pdu_type() != SNMP_PDU_GET_BULK_REQUEST) {
+    return varbinds;
+  }
+
+  uint32_t non_repeaters =
+      std::min<uint32_t>(request.get_non_repeaters(), varbinds);
+  uint64_t repeaters = varbinds - non_repeaters;
+  uint64_t cost = non_repeaters + repeaters * request.get_max_repetitions();
+  return static_cast<uint32_t>(std::min<uint64_t>(
+      cost, std::numeric_limits<uint32_t>::max()));
+}
+
+RequestClass
+AdmissionController::classify(const SNMPPacketView &request) const {
+  return classify(request, request.get_community().to_string());
+}
+
+RequestClass
+AdmissionController::classify(const SNMPPacketView &request,
+                              const std::string &user_name) const {
+  if (!priority_communities_.empty() &&
+      priority_communities_.count(user_name)) {
+    return RequestClass::CRITICAL;
+  }
+  if (!low_priority_communities_.empty() &&
+      low_priority_communities_.count(user_name)) {
+    return RequestClass::BACKGROUND;
+  }
+
+  if (request.get_pdu_type() == SNMP_PDU_GET_BULK_REQUEST ||
+      estimate_cost(request) > bulk_cost_) {
+    return RequestClass::BULK;
+  }
+  return RequestClass::INTERACTIVE;
+}
+
+bool AdmissionController::admit(const RequestContext &context,
+                                const SNMPPacketView &request,
+                                uint64_t now_ns) {
+  return !enabled_ || admit(context, classify(request), now_ns);
+}
+
+bool AdmissionController::admit(const RequestContext &context,
+                                const SNMPPacketView &request,
+                                const std::string &user_name,
+                                uint64_t now_ns) {
+  return !enabled_ || admit(context, classify(request, user_name), now_ns);
+}
+
+bool AdmissionController::admit(const RequestContext &context,
+                                RequestClass classified, uint64_t now_ns) {
+  size_t request_class = static_cast<size_t>(classified);
+
+  // Track the smallest sojourn time of the interval; shed requests count
+  // too, they are what tells us the queue has drained
+  uint64_t sojourn_ns = context.arrival_ns != 0 && now_ns > context.arrival_ns
+                            ? now_ns - context.arrival_ns
+                            : 0;
+  uint64_t current = interval_min_ns_.load(std::memory_order_relaxed);
+  while (sojourn_ns < current &&
+         !interval_min_ns_.compare_exchange_weak(current, sojourn_ns,
+                                                 std::memory_order_relaxed)) {
+  }
+
+  uint64_t interval_end = interval_end_ns_.load(std::memory_order_relaxed);
+  if (now_ns >= interval_end &&
+      interval_end_ns_.compare_exchange_strong(interval_end,
+                                               now_ns + interval_ns_,
+                                               std::memory_order_relaxed)) {
+    end_interval();
+  }
+
+  uint32_t level = shed_level_.load(std::memory_order_relaxed);
+  if (request_class + level >= SNMP_REQUEST_CLASSES) {
+    shed_[request_class].fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  admitted_[request_class].fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void AdmissionController::end_interval() {
+  uint64_t min_sojourn =
+      interval_min_ns_.exchange(NO_SAMPLE, std::memory_order_relaxed);
+  uint32_t level = shed_level_.load(std::memory_order_relaxed);
+  uint32_t new_level = level;
+
+  // Even the fastest request waited longer than the target for a whole
+  // interval: the queue is standing, not just absorbing a burst
+  if (min_sojourn != NO_SAMPLE && min_sojourn > target_ns_) {
+    new_level = std::min<uint32_t>(level + 1, SNMP_REQUEST_CLASSES - 1);
+  } else if (level > 0) {
+    new_level = level - 1;
+  }
+
+  if (new_level == level) {
+    return;
+  }
+  shed_level_.store(new_level, std::memory_order_relaxed);
+
+  // Only entering and leaving the shedding state are worth a log line at
+  // the default level; the level moves every interval under sustained load
+  Logger &logger = Logger::get_instance();
+  if (new_level == 0) {
+    logger.log(LogLevel::INFO, "Load shedding stopped");
+    return;
+  }
+  LogLevel log_level = level == 0 ? LogLevel::WARNING : LogLevel::DEBUG;
+  if (logger.is_enabled(log_level)) {
+    RequestClass lowest_admitted =
+        static_cast<RequestClass>(SNMP_REQUEST_CLASSES - 1 - new_level);
+    std::string reason =
+        new_level > level
+            ? "queue delay " + std::to_string(min_sojourn / 1000) + "us"
+            : "queue delay below target";
+    logger.log(log_level, "Load shedding (" + reason + "): admitting " +
+                              request_class_name(lowest_admitted) +
+                              " and more important requests only");
+  }
+}
+
+AdmissionController::Statistics AdmissionController::get_statistics() const {
+  Statistics stats;
+  stats.shed_level = shed_level_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < SNMP_REQUEST_CLASSES; ++i) {
+    stats.admitted[i] = admitted_[i].load(std::memory_order_relaxed);
+    stats.shed[i] = shed_[i].load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+} // namespace simple_snmpd
@@ -0,0 +1,109 @@
+/*
+ * src/core/ber_encoder.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/ber_encoder.hpp"
+#include <cstring>
+
+namespace simple_snmpd {
+
+BerEncoder::BerEncoder(uint8_t *buffer, size_t capacity)
+    : buffer_(buffer), capacity_(capacity), start_(capacity),
+      overflow_(false) {}
+
+void BerEncoder::write_byte(uint8_t byte) {
+  if (start_ == 0) {
+    overflow_ = true;
+    return;
+  }
+  buffer_[--start_] = byte;
+}
+
+void BerEncoder::write_bytes(const uint8_t *bytes, size_t length) {
+  if (length > start_) {
+    overflow_ = true;
+    return;
+  }
+  start_ -= length;
+  if (length > 0) {
+    std::memcpy(buffer_ + start_, bytes, length);
+  }
+}
+
+void BerEncoder::write_header(uint8_t tag, size_t length) {
+  size_t needed = header_size(length);
+  if (needed > start_ || length > 0xFFFFFFFFu) {
+    overflow_ = true;
+    return;
+  }
+
+  if (length < 0x80) {
+    buffer_[--start_] = static_cast<uint8_t>(length);
+  } else {
+    size_t count = 0;
+    for (size_t value = length; value > 0; value >>= 8, ++count) {
+      buffer_[--start_] = static_cast<uint8_t>(value & 0xFF);
+    }
+    buffer_[--start_] = static_cast<uint8_t>(0x80 | count);
+  }
+  buffer_[--start_] = tag;
+}
+
+void BerEncoder::write_tlv(uint8_t tag, const uint8_t *contents,
+                           size_t length) {
+  write_bytes(contents, length);
+  write_header(tag, length);
+}
+
+void BerEncoder::write_integer(uint8_t tag, int64_t value) {
+  // Emit low octets until the remaining high part is just the sign
+  // extension of the last octet written
+  uint8_t octets[sizeof(value)];
+  size_t count = 0;
+  int64_t rest = value;
+  bool minimal = false;
+  do {
+    uint8_t octet = static_cast<uint8_t>(rest & 0xFF);
+    octets[sizeof(octets) - ++count] = octet;
+    rest >>= 8;
+    minimal = (rest == 0 && (octet & 0x80) == 0) ||
+              (rest == -1 && (octet & 0x80) != 0);
+  } while (!minimal && count < sizeof(octets));
+  write_tlv(tag, octets + sizeof(octets) - count, count);
+}
+
+size_t BerEncoder::integer_length(int64_t value) {
+  size_t length = 1;
+  while (length < sizeof(value) && (value < -128 || value > 127)) {
+    value >>= 8;
+    ++length;
+  }
+  return length;
+}
+
+size_t BerEncoder::header_size(size_t length) {
+  if (length < 0x80) {
+    return 2;
+  }
+  size_t size = 2;
+  for (size_t value = length; value > 0; value >>= 8) {
+    ++size;
+  }
+  return size;
+}
+
+} // namespace simple_snmpd
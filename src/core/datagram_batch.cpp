@@ -0,0 +1,215 @@
+/*
+ * src/core/datagram_batch.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/datagram_batch.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace simple_snmpd {
+
+#ifdef __linux__
+void read_datagram_control(const struct msghdr &msg, Datagram &datagram) {
+  datagram.timestamp_ns = 0;
+  datagram.has_drops = false;
+
+  for (const struct cmsghdr *cmsg =
+           CMSG_FIRSTHDR(const_cast<struct msghdr *>(&msg));
+       cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(const_cast<struct msghdr *>(&msg),
+                          const_cast<struct cmsghdr *>(cmsg))) {
+    if (cmsg->cmsg_level != SOL_SOCKET) {
+      continue;
+    }
+
+    if (cmsg->cmsg_type == SO_RXQ_OVFL &&
+        cmsg->cmsg_len >= CMSG_LEN(sizeof(uint32_t))) {
+      std::memcpy(&datagram.drops, CMSG_DATA(cmsg), sizeof(uint32_t));
+      datagram.has_drops = true;
+    } else if ((cmsg->cmsg_type == SO_TIMESTAMPING ||
+                cmsg->cmsg_type == SO_TIMESTAMPNS) &&
+               cmsg->cmsg_len >= CMSG_LEN(sizeof(struct timespec))) {
+      // SCM_TIMESTAMPING carries software, (legacy) and hardware stamps;
+      // the software stamp comes first, as does the SCM_TIMESTAMPNS one
+      struct timespec ts;
+      std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+      datagram.timestamp_ns =
+          static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+          static_cast<uint64_t>(ts.tv_nsec);
+    }
+  }
+}
+#endif
+
+DatagramBatch::DatagramBatch(size_t capacity, size_t slot_size)
+    : slot_size_(slot_size), count_(0), oversized_(0) {
+  capacity = std::max<size_t>(capacity, 1);
+  storage_.resize(capacity * slot_size_);
+  datagrams_.resize(capacity);
+
+  for (size_t i = 0; i < capacity; ++i) {
+    datagrams_[i].data = storage_.data() + i * slot_size_;
+  }
+
+#ifdef __linux__
+  headers_.resize(capacity);
+  iovecs_.resize(capacity);
+  control_.resize(capacity * SNMP_RECEIVE_CONTROL_SIZE);
+#endif
+}
+
+DatagramBatch::~DatagramBatch() {}
+
+Datagram &DatagramBatch::append() {
+  Datagram &datagram = datagrams_[count_++];
+  datagram.length = 0;
+  datagram.address_length = 0;
+  datagram.timestamp_ns = 0;
+  datagram.has_drops = false;
+  return datagram;
+}
+
+void DatagramBatch::discard_last() {
+  if (count_ > 0) {
+    --count_;
+  }
+}
+
+int DatagramBatch::receive(int socket_fd) {
+  clear();
+
+#ifdef __linux__
+  for (size_t i = 0; i < datagrams_.size(); ++i) {
+    iovecs_[i].iov_base = datagrams_[i].data;
+    iovecs_[i].iov_len = slot_size_;
+
+    struct msghdr &msg = headers_[i].msg_hdr;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &datagrams_[i].address;
+    msg.msg_namelen = sizeof(datagrams_[i].address);
+    msg.msg_iov = &iovecs_[i];
+    msg.msg_iovlen = 1;
+    msg.msg_control = control_.data() + i * SNMP_RECEIVE_CONTROL_SIZE;
+    msg.msg_controllen = SNMP_RECEIVE_CONTROL_SIZE;
+    headers_[i].msg_len = 0;
+  }
+
+  // MSG_WAITFORONE blocks for the first datagram only, so batching never
+  // holds back a request that is already queued.
+  int received =
+      recvmmsg(socket_fd, headers_.data(),
+               static_cast<unsigned int>(headers_.size()), MSG_WAITFORONE,
+               nullptr);
+  if (received < 0) {
+    return -1;
+  }
+
+  // A request cut to the slot size cannot be parsed; drop it rather than
+  // answer a different one. Slots swap with their buffers, so the kept
+  // datagrams stay contiguous.
+  int kept = 0;
+  for (int i = 0; i < received; ++i) {
+    const struct msghdr &msg = headers_[i].msg_hdr;
+    if (msg.msg_flags & MSG_TRUNC) {
+      ++oversized_;
+      continue;
+    }
+    read_datagram_control(msg, datagrams_[i]);
+    datagrams_[i].length = headers_[i].msg_len;
+    datagrams_[i].address_length = msg.msg_namelen;
+    if (kept != i) {
+      std::swap(datagrams_[kept], datagrams_[i]);
+    }
+    ++kept;
+  }
+  received = kept;
+#else
+  Datagram &datagram = datagrams_[0];
+  socklen_t address_length = sizeof(datagram.address);
+  auto bytes_received = recvfrom(
+      socket_fd, reinterpret_cast<char *>(datagram.data),
+      static_cast<int>(slot_size_), 0,
+      reinterpret_cast<struct sockaddr *>(&datagram.address), &address_length);
+  if (bytes_received < 0) {
+    return -1;
+  }
+
+  datagram.length = static_cast<size_t>(bytes_received);
+  datagram.address_length = address_length;
+  datagram.timestamp_ns = 0;
+  datagram.has_drops = false;
+  int received = 1;
+#endif
+
+  count_ = static_cast<size_t>(received);
+  return received;
+}
+
+size_t DatagramBatch::send(int socket_fd, size_t &syscalls) {
+  size_t sent = 0;
+  syscalls = 0;
+
+#ifdef __linux__
+  for (size_t i = 0; i < count_; ++i) {
+    iovecs_[i].iov_base = datagrams_[i].data;
+    iovecs_[i].iov_len = datagrams_[i].length;
+
+    struct msghdr &msg = headers_[i].msg_hdr;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &datagrams_[i].address;
+    msg.msg_namelen = datagrams_[i].address_length;
+    msg.msg_iov = &iovecs_[i];
+    msg.msg_iovlen = 1;
+  }
+
+  size_t offset = 0;
+  while (offset < count_) {
+    ++syscalls;
+    int result = sendmmsg(socket_fd, headers_.data() + offset,
+                          static_cast<unsigned int>(count_ - offset), 0);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // The datagram at offset could not be sent; skip it and keep going
+      ++offset;
+      continue;
+    }
+    offset += static_cast<size_t>(result);
+    sent += static_cast<size_t>(result);
+  }
+#else
+  for (size_t i = 0; i < count_; ++i) {
+    const Datagram &datagram = datagrams_[i];
+    ++syscalls;
+    auto bytes_sent = sendto(
+        socket_fd, reinterpret_cast<const char *>(datagram.data),
+        static_cast<int>(datagram.length), 0,
+        reinterpret_cast<const struct sockaddr *>(&datagram.address),
+        datagram.address_length);
+    if (bytes_sent >= 0) {
+      ++sent;
+    }
+  }
+#endif
+
+  count_ = 0;
+  return sent;
+}
+
+} // namespace simple_snmpd
@@ -0,0 +1,53 @@
+/*
+ * src/core/datagram_engine.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/datagram_engine.hpp"
+#include "simple_snmpd/logger.hpp"
+
+namespace simple_snmpd {
+
+int SocketDatagramEngine::receive(DatagramBatch &batch, size_t &syscalls) {
+  syscalls = 1;
+  return batch.receive(socket_fd_);
+}
+
+size_t SocketDatagramEngine::send(DatagramBatch &batch, size_t &syscalls) {
+  return batch.send(socket_fd_, syscalls);
+}
+
+std::unique_ptr<DatagramEngine>
+create_datagram_engine(const std::string &backend, int socket_fd,
+                       size_t batch_size) {
+  if (backend == "io_uring") {
+    auto engine = create_io_uring_datagram_engine(socket_fd, batch_size);
+    if (engine) {
+      return engine;
+    }
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "io_uring datagram engine is not supported, "
+                               "falling back to the socket engine");
+  } else if (backend != "socket") {
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "Unknown io_backend '" + backend +
+                                   "', using the socket engine");
+  }
+
+  return std::make_unique<SocketDatagramEngine>(socket_fd);
+}
+
+} // namespace simple_snmpd
@@ -0,0 +1,180 @@
+/*
+ * src/core/epoch.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/epoch.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace simple_snmpd {
+
+namespace {
+
+constexpr size_t NO_SLOT = static_cast<size_t>(-1);
+
+} // namespace
+
+// Per-thread reader state: the claimed slot and the guard nesting depth
+struct ThreadReader {
+  size_t slot = NO_SLOT;
+  bool overflow = false;
+  unsigned depth = 0;
+
+  ~ThreadReader() {
+    if (slot != NO_SLOT) {
+      EpochManager::get_instance().release_slot(slot);
+    }
+  }
+};
+
+namespace {
+
+thread_local ThreadReader thread_reader;
+
+} // namespace
+
+EpochManager::Guard::Guard() { EpochManager::get_instance().enter(); }
+
+EpochManager::Guard::Guard(const Guard &) {
+  EpochManager::get_instance().enter();
+}
+
+EpochManager::Guard::~Guard() { EpochManager::get_instance().leave(); }
+
+EpochManager &EpochManager::get_instance() {
+  static EpochManager instance;
+  return instance;
+}
+
+EpochManager::EpochManager()
+    : epoch_(1), overflow_readers_(0), readers_(0), reclaimed_(0) {
+  for (Slot &slot : slots_) {
+    slot.in_use.store(false, std::memory_order_relaxed);
+    slot.pinned.store(0, std::memory_order_relaxed);
+  }
+}
+
+EpochManager::~EpochManager() {
+  // No readers are left at exit
+  for (Retired &retired : retired_) {
+    retired.deleter();
+  }
+}
+
+void EpochManager::enter() {
+  ThreadReader &reader = thread_reader;
+  if (reader.depth++ > 0) {
+    return;
+  }
+  if (reader.slot == NO_SLOT) {
+    reader.slot = claim_slot();
+  }
+  reader.overflow = reader.slot == NO_SLOT;
+  if (reader.overflow) {
+    overflow_readers_.fetch_add(1, std::memory_order_seq_cst);
+    return;
+  }
+
+  // Sequentially consistent, so the pin is visible to writers before
+  // anything this reader loads afterwards
+  slots_[reader.slot].pinned.store(epoch_.load(std::memory_order_seq_cst),
+                                   std::memory_order_seq_cst);
+}
+
+void EpochManager::leave() {
+  ThreadReader &reader = thread_reader;
+  if (--reader.depth > 0) {
+    return;
+  }
+  if (reader.overflow) {
+    overflow_readers_.fetch_sub(1, std::memory_order_release);
+  } else {
+    slots_[reader.slot].pinned.store(0, std::memory_order_release);
+  }
+}
+
+size_t EpochManager::claim_slot() {
+  for (size_t i = 0; i < MAX_READERS; ++i) {
+    bool expected = false;
+    if (!slots_[i].in_use.load(std::memory_order_relaxed) &&
+        slots_[i].in_use.compare_exchange_strong(expected, true,
+                                                 std::memory_order_acq_rel)) {
+      readers_.fetch_add(1, std::memory_order_relaxed);
+      return i;
+    }
+  }
+  return NO_SLOT;
+}
+
+void EpochManager::release_slot(size_t slot) {
+  slots_[slot].pinned.store(0, std::memory_order_release);
+  slots_[slot].in_use.store(false, std::memory_order_release);
+  readers_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void EpochManager::retire(std::function<void()> deleter) {
+  std::lock_guard<std::mutex> lock(retired_mutex_);
+
+  // The old version was unpublished before this: readers pinned at or
+  // before the current epoch may hold it, later ones cannot
+  uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst);
+  retired_.push_back({epoch, std::move(deleter)});
+  reclaim_locked();
+}
+
+void EpochManager::reclaim() {
+  std::lock_guard<std::mutex> lock(retired_mutex_);
+  reclaim_locked();
+}
+
+void EpochManager::reclaim_locked() {
+  if (retired_.empty() ||
+      overflow_readers_.load(std::memory_order_seq_cst) > 0) {
+    return;
+  }
+
+  uint64_t oldest = UINT64_MAX;
+  for (const Slot &slot : slots_) {
+    uint64_t pinned = slot.pinned.load(std::memory_order_seq_cst);
+    if (pinned != 0) {
+      oldest = std::min(oldest, pinned);
+    }
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < retired_.size(); ++i) {
+    if (retired_[i].epoch < oldest) {
+      retired_[i].deleter();
+      ++reclaimed_;
+    } else if (kept++ != i) {
+      retired_[kept - 1] = std::move(retired_[i]);
+    }
+  }
+  retired_.resize(kept);
+}
+
+EpochManager::Statistics EpochManager::get_statistics() const {
+  std::lock_guard<std::mutex> lock(retired_mutex_);
+  Statistics stats;
+  stats.epoch = epoch_.load(std::memory_order_relaxed);
+  stats.retired = retired_.size();
+  stats.reclaimed = reclaimed_;
+  stats.readers = readers_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+} // namespace simple_snmpd
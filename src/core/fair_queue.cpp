@@ -0,0 +1,186 @@
+/*
+ * src/core/fair_queue.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/fair_queue.hpp"
+#include "simple_snmpd/logger.hpp"
+#include <algorithm>
+
+namespace simple_snmpd {
+
+FairQueue::FairQueue()
+    : quantum_(1500), flow_depth_(64), depth_(0), enqueued_(0), dropped_(0) {}
+
+bool FairQueue::configure(uint32_t quantum, uint32_t flow_depth,
+                          const std::vector<std::string> &weights) {
+  quantum_ = quantum;
+  flow_depth_ = flow_depth;
+  rules_.clear();
+
+  for (const auto &rule_text : weights) {
+    size_t equal_pos = rule_text.rfind('=');
+    if (equal_pos == std::string::npos) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid fair queue weight: " + rule_text);
+      return false;
+    }
+
+    std::string network = rule_text.substr(0, equal_pos);
+    WeightRule rule;
+    try {
+      rule.weight = static_cast<uint32_t>(
+          std::stoul(rule_text.substr(equal_pos + 1)));
+    } catch (const std::exception &) {
+      rule.weight = 0;
+    }
+
+    size_t slash_pos = network.find('/');
+    std::string address = network.substr(0, slash_pos);
+    if (rule.weight == 0 || !NetworkAddress::parse(address, rule.network)) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid fair queue weight: " + rule_text);
+      return false;
+    }
+
+    rule.prefix_length = rule.network.length * 8;
+    if (slash_pos != std::string::npos) {
+      try {
+        rule.prefix_length = static_cast<uint32_t>(
+            std::stoul(network.substr(slash_pos + 1)));
+      } catch (const std::exception &) {
+        rule.prefix_length = rule.network.length * 8 + 1;
+      }
+      if (rule.prefix_length > rule.network.length * 8u) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid fair queue weight: " + rule_text);
+        return false;
+      }
+    }
+    rules_.push_back(rule);
+  }
+  return true;
+}
+
+uint32_t FairQueue::weight_for(const NetworkAddress &source) const {
+  for (const auto &rule : rules_) {
+    if (source.in_network(rule.network, rule.prefix_length)) {
+      return rule.weight;
+    }
+  }
+  return 1;
+}
+
+bool FairQueue::push(const NetworkAddress &source, uint32_t item,
+                     uint32_t cost) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::unique_ptr<Flow> &slot = flows_[source];
+  if (!slot) {
+    slot.reset(new Flow());
+    slot->source = source;
+    slot->weight = weight_for(source);
+    slot->deficit = 0;
+    slot->active = false;
+  }
+  Flow &flow = *slot;
+
+  if (flow.entries.size() >=
+      static_cast<size_t>(flow_depth_) * flow.weight) {
+    dropped_++;
+    return false;
+  }
+
+  flow.entries.push_back(Entry{item, cost});
+  depth_++;
+  enqueued_++;
+
+  // A flow joining the round starts with one quantum of credit
+  if (!flow.active) {
+    flow.active = true;
+    flow.deficit = static_cast<uint64_t>(quantum_) * flow.weight;
+    active_.push_back(&flow);
+  }
+  return true;
+}
+
+bool FairQueue::pop(uint32_t &item) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  while (!active_.empty()) {
+    Flow *flow = active_.front();
+    const Entry &head = flow->entries.front();
+
+    if (head.cost <= flow->deficit) {
+      item = head.item;
+      flow->deficit -= head.cost;
+      flow->entries.pop_front();
+      depth_--;
+
+      // Idle sources keep no state and no credit
+      if (flow->entries.empty()) {
+        active_.pop_front();
+        flows_.erase(flow->source);
+      }
+      return true;
+    }
+
+    // Out of credit: the next source's turn, with a fresh quantum for
+    // this one when it comes round again
+    flow->deficit += static_cast<uint64_t>(quantum_) * flow->weight;
+    active_.pop_front();
+    active_.push_back(flow);
+  }
+  return false;
+}
+
+size_t FairQueue::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return depth_;
+}
+
+FairQueue::Statistics FairQueue::get_statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Statistics stats;
+  stats.enqueued = enqueued_;
+  stats.dropped = dropped_;
+  stats.depth = depth_;
+  stats.active_flows = active_.size();
+  return stats;
+}
+
+std::vector<FairQueue::FlowStatistics>
+FairQueue::top_flows(size_t count) const {
+  std::vector<FlowStatistics> flows;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flows.reserve(active_.size());
+    for (const Flow *flow : active_) {
+      flows.push_back(
+          FlowStatistics{flow->source, flow->weight, flow->entries.size()});
+    }
+  }
+
+  count = std::min(count, flows.size());
+  std::partial_sort(flows.begin(), flows.begin() + count, flows.end(),
+                    [](const FlowStatistics &a, const FlowStatistics &b) {
+                      return a.depth > b.depth;
+                    });
+  flows.resize(count);
+  return flows;
+}
+
+} // namespace simple_snmpd
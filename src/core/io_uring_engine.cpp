@@ -0,0 +1,599 @@
+/*
+ * src/core/io_uring_engine.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/datagram_engine.hpp"
+#include "simple_snmpd/logger.hpp"
+
+#ifdef SIMPLE_SNMPD_HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+// Multishot recvmsg and provided-buffer rings need Linux 6.0 UAPI headers
+#if defined(SIMPLE_SNMPD_HAVE_IO_URING) && defined(IORING_RECV_MULTISHOT)
+#define SIMPLE_SNMPD_IO_URING_ENGINE 1
+#endif
+
+#ifdef SIMPLE_SNMPD_IO_URING_ENGINE
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+#endif
+
+namespace simple_snmpd {
+
+#ifdef SIMPLE_SNMPD_IO_URING_ENGINE
+
+namespace {
+
+constexpr uint64_t RECEIVE_USER_DATA = 1;
+constexpr uint64_t SEND_USER_DATA = 2;
+constexpr uint16_t RECEIVE_BUFFER_GROUP = 0;
+
+// Upper bound on how long receive() blocks, so the server loop can notice
+// shutdown even if no datagram arrives
+constexpr long RECEIVE_WAIT_NSEC = 200 * 1000 * 1000;
+
+int io_uring_setup(unsigned int entries, struct io_uring_params *params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int ring_fd, unsigned int to_submit,
+                   unsigned int min_complete, unsigned int flags,
+                   const void *arg, size_t arg_size) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                  min_complete, flags, arg, arg_size));
+}
+
+int io_uring_register(int ring_fd, unsigned int opcode, const void *arg,
+                      unsigned int nr_args) {
+  return static_cast<int>(
+      syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+unsigned int round_up_pow2(size_t value) {
+  unsigned int result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+// One io_uring instance with its submission and completion rings mapped
+class Ring {
+public:
+  Ring()
+      : fd_(-1), features_(0), sq_ring_(nullptr), sq_ring_size_(0),
+        cq_ring_(nullptr), cq_ring_size_(0), sqes_(nullptr), sqes_size_(0),
+        sq_head_(nullptr), sq_tail_(nullptr), sq_mask_(nullptr),
+        sq_array_(nullptr), sq_entries_(0), cq_head_(nullptr),
+        cq_tail_(nullptr), cq_mask_(nullptr), cqes_(nullptr), sqe_tail_(0),
+        sqe_submitted_(0) {}
+
+  ~Ring() { close(); }
+
+  Ring(const Ring &) = delete;
+  Ring &operator=(const Ring &) = delete;
+
+  bool setup(unsigned int entries, unsigned int cq_entries) {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    if (cq_entries > 0) {
+      params.flags |= IORING_SETUP_CQSIZE;
+      params.cq_entries = cq_entries;
+    }
+
+    fd_ = io_uring_setup(entries, &params);
+    if (fd_ < 0) {
+      fd_ = -1;
+      return false;
+    }
+    features_ = params.features;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+      sq_ring_ = nullptr;
+      close();
+      return false;
+    }
+
+    if (single_mmap) {
+      cq_ring_ = sq_ring_;
+    } else {
+      cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+      if (cq_ring_ == MAP_FAILED) {
+        cq_ring_ = nullptr;
+        close();
+        return false;
+      }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      close();
+      return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+    auto *sq = static_cast<uint8_t *>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+
+    auto *cq = static_cast<uint8_t *>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    sqe_tail_ = sqe_submitted_ = *sq_tail_;
+    return true;
+  }
+
+  void close() {
+    if (sqes_) {
+      munmap(sqes_, sqes_size_);
+      sqes_ = nullptr;
+    }
+    if (cq_ring_ && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = nullptr;
+    if (sq_ring_) {
+      munmap(sq_ring_, sq_ring_size_);
+      sq_ring_ = nullptr;
+    }
+    if (fd_ != -1) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  int fd() const { return fd_; }
+  bool has_feature(unsigned int feature) const {
+    return (features_ & feature) != 0;
+  }
+
+  // Next free submission entry, zeroed, or nullptr if the ring is full
+  struct io_uring_sqe *get_sqe() {
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sqe_tail_ - head >= sq_entries_) {
+      return nullptr;
+    }
+    unsigned index = sqe_tail_ & *sq_mask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sqe_tail_;
+    return sqe;
+  }
+
+  unsigned pending() const { return sqe_tail_ - sqe_submitted_; }
+
+  // Submit every prepared entry and optionally wait for completions
+  int enter(unsigned min_complete, unsigned flags, const void *arg,
+            size_t arg_size) {
+    unsigned to_submit = pending();
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    int result =
+        io_uring_enter(fd_, to_submit, min_complete, flags, arg, arg_size);
+    if (result > 0) {
+      sqe_submitted_ += std::min<unsigned>(static_cast<unsigned>(result),
+                                           to_submit);
+    }
+    return result;
+  }
+
+  struct io_uring_cqe *peek_cqe() {
+    unsigned head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      return nullptr;
+    }
+    return &cqes_[head & *cq_mask_];
+  }
+
+  void cqe_seen() {
+    __atomic_store_n(cq_head_, *cq_head_ + 1, __ATOMIC_RELEASE);
+  }
+
+private:
+  int fd_;
+  unsigned int features_;
+  void *sq_ring_;
+  size_t sq_ring_size_;
+  void *cq_ring_;
+  size_t cq_ring_size_;
+  struct io_uring_sqe *sqes_;
+  size_t sqes_size_;
+  unsigned *sq_head_;
+  unsigned *sq_tail_;
+  unsigned *sq_mask_;
+  unsigned *sq_array_;
+  unsigned sq_entries_;
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned *cq_mask_;
+  struct io_uring_cqe *cqes_;
+  unsigned sqe_tail_;
+  unsigned sqe_submitted_;
+};
+
+// Receives with one multishot recvmsg that the kernel completes into a
+// provided-buffer ring, and sends each batch with a single submission on
+// a separate ring so send completions never interleave with receives.
+class IoUringDatagramEngine : public DatagramEngine {
+public:
+  IoUringDatagramEngine(int socket_fd, size_t batch_size)
+      : socket_fd_(socket_fd), batch_size_(std::max<size_t>(batch_size, 1)),
+        buffer_count_(0), buffer_size_(0), buffer_ring_(nullptr),
+        buffer_ring_size_(0), buffer_ring_tail_(0), receive_armed_(false) {
+    std::memset(&receive_msg_, 0, sizeof(receive_msg_));
+  }
+
+  ~IoUringDatagramEngine() override {
+    // Tear the rings down first so the kernel stops using our buffers
+    receive_ring_.close();
+    send_ring_.close();
+    if (buffer_ring_) {
+      munmap(buffer_ring_, buffer_ring_size_);
+    }
+  }
+
+  bool initialize() {
+    // Keep enough buffers for several batches in flight
+    buffer_count_ = round_up_pow2(std::max<size_t>(batch_size_ * 4, 64));
+    buffer_size_ = sizeof(struct io_uring_recvmsg_out) +
+                   sizeof(struct sockaddr_storage) +
+                   SNMP_RECEIVE_CONTROL_SIZE + SNMP_RECEIVE_BUFFER_SIZE;
+
+    if (!receive_ring_.setup(8, buffer_count_ * 2) ||
+        !send_ring_.setup(round_up_pow2(batch_size_), 0)) {
+      return false;
+    }
+
+    // Provided-buffer ring shared with the kernel
+    buffer_ring_size_ = buffer_count_ * sizeof(struct io_uring_buf);
+    void *ring = mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED) {
+      return false;
+    }
+    buffer_ring_ = static_cast<struct io_uring_buf_ring *>(ring);
+
+    struct io_uring_buf_reg registration;
+    std::memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<uint64_t>(buffer_ring_);
+    registration.ring_entries = buffer_count_;
+    registration.bgid = RECEIVE_BUFFER_GROUP;
+    if (io_uring_register(receive_ring_.fd(), IORING_REGISTER_PBUF_RING,
+                          &registration, 1) < 0) {
+      return false;
+    }
+
+    buffers_.resize(static_cast<size_t>(buffer_count_) * buffer_size_);
+    buffer_ring_tail_ = 0;
+    for (unsigned int bid = 0; bid < buffer_count_; ++bid) {
+      add_buffer(static_cast<uint16_t>(bid));
+    }
+    publish_buffers();
+
+    // recvmsg header template: the kernel writes the source address and
+    // ancillary data in front of each payload inside the selected buffer
+    receive_msg_.msg_namelen = sizeof(struct sockaddr_storage);
+    receive_msg_.msg_controllen = SNMP_RECEIVE_CONTROL_SIZE;
+
+    send_msgs_.resize(batch_size_);
+    send_iovecs_.resize(batch_size_);
+
+    // Kernels without multishot recvmsg reject the request immediately
+    arm_receive();
+    if (receive_ring_.enter(0, 0, nullptr, 0) < 0) {
+      return false;
+    }
+    struct io_uring_cqe *cqe = receive_ring_.peek_cqe();
+    if (cqe && cqe->res == -EINVAL) {
+      return false;
+    }
+
+    return true;
+  }
+
+  const char *name() const override { return "io_uring"; }
+
+  int receive(DatagramBatch &batch, size_t &syscalls) override {
+    syscalls = 0;
+    batch.clear();
+    bool failed = false;
+
+    reap_receive(batch, failed);
+
+    if (batch.empty()) {
+      ++syscalls;
+      int result;
+      if (receive_ring_.has_feature(IORING_FEAT_EXT_ARG)) {
+        struct __kernel_timespec timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_nsec = RECEIVE_WAIT_NSEC;
+        struct io_uring_getevents_arg arg;
+        std::memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+        result = receive_ring_.enter(
+            1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+            sizeof(arg));
+      } else {
+        result = receive_ring_.enter(1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      }
+
+      if (result < 0 && errno != ETIME && errno != EINTR && errno != EAGAIN &&
+          errno != EBUSY) {
+        return -1;
+      }
+
+      reap_receive(batch, failed);
+    } else if (receive_ring_.pending() > 0) {
+      // Re-arm the receive without waiting
+      ++syscalls;
+      receive_ring_.enter(0, 0, nullptr, 0);
+    }
+
+    if (failed && batch.empty()) {
+      return -1;
+    }
+    return static_cast<int>(batch.size());
+  }
+
+  size_t send(DatagramBatch &batch, size_t &syscalls) override {
+    syscalls = 0;
+    size_t sent = 0;
+    size_t count = std::min(batch.size(), send_msgs_.size());
+    size_t next = 0;
+
+    while (next < count) {
+      // Queue as many sends as the submission ring takes
+      unsigned int queued = 0;
+      while (next < count) {
+        struct io_uring_sqe *sqe = send_ring_.get_sqe();
+        if (!sqe) {
+          break;
+        }
+
+        Datagram &datagram = batch[next];
+        send_iovecs_[next].iov_base = datagram.data;
+        send_iovecs_[next].iov_len = datagram.length;
+
+        struct msghdr &msg = send_msgs_[next];
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &datagram.address;
+        msg.msg_namelen = datagram.address_length;
+        msg.msg_iov = &send_iovecs_[next];
+        msg.msg_iovlen = 1;
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = socket_fd_;
+        sqe->addr = reinterpret_cast<uint64_t>(&msg);
+        sqe->len = 1;
+        sqe->user_data = SEND_USER_DATA;
+        ++next;
+        ++queued;
+      }
+
+      // One io_uring_enter submits the whole batch and waits for it
+      unsigned int completed = 0;
+      while (completed < queued) {
+        ++syscalls;
+        int result = send_ring_.enter(queued - completed,
+                                      IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (result < 0 && errno != EINTR && errno != EAGAIN &&
+            errno != EBUSY) {
+          batch.clear();
+          return sent;
+        }
+
+        struct io_uring_cqe *cqe;
+        while ((cqe = send_ring_.peek_cqe()) != nullptr) {
+          if (cqe->res >= 0) {
+            ++sent;
+          }
+          ++completed;
+          send_ring_.cqe_seen();
+        }
+      }
+    }
+
+    batch.clear();
+    return sent;
+  }
+
+private:
+  void arm_receive() {
+    struct io_uring_sqe *sqe = receive_ring_.get_sqe();
+    if (!sqe) {
+      return;
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = socket_fd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&receive_msg_);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECEIVE_BUFFER_GROUP;
+    sqe->user_data = RECEIVE_USER_DATA;
+    receive_armed_ = true;
+  }
+
+  void add_buffer(uint16_t bid) {
+    // Index the entries directly: in C++ the flexible bufs member of
+    // io_uring_buf_ring sits behind a one-byte placeholder struct and does
+    // not start at offset 0 as it does for the kernel
+    struct io_uring_buf &buf = reinterpret_cast<struct io_uring_buf *>(
+        buffer_ring_)[buffer_ring_tail_ & (buffer_count_ - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(buffers_.data() +
+                                          static_cast<size_t>(bid) *
+                                              buffer_size_);
+    buf.len = static_cast<uint32_t>(buffer_size_);
+    buf.bid = bid;
+    ++buffer_ring_tail_;
+  }
+
+  void publish_buffers() {
+    __atomic_store_n(&buffer_ring_->tail, buffer_ring_tail_,
+                     __ATOMIC_RELEASE);
+  }
+
+  // Copy completed receives into the batch and recycle their buffers
+  void reap_receive(DatagramBatch &batch, bool &failed) {
+    bool recycled = false;
+    struct io_uring_cqe *cqe;
+
+    while (!batch.full() && (cqe = receive_ring_.peek_cqe()) != nullptr) {
+      int result = cqe->res;
+      uint32_t flags = cqe->flags;
+      receive_ring_.cqe_seen();
+
+      if (!(flags & IORING_CQE_F_MORE)) {
+        // The multishot request ended (error or no buffers); re-arm it
+        receive_armed_ = false;
+      }
+
+      if (result < 0) {
+        if (result != -ENOBUFS) {
+          failed = true;
+        }
+        continue;
+      }
+
+      if (!(flags & IORING_CQE_F_BUFFER)) {
+        continue;
+      }
+
+      uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+      const uint8_t *buffer =
+          buffers_.data() + static_cast<size_t>(bid) * buffer_size_;
+      copy_datagram(buffer, static_cast<size_t>(result), batch);
+      add_buffer(bid);
+      recycled = true;
+    }
+
+    if (recycled) {
+      publish_buffers();
+    }
+    if (!receive_armed_) {
+      arm_receive();
+    }
+  }
+
+  void copy_datagram(const uint8_t *buffer, size_t length,
+                     DatagramBatch &batch) {
+    size_t header = sizeof(struct io_uring_recvmsg_out) +
+                    receive_msg_.msg_namelen + receive_msg_.msg_controllen;
+    if (length < header) {
+      return;
+    }
+
+    const auto *out =
+        reinterpret_cast<const struct io_uring_recvmsg_out *>(buffer);
+    size_t payload_length = length - header;
+    if ((out->flags & MSG_TRUNC) || payload_length > batch.slot_size()) {
+      // Oversized request; dropped and counted as the socket engine does
+      batch.drop_oversized();
+      return;
+    }
+
+    Datagram &datagram = batch.append();
+    size_t name_length =
+        std::min<size_t>(out->namelen, sizeof(datagram.address));
+    std::memcpy(&datagram.address,
+                buffer + sizeof(struct io_uring_recvmsg_out), name_length);
+    datagram.address_length = static_cast<socklen_t>(name_length);
+    std::memcpy(datagram.data, buffer + header, payload_length);
+    datagram.length = payload_length;
+
+    struct msghdr control;
+    std::memset(&control, 0, sizeof(control));
+    control.msg_control = const_cast<uint8_t *>(
+        buffer + sizeof(struct io_uring_recvmsg_out) +
+        receive_msg_.msg_namelen);
+    control.msg_controllen = out->controllen;
+    read_datagram_control(control, datagram);
+  }
+
+  int socket_fd_;
+  size_t batch_size_;
+
+  Ring receive_ring_;
+  Ring send_ring_;
+
+  // Provided buffers
+  unsigned int buffer_count_;
+  size_t buffer_size_;
+  std::vector<uint8_t> buffers_;
+  struct io_uring_buf_ring *buffer_ring_;
+  size_t buffer_ring_size_;
+  unsigned short buffer_ring_tail_;
+
+  struct msghdr receive_msg_;
+  bool receive_armed_;
+
+  std::vector<struct msghdr> send_msgs_;
+  std::vector<struct iovec> send_iovecs_;
+};
+
+} // namespace
+
+std::unique_ptr<DatagramEngine>
+create_io_uring_datagram_engine(int socket_fd, size_t batch_size) {
+  auto engine = std::make_unique<IoUringDatagramEngine>(socket_fd, batch_size);
+  if (!engine->initialize()) {
+    Logger::get_instance().log(LogLevel::DEBUG,
+                               "io_uring engine initialization failed: " +
+                                   std::string(std::strerror(errno)));
+    return nullptr;
+  }
+  return engine;
+}
+
+#else
+
+std::unique_ptr<DatagramEngine>
+create_io_uring_datagram_engine(int socket_fd, size_t batch_size) {
+  (void)socket_fd;
+  (void)batch_size;
+  return nullptr;
+}
+
+#endif
+
+} // namespace simple_snmpd
@@ -0,0 +1,182 @@
+/*
+ * src/core/listen_endpoint.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/listen_endpoint.hpp"
+#include <cstring>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#endif
+
+namespace simple_snmpd {
+
+namespace {
+
+std::string trim(const std::string &value) {
+  size_t start = value.find_first_not_of(" \t");
+  if (start == std::string::npos) {
+    return "";
+  }
+  size_t end = value.find_last_not_of(" \t");
+  return value.substr(start, end - start + 1);
+}
+
+bool parse_port(const std::string &text, uint16_t &port) {
+  if (text.empty() || text.size() > 5) {
+    return false;
+  }
+  uint32_t value = 0;
+  for (char c : text) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    value = value * 10 + static_cast<uint32_t>(c - '0');
+  }
+  if (value < 1 || value > 65535) {
+    return false;
+  }
+  port = static_cast<uint16_t>(value);
+  return true;
+}
+
+} // namespace
+
+bool parse_listen_endpoint(const std::string &spec, uint16_t default_port,
+                           ListenEndpoint &endpoint) {
+  endpoint = ListenEndpoint();
+  std::string text = trim(spec);
+
+  size_t at = text.rfind('@');
+  if (at != std::string::npos) {
+    endpoint.interface = text.substr(at + 1);
+    text = text.substr(0, at);
+    if (endpoint.interface.empty()) {
+      return false;
+    }
+  }
+
+  std::string host;
+  uint16_t port = default_port;
+  bool bracketed = false;
+
+  if (text == "*") {
+    host = "::";
+    endpoint.v6_only = false;
+  } else if (!text.empty() && text[0] == '[') {
+    size_t close = text.find(']');
+    if (close == std::string::npos) {
+      return false;
+    }
+    host = text.substr(1, close - 1);
+    bracketed = true;
+    std::string rest = text.substr(close + 1);
+    if (!rest.empty() &&
+        (rest[0] != ':' || !parse_port(rest.substr(1), port))) {
+      return false;
+    }
+  } else if (text.find(':') != text.rfind(':')) {
+    // Bare IPv6 address; a port needs the bracketed form
+    host = text;
+  } else {
+    size_t colon = text.find(':');
+    host = text.substr(0, colon);
+    if (colon != std::string::npos &&
+        !parse_port(text.substr(colon + 1), port)) {
+      return false;
+    }
+  }
+
+  std::memset(&endpoint.address, 0, sizeof(endpoint.address));
+
+  struct in_addr v4;
+  struct in6_addr v6;
+  if (!bracketed && inet_pton(AF_INET, host.c_str(), &v4) == 1) {
+    auto &sin = reinterpret_cast<struct sockaddr_in &>(endpoint.address);
+    sin.sin_family = AF_INET;
+    sin.sin_addr = v4;
+    sin.sin_port = htons(port);
+    endpoint.address_length = sizeof(struct sockaddr_in);
+    return true;
+  }
+
+  if (inet_pton(AF_INET6, host.c_str(), &v6) == 1) {
+    auto &sin6 = reinterpret_cast<struct sockaddr_in6 &>(endpoint.address);
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_addr = v6;
+    sin6.sin6_port = htons(port);
+#ifndef _WIN32
+    // Link-local addresses are only meaningful with their interface
+    if (!endpoint.interface.empty() && IN6_IS_ADDR_LINKLOCAL(&v6)) {
+      sin6.sin6_scope_id = if_nametoindex(endpoint.interface.c_str());
+    }
+#endif
+    endpoint.address_length = sizeof(struct sockaddr_in6);
+    return true;
+  }
+
+  return false;
+}
+
+std::vector<std::string> split_listen_addresses(const std::string &value) {
+  std::vector<std::string> result;
+  size_t start = 0;
+  while (start <= value.size()) {
+    size_t comma = value.find(',', start);
+    if (comma == std::string::npos) {
+      comma = value.size();
+    }
+    std::string entry = trim(value.substr(start, comma - start));
+    if (!entry.empty()) {
+      result.push_back(entry);
+    }
+    start = comma + 1;
+  }
+  return result;
+}
+
+std::string listen_endpoint_to_string(const ListenEndpoint &endpoint) {
+  char host[INET6_ADDRSTRLEN] = "?";
+  uint16_t port = 0;
+  std::string result;
+
+  if (endpoint.family() == AF_INET) {
+    const auto &sin =
+        reinterpret_cast<const struct sockaddr_in &>(endpoint.address);
+    inet_ntop(AF_INET, &sin.sin_addr, host, sizeof(host));
+    port = ntohs(sin.sin_port);
+    result = std::string(host) + ":" + std::to_string(port);
+  } else if (endpoint.family() == AF_INET6) {
+    const auto &sin6 =
+        reinterpret_cast<const struct sockaddr_in6 &>(endpoint.address);
+    inet_ntop(AF_INET6, &sin6.sin6_addr, host, sizeof(host));
+    port = ntohs(sin6.sin6_port);
+    result = "[" + std::string(host) + "]:" + std::to_string(port);
+    if (!endpoint.v6_only) {
+      result += " (dual-stack)";
+    }
+  }
+
+  if (!endpoint.interface.empty()) {
+    result += "@" + endpoint.interface;
+  }
+  return result;
+}
+
+} // namespace simple_snmpd
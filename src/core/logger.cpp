@@ -26,6 +26,35 @@
 
 namespace simple_snmpd {
 
+LogSampler::LogSampler(uint32_t burst, std::chrono::milliseconds interval)
+    : burst_(burst),
+      interval_ns_(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(interval)
+              .count()),
+      window_start_ns_(0), window_count_(0), suppressed_(0) {}
+
+bool LogSampler::allow(uint64_t &suppressed) {
+  int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+
+  // Whoever moves the window forward resets its count; a message racing
+  // with the reset may be let through in either window
+  int64_t start = window_start_ns_.load(std::memory_order_relaxed);
+  if (now - start >= interval_ns_ &&
+      window_start_ns_.compare_exchange_strong(start, now,
+                                               std::memory_order_relaxed)) {
+    window_count_.store(0, std::memory_order_relaxed);
+  }
+
+  if (window_count_.fetch_add(1, std::memory_order_relaxed) >= burst_) {
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+  return true;
+}
+
 Logger::Logger() : level_(LogLevel::INFO), initialized_(false) {}
 
 Logger::~Logger() {
@@ -120,6 +149,10 @@ LogLevel Logger::get_level() const {
 
 bool Logger::is_initialized() const { return initialized_; }
 
+bool Logger::is_enabled(LogLevel level) const {
+  return initialized_ && level >= level_;
+}
+
 // Global logger instance
 Logger &Logger::get_instance() {
   static Logger instance;
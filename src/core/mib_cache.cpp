@@ -0,0 +1,288 @@
+/*
+ * src/core/mib_cache.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/mib_cache.hpp"
+#include "simple_snmpd/hash.hpp"
+#include "simple_snmpd/snmp_mib.hpp"
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace simple_snmpd {
+
+namespace {
+
+// The thread background refreshes run on, one for every cache, started
+// with the first refresh
+class Refresher {
+public:
+  static Refresher &get_instance() {
+    static Refresher instance;
+    return instance;
+  }
+
+  void schedule(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_.joinable()) {
+      thread_ = std::thread(&Refresher::run, this);
+    }
+    tasks_.push_back(std::move(task));
+    ready_.notify_one();
+  }
+
+private:
+  Refresher() : stopping_(false) {}
+
+  ~Refresher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_one();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  void run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+        if (stopping_) {
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<std::function<void()>> tasks_;
+  std::thread thread_;
+  bool stopping_;
+};
+
+bool parse_milliseconds(const std::string &text, uint64_t &value) {
+  if (text.empty() || text.size() > 9) {
+    return false;
+  }
+  value = 0;
+  for (char c : text) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    value = value * 10 + static_cast<uint64_t>(c - '0');
+  }
+  return true;
+}
+
+} // namespace
+
+size_t MIBCache::KeyHash::operator()(const std::vector<uint8_t> &key) const {
+  return static_cast<size_t>(fnv1a(key.data(), key.size()));
+}
+
+MIBCache::MIBCache(const std::vector<uint8_t> &subtree,
+                   const MIBCachePolicy &policy)
+    : subtree_(subtree), policy_(policy), hits_(0), stale_hits_(0),
+      misses_(0), waits_(0), refreshes_(0), entries_(0), load_us_(0) {
+  for (auto &bucket : load_latency_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+bool MIBCache::parse_rule(const std::string &rule,
+                          std::vector<uint8_t> &subtree,
+                          MIBCachePolicy &policy) {
+  size_t equals = rule.find('=');
+  if (equals == std::string::npos) {
+    return false;
+  }
+  std::string oid = rule.substr(0, equals);
+  std::string times = rule.substr(equals + 1);
+  size_t slash = times.find('/');
+  uint64_t ttl = 0;
+  uint64_t stale = 0;
+  if (!parse_milliseconds(times.substr(0, slash), ttl) || ttl == 0 ||
+      (slash != std::string::npos &&
+       !parse_milliseconds(times.substr(slash + 1), stale))) {
+    return false;
+  }
+
+  subtree = OIDUtils::string_to_oid(oid);
+  if (subtree.empty()) {
+    return false;
+  }
+  policy = MIBCachePolicy(std::chrono::milliseconds(ttl),
+                          std::chrono::milliseconds(stale));
+  return true;
+}
+
+std::string MIBCache::label() const {
+  return policy_.name.empty() ? OIDUtils::oid_to_string(subtree_)
+                              : policy_.name;
+}
+
+MIBCache::Lookup MIBCache::lookup(const std::vector<uint8_t> &key,
+                                  std::shared_ptr<const void> &value,
+                                  std::shared_ptr<Flight> &flight) {
+  auto now = std::chrono::steady_clock::now();
+  Stripe &entries = stripe(key);
+  Loader loader;
+  {
+    std::lock_guard<std::mutex> lock(entries.mutex);
+    auto result = entries.entries.emplace(key, Entry());
+    Entry &entry = result.first->second;
+    if (result.second) {
+      // Cold miss: the entry holds the load until it has a value
+      entries_.fetch_add(1, std::memory_order_relaxed);
+      entry.flight = std::make_shared<Flight>();
+      flight = entry.flight;
+      return Lookup::LOAD;
+    }
+    if (entry.flight) {
+      waits_.fetch_add(1, std::memory_order_relaxed);
+      flight = entry.flight;
+      return Lookup::WAIT;
+    }
+
+    auto age = now - entry.loaded;
+    if (age < policy_.ttl) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      value = entry.value;
+      return Lookup::HIT;
+    }
+    if (age >= policy_.ttl + policy_.max_stale) {
+      entry.flight = std::make_shared<Flight>();
+      flight = entry.flight;
+      return Lookup::LOAD;
+    }
+
+    stale_hits_.fetch_add(1, std::memory_order_relaxed);
+    value = entry.value;
+    if (entry.refreshing) {
+      return Lookup::HIT;
+    }
+    entry.refreshing = true;
+    loader = entry.loader;
+  }
+
+  std::shared_ptr<MIBCache> self = shared_from_this();
+  std::vector<uint8_t> refreshed = key;
+  Refresher::get_instance().schedule([self, refreshed, loader]() {
+    self->refresh(refreshed, loader);
+  });
+  return Lookup::HIT;
+}
+
+std::shared_ptr<const void>
+MIBCache::load(const std::vector<uint8_t> &key, Loader loader,
+               const std::shared_ptr<Flight> &flight) {
+  auto start = std::chrono::steady_clock::now();
+  std::shared_ptr<const void> value = loader();
+  auto loaded = std::chrono::steady_clock::now();
+  record_load(loaded - start);
+  misses_.fetch_add(1, std::memory_order_relaxed);
+
+  {
+    // Invalidated meanwhile: the waiters get the value, the cache does not
+    Stripe &entries = stripe(key);
+    std::lock_guard<std::mutex> lock(entries.mutex);
+    auto it = entries.entries.find(key);
+    if (it != entries.entries.end() && it->second.flight == flight) {
+      // A refresh still running was overtaken, and its result is dropped
+      Entry &entry = it->second;
+      entry.value = value;
+      entry.loaded = loaded;
+      entry.loader = std::move(loader);
+      entry.refreshing = false;
+      entry.flight.reset();
+    }
+  }
+  flight->promise.set_value(value);
+  return value;
+}
+
+void MIBCache::refresh(const std::vector<uint8_t> &key,
+                       const Loader &loader) {
+  auto start = std::chrono::steady_clock::now();
+  std::shared_ptr<const void> value = loader();
+  auto loaded = std::chrono::steady_clock::now();
+  record_load(loaded - start);
+  refreshes_.fetch_add(1, std::memory_order_relaxed);
+
+  // Invalidated or loaded again meanwhile: keep what is there
+  Stripe &entries = stripe(key);
+  std::lock_guard<std::mutex> lock(entries.mutex);
+  auto it = entries.entries.find(key);
+  if (it == entries.entries.end() || !it->second.refreshing) {
+    return;
+  }
+  it->second.value = value;
+  it->second.loaded = loaded;
+  it->second.refreshing = false;
+}
+
+void MIBCache::invalidate(const std::vector<uint8_t> &prefix) {
+  for (Stripe &entries : stripes_) {
+    std::lock_guard<std::mutex> lock(entries.mutex);
+    for (auto it = entries.entries.begin(); it != entries.entries.end();) {
+      if (OIDUtils::is_prefix(prefix, it->first)) {
+        it = entries.entries.erase(it);
+        entries_.fetch_sub(1, std::memory_order_relaxed);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+void MIBCache::record_load(std::chrono::steady_clock::duration elapsed) {
+  uint64_t microseconds = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+          .count());
+  size_t bucket = 0;
+  while (bucket + 1 < LATENCY_BUCKETS &&
+         microseconds > (static_cast<uint64_t>(1) << bucket)) {
+    ++bucket;
+  }
+  load_latency_[bucket].fetch_add(1, std::memory_order_relaxed);
+  load_us_.fetch_add(microseconds, std::memory_order_relaxed);
+}
+
+MIBCache::Statistics MIBCache::get_statistics() const {
+  Statistics stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.stale_hits = stale_hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.waits = waits_.load(std::memory_order_relaxed);
+  stats.refreshes = refreshes_.load(std::memory_order_relaxed);
+  stats.entries = entries_.load(std::memory_order_relaxed);
+  stats.load_us = load_us_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+    stats.load_latency[i] = load_latency_[i].load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+} // namespace simple_snmpd
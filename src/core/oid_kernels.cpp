@@ -0,0 +1,306 @@
+/*
+ * src/core/oid_kernels.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/oid_kernels.hpp"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMPLE_SNMPD_OID_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace simple_snmpd {
+
+namespace {
+
+constexpr uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+uint64_t load64(const uint8_t *bytes) {
+  uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+// Shared tails: eight bytes per step while they match or are all
+// single-byte sub-identifiers, then one at a time
+
+size_t mismatch_tail(const uint8_t *a, const uint8_t *b, size_t position,
+                     size_t length) {
+  while (length - position >= 8 &&
+         load64(a + position) == load64(b + position)) {
+    position += 8;
+  }
+  while (position < length && a[position] == b[position]) {
+    ++position;
+  }
+  return position;
+}
+
+size_t mismatch_arcs_tail(const uint32_t *a, const uint32_t *b,
+                          size_t position, size_t length) {
+  while (position < length && a[position] == b[position]) {
+    ++position;
+  }
+  return position;
+}
+
+bool decode_one(const uint8_t *oid, size_t &position, size_t length,
+                uint32_t &arc) {
+  uint64_t value = 0;
+  uint8_t byte = 0;
+  do {
+    if (position == length) {
+      return false;
+    }
+    byte = oid[position++];
+    value = (value << 7) | (byte & 0x7F);
+    if (value > 0xFFFFFFFFu) {
+      return false;
+    }
+  } while (byte & 0x80);
+  arc = static_cast<uint32_t>(value);
+  return true;
+}
+
+bool decode_tail(const uint8_t *oid, size_t position, size_t length,
+                 uint32_t *arcs, size_t &count) {
+  while (position < length) {
+    if (length - position >= 8 && (load64(oid + position) & HIGH_BITS) == 0) {
+      for (size_t i = 0; i < 8; ++i) {
+        arcs[count++] = oid[position++];
+      }
+    } else if (!decode_one(oid, position, length, arcs[count++])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t mismatch_scalar(const uint8_t *a, const uint8_t *b, size_t length) {
+  return mismatch_tail(a, b, 0, length);
+}
+
+size_t mismatch_arcs_scalar(const uint32_t *a, const uint32_t *b,
+                            size_t length) {
+  return mismatch_arcs_tail(a, b, 0, length);
+}
+
+bool decode_scalar(const uint8_t *oid, size_t length, uint32_t *arcs,
+                   size_t &count) {
+  count = 0;
+  return decode_tail(oid, 0, length, arcs, count);
+}
+
+#ifdef SIMPLE_SNMPD_OID_KERNELS_X86
+
+__attribute__((target("sse4.2"))) size_t
+mismatch_sse42(const uint8_t *a, const uint8_t *b, size_t length) {
+  size_t position = 0;
+  while (length - position >= 16) {
+    __m128i x =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + position));
+    __m128i y =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + position));
+    unsigned differ = ~_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) & 0xFFFFu;
+    if (differ) {
+      return position + __builtin_ctz(differ);
+    }
+    position += 16;
+  }
+  return mismatch_tail(a, b, position, length);
+}
+
+__attribute__((target("sse4.2"))) size_t
+mismatch_arcs_sse42(const uint32_t *a, const uint32_t *b, size_t length) {
+  size_t position = 0;
+  while (length - position >= 4) {
+    __m128i x =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + position));
+    __m128i y =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + position));
+    unsigned differ = ~_mm_movemask_epi8(_mm_cmpeq_epi32(x, y)) & 0xFFFFu;
+    if (differ) {
+      return position + __builtin_ctz(differ) / 4;
+    }
+    position += 4;
+  }
+  return mismatch_arcs_tail(a, b, position, length);
+}
+
+// Sixteen bytes at a time: the single-byte sub-identifiers ahead of the
+// first continuation byte are widened with pmovzxbd, the sub-identifier
+// holding it is decoded alone. Widening writes up to 16 arcs past count,
+// which stays within the length entries the caller provides.
+__attribute__((target("sse4.2"))) bool
+decode_sse42(const uint8_t *oid, size_t length, uint32_t *arcs,
+             size_t &count) {
+  count = 0;
+  size_t position = 0;
+  while (length - position >= 16) {
+    __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(oid + position));
+    unsigned continued = _mm_movemask_epi8(bytes);
+    __m128i *out = reinterpret_cast<__m128i *>(arcs + count);
+    _mm_storeu_si128(out, _mm_cvtepu8_epi32(bytes));
+    _mm_storeu_si128(out + 1, _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4)));
+    _mm_storeu_si128(out + 2, _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+    _mm_storeu_si128(out + 3, _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12)));
+
+    size_t single = continued ? __builtin_ctz(continued) : 16;
+    count += single;
+    position += single;
+    if (single < 16 && !decode_one(oid, position, length, arcs[count++])) {
+      return false;
+    }
+  }
+  return decode_tail(oid, position, length, arcs, count);
+}
+
+__attribute__((target("avx2"))) size_t
+mismatch_avx2(const uint8_t *a, const uint8_t *b, size_t length) {
+  size_t position = 0;
+  while (length - position >= 32) {
+    __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + position));
+    __m256i y =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + position));
+    unsigned differ =
+        ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+    if (differ) {
+      return position + __builtin_ctz(differ);
+    }
+    position += 32;
+  }
+  return length - position >= 16
+             ? mismatch_sse42(a + position, b + position, length - position) +
+                   position
+             : mismatch_tail(a, b, position, length);
+}
+
+__attribute__((target("avx2"))) size_t
+mismatch_arcs_avx2(const uint32_t *a, const uint32_t *b, size_t length) {
+  size_t position = 0;
+  while (length - position >= 8) {
+    __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + position));
+    __m256i y =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + position));
+    unsigned differ =
+        ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi32(x, y)));
+    if (differ) {
+      return position + __builtin_ctz(differ) / 4;
+    }
+    position += 8;
+  }
+  return mismatch_arcs_tail(a, b, position, length);
+}
+
+__attribute__((target("avx2"))) bool
+decode_avx2(const uint8_t *oid, size_t length, uint32_t *arcs,
+            size_t &count) {
+  count = 0;
+  size_t position = 0;
+  while (length - position >= 32) {
+    __m256i bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(oid + position));
+    unsigned continued = static_cast<unsigned>(_mm256_movemask_epi8(bytes));
+    __m128i low = _mm256_castsi256_si128(bytes);
+    __m128i high = _mm256_extracti128_si256(bytes, 1);
+    __m256i *out = reinterpret_cast<__m256i *>(arcs + count);
+    _mm256_storeu_si256(out, _mm256_cvtepu8_epi32(low));
+    _mm256_storeu_si256(out + 1,
+                        _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+    _mm256_storeu_si256(out + 2, _mm256_cvtepu8_epi32(high));
+    _mm256_storeu_si256(out + 3,
+                        _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+
+    size_t single = continued ? __builtin_ctz(continued) : 32;
+    count += single;
+    position += single;
+    if (single < 32 && !decode_one(oid, position, length, arcs[count++])) {
+      return false;
+    }
+  }
+  return decode_tail(oid, position, length, arcs, count);
+}
+
+#endif // SIMPLE_SNMPD_OID_KERNELS_X86
+
+const OIDKernels SCALAR_KERNELS = {mismatch_scalar, mismatch_arcs_scalar,
+                                   decode_scalar};
+#ifdef SIMPLE_SNMPD_OID_KERNELS_X86
+const OIDKernels SSE42_KERNELS = {mismatch_sse42, mismatch_arcs_sse42,
+                                  decode_sse42};
+const OIDKernels AVX2_KERNELS = {mismatch_avx2, mismatch_arcs_avx2,
+                                 decode_avx2};
+#endif
+
+OIDKernelLevel detect_level() {
+#ifdef SIMPLE_SNMPD_OID_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return OIDKernelLevel::AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2")) {
+    return OIDKernelLevel::SSE42;
+  }
+#endif
+  return OIDKernelLevel::SCALAR;
+}
+
+} // namespace
+
+OIDKernelLevel OIDKernels::detected_level() {
+  static const OIDKernelLevel level = detect_level();
+  return level;
+}
+
+const OIDKernels &OIDKernels::get(OIDKernelLevel level) {
+  if (level > detected_level()) {
+    level = detected_level();
+  }
+  switch (level) {
+#ifdef SIMPLE_SNMPD_OID_KERNELS_X86
+  case OIDKernelLevel::AVX2:
+    return AVX2_KERNELS;
+  case OIDKernelLevel::SSE42:
+    return SSE42_KERNELS;
+#endif
+  default:
+    return SCALAR_KERNELS;
+  }
+}
+
+const OIDKernels &OIDKernels::active() {
+  static const OIDKernels &kernels = get(detected_level());
+  return kernels;
+}
+
+const char *OIDKernels::level_name(OIDKernelLevel level) {
+  switch (level) {
+  case OIDKernelLevel::SCALAR:
+    return "scalar";
+  case OIDKernelLevel::SSE42:
+    return "sse4.2";
+  case OIDKernelLevel::AVX2:
+    return "avx2";
+  }
+  return "unknown";
+}
+
+} // namespace simple_snmpd
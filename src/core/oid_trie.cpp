@@ -0,0 +1,283 @@
+/*
+ * src/core/oid_trie.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/oid_trie.hpp"
+#include "simple_snmpd/oid_kernels.hpp"
+#include <algorithm>
+
+namespace simple_snmpd {
+
+namespace {
+
+// Decoded arcs of an OID, kept on the stack for any OID a request can
+// name (at most 128 sub-identifiers, RFC 2578 section 3.5)
+class ArcKey {
+public:
+  explicit ArcKey(const std::vector<uint8_t> &oid)
+      : arcs_(inline_), canonical_(false) {
+    if (oid.size() > INLINE_ARCS) {
+      heap_.resize(oid.size());
+      arcs_ = heap_.data();
+    }
+    if (!OIDKernels::active().decode(oid.data(), oid.size(), arcs_,
+                                     count_)) {
+      decode_lenient(oid);
+      return;
+    }
+
+    // Without padding octets the arcs re-encode to exactly oid
+    size_t encoded = 0;
+    for (size_t i = 0; i < count_; ++i) {
+      uint32_t arc = arcs_[i];
+      encoded += 1 + (arc >= 1u << 7) + (arc >= 1u << 14) +
+                 (arc >= 1u << 21) + (arc >= 1u << 28);
+    }
+    canonical_ = encoded == oid.size();
+  }
+
+  const uint32_t *data() const { return arcs_; }
+  size_t size() const { return count_; }
+
+  // True when no other encoding decodes to the same arcs as this one
+  bool canonical() const { return canonical_; }
+
+private:
+  static constexpr size_t INLINE_ARCS = 128;
+
+  // A truncated last sub-identifier keeps what was read and one over 32
+  // bits becomes the largest arc, so malformed OIDs still have a place
+  // in the order
+  void decode_lenient(const std::vector<uint8_t> &oid) {
+    count_ = 0;
+    uint64_t arc = 0;
+    bool pending = false;
+    for (uint8_t byte : oid) {
+      if (arc <= UINT32_MAX) {
+        arc = (arc << 7) | (byte & 0x7F);
+      }
+      pending = (byte & 0x80) != 0;
+      if (!pending) {
+        arcs_[count_++] = static_cast<uint32_t>(std::min<uint64_t>(
+            arc, UINT32_MAX));
+        arc = 0;
+      }
+    }
+    if (pending) {
+      arcs_[count_++] =
+          static_cast<uint32_t>(std::min<uint64_t>(arc, UINT32_MAX));
+    }
+  }
+
+  uint32_t inline_[INLINE_ARCS];
+  std::vector<uint32_t> heap_;
+  uint32_t *arcs_;
+  size_t count_ = 0;
+  bool canonical_;
+};
+
+} // namespace
+
+OIDTrie::OIDTrie() : root_(new Node), head_(npos), tail_(npos) {}
+
+OIDTrie::OIDTrie(const OIDTrie &other)
+    : root_(clone(*other.root_)), entries_(other.entries_),
+      head_(other.head_), tail_(other.tail_) {}
+
+OIDTrie::~OIDTrie() = default;
+
+size_t OIDTrie::insert(const std::vector<uint8_t> &oid) {
+  ArcKey key(oid);
+  const uint32_t *arcs = key.data();
+  size_t count = key.size();
+  const OIDKernels &kernels = OIDKernels::active();
+
+  // Where a new OID goes in the slot order
+  size_t successor = upper_bound(arcs, count);
+
+  Node *node = root_.get();
+  size_t depth = 0;
+  while (depth < count) {
+    size_t index = node->lower_bound(arcs[depth]);
+    if (index == node->arcs.size() || node->arcs[index] != arcs[depth]) {
+      // Nothing shares the next arc: one leaf takes all that is left
+      std::unique_ptr<Node> leaf(new Node);
+      leaf->label.assign(arcs + depth, arcs + count);
+      Node *added = leaf.get();
+      node->arcs.insert(node->arcs.begin() + index, arcs[depth]);
+      node->children.insert(node->children.begin() + index, std::move(leaf));
+      node = added;
+      break;
+    }
+
+    Node *child = node->children[index].get();
+    size_t length = std::min(child->label.size(), count - depth);
+    size_t common =
+        kernels.mismatch_arcs(child->label.data(), arcs + depth, length);
+    if (common < child->label.size()) {
+      // Split the edge where oid leaves it (or ends inside it)
+      std::unique_ptr<Node> middle(new Node);
+      middle->label.assign(child->label.begin(),
+                           child->label.begin() + common);
+      child->label.erase(child->label.begin(),
+                         child->label.begin() + common);
+      middle->arcs.push_back(child->label.front());
+      middle->children.push_back(std::move(node->children[index]));
+      node->children[index] = std::move(middle);
+      child = node->children[index].get();
+    }
+    node = child;
+    depth += common;
+  }
+
+  if (node->slot != npos) {
+    return node->slot;
+  }
+
+  Entry entry;
+  entry.oid = oid;
+  entry.prev = prev(successor);
+  entry.next = successor;
+  size_t slot = entries_.size();
+  if (entry.prev == npos) {
+    head_ = slot;
+  } else {
+    entries_[entry.prev].next = slot;
+  }
+  if (successor == npos) {
+    tail_ = slot;
+  } else {
+    entries_[successor].prev = slot;
+  }
+  entries_.push_back(std::move(entry));
+  node->slot = slot;
+  return slot;
+}
+
+size_t OIDTrie::find(const std::vector<uint8_t> &oid) const {
+  ArcKey key(oid);
+  const Node *node = find_node(key.data(), key.size());
+  if (node == nullptr || node->slot == npos) {
+    return npos;
+  }
+
+  // Padded or malformed encodings can decode like another OID
+  if (key.canonical() || entries_[node->slot].oid == oid) {
+    return node->slot;
+  }
+  return npos;
+}
+
+size_t OIDTrie::upper_bound(const std::vector<uint8_t> &oid) const {
+  ArcKey key(oid);
+  return upper_bound(key.data(), key.size());
+}
+
+size_t OIDTrie::Node::lower_bound(uint32_t arc) const {
+  return std::lower_bound(arcs.begin(), arcs.end(), arc) - arcs.begin();
+}
+
+size_t OIDTrie::leftmost(const Node *node) {
+  // Only leaves end without a slot below them, and every leaf has one
+  while (node->slot == npos) {
+    node = node->children.front().get();
+  }
+  return node->slot;
+}
+
+std::unique_ptr<OIDTrie::Node> OIDTrie::clone(const Node &node) {
+  std::unique_ptr<Node> copy(new Node);
+  copy->label = node.label;
+  copy->arcs = node.arcs;
+  copy->slot = node.slot;
+  copy->children.reserve(node.children.size());
+  for (const auto &child : node.children) {
+    copy->children.push_back(clone(*child));
+  }
+  return copy;
+}
+
+const OIDTrie::Node *OIDTrie::find_node(const uint32_t *arcs,
+                                        size_t count) const {
+  const OIDKernels &kernels = OIDKernels::active();
+  const Node *node = root_.get();
+  size_t depth = 0;
+  while (depth < count) {
+    size_t index = node->lower_bound(arcs[depth]);
+    if (index == node->arcs.size() || node->arcs[index] != arcs[depth]) {
+      return nullptr;
+    }
+    const Node *child = node->children[index].get();
+    size_t length = child->label.size();
+    if (length > count - depth ||
+        kernels.mismatch_arcs(child->label.data(), arcs + depth, length) !=
+            length) {
+      return nullptr;
+    }
+    node = child;
+    depth += length;
+  }
+  return node;
+}
+
+size_t OIDTrie::upper_bound(const uint32_t *arcs, size_t count) const {
+  const OIDKernels &kernels = OIDKernels::active();
+  const Node *node = root_.get();
+  size_t depth = 0;
+
+  // Subtree following the path taken so far, where the search ends if
+  // nothing on the path itself is greater
+  const Node *after = nullptr;
+
+  while (depth < count) {
+    size_t index = node->lower_bound(arcs[depth]);
+    if (index == node->arcs.size()) {
+      break;
+    }
+    if (node->arcs[index] != arcs[depth]) {
+      return leftmost(node->children[index].get());
+    }
+    if (index + 1 < node->children.size()) {
+      after = node->children[index + 1].get();
+    }
+
+    const Node *child = node->children[index].get();
+    size_t length = std::min(child->label.size(), count - depth);
+    size_t common =
+        kernels.mismatch_arcs(child->label.data(), arcs + depth, length);
+    if (common < length) {
+      if (child->label[common] > arcs[depth + common]) {
+        return leftmost(child);
+      }
+      break;
+    }
+    if (length < child->label.size()) {
+      // oid ends inside the edge, before everything below it
+      return leftmost(child);
+    }
+    node = child;
+    depth += length;
+  }
+
+  // oid itself ends at node: its descendants come first
+  if (depth == count && !node->children.empty()) {
+    return leftmost(node->children.front().get());
+  }
+  return after != nullptr ? leftmost(after) : npos;
+}
+
+} // namespace simple_snmpd
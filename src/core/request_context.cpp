@@ -0,0 +1,167 @@
+/*
+ * src/core/request_context.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/request_context.hpp"
+#include "simple_snmpd/hash.hpp"
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#endif
+
+namespace simple_snmpd {
+
+namespace {
+
+// ::ffff:0:0/96
+const uint8_t V4_MAPPED_PREFIX[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+
+} // namespace
+
+bool NetworkAddress::from_sockaddr(const struct sockaddr_storage &address,
+                                   socklen_t address_length,
+                                   NetworkAddress &result) {
+  if (address.ss_family == AF_INET &&
+      address_length >= static_cast<socklen_t>(sizeof(struct sockaddr_in))) {
+    const auto &v4 = reinterpret_cast<const struct sockaddr_in &>(address);
+    result.family = AF_INET;
+    result.length = 4;
+    std::memcpy(result.bytes, &v4.sin_addr, 4);
+    std::memset(result.bytes + 4, 0, 12);
+    return true;
+  }
+
+  if (address.ss_family == AF_INET6 &&
+      address_length >= static_cast<socklen_t>(sizeof(struct sockaddr_in6))) {
+    const auto &v6 = reinterpret_cast<const struct sockaddr_in6 &>(address);
+    const auto *raw = reinterpret_cast<const uint8_t *>(&v6.sin6_addr);
+    if (std::memcmp(raw, V4_MAPPED_PREFIX, sizeof(V4_MAPPED_PREFIX)) == 0) {
+      result.family = AF_INET;
+      result.length = 4;
+      std::memcpy(result.bytes, raw + 12, 4);
+      std::memset(result.bytes + 4, 0, 12);
+    } else {
+      result.family = AF_INET6;
+      result.length = 16;
+      std::memcpy(result.bytes, raw, 16);
+    }
+    return true;
+  }
+
+  result = NetworkAddress();
+  return false;
+}
+
+bool NetworkAddress::parse(const std::string &text, NetworkAddress &result) {
+  struct in_addr v4;
+  if (inet_pton(AF_INET, text.c_str(), &v4) == 1) {
+    result.family = AF_INET;
+    result.length = 4;
+    std::memcpy(result.bytes, &v4, 4);
+    std::memset(result.bytes + 4, 0, 12);
+    return true;
+  }
+
+  struct in6_addr v6;
+  if (inet_pton(AF_INET6, text.c_str(), &v6) == 1) {
+    struct sockaddr_storage storage;
+    std::memset(&storage, 0, sizeof(storage));
+    auto &sin6 = reinterpret_cast<struct sockaddr_in6 &>(storage);
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_addr = v6;
+    return from_sockaddr(storage, sizeof(struct sockaddr_in6), result);
+  }
+
+  result = NetworkAddress();
+  return false;
+}
+
+bool NetworkAddress::in_network(const NetworkAddress &network,
+                                uint32_t prefix_length) const {
+  if (family != network.family) {
+    return false;
+  }
+
+  uint32_t bits = std::min<uint32_t>(prefix_length, length * 8u);
+  uint32_t whole_bytes = bits / 8;
+  if (std::memcmp(bytes, network.bytes, whole_bytes) != 0) {
+    return false;
+  }
+
+  uint32_t remaining = bits % 8;
+  if (remaining == 0) {
+    return true;
+  }
+  uint8_t mask = static_cast<uint8_t>(0xff << (8 - remaining));
+  return (bytes[whole_bytes] & mask) == (network.bytes[whole_bytes] & mask);
+}
+
+std::string NetworkAddress::to_string() const {
+  char buffer[INET6_ADDRSTRLEN];
+  if (family == AF_INET) {
+    if (inet_ntop(AF_INET, bytes, buffer, sizeof(buffer))) {
+      return buffer;
+    }
+  } else if (family == AF_INET6) {
+    if (inet_ntop(AF_INET6, bytes, buffer, sizeof(buffer))) {
+      return buffer;
+    }
+  }
+  return "unknown";
+}
+
+bool NetworkAddress::operator==(const NetworkAddress &other) const {
+  return family == other.family &&
+         std::memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+}
+
+size_t NetworkAddressHash::operator()(const NetworkAddress &address) const {
+  // The family, then the significant bytes
+  return static_cast<size_t>(fnv1a(address.bytes, address.length,
+                                   fnv1a(FNV1A_OFFSET, address.family)));
+}
+
+RequestContext::RequestContext(
+    const struct sockaddr_storage &peer, socklen_t peer_length,
+    std::chrono::steady_clock::time_point received_at, uint32_t shard)
+    : address(), address_length(peer_length), received(received_at),
+      arrival_ns(0), shard_id(shard) {
+  std::memcpy(&address, &peer,
+              std::min<size_t>(peer_length, sizeof(address)));
+  NetworkAddress::from_sockaddr(address, address_length, source);
+}
+
+uint16_t RequestContext::port() const {
+  if (address.ss_family == AF_INET) {
+    return ntohs(
+        reinterpret_cast<const struct sockaddr_in &>(address).sin_port);
+  }
+  if (address.ss_family == AF_INET6) {
+    return ntohs(
+        reinterpret_cast<const struct sockaddr_in6 &>(address).sin6_port);
+  }
+  return 0;
+}
+
+std::string RequestContext::address_string() const {
+  return source.to_string();
+}
+
+} // namespace simple_snmpd
@@ -0,0 +1,123 @@
+/*
+ * src/core/request_shape_cache.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/request_shape_cache.hpp"
+#include "simple_snmpd/hash.hpp"
+#include <algorithm>
+
+namespace simple_snmpd {
+
+RequestShapeCache::RequestShapeCache()
+    : stripe_capacity_(0), hits_(0), misses_(0), insertions_(0),
+      invalidations_(0), evictions_(0), entries_(0) {}
+
+void RequestShapeCache::configure(size_t max_entries) {
+  stripe_capacity_ =
+      max_entries == 0
+          ? 0
+          : std::max<size_t>(1, max_entries / LockStripes<Stripe>::COUNT);
+}
+
+uint64_t RequestShapeCache::hash(const SNMPPacketView &request) {
+  // Mixing in each length keeps 1.3 + 6.1 apart from 1.3.6 + 1
+  uint64_t hash = FNV1A_OFFSET;
+  for (const auto &varbind : request) {
+    hash = fnv1a(varbind.oid.data, varbind.oid.length,
+                 fnv1a(hash, varbind.oid.length));
+  }
+  return hash;
+}
+
+bool RequestShapeCache::same_oids(const Entry &entry,
+                                  const SNMPPacketView &request) {
+  if (entry.oids.size() != request.get_variable_binding_count()) {
+    return false;
+  }
+  size_t i = 0;
+  for (const auto &varbind : request) {
+    const std::vector<uint8_t> &oid = entry.oids[i++];
+    if (varbind.oid != ByteSpan(oid.data(), oid.size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RequestShapeCache::lookup(uint64_t hash, const SNMPPacketView &request,
+                               uint64_t generation,
+                               std::vector<MIBManager::Handle> &handles) {
+  Stripe &stripe = stripes_[hash];
+
+  std::lock_guard<std::mutex> lock(stripe.mutex);
+  auto it = stripe.entries.find(hash);
+  if (it != stripe.entries.end() && it->second.generation != generation) {
+    stripe.entries.erase(it);
+    entries_.fetch_sub(1, std::memory_order_relaxed);
+    invalidations_.fetch_add(1, std::memory_order_relaxed);
+    it = stripe.entries.end();
+  }
+  if (it == stripe.entries.end() || !same_oids(it->second, request)) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  handles = it->second.handles;
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void RequestShapeCache::insert(uint64_t hash, const SNMPPacketView &request,
+                               uint64_t generation,
+                               const std::vector<MIBManager::Handle> &handles) {
+  Stripe &stripe = stripes_[hash];
+
+  std::lock_guard<std::mutex> lock(stripe.mutex);
+  auto it = stripe.entries.find(hash);
+  if (it == stripe.entries.end()) {
+    if (stripe.entries.size() >= stripe_capacity_) {
+      stripe.entries.erase(stripe.entries.begin());
+      evictions_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      entries_.fetch_add(1, std::memory_order_relaxed);
+    }
+    it = stripe.entries.emplace(hash, Entry()).first;
+  }
+
+  Entry &entry = it->second;
+  entry.generation = generation;
+  entry.oids.clear();
+  entry.oids.reserve(request.get_variable_binding_count());
+  for (const auto &varbind : request) {
+    entry.oids.push_back(varbind.oid.to_vector());
+  }
+  entry.handles = handles;
+  insertions_.fetch_add(1, std::memory_order_relaxed);
+}
+
+RequestShapeCache::Statistics RequestShapeCache::get_statistics() const {
+  Statistics stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.insertions = insertions_.load(std::memory_order_relaxed);
+  stats.invalidations = invalidations_.load(std::memory_order_relaxed);
+  stats.evictions = evictions_.load(std::memory_order_relaxed);
+  stats.entries = entries_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+} // namespace simple_snmpd
@@ -0,0 +1,188 @@
+/*
+ * src/core/response_cache.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/response_cache.hpp"
+#include "simple_snmpd/hash.hpp"
+#include "simple_snmpd/snmp_packet.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace simple_snmpd {
+
+namespace {
+
+// Read a tag and its definite length, leaving offset at the contents
+bool read_header(const uint8_t *data, size_t length, size_t &offset,
+                 uint8_t tag, size_t &content_length) {
+  if (offset + 2 > length || data[offset] != tag) {
+    return false;
+  }
+  offset++;
+
+  uint8_t first = data[offset++];
+  if ((first & 0x80) == 0) {
+    content_length = first;
+  } else {
+    size_t count = first & 0x7F;
+    if (count == 0 || count > 4 || offset + count > length) {
+      return false;
+    }
+    content_length = 0;
+    for (size_t i = 0; i < count; ++i) {
+      content_length = (content_length << 8) | data[offset++];
+    }
+  }
+  return content_length <= length - offset;
+}
+
+bool is_request_pdu(uint8_t pdu_type) {
+  return pdu_type == SNMP_PDU_GET_REQUEST ||
+         pdu_type == SNMP_PDU_GET_NEXT_REQUEST ||
+         pdu_type == SNMP_PDU_SET_REQUEST ||
+         pdu_type == SNMP_PDU_GET_BULK_REQUEST;
+}
+
+} // namespace
+
+size_t ResponseCache::KeyHash::operator()(const Key &key) const {
+  uint64_t hash = NetworkAddressHash()(key.source);
+  hash = fnv1a(hash, key.port);
+  hash = fnv1a(hash, key.request_id);
+  hash = fnv1a(hash, key.community_hash);
+  return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+ResponseCache::ResponseCache()
+    : ttl_ns_(0), stripe_capacity_(1), hits_(0), misses_(0), insertions_(0),
+      evictions_(0), entries_(0) {}
+
+void ResponseCache::configure(std::chrono::milliseconds ttl,
+                              size_t max_entries) {
+  ttl_ns_ = static_cast<uint64_t>(ttl.count()) * 1000000;
+  stripe_capacity_ =
+      std::max<size_t>(1, max_entries / LockStripes<Stripe>::COUNT);
+}
+
+bool ResponseCache::make_key(const RequestContext &context,
+                             const uint8_t *data, size_t length, Key &key,
+                             uint64_t &digest) {
+  size_t offset = 0;
+  size_t content_length = 0;
+
+  // Message SEQUENCE and version; SNMPv3 messages carry no community
+  if (!read_header(data, length, offset, 0x30, content_length) ||
+      !read_header(data, length, offset, 0x02, content_length) ||
+      content_length != 1 ||
+      (data[offset] != SNMP_VERSION_1 && data[offset] != SNMP_VERSION_2C)) {
+    return false;
+  }
+  offset += content_length;
+
+  if (!read_header(data, length, offset, 0x04, content_length)) {
+    return false;
+  }
+  key.community_hash = fnv1a(data + offset, content_length);
+  offset += content_length;
+
+  if (offset >= length || !is_request_pdu(data[offset]) ||
+      !read_header(data, length, offset, data[offset], content_length) ||
+      !read_header(data, length, offset, 0x02, content_length) ||
+      content_length == 0 || content_length > 5) {
+    return false;
+  }
+  key.request_id = 0;
+  for (size_t i = 0; i < content_length; ++i) {
+    key.request_id = (key.request_id << 8) | data[offset + i];
+  }
+
+  key.source = context.source;
+  key.port = context.port();
+  digest = fnv1a(data, length);
+  return true;
+}
+
+size_t ResponseCache::lookup(const Key &key, uint64_t digest, uint8_t *buffer,
+                             size_t capacity) {
+  Stripe &stripe = stripes_[KeyHash()(key)];
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  std::lock_guard<std::mutex> lock(stripe.mutex);
+  auto it = stripe.entries.find(key);
+  if (it == stripe.entries.end() || it->second.digest != digest ||
+      it->second.expires <= now || it->second.response.size() > capacity) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+  }
+
+  std::memcpy(buffer, it->second.response.data(), it->second.response.size());
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  return it->second.response.size();
+}
+
+void ResponseCache::insert(const Key &key, uint64_t digest,
+                           const uint8_t *response, size_t length) {
+  Stripe &stripe = stripes_[KeyHash()(key)];
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point expires =
+      now + std::chrono::nanoseconds(ttl_ns_);
+
+  std::lock_guard<std::mutex> lock(stripe.mutex);
+  evict(stripe, now);
+
+  auto result = stripe.entries.emplace(key, Entry());
+  if (result.second) {
+    entries_.fetch_add(1, std::memory_order_relaxed);
+  }
+  Entry &entry = result.first->second;
+  entry.digest = digest;
+  entry.expires = expires;
+  entry.response.assign(response, response + length);
+  stripe.order.emplace_back(key, expires);
+  insertions_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ResponseCache::evict(Stripe &stripe,
+                          std::chrono::steady_clock::time_point now) {
+  // Drop expired entries, then the oldest ones while the stripe is full.
+  // An order record whose expiry no longer matches belongs to an entry
+  // that was replaced later and has a newer record of its own.
+  while (!stripe.order.empty() &&
+         (stripe.order.front().second <= now ||
+          stripe.entries.size() >= stripe_capacity_)) {
+    auto it = stripe.entries.find(stripe.order.front().first);
+    if (it != stripe.entries.end() &&
+        it->second.expires == stripe.order.front().second) {
+      stripe.entries.erase(it);
+      entries_.fetch_sub(1, std::memory_order_relaxed);
+      evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+    stripe.order.pop_front();
+  }
+}
+
+ResponseCache::Statistics ResponseCache::get_statistics() const {
+  Statistics stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.insertions = insertions_.load(std::memory_order_relaxed);
+  stats.evictions = evictions_.load(std::memory_order_relaxed);
+  stats.entries = entries_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+} // namespace simple_snmpd
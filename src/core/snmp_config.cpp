@@ -17,17 +17,49 @@
  */
 
 #include "simple_snmpd/snmp_config.hpp"
+#include "simple_snmpd/listen_endpoint.hpp"
 #include "simple_snmpd/logger.hpp"
+#include "simple_snmpd/mib_cache.hpp"
 #include <algorithm>
 #include <fstream>
 #include <sstream>
 
 namespace simple_snmpd {
 
+namespace {
+
+// Comma separated list value; entries are trimmed and empty ones skipped
+std::vector<std::string> split_list(const std::string &value) {
+  std::vector<std::string> result;
+  std::istringstream stream(value);
+  std::string entry;
+  while (std::getline(stream, entry, ',')) {
+    entry.erase(0, entry.find_first_not_of(" \t"));
+    entry.erase(entry.find_last_not_of(" \t") + 1);
+    if (!entry.empty()) {
+      result.push_back(entry);
+    }
+  }
+  return result;
+}
+
+} // namespace
+
 SNMPConfig::SNMPConfig()
     : port_(161), community_("public"), max_connections_(100),
       timeout_seconds_(30), log_level_("info"), enable_ipv6_(true),
-      enable_trap_(false), trap_port_(162) {}
+      enable_trap_(false), trap_port_(162), io_batch_size_(1),
+      listener_shards_(1), shard_cpu_affinity_(false),
+      io_backend_("socket"), worker_threads_(0),
+      dispatch_queue_depth_(1024), enable_tcp_(false),
+      tcp_max_message_size_(1048576), max_response_size_(1472),
+      receive_buffer_size_(0),
+      receive_buffer_auto_(false), receive_buffer_max_(16777216),
+      load_shedding_(false), shed_target_us_(5000), shed_interval_ms_(100),
+      shed_bulk_cost_(64), response_cache_ttl_ms_(0),
+      response_cache_entries_(8192), shape_cache_entries_(1024),
+      fair_queueing_(false),
+      fair_queue_quantum_(1500), fair_queue_flow_depth_(64) {}
 
 SNMPConfig::~SNMPConfig() {}
 
@@ -108,6 +140,19 @@ bool SNMPConfig::parse_config_value(const std::string &key,
                                  "Invalid port value: " + value);
       return false;
     }
+  } else if (key == "bind_address") {
+    // Comma separated; each entry is validated with a placeholder port
+    // because the port key may come later in the file
+    std::vector<std::string> addresses = split_listen_addresses(value);
+    for (const auto &address : addresses) {
+      ListenEndpoint endpoint;
+      if (!parse_listen_endpoint(address, 161, endpoint)) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid bind_address: " + address);
+        return false;
+      }
+    }
+    bind_addresses_ = addresses;
   } else if (key == "community") {
     community_ = value;
   } else if (key == "max_connections") {
@@ -168,6 +213,275 @@ bool SNMPConfig::parse_config_value(const std::string &key,
                                  "Invalid trap_port value: " + value);
       return false;
     }
+  } else if (key == "io_batch_size") {
+    try {
+      io_batch_size_ = std::stoi(value);
+      if (io_batch_size_ < 1 || io_batch_size_ > 1024) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid io_batch_size: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid io_batch_size value: " + value);
+      return false;
+    }
+  } else if (key == "listener_shards") {
+    try {
+      // 0 selects one shard per available CPU
+      listener_shards_ = std::stoi(value);
+      if (listener_shards_ > 256) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid listener_shards: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid listener_shards value: " + value);
+      return false;
+    }
+  } else if (key == "shard_cpu_affinity") {
+    std::string val = value;
+    std::transform(val.begin(), val.end(), val.begin(), ::tolower);
+    shard_cpu_affinity_ = (val == "true" || val == "1" || val == "yes");
+  } else if (key == "io_backend") {
+    std::string backend = value;
+    std::transform(backend.begin(), backend.end(), backend.begin(), ::tolower);
+    if (backend == "socket" || backend == "io_uring") {
+      io_backend_ = backend;
+    } else {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid io_backend: " + value);
+      return false;
+    }
+  } else if (key == "worker_threads") {
+    try {
+      // 0 processes requests on the listener shard threads
+      worker_threads_ = std::stoi(value);
+      if (worker_threads_ > 1024) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid worker_threads: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid worker_threads value: " + value);
+      return false;
+    }
+  } else if (key == "dispatch_queue_depth") {
+    try {
+      dispatch_queue_depth_ = std::stoi(value);
+      if (dispatch_queue_depth_ < 1 || dispatch_queue_depth_ > 1048576) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid dispatch_queue_depth: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid dispatch_queue_depth value: " +
+                                     value);
+      return false;
+    }
+  } else if (key == "enable_tcp") {
+    std::string val = value;
+    std::transform(val.begin(), val.end(), val.begin(), ::tolower);
+    enable_tcp_ = (val == "true" || val == "1" || val == "yes");
+  } else if (key == "tcp_max_message_size") {
+    try {
+      // RFC 3430 agents must accept at least 484 octet messages
+      tcp_max_message_size_ = std::stoi(value);
+      if (tcp_max_message_size_ < 484 || tcp_max_message_size_ > 16777216) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid tcp_max_message_size: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid tcp_max_message_size value: " +
+                                     value);
+      return false;
+    }
+  } else if (key == "max_response_size") {
+    try {
+      // 484 octets is the smallest message every SNMP entity accepts and
+      // 65507 the largest UDP payload
+      max_response_size_ = std::stoul(value);
+      if (max_response_size_ < 484 || max_response_size_ > 65507) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid max_response_size: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid max_response_size value: " + value);
+      return false;
+    }
+  } else if (key == "receive_buffer_size") {
+    try {
+      // 0 keeps the kernel default (net.core.rmem_default)
+      receive_buffer_size_ = std::stoul(value);
+      if (receive_buffer_size_ > 1073741824) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid receive_buffer_size: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid receive_buffer_size value: " +
+                                     value);
+      return false;
+    }
+  } else if (key == "receive_buffer_auto") {
+    std::string val = value;
+    std::transform(val.begin(), val.end(), val.begin(), ::tolower);
+    receive_buffer_auto_ = (val == "true" || val == "1" || val == "yes");
+  } else if (key == "receive_buffer_max") {
+    try {
+      receive_buffer_max_ = std::stoul(value);
+      if (receive_buffer_max_ < 65536 || receive_buffer_max_ > 1073741824) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid receive_buffer_max: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid receive_buffer_max value: " + value);
+      return false;
+    }
+  } else if (key == "load_shedding") {
+    std::string val = value;
+    std::transform(val.begin(), val.end(), val.begin(), ::tolower);
+    load_shedding_ = (val == "true" || val == "1" || val == "yes");
+  } else if (key == "shed_target_us") {
+    try {
+      shed_target_us_ = std::stoul(value);
+      if (shed_target_us_ < 1 || shed_target_us_ > 10000000) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid shed_target_us: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid shed_target_us value: " + value);
+      return false;
+    }
+  } else if (key == "shed_interval_ms") {
+    try {
+      shed_interval_ms_ = std::stoul(value);
+      if (shed_interval_ms_ < 1 || shed_interval_ms_ > 60000) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid shed_interval_ms: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid shed_interval_ms value: " + value);
+      return false;
+    }
+  } else if (key == "shed_bulk_cost") {
+    try {
+      shed_bulk_cost_ = std::stoul(value);
+      if (shed_bulk_cost_ < 1) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid shed_bulk_cost: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid shed_bulk_cost value: " + value);
+      return false;
+    }
+  } else if (key == "priority_communities") {
+    priority_communities_ = split_list(value);
+  } else if (key == "low_priority_communities") {
+    low_priority_communities_ = split_list(value);
+  } else if (key == "response_cache_ttl_ms") {
+    try {
+      response_cache_ttl_ms_ = std::stoul(value);
+      if (response_cache_ttl_ms_ > 60000) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid response_cache_ttl_ms: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid response_cache_ttl_ms value: " +
+                                     value);
+      return false;
+    }
+  } else if (key == "response_cache_entries") {
+    try {
+      response_cache_entries_ = std::stoul(value);
+      if (response_cache_entries_ < 1 || response_cache_entries_ > 1048576) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid response_cache_entries: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid response_cache_entries value: " +
+                                     value);
+      return false;
+    }
+  } else if (key == "shape_cache_entries") {
+    try {
+      shape_cache_entries_ = std::stoul(value);
+      if (shape_cache_entries_ > 65536) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid shape_cache_entries: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid shape_cache_entries value: " +
+                                     value);
+      return false;
+    }
+  } else if (key == "fair_queueing") {
+    std::string val = value;
+    std::transform(val.begin(), val.end(), val.begin(), ::tolower);
+    fair_queueing_ = (val == "true" || val == "1" || val == "yes");
+  } else if (key == "fair_queue_quantum") {
+    try {
+      fair_queue_quantum_ = std::stoul(value);
+      if (fair_queue_quantum_ < 64 || fair_queue_quantum_ > 65536) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid fair_queue_quantum: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid fair_queue_quantum value: " + value);
+      return false;
+    }
+  } else if (key == "fair_queue_flow_depth") {
+    try {
+      fair_queue_flow_depth_ = std::stoul(value);
+      if (fair_queue_flow_depth_ < 1 || fair_queue_flow_depth_ > 65536) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid fair_queue_flow_depth: " + value);
+        return false;
+      }
+    } catch (const std::exception &) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid fair_queue_flow_depth value: " +
+                                     value);
+      return false;
+    }
+  } else if (key == "fair_queue_weights") {
+    fair_queue_weights_ = split_list(value);
+  } else if (key == "mib_cache") {
+    std::vector<std::string> rules = split_list(value);
+    for (const auto &rule : rules) {
+      std::vector<uint8_t> subtree;
+      MIBCachePolicy policy;
+      if (!MIBCache::parse_rule(rule, subtree, policy)) {
+        Logger::get_instance().log(LogLevel::ERROR,
+                                   "Invalid mib_cache rule: " + rule);
+        return false;
+      }
+    }
+    mib_cache_rules_ = rules;
   } else {
     Logger::get_instance().log(LogLevel::WARNING, "Unknown config key: " + key);
     return false;
@@ -178,6 +492,10 @@ bool SNMPConfig::parse_config_value(const std::string &key,
 
 uint16_t SNMPConfig::get_port() const { return port_; }
 
+const std::vector<std::string> &SNMPConfig::get_bind_addresses() const {
+  return bind_addresses_;
+}
+
 const std::string &SNMPConfig::get_community() const { return community_; }
 
 uint32_t SNMPConfig::get_max_connections() const { return max_connections_; }
@@ -192,8 +510,96 @@ bool SNMPConfig::is_trap_enabled() const { return enable_trap_; }
 
 uint16_t SNMPConfig::get_trap_port() const { return trap_port_; }
 
+uint32_t SNMPConfig::get_io_batch_size() const { return io_batch_size_; }
+
+uint32_t SNMPConfig::get_listener_shards() const { return listener_shards_; }
+
+bool SNMPConfig::is_shard_cpu_affinity_enabled() const {
+  return shard_cpu_affinity_;
+}
+
+const std::string &SNMPConfig::get_io_backend() const { return io_backend_; }
+
+uint32_t SNMPConfig::get_worker_threads() const { return worker_threads_; }
+
+uint32_t SNMPConfig::get_dispatch_queue_depth() const {
+  return dispatch_queue_depth_;
+}
+
+bool SNMPConfig::is_tcp_enabled() const { return enable_tcp_; }
+
+uint32_t SNMPConfig::get_tcp_max_message_size() const {
+  return tcp_max_message_size_;
+}
+
+uint32_t SNMPConfig::get_max_response_size() const {
+  return max_response_size_;
+}
+
+uint32_t SNMPConfig::get_receive_buffer_size() const {
+  return receive_buffer_size_;
+}
+
+bool SNMPConfig::is_receive_buffer_auto() const { return receive_buffer_auto_; }
+
+uint32_t SNMPConfig::get_receive_buffer_max() const {
+  return receive_buffer_max_;
+}
+
+bool SNMPConfig::is_load_shedding_enabled() const { return load_shedding_; }
+
+uint32_t SNMPConfig::get_shed_target_us() const { return shed_target_us_; }
+
+uint32_t SNMPConfig::get_shed_interval_ms() const { return shed_interval_ms_; }
+
+uint32_t SNMPConfig::get_shed_bulk_cost() const { return shed_bulk_cost_; }
+
+const std::vector<std::string> &SNMPConfig::get_priority_communities() const {
+  return priority_communities_;
+}
+
+const std::vector<std::string> &
+SNMPConfig::get_low_priority_communities() const {
+  return low_priority_communities_;
+}
+
+uint32_t SNMPConfig::get_response_cache_ttl_ms() const {
+  return response_cache_ttl_ms_;
+}
+
+uint32_t SNMPConfig::get_response_cache_entries() const {
+  return response_cache_entries_;
+}
+
+uint32_t SNMPConfig::get_shape_cache_entries() const {
+  return shape_cache_entries_;
+}
+
+bool SNMPConfig::is_fair_queueing_enabled() const { return fair_queueing_; }
+
+uint32_t SNMPConfig::get_fair_queue_quantum() const {
+  return fair_queue_quantum_;
+}
+
+uint32_t SNMPConfig::get_fair_queue_flow_depth() const {
+  return fair_queue_flow_depth_;
+}
+
+const std::vector<std::string> &SNMPConfig::get_fair_queue_weights() const {
+  return fair_queue_weights_;
+}
+
+const std::vector<std::string> &SNMPConfig::get_mib_cache_rules() const {
+  return mib_cache_rules_;
+}
+
 void SNMPConfig::set_port(uint16_t port) { port_ = port; }
 
+void SNMPConfig::set_bind_addresses(
+    const std::vector<std::string> &addresses) {
+  bind_addresses_ = addresses;
+}
+
 void SNMPConfig::set_community(const std::string &community) {
   community_ = community;
 }
@@ -216,4 +622,107 @@ void SNMPConfig::set_trap_enabled(bool enabled) { enable_trap_ = enabled; }
 
 void SNMPConfig::set_trap_port(uint16_t port) { trap_port_ = port; }
 
+void SNMPConfig::set_io_batch_size(uint32_t batch_size) {
+  io_batch_size_ = batch_size;
+}
+
+void SNMPConfig::set_listener_shards(uint32_t shards) {
+  listener_shards_ = shards;
+}
+
+void SNMPConfig::set_shard_cpu_affinity(bool enabled) {
+  shard_cpu_affinity_ = enabled;
+}
+
+void SNMPConfig::set_io_backend(const std::string &backend) {
+  io_backend_ = backend;
+}
+
+void SNMPConfig::set_worker_threads(uint32_t threads) {
+  worker_threads_ = threads;
+}
+
+void SNMPConfig::set_dispatch_queue_depth(uint32_t depth) {
+  dispatch_queue_depth_ = depth;
+}
+
+void SNMPConfig::set_tcp_enabled(bool enabled) { enable_tcp_ = enabled; }
+
+void SNMPConfig::set_tcp_max_message_size(uint32_t max_size) {
+  tcp_max_message_size_ = max_size;
+}
+
+void SNMPConfig::set_max_response_size(uint32_t max_size) {
+  max_response_size_ = max_size;
+}
+
+void SNMPConfig::set_receive_buffer_size(uint32_t size) {
+  receive_buffer_size_ = size;
+}
+
+void SNMPConfig::set_receive_buffer_auto(bool enabled) {
+  receive_buffer_auto_ = enabled;
+}
+
+void SNMPConfig::set_receive_buffer_max(uint32_t size) {
+  receive_buffer_max_ = size;
+}
+
+void SNMPConfig::set_load_shedding_enabled(bool enabled) {
+  load_shedding_ = enabled;
+}
+
+void SNMPConfig::set_shed_target_us(uint32_t target_us) {
+  shed_target_us_ = target_us;
+}
+
+void SNMPConfig::set_shed_interval_ms(uint32_t interval_ms) {
+  shed_interval_ms_ = interval_ms;
+}
+
+void SNMPConfig::set_shed_bulk_cost(uint32_t cost) { shed_bulk_cost_ = cost; }
+
+void SNMPConfig::set_priority_communities(
+    const std::vector<std::string> &communities) {
+  priority_communities_ = communities;
+}
+
+void SNMPConfig::set_low_priority_communities(
+    const std::vector<std::string> &communities) {
+  low_priority_communities_ = communities;
+}
+
+void SNMPConfig::set_response_cache_ttl_ms(uint32_t ttl_ms) {
+  response_cache_ttl_ms_ = ttl_ms;
+}
+
+void SNMPConfig::set_response_cache_entries(uint32_t entries) {
+  response_cache_entries_ = entries;
+}
+
+void SNMPConfig::set_shape_cache_entries(uint32_t entries) {
+  shape_cache_entries_ = entries;
+}
+
+void SNMPConfig::set_fair_queueing_enabled(bool enabled) {
+  fair_queueing_ = enabled;
+}
+
+void SNMPConfig::set_fair_queue_quantum(uint32_t quantum) {
+  fair_queue_quantum_ = quantum;
+}
+
+void SNMPConfig::set_fair_queue_flow_depth(uint32_t depth) {
+  fair_queue_flow_depth_ = depth;
+}
+
+void SNMPConfig::set_fair_queue_weights(
+    const std::vector<std::string> &weights) {
+  fair_queue_weights_ = weights;
+}
+
+void SNMPConfig::set_mib_cache_rules(const std::vector<std::string> &rules) {
+  mib_cache_rules_ = rules;
+}
+
 } // namespace simple_snmpd
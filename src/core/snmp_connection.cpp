@@ -19,6 +19,8 @@
 #include "simple_snmpd/snmp_connection.hpp"
 #include "simple_snmpd/error_handler.hpp"
 #include "simple_snmpd/logger.hpp"
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
 #include <cstring>
 
@@ -40,7 +42,31 @@ SNMPConnection::SNMPConnection(int socket_fd, const std::string &client_address,
                                uint16_t client_port)
     : socket_fd_(socket_fd), client_address_(client_address),
       client_port_(client_port), connected_(true),
-      last_activity_(std::chrono::steady_clock::now()) {}
+      last_activity_(std::chrono::steady_clock::now()), peer_(),
+      peer_length_(0), input_start_(0), message_length_(0),
+      output_start_(0), max_message_size_(65535) {}
+
+SNMPConnection::SNMPConnection(int socket_fd,
+                               const struct sockaddr_storage &peer,
+                               socklen_t peer_length)
+    : socket_fd_(socket_fd), client_port_(0), connected_(true),
+      last_activity_(std::chrono::steady_clock::now()), peer_(),
+      peer_length_(peer_length), input_start_(0), message_length_(0),
+      output_start_(0), max_message_size_(65535) {
+  std::memcpy(&peer_, &peer, std::min<size_t>(peer_length, sizeof(peer_)));
+
+  char host[INET6_ADDRSTRLEN] = "";
+  if (peer.ss_family == AF_INET) {
+    const auto &v4 = reinterpret_cast<const struct sockaddr_in &>(peer);
+    inet_ntop(AF_INET, &v4.sin_addr, host, sizeof(host));
+    client_port_ = ntohs(v4.sin_port);
+  } else if (peer.ss_family == AF_INET6) {
+    const auto &v6 = reinterpret_cast<const struct sockaddr_in6 &>(peer);
+    inet_ntop(AF_INET6, &v6.sin6_addr, host, sizeof(host));
+    client_port_ = ntohs(v6.sin6_port);
+  }
+  client_address_ = host;
+}
 
 SNMPConnection::~SNMPConnection() { close(); }
 
@@ -95,8 +121,14 @@ bool SNMPConnection::receive_request(SNMPPacket &packet) {
     return false;
   }
 
-  if (!packet.parse(buffer, bytes_received)) {
-    Logger::get_instance().log(LogLevel::ERROR, "Failed to parse SNMP packet");
+  // The buffer is gone on return, so the caller gets an owning copy; the
+  // server reads stream messages in place through next_message() instead
+  ParseResult parsed = packet.parse(buffer, bytes_received);
+  if (!parsed) {
+    Logger::get_instance().log(
+        LogLevel::ERROR, std::string("Failed to parse SNMP packet: ") +
+                             parse_error_name(parsed.error) + " at offset " +
+                             std::to_string(parsed.offset));
     return false;
   }
 
@@ -104,6 +136,149 @@ bool SNMPConnection::receive_request(SNMPPacket &packet) {
   return true;
 }
 
+bool SNMPConnection::read_available() {
+  if (!connected_) {
+    return false;
+  }
+
+  for (;;) {
+    // Drop consumed bytes before growing the buffer
+    if (input_start_ > 0 && input_start_ * 2 >= input_.size()) {
+      input_.erase(input_.begin(), input_.begin() + input_start_);
+      input_start_ = 0;
+    }
+
+    size_t used = input_.size();
+    input_.resize(used + 16384);
+    ssize_t bytes_received =
+        recv(socket_fd_, reinterpret_cast<char *>(input_.data() + used),
+             input_.size() - used, 0);
+    input_.resize(used + std::max<ssize_t>(bytes_received, 0));
+
+    if (bytes_received > 0) {
+      last_activity_ = std::chrono::steady_clock::now();
+      // Bound buffering per connection; the rest stays in the socket
+      // until the buffered requests have been answered
+      if (input_.size() - input_start_ > max_message_size_) {
+        return true;
+      }
+      continue;
+    }
+
+    if (bytes_received == 0) {
+      connected_ = false;
+      return false;
+    }
+
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return true;
+    }
+    connected_ = false;
+    return false;
+  }
+}
+
+int SNMPConnection::next_message(const uint8_t *&data, size_t &length) {
+  const uint8_t *buffer = input_.data() + input_start_;
+  size_t available = input_.size() - input_start_;
+
+  // Each message is a BER SEQUENCE: tag, length, contents
+  if (available < 2) {
+    return 0;
+  }
+  if (buffer[0] != 0x30) {
+    return -1;
+  }
+
+  size_t header = 2;
+  size_t content_length = buffer[1];
+  if (content_length & 0x80) {
+    size_t length_bytes = content_length & 0x7f;
+    if (length_bytes == 0 || length_bytes > 4) {
+      return -1;
+    }
+    header += length_bytes;
+    if (available < header) {
+      return 0;
+    }
+    content_length = 0;
+    for (size_t i = 0; i < length_bytes; ++i) {
+      content_length = (content_length << 8) | buffer[2 + i];
+    }
+  }
+
+  if (header + content_length > max_message_size_) {
+    return -1;
+  }
+  if (available < header + content_length) {
+    return 0;
+  }
+
+  message_length_ = header + content_length;
+  data = buffer;
+  length = message_length_;
+  return 1;
+}
+
+void SNMPConnection::consume_message() {
+  input_start_ += message_length_;
+  message_length_ = 0;
+  if (input_start_ == input_.size()) {
+    input_.clear();
+    input_start_ = 0;
+  }
+}
+
+void SNMPConnection::queue_output(const uint8_t *data, size_t length) {
+  if (output_start_ > 0 && output_start_ == output_.size()) {
+    output_.clear();
+    output_start_ = 0;
+  }
+  output_.insert(output_.end(), data, data + length);
+}
+
+bool SNMPConnection::flush_output() {
+  while (output_start_ < output_.size()) {
+#ifdef MSG_NOSIGNAL
+    int flags = MSG_NOSIGNAL;
+#else
+    int flags = 0;
+#endif
+    ssize_t bytes_sent = send(
+        socket_fd_, reinterpret_cast<const char *>(output_.data()) +
+                        output_start_,
+        output_.size() - output_start_, flags);
+    if (bytes_sent > 0) {
+      output_start_ += static_cast<size_t>(bytes_sent);
+      continue;
+    }
+    if (bytes_sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes_sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return true;
+    }
+    connected_ = false;
+    return false;
+  }
+
+  output_.clear();
+  output_start_ = 0;
+  last_activity_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+size_t SNMPConnection::pending_output() const {
+  return output_.size() - output_start_;
+}
+
+void SNMPConnection::set_max_message_size(size_t max_size) {
+  max_message_size_ = max_size;
+}
+
 bool SNMPConnection::is_connected() const { return connected_; }
 
 const std::string &SNMPConnection::get_client_address() const {
@@ -112,6 +287,14 @@ const std::string &SNMPConnection::get_client_address() const {
 
 uint16_t SNMPConnection::get_client_port() const { return client_port_; }
 
+const struct sockaddr_storage &SNMPConnection::get_peer_address() const {
+  return peer_;
+}
+
+socklen_t SNMPConnection::get_peer_address_length() const {
+  return peer_length_;
+}
+
 std::chrono::steady_clock::time_point
 SNMPConnection::get_last_activity() const {
   return last_activity_;
@@ -0,0 +1,1200 @@
+/*
+ * src/core/snmp_mib.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/snmp_mib.hpp"
+#include "simple_snmpd/ber_encoder.hpp"
+#include "simple_snmpd/oid_kernels.hpp"
+#include "simple_snmpd/platform.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace simple_snmpd {
+
+namespace {
+
+// Decode one sub-identifier; an arc cut off by the end of the OID yields
+// what was read so far
+uint64_t read_arc(const std::vector<uint8_t> &oid, size_t &position) {
+  uint64_t arc = 0;
+  while (position < oid.size()) {
+    uint8_t byte = oid[position++];
+    arc = (arc << 7) | (byte & 0x7F);
+    if ((byte & 0x80) == 0) {
+      break;
+    }
+  }
+  return arc;
+}
+
+// Length of oid without its last sub-identifier
+size_t parent_size(const std::vector<uint8_t> &oid) {
+  size_t size = oid.empty() ? 0 : oid.size() - 1;
+  while (size > 0 && (oid[size - 1] & 0x80) != 0) {
+    --size;
+  }
+  return size;
+}
+
+void append_arc(std::vector<uint8_t> &oid, uint64_t arc) {
+  uint8_t encoded[10];
+  size_t count = 0;
+  do {
+    encoded[count++] = static_cast<uint8_t>(arc & 0x7F);
+    arc >>= 7;
+  } while (arc > 0);
+  while (count > 0) {
+    --count;
+    oid.push_back(static_cast<uint8_t>(encoded[count] | (count ? 0x80 : 0)));
+  }
+}
+
+// Minimal two's complement contents, as an INTEGER or one of the unsigned
+// application types (a leading zero keeps the high bit clear)
+MIBValue integer_value(SNMPDataType type, int64_t value) {
+  size_t length = BerEncoder::integer_length(value);
+  std::vector<uint8_t> data(length);
+  for (size_t i = 0; i < length; ++i) {
+    data[length - 1 - i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+  return MIBValue(type, data);
+}
+
+std::chrono::steady_clock::time_point start_time =
+    std::chrono::steady_clock::now();
+
+// Largest batch a cursor asks a row provider for
+constexpr size_t MAX_ROW_BATCH = 256;
+
+// Rows and indexes in OID order
+bool row_before(const MIBRow &row, const MIBIndex &index) {
+  return OIDUtils::compare_arcs(row.index, index) < 0;
+}
+
+bool index_before(const MIBIndex &index, const MIBRow &row) {
+  return OIDUtils::compare_arcs(index, row.index) < 0;
+}
+
+// Row of sorted rows with exactly this index, or null
+const MIBRow *find_row(const std::vector<MIBRow> &rows,
+                       const MIBIndex &index) {
+  auto it = std::lower_bound(rows.begin(), rows.end(), index, row_before);
+  if (it == rows.end() || OIDUtils::compare_arcs(it->index, index) != 0) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+// Fill rows with up to limit of the sorted rows in all after *after
+void rows_after(const std::vector<MIBRow> &all, const MIBIndex *after,
+                size_t limit, std::vector<MIBRow> &rows) {
+  auto first = after == nullptr ? all.begin()
+                                : std::upper_bound(all.begin(), all.end(),
+                                                   *after, index_before);
+  rows.resize(std::min<size_t>(limit, all.end() - first));
+  std::copy(first, first + rows.size(), rows.begin());
+}
+
+// Every row of table, read through cache
+std::shared_ptr<const std::vector<MIBRow>>
+cached_rows(MIBCache &cache, const std::shared_ptr<const MIBTable> &table) {
+  return cache.get<std::vector<MIBRow>>(
+      table->entry_oid, [&table]() -> MIBCache::Loader {
+        std::shared_ptr<const MIBTable> owned = table;
+        return [owned]() -> std::shared_ptr<const void> {
+          std::shared_ptr<std::vector<MIBRow>> rows =
+              std::make_shared<std::vector<MIBRow>>();
+          owned->provider->get_rows(nullptr, SIZE_MAX, *rows);
+          return rows;
+        };
+      });
+}
+
+} // namespace
+
+bool MIBRowProvider::set_cell(const MIBIndex &, size_t, const MIBValue &) {
+  return false;
+}
+
+SortedRowProvider::SortedRowProvider() : rows_(new std::vector<MIBRow>) {}
+
+SortedRowProvider::~SortedRowProvider() { delete rows_.load(); }
+
+void SortedRowProvider::set_rows(std::vector<MIBRow> rows) {
+  // Stable, so of several rows with one index the last stays last
+  std::stable_sort(rows.begin(), rows.end(),
+                   [](const MIBRow &row1, const MIBRow &row2) {
+                     return row_before(row1, row2.index);
+                   });
+  std::unique_ptr<std::vector<MIBRow>> sorted(new std::vector<MIBRow>);
+  sorted->reserve(rows.size());
+  for (MIBRow &row : rows) {
+    if (!sorted->empty() &&
+        OIDUtils::compare_arcs(sorted->back().index, row.index) == 0) {
+      sorted->back() = std::move(row);
+    } else {
+      sorted->push_back(std::move(row));
+    }
+  }
+
+  const std::vector<MIBRow> *previous =
+      rows_.exchange(sorted.release(), std::memory_order_acq_rel);
+  EpochManager::get_instance().retire([previous]() { delete previous; });
+}
+
+size_t SortedRowProvider::size() const {
+  EpochManager::Guard guard;
+  return rows_.load(std::memory_order_acquire)->size();
+}
+
+bool SortedRowProvider::get_row(const MIBIndex &index, MIBRow &row) const {
+  EpochManager::Guard guard;
+  const MIBRow *found =
+      find_row(*rows_.load(std::memory_order_acquire), index);
+  if (found == nullptr) {
+    return false;
+  }
+  row = *found;
+  return true;
+}
+
+void SortedRowProvider::get_rows(const MIBIndex *after, size_t limit,
+                                 std::vector<MIBRow> &rows) const {
+  EpochManager::Guard guard;
+  rows_after(*rows_.load(std::memory_order_acquire), after, limit, rows);
+}
+
+void IndexUtils::append_integer(MIBIndex &index, uint32_t value) {
+  index.push_back(value);
+}
+
+void IndexUtils::append_ip_address(MIBIndex &index, uint32_t address) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    index.push_back((address >> shift) & 0xFF);
+  }
+}
+
+void IndexUtils::append_string(MIBIndex &index, const std::string &value,
+                               bool implied) {
+  if (!implied) {
+    index.push_back(static_cast<uint32_t>(value.size()));
+  }
+  for (char octet : value) {
+    index.push_back(static_cast<uint8_t>(octet));
+  }
+}
+
+bool IndexUtils::read_integer(const MIBIndex &index, size_t &position,
+                              uint32_t &value) {
+  if (position >= index.size()) {
+    return false;
+  }
+  value = index[position++];
+  return true;
+}
+
+bool IndexUtils::read_ip_address(const MIBIndex &index, size_t &position,
+                                 uint32_t &address) {
+  if (index.size() - std::min(position, index.size()) < 4) {
+    return false;
+  }
+  uint32_t result = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    if (index[position + i] > 0xFF) {
+      return false;
+    }
+    result = (result << 8) | index[position + i];
+  }
+  position += 4;
+  address = result;
+  return true;
+}
+
+bool IndexUtils::read_string(const MIBIndex &index, size_t &position,
+                             std::string &value, bool implied) {
+  if (position > index.size()) {
+    return false;
+  }
+  size_t length = index.size() - position;
+  size_t start = position;
+  if (!implied) {
+    if (position == index.size() || index[position] > length - 1) {
+      return false;
+    }
+    length = index[position];
+    ++start;
+  }
+
+  std::string result;
+  result.reserve(length);
+  for (size_t i = start; i < start + length; ++i) {
+    if (index[i] > 0xFF) {
+      return false;
+    }
+    result.push_back(static_cast<char>(index[i]));
+  }
+  position = start + length;
+  value.swap(result);
+  return true;
+}
+
+bool OIDLess::operator()(const std::vector<uint8_t> &oid1,
+                         const std::vector<uint8_t> &oid2) const {
+  return OIDUtils::compare_oids(oid1, oid2) < 0;
+}
+
+MIBManager &MIBManager::get_instance() {
+  static MIBManager instance;
+  return instance;
+}
+
+MIBManager::MIBManager() : version_(new Version), update_depth_(0) {}
+
+MIBManager::~MIBManager() { delete version_.load(); }
+
+MIBManager::Update::Update(MIBManager &mib) : mib_(mib) {
+  mib_.update_mutex_.lock();
+  if (mib_.update_depth_++ == 0) {
+    // Writers are serialized, so the current version cannot be retired
+    // while it is copied
+    mib_.pending_.reset(new Version(*mib_.version_.load()));
+    ++mib_.pending_->generation;
+  }
+}
+
+MIBManager::Update::~Update() {
+  if (--mib_.update_depth_ == 0) {
+    const Version *previous = mib_.version_.exchange(
+        mib_.pending_.release(), std::memory_order_acq_rel);
+    EpochManager::get_instance().retire([previous]() { delete previous; });
+  }
+  mib_.update_mutex_.unlock();
+}
+
+void MIBManager::register_scalar(const MIBEntry &entry) {
+  Object object;
+  object.scalar = entry;
+  register_object(entry.oid, object);
+}
+
+void MIBManager::register_table(const MIBTableEntry &entry,
+                                uint32_t max_index) {
+  Object object;
+  object.table = true;
+  object.column = entry;
+  object.rows = max_index;
+  register_object(entry.oid, object);
+}
+
+void MIBManager::register_table(const MIBTable &table) {
+  if (!table.provider) {
+    return;
+  }
+
+  // Every column of the table appears in the same version
+  Update update(*this);
+  std::shared_ptr<const MIBTable> shared = std::make_shared<MIBTable>(table);
+  for (size_t i = 0; i < table.columns.size(); ++i) {
+    const MIBColumn &column = table.columns[i];
+    std::vector<uint8_t> oid = table.entry_oid;
+    append_arc(oid, column.arc);
+
+    Object object;
+    object.table = true;
+    object.column =
+        MIBTableEntry(oid, column.name, column.type, column.read_only);
+    object.indexed = shared;
+    object.column_index = i;
+    register_object(oid, object);
+  }
+}
+
+void MIBManager::register_object(const std::vector<uint8_t> &oid,
+                                 const Object &object) {
+  Update update(*this);
+  Version &version = *pending_;
+  std::shared_ptr<Object> shared = std::make_shared<Object>(object);
+  shared->cache = cache_for(version, oid);
+  if (shared->cache) {
+    // Values of what this replaces
+    shared->cache->invalidate(object.indexed ? object.indexed->entry_oid
+                                             : oid);
+  }
+  size_t slot = version.index.insert(oid);
+  if (slot == version.objects.size()) {
+    version.objects.push_back(std::move(shared));
+  } else {
+    version.objects[slot] = std::move(shared);
+  }
+}
+
+void MIBManager::set_cache_policy(const std::vector<uint8_t> &subtree,
+                                  const MIBCachePolicy &policy) {
+  Update update(*this);
+  Version &version = *pending_;
+  std::shared_ptr<MIBCache> cache = std::make_shared<MIBCache>(subtree, policy);
+  auto same = std::find_if(version.caches.begin(), version.caches.end(),
+                           [&subtree](const std::shared_ptr<MIBCache> &c) {
+                             return c->subtree() == subtree;
+                           });
+  if (same != version.caches.end()) {
+    *same = cache;
+  } else {
+    version.caches.push_back(cache);
+  }
+
+  // Objects already registered under subtree
+  const OIDTrie &index = version.index;
+  size_t slot = index.find(subtree);
+  if (slot == OIDTrie::npos) {
+    slot = index.upper_bound(subtree);
+  }
+  for (; slot != OIDTrie::npos && OIDUtils::is_prefix(subtree, index.oid(slot));
+       slot = index.next(slot)) {
+    std::shared_ptr<Object> object =
+        std::make_shared<Object>(*version.objects[slot]);
+    object->cache = cache_for(version, index.oid(slot));
+    version.objects[slot] = std::move(object);
+  }
+}
+
+std::vector<std::shared_ptr<const MIBCache>> MIBManager::get_caches() const {
+  EpochManager::Guard guard;
+  const Version &version = current();
+  return std::vector<std::shared_ptr<const MIBCache>>(version.caches.begin(),
+                                                      version.caches.end());
+}
+
+std::shared_ptr<MIBCache>
+MIBManager::cache_for(const Version &version,
+                      const std::vector<uint8_t> &oid) {
+  std::shared_ptr<MIBCache> best;
+  for (const auto &cache : version.caches) {
+    if (OIDUtils::is_prefix(cache->subtree(), oid) &&
+        (!best || cache->subtree().size() > best->subtree().size())) {
+      best = cache;
+    }
+  }
+  return best;
+}
+
+uint64_t MIBManager::generation() const {
+  EpochManager::Guard guard;
+  return current().generation;
+}
+
+size_t MIBManager::find_instance(const Version &version,
+                                 const std::vector<uint8_t> &oid,
+                                 uint32_t &row, MIBIndex &row_index) {
+  // The registration at or before oid is the only one that can hold it
+  const OIDTrie &index = version.index;
+  size_t slot = index.prev(index.upper_bound(oid));
+  if (slot == OIDTrie::npos) {
+    return OIDTrie::npos;
+  }
+
+  row = 0;
+  const std::vector<uint8_t> &registered = index.oid(slot);
+  const Object &object = *version.objects[slot];
+  if (!object.table) {
+    return registered == oid ? slot : OIDTrie::npos;
+  }
+
+  // A column instance is the column OID followed by the row's index
+  if (!OIDUtils::is_prefix(registered, oid) ||
+      oid.size() == registered.size()) {
+    return OIDTrie::npos;
+  }
+  if (object.indexed) {
+    // Any index may name a row; only the provider knows which do
+    size_t length = oid.size() - registered.size();
+    size_t count = 0;
+    row_index.resize(length);
+    bool ok = OIDKernels::active().decode(oid.data() + registered.size(),
+                                          length, row_index.data(), count);
+    row_index.resize(ok ? count : 0);
+    return ok ? slot : OIDTrie::npos;
+  }
+
+  // Rows 1..rows take exactly one arc
+  size_t position = registered.size();
+  uint64_t arc = read_arc(oid, position);
+  if (position != oid.size() || (oid.back() & 0x80) != 0 || arc < 1 ||
+      arc > object.rows) {
+    return OIDTrie::npos;
+  }
+  row = static_cast<uint32_t>(arc);
+  return slot;
+}
+
+bool MIBManager::get_value(const std::vector<uint8_t> &oid,
+                           MIBValue &value) const {
+  EpochManager::Guard guard;
+  const Version &version = current();
+  uint32_t row = 0;
+  MIBIndex index;
+  size_t slot = find_instance(version, oid, row, index);
+  return slot != OIDTrie::npos &&
+         read_object(*version.objects[slot], row, index, value);
+}
+
+void MIBManager::resolve(const std::vector<uint8_t> &oid,
+                         Handle &handle) const {
+  EpochManager::Guard guard;
+  const Version &version = current();
+  uint32_t row = 0;
+  size_t slot = find_instance(version, oid, row, handle.index_);
+  handle.object_ =
+      slot != OIDTrie::npos ? version.objects[slot].get() : nullptr;
+  handle.row_ = row;
+}
+
+bool MIBManager::get_value(const Handle &handle, MIBValue &value) const {
+  return handle.valid() &&
+         read_object(*handle.object_, handle.row_, handle.index_, value);
+}
+
+bool MIBManager::read_object(const Object &object, uint32_t row,
+                             const MIBIndex &index, MIBValue &value) {
+  if (object.indexed) {
+    MIBRow cells;
+    if (!get_row(object, index, cells) ||
+        object.column_index >= cells.values.size() ||
+        cells.values[object.column_index].type == SNMPDataType::NULL_TYPE) {
+      return false;
+    }
+    value = std::move(cells.values[object.column_index]);
+    return true;
+  }
+  if (object.cache) {
+    return read_cached(object, row, value);
+  }
+  if (object.table) {
+    if (!object.column.getter) {
+      return false;
+    }
+    value = object.column.getter(row);
+    return true;
+  }
+  if (!object.scalar.getter) {
+    return false;
+  }
+  value = object.scalar.getter();
+  return true;
+}
+
+bool MIBManager::read_cached(const Object &object, uint32_t row,
+                             MIBValue &value) {
+  // The loaders copy the getter, since a refresh can outlive this version
+  std::shared_ptr<const MIBValue> cached;
+  if (object.table) {
+    std::vector<uint8_t> key = object.column.oid;
+    append_arc(key, row);
+    cached = object.cache->get<MIBValue>(key, [&object, row]() {
+      std::function<MIBValue(uint32_t)> getter = object.column.getter;
+      return MIBCache::Loader([getter, row]() -> std::shared_ptr<const void> {
+        if (!getter) {
+          return nullptr;
+        }
+        return std::make_shared<MIBValue>(getter(row));
+      });
+    });
+  } else {
+    cached = object.cache->get<MIBValue>(object.scalar.oid, [&object]() {
+      std::function<MIBValue()> getter = object.scalar.getter;
+      return MIBCache::Loader([getter]() -> std::shared_ptr<const void> {
+        if (!getter) {
+          return nullptr;
+        }
+        return std::make_shared<MIBValue>(getter());
+      });
+    });
+  }
+  if (!cached) {
+    return false;
+  }
+  value = *cached;
+  return true;
+}
+
+bool MIBManager::get_row(const Object &object, const MIBIndex &index,
+                         MIBRow &row) {
+  if (!object.cache) {
+    return object.indexed->provider->get_row(index, row);
+  }
+  const MIBRow *found =
+      find_row(*cached_rows(*object.cache, object.indexed), index);
+  if (found == nullptr) {
+    return false;
+  }
+  row = *found;
+  return true;
+}
+
+void MIBManager::get_rows(const Object &object, const MIBIndex *after,
+                          size_t limit, std::vector<MIBRow> &rows) {
+  if (!object.cache) {
+    object.indexed->provider->get_rows(after, limit, rows);
+    return;
+  }
+  rows_after(*cached_rows(*object.cache, object.indexed), after, limit, rows);
+}
+
+bool MIBManager::set_value(const std::vector<uint8_t> &oid,
+                           const MIBValue &value) {
+  EpochManager::Guard guard;
+  const Version &version = current();
+  uint32_t row = 0;
+  MIBIndex index;
+  size_t slot = find_instance(version, oid, row, index);
+  if (slot == OIDTrie::npos) {
+    return false;
+  }
+
+  const Object &object = *version.objects[slot];
+  bool written;
+  if (object.indexed) {
+    written = !object.column.read_only && value.type == object.column.type &&
+              object.indexed->provider->set_cell(index, object.column_index,
+                                                 value);
+  } else if (object.table) {
+    written = !object.column.read_only && object.column.setter &&
+              value.type == object.column.type &&
+              object.column.setter(row, value);
+  } else {
+    written = !object.scalar.read_only && object.scalar.setter &&
+              value.type == object.scalar.type && object.scalar.setter(value);
+  }
+
+  // The next read sees what was written
+  if (written && object.cache) {
+    object.cache->invalidate(object.indexed ? object.indexed->entry_oid
+                                            : oid);
+  }
+  return written;
+}
+
+bool MIBManager::get_next_oid(const std::vector<uint8_t> &oid,
+                              std::vector<uint8_t> &next_oid) const {
+  Cursor cursor(*this);
+  if (!cursor.seek_after(oid)) {
+    return false;
+  }
+  next_oid = cursor.oid();
+  return true;
+}
+
+bool MIBManager::is_scalar(const std::vector<uint8_t> &oid) const {
+  EpochManager::Guard guard;
+  const Version &version = current();
+  size_t slot = version.index.find(oid);
+  return slot != OIDTrie::npos && !version.objects[slot]->table;
+}
+
+bool MIBManager::is_table(const std::vector<uint8_t> &oid) const {
+  EpochManager::Guard guard;
+  const Version &version = current();
+  size_t slot = version.index.find(oid);
+  return slot != OIDTrie::npos && version.objects[slot]->table;
+}
+
+bool MIBManager::is_writable(const std::vector<uint8_t> &oid) const {
+  EpochManager::Guard guard;
+  const Version &version = current();
+  uint32_t row = 0;
+  MIBIndex index;
+  size_t slot = find_instance(version, oid, row, index);
+  if (slot == OIDTrie::npos) {
+    return false;
+  }
+
+  const Object &object = *version.objects[slot];
+  if (object.indexed) {
+    return !object.column.read_only;
+  }
+  if (object.table) {
+    return !object.column.read_only && object.column.setter;
+  }
+  return !object.scalar.read_only && object.scalar.setter;
+}
+
+bool MIBManager::has_object(const std::vector<uint8_t> &oid) const {
+  EpochManager::Guard guard;
+  const Version &version = current();
+
+  // A column is its own object type and a scalar's type is its instance
+  // OID without the trailing .0
+  auto covers = [&version, &oid](size_t slot) {
+    if (slot == OIDTrie::npos) {
+      return false;
+    }
+    const std::vector<uint8_t> &registered = version.index.oid(slot);
+    size_t type_size = version.objects[slot]->table ? registered.size()
+                                                    : parent_size(registered);
+    return type_size <= oid.size() &&
+           std::equal(registered.begin(), registered.begin() + type_size,
+                      oid.begin());
+  };
+
+  // Only the registrations either side of oid can cover it
+  size_t slot = version.index.upper_bound(oid);
+  return covers(slot) || covers(version.index.prev(slot));
+}
+
+uint32_t
+MIBManager::get_table_size(const std::vector<uint8_t> &table_oid) const {
+  EpochManager::Guard guard;
+  const Version &version = current();
+  size_t slot = version.index.find(table_oid);
+  if (slot == OIDTrie::npos || !version.objects[slot]->table) {
+    return 0;
+  }
+  return version.objects[slot]->rows;
+}
+
+void MIBManager::initialize_standard_mibs() {
+  // Published as one version
+  Update update(*this);
+  initialize_system_mib();
+  initialize_interface_mib();
+  initialize_ip_mib();
+  initialize_snmp_mib();
+}
+
+void MIBManager::initialize_system_mib() {
+  // system group (RFC 3418)
+  const std::string prefix = "1.3.6.1.2.1.1.";
+  Platform &platform = Platform::get_instance();
+  const std::string descr = "Simple SNMP Daemon on " +
+                            platform.get_os_name() + " " +
+                            platform.get_os_version() + " " +
+                            platform.get_architecture();
+  const std::string hostname = platform.get_hostname();
+
+  MIBEntry entry(OIDUtils::string_to_oid(prefix + "1.0"), "sysDescr",
+                 SNMPDataType::OCTET_STRING);
+  entry.getter = [descr]() {
+    return MIBValue(SNMPDataType::OCTET_STRING, descr);
+  };
+  register_scalar(entry);
+
+  // zeroDotZero: no registered product identifier
+  entry = MIBEntry(OIDUtils::string_to_oid(prefix + "2.0"), "sysObjectID",
+                   SNMPDataType::OBJECT_IDENTIFIER);
+  entry.getter = []() {
+    return MIBValue(SNMPDataType::OBJECT_IDENTIFIER,
+                    std::vector<uint8_t>{0x00});
+  };
+  register_scalar(entry);
+
+  entry = MIBEntry(OIDUtils::string_to_oid(prefix + "3.0"), "sysUpTime",
+                   SNMPDataType::TIME_TICKS);
+  entry.getter = []() {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time);
+    return integer_value(SNMPDataType::TIME_TICKS,
+                         (elapsed.count() / 10) & 0xFFFFFFFF);
+  };
+  register_scalar(entry);
+
+  entry = MIBEntry(OIDUtils::string_to_oid(prefix + "4.0"), "sysContact",
+                   SNMPDataType::OCTET_STRING);
+  entry.getter = []() {
+    return MIBValue(SNMPDataType::OCTET_STRING, std::string());
+  };
+  register_scalar(entry);
+
+  entry = MIBEntry(OIDUtils::string_to_oid(prefix + "5.0"), "sysName",
+                   SNMPDataType::OCTET_STRING);
+  entry.getter = [hostname]() {
+    return MIBValue(SNMPDataType::OCTET_STRING, hostname);
+  };
+  register_scalar(entry);
+
+  entry = MIBEntry(OIDUtils::string_to_oid(prefix + "6.0"), "sysLocation",
+                   SNMPDataType::OCTET_STRING);
+  entry.getter = []() {
+    return MIBValue(SNMPDataType::OCTET_STRING, std::string());
+  };
+  register_scalar(entry);
+
+  // Applications and end-to-end layers
+  entry = MIBEntry(OIDUtils::string_to_oid(prefix + "7.0"), "sysServices",
+                   SNMPDataType::INTEGER);
+  entry.getter = []() { return integer_value(SNMPDataType::INTEGER, 72); };
+  register_scalar(entry);
+}
+
+void MIBManager::initialize_interface_mib() {
+  // interfaces group (RFC 2863) with the loopback interface
+  MIBEntry if_number(OIDUtils::string_to_oid("1.3.6.1.2.1.2.1.0"),
+                     "ifNumber", SNMPDataType::INTEGER);
+  if_number.getter = []() {
+    return integer_value(SNMPDataType::INTEGER, 1);
+  };
+  register_scalar(if_number);
+
+  struct Column {
+    const char *arc;
+    const char *name;
+    SNMPDataType type;
+    std::function<MIBValue(uint32_t)> getter;
+  };
+  const Column columns[] = {
+      {"1", "ifIndex", SNMPDataType::INTEGER,
+       [](uint32_t row) { return integer_value(SNMPDataType::INTEGER, row); }},
+      {"2", "ifDescr", SNMPDataType::OCTET_STRING,
+       [](uint32_t) {
+         return MIBValue(SNMPDataType::OCTET_STRING, std::string("lo"));
+       }},
+      {"3", "ifType", SNMPDataType::INTEGER,
+       [](uint32_t) {
+         return integer_value(SNMPDataType::INTEGER, 24); // softwareLoopback
+       }},
+      {"4", "ifMtu", SNMPDataType::INTEGER,
+       [](uint32_t) { return integer_value(SNMPDataType::INTEGER, 65536); }},
+      {"5", "ifSpeed", SNMPDataType::GAUGE32,
+       [](uint32_t) { return integer_value(SNMPDataType::GAUGE32, 0); }},
+      {"6", "ifPhysAddress", SNMPDataType::OCTET_STRING,
+       [](uint32_t) {
+         return MIBValue(SNMPDataType::OCTET_STRING, std::string());
+       }},
+      {"7", "ifAdminStatus", SNMPDataType::INTEGER,
+       [](uint32_t) { return integer_value(SNMPDataType::INTEGER, 1); }},
+      {"8", "ifOperStatus", SNMPDataType::INTEGER,
+       [](uint32_t) { return integer_value(SNMPDataType::INTEGER, 1); }},
+  };
+  for (const auto &column : columns) {
+    MIBTableEntry entry(
+        OIDUtils::string_to_oid(std::string("1.3.6.1.2.1.2.2.1.") +
+                                column.arc),
+        column.name, column.type);
+    entry.getter = column.getter;
+    register_table(entry, 1);
+  }
+}
+
+void MIBManager::initialize_ip_mib() {
+  // ipAddrTable (RFC 4293), indexed by IpAddress, with the loopback
+  // interface's address
+  MIBTable table;
+  table.entry_oid = OIDUtils::string_to_oid("1.3.6.1.2.1.4.20.1");
+  table.name = "ipAddrTable";
+  table.columns = {
+      MIBColumn(1, "ipAdEntAddr", SNMPDataType::IP_ADDRESS),
+      MIBColumn(2, "ipAdEntIfIndex", SNMPDataType::INTEGER),
+      MIBColumn(3, "ipAdEntNetMask", SNMPDataType::IP_ADDRESS),
+      MIBColumn(4, "ipAdEntBcastAddr", SNMPDataType::INTEGER),
+      MIBColumn(5, "ipAdEntReasmMaxSize", SNMPDataType::INTEGER),
+  };
+
+  MIBRow loopback;
+  IndexUtils::append_ip_address(loopback.index, 0x7F000001);
+  loopback.values = {
+      MIBValue(SNMPDataType::IP_ADDRESS, std::vector<uint8_t>{127, 0, 0, 1}),
+      integer_value(SNMPDataType::INTEGER, 1),
+      MIBValue(SNMPDataType::IP_ADDRESS, std::vector<uint8_t>{255, 0, 0, 0}),
+      integer_value(SNMPDataType::INTEGER, 1),
+      integer_value(SNMPDataType::INTEGER, 65535),
+  };
+  std::shared_ptr<SortedRowProvider> provider =
+      std::make_shared<SortedRowProvider>();
+  provider->set_rows({loopback});
+  table.provider = provider;
+  register_table(table);
+}
+
+void MIBManager::initialize_snmp_mib() {
+  // snmp group (RFC 3418); the agent does not count these yet
+  struct Scalar {
+    const char *arc;
+    const char *name;
+    SNMPDataType type;
+    int64_t value;
+  };
+  const Scalar scalars[] = {
+      {"1", "snmpInPkts", SNMPDataType::COUNTER32, 0},
+      {"2", "snmpOutPkts", SNMPDataType::COUNTER32, 0},
+      {"3", "snmpInBadVersions", SNMPDataType::COUNTER32, 0},
+      {"4", "snmpInBadCommunityNames", SNMPDataType::COUNTER32, 0},
+      {"5", "snmpInBadCommunityUses", SNMPDataType::COUNTER32, 0},
+      {"6", "snmpInASNParseErrs", SNMPDataType::COUNTER32, 0},
+      {"30", "snmpEnableAuthenTraps", SNMPDataType::INTEGER, 2}, // disabled
+      {"31", "snmpSilentDrops", SNMPDataType::COUNTER32, 0},
+      {"32", "snmpProxyDrops", SNMPDataType::COUNTER32, 0},
+  };
+  for (const auto &scalar : scalars) {
+    MIBEntry entry(OIDUtils::string_to_oid(std::string("1.3.6.1.2.1.11.") +
+                                           scalar.arc + ".0"),
+                   scalar.name, scalar.type);
+    MIBValue value = integer_value(scalar.type, scalar.value);
+    entry.getter = [value]() { return value; };
+    register_scalar(entry);
+  }
+}
+
+MIBManager::Cursor::Cursor(const MIBManager &mib)
+    : version_(&mib.current()), slot_(OIDTrie::npos), row_(0),
+      valid_(false), position_(0), batch_(1) {}
+
+bool MIBManager::Cursor::seek_after(const std::vector<uint8_t> &oid) {
+  const OIDTrie &index = version_->index;
+  slot_ = index.upper_bound(oid);
+
+  // oid may fall inside the column registered at or before it
+  size_t previous = index.prev(slot_);
+  if (previous != OIDTrie::npos && version_->objects[previous]->table &&
+      OIDUtils::is_prefix(index.oid(previous), oid)) {
+    size_t position = index.oid(previous).size();
+    if (version_->objects[previous]->indexed) {
+      // Rows after the index oid names, however malformed
+      MIBIndex after;
+      while (position < oid.size()) {
+        after.push_back(static_cast<uint32_t>(
+            std::min<uint64_t>(read_arc(oid, position), UINT32_MAX)));
+      }
+      slot_ = previous;
+      fetch_rows(&after);
+      if (skip_absent()) {
+        return valid_ = true;
+      }
+      slot_ = index.next(previous);
+      return settle();
+    }
+    uint64_t row = position < oid.size() ? read_arc(oid, position) : 0;
+    if (row < version_->objects[previous]->rows) {
+      slot_ = previous;
+      set_row(static_cast<uint32_t>(row) + 1);
+      return valid_ = true;
+    }
+  }
+  return settle();
+}
+
+bool MIBManager::Cursor::next() {
+  if (!valid_) {
+    return false;
+  }
+  const Object &object = *version_->objects[slot_];
+  if (object.indexed) {
+    ++position_;
+    if (skip_absent()) {
+      return true;
+    }
+  } else if (object.table && row_ < object.rows) {
+    set_row(row_ + 1);
+    return true;
+  }
+  slot_ = version_->index.next(slot_);
+  return settle();
+}
+
+bool MIBManager::Cursor::get_value(MIBValue &value) const {
+  if (!valid_) {
+    return false;
+  }
+  const Object &object = *version_->objects[slot_];
+  if (object.indexed) {
+    // Already read with the batch
+    value = cell();
+    return true;
+  }
+  return read_object(object, row_, MIBIndex(), value);
+}
+
+bool MIBManager::Cursor::read(MIBValue &value) {
+  for (; valid_; next()) {
+    if (get_value(value)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const std::string &MIBManager::Cursor::name() const {
+  const Object &object = *version_->objects[slot_];
+  return object.table ? object.column.name : object.scalar.name;
+}
+
+SNMPDataType MIBManager::Cursor::type() const {
+  const Object &object = *version_->objects[slot_];
+  return object.table ? object.column.type : object.scalar.type;
+}
+
+MIBManager::Handle MIBManager::Cursor::handle() const {
+  Handle handle;
+  if (valid_) {
+    handle.object_ = version_->objects[slot_].get();
+    handle.row_ = row_;
+    if (handle.object_->indexed) {
+      handle.index_ = rows_[position_].index;
+    }
+  }
+  return handle;
+}
+
+MIBManager::Cursor::Position MIBManager::Cursor::save() const {
+  Position position;
+  if (valid_) {
+    position.oid = oid_;
+    position.generation = version_->generation;
+    position.slot = slot_;
+    position.row = row_;
+  }
+  return position;
+}
+
+bool MIBManager::Cursor::resume(const Position &position) {
+  if (position.slot == OIDTrie::npos) {
+    oid_.clear();
+    return valid_ = false;
+  }
+  if (position.generation == version_->generation &&
+      !version_->objects[position.slot]->indexed) {
+    slot_ = position.slot;
+    row_ = position.row;
+    oid_ = position.oid;
+    return valid_ = true;
+  }
+
+  // Registrations changed since, or the rows are the provider's: find
+  // the instance again by name
+  uint32_t row = 0;
+  MIBIndex index;
+  size_t slot = find_instance(*version_, position.oid, row, index);
+  if (slot == OIDTrie::npos) {
+    return seek_after(position.oid);
+  }
+  const Object &object = *version_->objects[slot];
+  if (object.indexed) {
+    slot_ = slot;
+    rows_.resize(1);
+    position_ = 0;
+    if (get_row(object, index, rows_.front()) &&
+        skip_absent()) {
+      return valid_ = true;
+    }
+    return seek_after(position.oid);
+  }
+  slot_ = slot;
+  row_ = row;
+  oid_ = position.oid;
+  return valid_ = true;
+}
+
+bool MIBManager::Cursor::settle() {
+  // Empty tables have no instances to stop on
+  while (slot_ != OIDTrie::npos) {
+    const Object &object = *version_->objects[slot_];
+    if (object.indexed) {
+      fetch_rows(nullptr);
+      if (skip_absent()) {
+        return valid_ = true;
+      }
+    } else if (!object.table) {
+      row_ = 0;
+      oid_ = version_->index.oid(slot_);
+      return valid_ = true;
+    } else if (object.rows > 0) {
+      set_row(1);
+      return valid_ = true;
+    }
+    slot_ = version_->index.next(slot_);
+  }
+  oid_.clear();
+  return valid_ = false;
+}
+
+void MIBManager::Cursor::set_row(uint32_t row) {
+  row_ = row;
+  const std::vector<uint8_t> &column = version_->index.oid(slot_);
+  oid_.assign(column.begin(), column.end());
+  append_arc(oid_, row);
+}
+
+void MIBManager::Cursor::fetch_rows(const MIBIndex *after) {
+  // One row is all a GETNEXT needs; a walk asks for more each time
+  row_ = 0;
+  position_ = 0;
+  get_rows(*version_->objects[slot_], after, batch_, rows_);
+  batch_ = std::min(batch_ * 4, MAX_ROW_BATCH);
+}
+
+bool MIBManager::Cursor::skip_absent() {
+  size_t column = version_->objects[slot_]->column_index;
+  while (!rows_.empty()) {
+    for (; position_ < rows_.size(); ++position_) {
+      const std::vector<MIBValue> &values = rows_[position_].values;
+      if (column < values.size() &&
+          values[column].type != SNMPDataType::NULL_TYPE) {
+        const std::vector<uint8_t> &prefix = version_->index.oid(slot_);
+        oid_.assign(prefix.begin(), prefix.end());
+        for (uint32_t arc : rows_[position_].index) {
+          append_arc(oid_, arc);
+        }
+        return true;
+      }
+    }
+    MIBIndex last = rows_.back().index;
+    fetch_rows(&last);
+  }
+  return false;
+}
+
+const MIBValue &MIBManager::Cursor::cell() const {
+  return rows_[position_].values[version_->objects[slot_]->column_index];
+}
+
+std::vector<uint8_t> OIDUtils::string_to_oid(const std::string &oid_str) {
+  std::vector<uint64_t> arcs;
+  size_t position = oid_str.empty() || oid_str[0] != '.' ? 0 : 1;
+  while (position < oid_str.size()) {
+    size_t dot = oid_str.find('.', position);
+    if (dot == std::string::npos) {
+      dot = oid_str.size();
+    }
+    if (dot == position) {
+      return {};
+    }
+    uint64_t arc = 0;
+    for (size_t i = position; i < dot; ++i) {
+      if (oid_str[i] < '0' || oid_str[i] > '9' || arc > 0xFFFFFFFFu) {
+        return {};
+      }
+      arc = arc * 10 + static_cast<uint64_t>(oid_str[i] - '0');
+    }
+    if (arc > 0xFFFFFFFFu) {
+      return {};
+    }
+    arcs.push_back(arc);
+    position = dot + 1;
+  }
+
+  // The first two arcs share one sub-identifier (X.690 8.19.4)
+  if (arcs.size() < 2 || arcs[0] > 2 || (arcs[0] < 2 && arcs[1] > 39)) {
+    return {};
+  }
+  std::vector<uint8_t> oid;
+  append_arc(oid, arcs[0] * 40 + arcs[1]);
+  for (size_t i = 2; i < arcs.size(); ++i) {
+    append_arc(oid, arcs[i]);
+  }
+  return oid;
+}
+
+std::string OIDUtils::oid_to_string(const std::vector<uint8_t> &oid) {
+  if (oid.empty()) {
+    return "";
+  }
+
+  std::vector<uint32_t> arcs;
+  if (decode_arcs(oid, arcs)) {
+    uint32_t top = std::min<uint32_t>(arcs[0] / 40, 2);
+    std::string result =
+        std::to_string(top) + "." + std::to_string(arcs[0] - top * 40);
+    for (size_t i = 1; i < arcs.size(); ++i) {
+      result += "." + std::to_string(arcs[i]);
+    }
+    return result;
+  }
+
+  // Malformed: print what decodes
+  size_t position = 0;
+  uint64_t first = read_arc(oid, position);
+  uint64_t top = std::min<uint64_t>(first / 40, 2);
+  std::string result =
+      std::to_string(top) + "." + std::to_string(first - top * 40);
+  while (position < oid.size()) {
+    result += "." + std::to_string(read_arc(oid, position));
+  }
+  return result;
+}
+
+bool OIDUtils::is_prefix(const std::vector<uint8_t> &oid1,
+                         const std::vector<uint8_t> &oid2) {
+  // Encoded arcs end on a byte with the high bit clear, so a byte prefix
+  // of a well-formed OID is also an arc prefix
+  return oid1.size() <= oid2.size() &&
+         OIDKernels::active().mismatch(oid1.data(), oid2.data(),
+                                       oid1.size()) == oid1.size();
+}
+
+std::vector<uint8_t> OIDUtils::get_next_oid(const std::vector<uint8_t> &oid) {
+  // oid.0 is the smallest OID after oid
+  std::vector<uint8_t> next = oid;
+  next.push_back(0x00);
+  return next;
+}
+
+int OIDUtils::compare_oids(const std::vector<uint8_t> &oid1,
+                           const std::vector<uint8_t> &oid2) {
+  // Equal leading bytes hold equal leading arcs, and the arc boundaries
+  // among them are the same in both. Decoding starts at the arc holding
+  // the first differing byte.
+  size_t common = OIDKernels::active().mismatch(
+      oid1.data(), oid2.data(), std::min(oid1.size(), oid2.size()));
+  while (common > 0 && (oid1[common - 1] & 0x80) != 0) {
+    --common;
+  }
+
+  size_t position1 = common;
+  size_t position2 = common;
+  while (position1 < oid1.size() && position2 < oid2.size()) {
+    uint64_t arc1 = read_arc(oid1, position1);
+    uint64_t arc2 = read_arc(oid2, position2);
+    if (arc1 != arc2) {
+      return arc1 < arc2 ? -1 : 1;
+    }
+  }
+  if (position1 < oid1.size()) {
+    return 1;
+  }
+  return position2 < oid2.size() ? -1 : 0;
+}
+
+bool OIDUtils::decode_arcs(const std::vector<uint8_t> &oid,
+                           std::vector<uint32_t> &arcs) {
+  arcs.resize(oid.size());
+  size_t count = 0;
+  bool ok = OIDKernels::active().decode(oid.data(), oid.size(), arcs.data(),
+                                        count);
+  arcs.resize(ok ? count : 0);
+  return ok;
+}
+
+int OIDUtils::compare_arcs(const std::vector<uint32_t> &arcs1,
+                           const std::vector<uint32_t> &arcs2) {
+  size_t common = std::min(arcs1.size(), arcs2.size());
+  size_t index =
+      OIDKernels::active().mismatch_arcs(arcs1.data(), arcs2.data(), common);
+  if (index < common) {
+    return arcs1[index] < arcs2[index] ? -1 : 1;
+  }
+  if (arcs1.size() != arcs2.size()) {
+    return arcs1.size() < arcs2.size() ? -1 : 1;
+  }
+  return 0;
+}
+
+bool OIDUtils::is_arc_prefix(const std::vector<uint32_t> &arcs1,
+                             const std::vector<uint32_t> &arcs2) {
+  return arcs1.size() <= arcs2.size() &&
+         OIDKernels::active().mismatch_arcs(arcs1.data(), arcs2.data(),
+                                            arcs1.size()) == arcs1.size();
+}
+
+} // namespace simple_snmpd
@@ -17,415 +17,480 @@
  */
 
 #include "simple_snmpd/snmp_packet.hpp"
-#include "simple_snmpd/logger.hpp"
+#include "simple_snmpd/ber_encoder.hpp"
 #include <algorithm>
 #include <cstring>
 
 namespace simple_snmpd {
 
-SNMPPacket::SNMPPacket()
-    : version_(SNMP_VERSION_2C), pdu_type_(SNMP_PDU_GET_REQUEST),
-      request_id_(0), error_status_(0), error_index_(0) {}
+namespace {
 
-SNMPPacket::~SNMPPacket() {}
+// Keeps the first failure met while decoding one message, with its
+// offset from the start of the message
+class Reader {
+public:
+  explicit Reader(const uint8_t *base) : base_(base) {}
 
-bool SNMPPacket::parse(const uint8_t *data, size_t length) {
-  if (!data || length == 0) {
+  bool fail(ParseError error, const uint8_t *at) {
+    if (result_) {
+      result_ = ParseResult(error, static_cast<size_t>(at - base_));
+    }
     return false;
   }
 
-  size_t offset = 0;
+  const ParseResult &result() const { return result_; }
 
-  // Parse ASN.1 sequence header
-  if (offset >= length || data[offset] != 0x30) { // SEQUENCE
-    Logger::get_instance().log(LogLevel::ERROR,
-                               "Invalid SNMP packet: missing sequence header");
-    return false;
-  }
-  offset++;
+private:
+  const uint8_t *base_;
+  ParseResult result_;
+};
 
-  // Parse length
-  size_t packet_length = 0;
-  if (!parse_length(data, length, offset, packet_length)) {
-    Logger::get_instance().log(LogLevel::ERROR,
-                               "Invalid SNMP packet: invalid length");
-    return false;
+// Read one TLV at position, leaving position after it. Only the definite
+// length forms SNMP uses are accepted, with at most four length bytes.
+bool read_tlv(Reader &reader, const uint8_t *&position, const uint8_t *end,
+              uint8_t &tag, ByteSpan &contents) {
+  const uint8_t *start = position;
+  if (end - position < 2) {
+    return reader.fail(ParseError::TRUNCATED, start);
   }
+  tag = *position++;
 
-  if (packet_length != length - offset) {
-    Logger::get_instance().log(LogLevel::ERROR,
-                               "Invalid SNMP packet: length mismatch");
-    return false;
+  size_t length = *position++;
+  if (length & 0x80) {
+    size_t count = length & 0x7F;
+    if (count == 0 || count > 4) {
+      return reader.fail(ParseError::BAD_LENGTH, start + 1);
+    }
+    if (static_cast<size_t>(end - position) < count) {
+      return reader.fail(ParseError::TRUNCATED, start + 1);
+    }
+    length = 0;
+    for (size_t i = 0; i < count; ++i) {
+      length = (length << 8) | *position++;
+    }
   }
 
-  // Parse version
-  if (offset >= length || data[offset] != 0x02) { // INTEGER
-    Logger::get_instance().log(LogLevel::ERROR,
-                               "Invalid SNMP packet: missing version");
-    return false;
+  if (static_cast<size_t>(end - position) < length) {
+    return reader.fail(ParseError::TRUNCATED, start);
   }
-  offset++;
+  contents = ByteSpan(position, length);
+  position += length;
+  return true;
+}
 
-  size_t version_length = 0;
-  if (!parse_length(data, length, offset, version_length)) {
+bool read_expected(Reader &reader, const uint8_t *&position,
+                   const uint8_t *end, uint8_t expected_tag,
+                   ByteSpan &contents) {
+  const uint8_t *start = position;
+  uint8_t tag = 0;
+  if (!read_tlv(reader, position, end, tag, contents)) {
     return false;
   }
+  return tag == expected_tag || reader.fail(ParseError::UNEXPECTED_TAG, start);
+}
 
-  if (offset + version_length > length) {
+// Sign-extended INTEGER of at most 32 bits
+bool read_signed_integer(Reader &reader, const uint8_t *&position,
+                         const uint8_t *end, int32_t &value) {
+  const uint8_t *start = position;
+  ByteSpan contents;
+  if (!read_expected(reader, position, end, 0x02, contents)) {
     return false;
   }
-
-  if (version_length == 1) {
-    version_ = data[offset];
-  } else {
-    Logger::get_instance().log(LogLevel::ERROR,
-                               "Invalid SNMP packet: invalid version length");
-    return false;
+  if (contents.empty() || contents.length > 4) {
+    return reader.fail(ParseError::BAD_INTEGER, start);
   }
-  offset += version_length;
-
-  // Parse community string
-  if (offset >= length || data[offset] != 0x04) { // OCTET STRING
-    Logger::get_instance().log(LogLevel::ERROR,
-                               "Invalid SNMP packet: missing community");
-    return false;
+  uint32_t bits = (contents.data[0] & 0x80) ? 0xFFFFFFFFu : 0;
+  for (uint8_t byte : contents) {
+    bits = (bits << 8) | byte;
   }
-  offset++;
+  value = static_cast<int32_t>(bits);
+  return true;
+}
 
-  size_t community_length = 0;
-  if (!parse_length(data, length, offset, community_length)) {
+// Decode a VarBind SEQUENCE { OBJECT IDENTIFIER, value }
+bool read_variable_binding(Reader &reader, const uint8_t *&position,
+                           const uint8_t *end,
+                           SNMPPacketView::VariableBinding &varbind) {
+  ByteSpan sequence;
+  if (!read_expected(reader, position, end, 0x30, sequence)) {
     return false;
   }
-
-  if (offset + community_length > length) {
+  const uint8_t *inner = sequence.begin();
+  if (!read_expected(reader, inner, sequence.end(), 0x06, varbind.oid) ||
+      !read_tlv(reader, inner, sequence.end(), varbind.value_type,
+                varbind.value)) {
     return false;
   }
+  return inner == sequence.end() ||
+         reader.fail(ParseError::TRAILING_DATA, inner);
+}
 
-  community_.assign(reinterpret_cast<const char *>(data + offset),
-                    community_length);
-  offset += community_length;
+} // namespace
+
+const char *parse_error_name(ParseError error) {
+  switch (error) {
+  case ParseError::NONE:
+    return "none";
+  case ParseError::EMPTY:
+    return "empty";
+  case ParseError::TRUNCATED:
+    return "truncated";
+  case ParseError::BAD_LENGTH:
+    return "bad_length";
+  case ParseError::UNEXPECTED_TAG:
+    return "unexpected_tag";
+  case ParseError::BAD_VERSION:
+    return "bad_version";
+  case ParseError::BAD_INTEGER:
+    return "bad_integer";
+  case ParseError::TRAILING_DATA:
+    return "trailing_data";
+  }
+  return "unknown";
+}
 
-  // Parse PDU
-  if (offset >= length) {
-    Logger::get_instance().log(LogLevel::ERROR,
-                               "Invalid SNMP packet: missing PDU");
-    return false;
-  }
+bool ByteSpan::operator==(const ByteSpan &other) const {
+  return length == other.length &&
+         (length == 0 || std::memcmp(data, other.data, length) == 0);
+}
 
-  pdu_type_ = data[offset];
-  offset++;
+std::vector<uint8_t> ByteSpan::to_vector() const {
+  return std::vector<uint8_t>(begin(), end());
+}
 
-  size_t pdu_length = 0;
-  if (!parse_length(data, length, offset, pdu_length)) {
-    return false;
-  }
+std::string ByteSpan::to_string() const {
+  return std::string(reinterpret_cast<const char *>(data), length);
+}
 
-  if (offset + pdu_length > length) {
-    return false;
+SNMPPacketView::Iterator::Iterator(const uint8_t *position,
+                                   const uint8_t *end)
+    : position_(position), next_(position), end_(end) {
+  if (position_ != end_) {
+    // The bindings were validated by parse(), decoding cannot fail
+    Reader reader(position_);
+    read_variable_binding(reader, next_, end_, current_);
   }
+}
 
-  // Parse PDU fields based on type
-  if (!parse_pdu_fields(data, offset, pdu_length)) {
-    return false;
+SNMPPacketView::Iterator &SNMPPacketView::Iterator::operator++() {
+  position_ = next_;
+  if (position_ != end_) {
+    Reader reader(position_);
+    read_variable_binding(reader, next_, end_, current_);
   }
-
-  return true;
+  return *this;
 }
 
-bool SNMPPacket::serialize(std::vector<uint8_t> &buffer) const {
-  buffer.clear();
-
-  // Start with sequence header
-  buffer.push_back(0x30); // SEQUENCE
-
-  // Calculate total length (will be filled later)
-  size_t length_pos = buffer.size();
-  buffer.push_back(0x00); // Placeholder for length
-
-  // Version
-  buffer.push_back(0x02); // INTEGER
-  buffer.push_back(0x01); // Length
-  buffer.push_back(static_cast<uint8_t>(version_));
-
-  // Community string
-  buffer.push_back(0x04); // OCTET STRING
-  buffer.push_back(static_cast<uint8_t>(community_.length()));
-  buffer.insert(buffer.end(), community_.begin(), community_.end());
-
-  // PDU type
-  buffer.push_back(static_cast<uint8_t>(pdu_type_));
+SNMPPacketView::SNMPPacketView()
+    : version_(0), pdu_type_(0), request_id_(0), error_status_(0),
+      error_index_(0), varbind_count_(0) {}
 
-  // PDU length (will be filled later)
-  size_t pdu_length_pos = buffer.size();
-  buffer.push_back(0x00); // Placeholder for PDU length
-
-  // Serialize PDU fields
-  if (!serialize_pdu_fields(buffer)) {
-    return false;
+ParseResult peek_message_version(const uint8_t *data, size_t length,
+                                 uint8_t &version) {
+  if (!data || length == 0) {
+    return ParseResult(ParseError::EMPTY, 0);
   }
 
-  // Fill in PDU length
-  size_t pdu_length = buffer.size() - pdu_length_pos - 1;
-  buffer[pdu_length_pos] = static_cast<uint8_t>(pdu_length);
-
-  // Fill in total length
-  size_t total_length = buffer.size() - length_pos - 1;
-  buffer[length_pos] = static_cast<uint8_t>(total_length);
-
-  return true;
-}
-
-bool SNMPPacket::parse_length(const uint8_t *data, size_t length,
-                              size_t &offset, size_t &len) {
-  if (offset >= length) {
-    return false;
+  Reader reader(data);
+  const uint8_t *position = data;
+  const uint8_t *end = data + length;
+  ByteSpan message;
+  ByteSpan contents;
+  if (!read_expected(reader, position, end, 0x30, message)) {
+    return reader.result();
   }
-
-  uint8_t first_byte = data[offset++];
-
-  if ((first_byte & 0x80) == 0) {
-    // Short form
-    len = first_byte;
-  } else {
-    // Long form
-    size_t length_bytes = first_byte & 0x7F;
-    if (length_bytes == 0 || length_bytes > 4) {
-      return false;
-    }
-
-    len = 0;
-    for (size_t i = 0; i < length_bytes; i++) {
-      if (offset >= length) {
-        return false;
-      }
-      len = (len << 8) | data[offset++];
-    }
+  if (position != end) {
+    reader.fail(ParseError::TRAILING_DATA, position);
+    return reader.result();
   }
-
-  return true;
-}
-
-bool SNMPPacket::parse_pdu_fields(const uint8_t *data, size_t &offset,
-                                  size_t length) {
-  size_t start_offset = offset;
-
-  // Request ID
-  if (offset >= start_offset + length || data[offset] != 0x02) { // INTEGER
-    return false;
+  position = message.begin();
+  if (!read_expected(reader, position, message.end(), 0x02, contents)) {
+    return reader.result();
   }
-  offset++;
-
-  size_t request_id_length = 0;
-  if (!parse_length(data, start_offset + length, offset, request_id_length)) {
-    return false;
+  if (contents.length != 1) {
+    reader.fail(ParseError::BAD_VERSION, contents.begin());
+    return reader.result();
   }
+  version = contents.data[0];
+  return reader.result();
+}
 
-  if (offset + request_id_length > start_offset + length) {
-    return false;
+ParseResult SNMPPacketView::parse(const uint8_t *data, size_t length) {
+  reset();
+  if (!data || length == 0) {
+    return ParseResult(ParseError::EMPTY, 0);
   }
 
-  request_id_ = 0;
-  for (size_t i = 0; i < request_id_length; i++) {
-    request_id_ = (request_id_ << 8) | data[offset++];
+  // The message SEQUENCE must span the whole buffer
+  Reader reader(data);
+  const uint8_t *position = data;
+  const uint8_t *end = data + length;
+  ByteSpan message;
+  if (!read_expected(reader, position, end, 0x30, message)) {
+    return reader.result();
   }
-
-  // Error status
-  if (offset >= start_offset + length || data[offset] != 0x02) { // INTEGER
-    return false;
+  if (position != end) {
+    reader.fail(ParseError::TRAILING_DATA, position);
+    return reader.result();
   }
-  offset++;
 
-  size_t error_status_length = 0;
-  if (!parse_length(data, start_offset + length, offset, error_status_length)) {
-    return false;
+  position = message.begin();
+  end = message.end();
+  ByteSpan version;
+  if (!read_expected(reader, position, end, 0x02, version)) {
+    return reader.result();
   }
-
-  if (offset + error_status_length > start_offset + length) {
-    return false;
+  if (version.length != 1) {
+    reader.fail(ParseError::BAD_VERSION, version.begin());
+    return reader.result();
   }
+  version_ = version.data[0];
 
-  error_status_ = 0;
-  for (size_t i = 0; i < error_status_length; i++) {
-    error_status_ = (error_status_ << 8) | data[offset++];
+  if (!read_expected(reader, position, end, 0x04, community_)) {
+    return reader.result();
   }
+  return parse_pdu(data, position, end);
+}
 
-  // Error index
-  if (offset >= start_offset + length || data[offset] != 0x02) { // INTEGER
-    return false;
+ParseResult SNMPPacketView::parse_v3(const uint8_t *data, size_t length) {
+  reset();
+  if (!data || length == 0) {
+    return ParseResult(ParseError::EMPTY, 0);
   }
-  offset++;
 
-  size_t error_index_length = 0;
-  if (!parse_length(data, start_offset + length, offset, error_index_length)) {
-    return false;
+  Reader reader(data);
+  const uint8_t *position = data;
+  const uint8_t *end = data + length;
+  ByteSpan message;
+  if (!read_expected(reader, position, end, 0x30, message)) {
+    return reader.result();
   }
-
-  if (offset + error_index_length > start_offset + length) {
-    return false;
+  if (position != end) {
+    reader.fail(ParseError::TRAILING_DATA, position);
+    return reader.result();
   }
 
-  error_index_ = 0;
-  for (size_t i = 0; i < error_index_length; i++) {
-    error_index_ = (error_index_ << 8) | data[offset++];
+  // msgVersion, msgGlobalData, msgSecurityParameters, then msgData
+  position = message.begin();
+  end = message.end();
+  ByteSpan version;
+  ByteSpan skipped;
+  if (!read_expected(reader, position, end, 0x02, version)) {
+    return reader.result();
   }
-
-  // Variable bindings
-  if (offset >= start_offset + length || data[offset] != 0x30) { // SEQUENCE
-    return false;
+  if (version.length != 1) {
+    reader.fail(ParseError::BAD_VERSION, version.begin());
+    return reader.result();
   }
-  offset++;
-
-  size_t varbinds_length = 0;
-  if (!parse_length(data, start_offset + length, offset, varbinds_length)) {
-    return false;
+  version_ = version.data[0];
+  if (!read_expected(reader, position, end, 0x30, skipped) ||
+      !read_expected(reader, position, end, 0x04, skipped)) {
+    return reader.result();
   }
+  return parse_scoped(data, position, end);
+}
 
-  if (offset + varbinds_length > start_offset + length) {
-    return false;
+ParseResult SNMPPacketView::parse_scoped_pdu(const uint8_t *data,
+                                             size_t length) {
+  reset();
+  if (!data || length == 0) {
+    return ParseResult(ParseError::EMPTY, 0);
   }
+  version_ = SNMP_VERSION_3;
+  return parse_scoped(data, data, data + length);
+}
 
-  return parse_variable_bindings(data, offset, varbinds_length);
+void SNMPPacketView::reset() {
+  community_ = ByteSpan();
+  context_engine_id_ = ByteSpan();
+  context_name_ = ByteSpan();
+  varbinds_ = ByteSpan();
+  varbind_count_ = 0;
 }
 
-bool SNMPPacket::parse_variable_bindings(const uint8_t *data, size_t &offset,
-                                         size_t length) {
-  size_t start_offset = offset;
-  variable_bindings_.clear();
+// ScopedPDU ::= SEQUENCE { contextEngineID, contextName, data }, which
+// must be the last thing before end
+ParseResult SNMPPacketView::parse_scoped(const uint8_t *base,
+                                         const uint8_t *position,
+                                         const uint8_t *end) {
+  Reader reader(base);
+  ByteSpan scoped;
+  if (!read_expected(reader, position, end, 0x30, scoped)) {
+    return reader.result();
+  }
+  if (position != end) {
+    reader.fail(ParseError::TRAILING_DATA, position);
+    return reader.result();
+  }
 
-  while (offset < start_offset + length) {
-    if (offset >= start_offset + length || data[offset] != 0x30) { // SEQUENCE
-      return false;
-    }
-    offset++;
+  position = scoped.begin();
+  if (!read_expected(reader, position, scoped.end(), 0x04,
+                     context_engine_id_) ||
+      !read_expected(reader, position, scoped.end(), 0x04, context_name_)) {
+    return reader.result();
+  }
+  return parse_pdu(base, position, scoped.end());
+}
 
-    size_t varbind_length = 0;
-    if (!parse_length(data, start_offset + length, offset, varbind_length)) {
-      return false;
-    }
+ParseResult SNMPPacketView::parse_pdu(const uint8_t *base,
+                                      const uint8_t *position,
+                                      const uint8_t *end) {
+  Reader reader(base);
+  ByteSpan pdu;
+  if (!read_tlv(reader, position, end, pdu_type_, pdu)) {
+    return reader.result();
+  }
 
-    if (offset + varbind_length > start_offset + length) {
-      return false;
-    }
+  position = pdu.begin();
+  end = pdu.end();
+  if (!read_signed_integer(reader, position, end, request_id_) ||
+      !read_signed_integer(reader, position, end, error_status_) ||
+      !read_signed_integer(reader, position, end, error_index_) ||
+      !read_expected(reader, position, end, 0x30, varbinds_)) {
+    varbinds_ = ByteSpan();
+    return reader.result();
+  }
 
+  // Validate every binding now so iteration never meets a bad one
+  position = varbinds_.begin();
+  while (position != varbinds_.end()) {
     VariableBinding varbind;
-    if (!parse_variable_binding(data, offset, varbind_length, varbind)) {
-      return false;
+    if (!read_variable_binding(reader, position, varbinds_.end(), varbind)) {
+      varbinds_ = ByteSpan();
+      varbind_count_ = 0;
+      return reader.result();
     }
-
-    variable_bindings_.push_back(varbind);
+    varbind_count_++;
   }
+  return reader.result();
+}
 
-  return true;
+uint32_t SNMPPacketView::get_non_repeaters() const {
+  return error_status_ > 0 ? static_cast<uint32_t>(error_status_) : 0;
 }
 
-bool SNMPPacket::parse_variable_binding(const uint8_t *data, size_t &offset,
-                                        size_t length,
-                                        VariableBinding &varbind) {
-  size_t start_offset = offset;
+uint32_t SNMPPacketView::get_max_repetitions() const {
+  return error_index_ > 0 ? static_cast<uint32_t>(error_index_) : 0;
+}
 
-  // OID
-  if (offset >= start_offset + length ||
-      data[offset] != 0x06) { // OBJECT IDENTIFIER
-    return false;
-  }
-  offset++;
+SNMPPacketView::Iterator SNMPPacketView::begin() const {
+  return Iterator(varbinds_.begin(), varbinds_.end());
+}
 
-  size_t oid_length = 0;
-  if (!parse_length(data, start_offset + length, offset, oid_length)) {
-    return false;
-  }
+SNMPPacketView::Iterator SNMPPacketView::end() const {
+  return Iterator(varbinds_.end(), varbinds_.end());
+}
 
-  if (offset + oid_length > start_offset + length) {
-    return false;
-  }
+SNMPPacket::SNMPPacket()
+    : version_(SNMP_VERSION_2C), pdu_type_(SNMP_PDU_GET_REQUEST),
+      request_id_(0), error_status_(0), error_index_(0), non_repeaters_(0),
+      max_repetitions_(0), variable_bindings_size_(0) {}
 
-  varbind.oid.assign(data + offset, data + offset + oid_length);
-  offset += oid_length;
+SNMPPacket::~SNMPPacket() {}
 
-  // Value
-  if (offset >= start_offset + length) {
-    return false;
+ParseResult SNMPPacket::parse(const uint8_t *data, size_t length) {
+  SNMPPacketView view;
+  ParseResult result = view.parse(data, length);
+  if (result) {
+    assign(view);
   }
+  return result;
+}
 
-  uint8_t value_type = data[offset++];
-  size_t value_length = 0;
-  if (!parse_length(data, start_offset + length, offset, value_length)) {
-    return false;
+void SNMPPacket::assign(const SNMPPacketView &view) {
+  version_ = view.get_version();
+  pdu_type_ = view.get_pdu_type();
+  community_.assign(reinterpret_cast<const char *>(view.get_community().data),
+                    view.get_community().length);
+  request_id_ = view.get_request_id();
+  error_status_ = view.get_error_status();
+  error_index_ = view.get_error_index();
+  non_repeaters_ = view.get_non_repeaters();
+  max_repetitions_ = view.get_max_repetitions();
+
+  variable_bindings_.clear();
+  variable_bindings_.reserve(view.get_variable_binding_count());
+  variable_bindings_size_ = 0;
+  for (const auto &binding : view) {
+    VariableBinding varbind;
+    varbind.oid.assign(binding.oid.begin(), binding.oid.end());
+    varbind.value_type = binding.value_type;
+    varbind.value.assign(binding.value.begin(), binding.value.end());
+    variable_bindings_size_ += encoded_size(varbind);
+    variable_bindings_.push_back(std::move(varbind));
   }
+}
 
-  if (offset + value_length > start_offset + length) {
+bool SNMPPacket::serialize(std::vector<uint8_t> &buffer) const {
+  // The size is exact, so the encoding fills the buffer completely
+  buffer.resize(encoded_size());
+  BerEncoder encoder(buffer.data(), buffer.size());
+  if (!serialize(encoder) || encoder.size() != buffer.size()) {
+    buffer.clear();
     return false;
   }
-
-  varbind.value_type = value_type;
-  varbind.value.assign(data + offset, data + offset + value_length);
-  offset += value_length;
-
   return true;
 }
 
-bool SNMPPacket::serialize_pdu_fields(std::vector<uint8_t> &buffer) const {
-  // Request ID
-  buffer.push_back(0x02); // INTEGER
-  buffer.push_back(0x04); // Length (4 bytes)
-  buffer.push_back((request_id_ >> 24) & 0xFF);
-  buffer.push_back((request_id_ >> 16) & 0xFF);
-  buffer.push_back((request_id_ >> 8) & 0xFF);
-  buffer.push_back(request_id_ & 0xFF);
-
-  // Error status
-  buffer.push_back(0x02); // INTEGER
-  buffer.push_back(0x01); // Length (1 byte)
-  buffer.push_back(static_cast<uint8_t>(error_status_));
-
-  // Error index
-  buffer.push_back(0x02); // INTEGER
-  buffer.push_back(0x01); // Length (1 byte)
-  buffer.push_back(static_cast<uint8_t>(error_index_));
+bool SNMPPacket::serialize(BerEncoder &encoder) const {
+  size_t message_mark = encoder.size();
+  serialize_pdu(encoder);
+  encoder.write_tlv(0x04,
+                    reinterpret_cast<const uint8_t *>(community_.data()),
+                    community_.size()); // OCTET STRING
+  encoder.write_integer(0x02, version_);
+  encoder.wrap(0x30, message_mark); // SEQUENCE
 
-  // Variable bindings
-  buffer.push_back(0x30); // SEQUENCE
+  return encoder.ok();
+}
 
-  // Calculate varbinds length
-  size_t varbinds_length_pos = buffer.size();
-  buffer.push_back(0x00); // Placeholder for varbinds length
+bool SNMPPacket::serialize_pdu(BerEncoder &encoder) const {
+  size_t pdu_mark = encoder.size();
 
-  if (!serialize_variable_bindings(buffer)) {
-    return false;
+  // Variable bindings, last one first
+  size_t varbinds_mark = encoder.size();
+  for (auto it = variable_bindings_.rbegin(); it != variable_bindings_.rend();
+       ++it) {
+    size_t varbind_mark = encoder.size();
+    encoder.write_tlv(it->value_type, it->value.data(), it->value.size());
+    encoder.write_tlv(0x06, it->oid.data(), it->oid.size()); // OID
+    encoder.wrap(0x30, varbind_mark);                         // SEQUENCE
   }
+  encoder.wrap(0x30, varbinds_mark); // SEQUENCE
 
-  // Fill in varbinds length
-  size_t varbinds_length = buffer.size() - varbinds_length_pos - 1;
-  buffer[varbinds_length_pos] = static_cast<uint8_t>(varbinds_length);
+  // PDU: request-id, error-status, error-index, variable-bindings
+  bool bulk = pdu_type_ == SNMP_PDU_GET_BULK_REQUEST;
+  encoder.write_integer(0x02, bulk ? max_repetitions_ : error_index_);
+  encoder.write_integer(0x02, bulk ? non_repeaters_ : error_status_);
+  encoder.write_integer(0x02, request_id_);
+  encoder.wrap(pdu_type_, pdu_mark);
 
-  return true;
+  return encoder.ok();
 }
 
-bool SNMPPacket::serialize_variable_bindings(
-    std::vector<uint8_t> &buffer) const {
-  for (const auto &varbind : variable_bindings_) {
-    buffer.push_back(0x30); // SEQUENCE
-
-    // Calculate varbind length
-    size_t varbind_length_pos = buffer.size();
-    buffer.push_back(0x00); // Placeholder for varbind length
-
-    // OID
-    buffer.push_back(0x06); // OBJECT IDENTIFIER
-    buffer.push_back(static_cast<uint8_t>(varbind.oid.size()));
-    buffer.insert(buffer.end(), varbind.oid.begin(), varbind.oid.end());
-
-    // Value
-    buffer.push_back(varbind.value_type);
-    buffer.push_back(static_cast<uint8_t>(varbind.value.size()));
-    buffer.insert(buffer.end(), varbind.value.begin(), varbind.value.end());
+size_t SNMPPacket::encoded_size() const {
+  return encoded_size_with(variable_bindings_size_);
+}
 
-    // Fill in varbind length
-    size_t varbind_length = buffer.size() - varbind_length_pos - 1;
-    buffer[varbind_length_pos] = static_cast<uint8_t>(varbind_length);
-  }
+size_t SNMPPacket::encoded_size_with(size_t variable_bindings_size) const {
+  bool bulk = pdu_type_ == SNMP_PDU_GET_BULK_REQUEST;
+  size_t pdu =
+      BerEncoder::tlv_size(BerEncoder::integer_length(request_id_)) +
+      BerEncoder::tlv_size(BerEncoder::integer_length(
+          bulk ? non_repeaters_ : error_status_)) +
+      BerEncoder::tlv_size(BerEncoder::integer_length(
+          bulk ? max_repetitions_ : error_index_)) +
+      BerEncoder::tlv_size(variable_bindings_size);
+  size_t message = BerEncoder::tlv_size(BerEncoder::integer_length(version_)) +
+                   BerEncoder::tlv_size(community_.size()) +
+                   BerEncoder::tlv_size(pdu);
+  return BerEncoder::tlv_size(message);
+}
 
-  return true;
+size_t SNMPPacket::encoded_size(const VariableBinding &varbind) {
+  return BerEncoder::tlv_size(BerEncoder::tlv_size(varbind.oid.size()) +
+                              BerEncoder::tlv_size(varbind.value.size()));
 }
 
 // Getters and setters
@@ -435,11 +500,15 @@ uint8_t SNMPPacket::get_pdu_type() const { return pdu_type_; }
 
 const std::string &SNMPPacket::get_community() const { return community_; }
 
-uint32_t SNMPPacket::get_request_id() const { return request_id_; }
+int32_t SNMPPacket::get_request_id() const { return request_id_; }
+
+int32_t SNMPPacket::get_error_status() const { return error_status_; }
+
+int32_t SNMPPacket::get_error_index() const { return error_index_; }
 
-uint8_t SNMPPacket::get_error_status() const { return error_status_; }
+uint32_t SNMPPacket::get_non_repeaters() const { return non_repeaters_; }
 
-uint8_t SNMPPacket::get_error_index() const { return error_index_; }
+uint32_t SNMPPacket::get_max_repetitions() const { return max_repetitions_; }
 
 const std::vector<SNMPPacket::VariableBinding> &
 SNMPPacket::get_variable_bindings() const {
@@ -454,22 +523,52 @@ void SNMPPacket::set_community(const std::string &community) {
   community_ = community;
 }
 
-void SNMPPacket::set_request_id(uint32_t request_id) {
+void SNMPPacket::set_request_id(int32_t request_id) {
   request_id_ = request_id;
 }
 
-void SNMPPacket::set_error_status(uint8_t error_status) {
+void SNMPPacket::set_error_status(int32_t error_status) {
   error_status_ = error_status;
 }
 
-void SNMPPacket::set_error_index(uint8_t error_index) {
+void SNMPPacket::set_error_index(int32_t error_index) {
   error_index_ = error_index;
 }
 
+void SNMPPacket::set_non_repeaters(uint32_t non_repeaters) {
+  non_repeaters_ = non_repeaters;
+}
+
+void SNMPPacket::set_max_repetitions(uint32_t max_repetitions) {
+  max_repetitions_ = max_repetitions;
+}
+
 void SNMPPacket::add_variable_binding(const VariableBinding &varbind) {
+  variable_bindings_size_ += encoded_size(varbind);
+  variable_bindings_.push_back(varbind);
+}
+
+bool SNMPPacket::add_variable_binding(const VariableBinding &varbind,
+                                      size_t max_size) {
+  size_t size = encoded_size(varbind);
+  if (encoded_size_with(variable_bindings_size_ + size) > max_size) {
+    return false;
+  }
+  variable_bindings_size_ += size;
   variable_bindings_.push_back(varbind);
+  return true;
 }
 
-void SNMPPacket::clear_variable_bindings() { variable_bindings_.clear(); }
+void SNMPPacket::truncate_variable_bindings(size_t count) {
+  while (variable_bindings_.size() > count) {
+    variable_bindings_size_ -= encoded_size(variable_bindings_.back());
+    variable_bindings_.pop_back();
+  }
+}
+
+void SNMPPacket::clear_variable_bindings() {
+  variable_bindings_.clear();
+  variable_bindings_size_ = 0;
+}
 
 } // namespace simple_snmpd
@@ -0,0 +1,393 @@
+/*
+ * src/core/snmp_security.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/snmp_security.hpp"
+#include "simple_snmpd/logger.hpp"
+#include <algorithm>
+
+namespace simple_snmpd {
+
+namespace {
+
+// Convert a mask given as a prefix length ("24") or in dotted form
+// ("255.255.255.0") to a prefix length
+bool parse_prefix_length(const std::string &mask, uint32_t max_length,
+                         uint32_t &prefix_length) {
+  if (!mask.empty() &&
+      std::all_of(mask.begin(), mask.end(),
+                  [](char c) { return c >= '0' && c <= '9'; })) {
+    if (mask.size() > 3) {
+      return false;
+    }
+    prefix_length = static_cast<uint32_t>(std::stoul(mask));
+    return prefix_length <= max_length;
+  }
+
+  NetworkAddress netmask;
+  if (!NetworkAddress::parse(mask, netmask)) {
+    return false;
+  }
+
+  // Count leading ones and reject non-contiguous masks
+  prefix_length = 0;
+  bool zero_seen = false;
+  for (uint8_t i = 0; i < netmask.length; ++i) {
+    for (int bit = 7; bit >= 0; --bit) {
+      bool one = (netmask.bytes[i] >> bit) & 1;
+      if (one && zero_seen) {
+        return false;
+      }
+      if (one) {
+        ++prefix_length;
+      } else {
+        zero_seen = true;
+      }
+    }
+  }
+  return prefix_length <= max_length;
+}
+
+// True when oid equals prefix or lies below it
+bool oid_has_prefix(const std::string &oid, const std::string &prefix) {
+  if (oid.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  return oid.size() == prefix.size() || oid[prefix.size()] == '.';
+}
+
+} // namespace
+
+SecurityManager::SecurityManager()
+    : default_max_requests_(0), default_window_duration_(60) {}
+
+SecurityManager &SecurityManager::get_instance() {
+  static SecurityManager instance;
+  return instance;
+}
+
+bool SecurityManager::AddressRule::matches(
+    const NetworkAddress &address) const {
+  if (any) {
+    return true;
+  }
+  return valid && address.in_network(network, prefix_length);
+}
+
+SecurityManager::AddressRule
+SecurityManager::parse_address_rule(const std::string &address,
+                                    const std::string &mask) {
+  AddressRule rule;
+  if (address.empty() || address == "*" || address == "any") {
+    rule.any = true;
+    rule.valid = true;
+    return rule;
+  }
+
+  // Accept "network/prefix" as well as a separate mask
+  std::string host = address;
+  std::string prefix = mask;
+  size_t slash = address.find('/');
+  if (slash != std::string::npos) {
+    host = address.substr(0, slash);
+    prefix = address.substr(slash + 1);
+  }
+
+  if (!NetworkAddress::parse(host, rule.network)) {
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "Ignoring invalid address rule: " + address);
+    return rule;
+  }
+
+  uint32_t max_length = rule.network.length * 8u;
+  rule.prefix_length = max_length;
+  if (!prefix.empty() &&
+      !parse_prefix_length(prefix, max_length, rule.prefix_length)) {
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "Ignoring address rule with invalid mask: " +
+                                   address + " " + mask);
+    return rule;
+  }
+
+  rule.valid = true;
+  return rule;
+}
+
+bool SecurityManager::matches_any(const NetworkAddress &address,
+                                  const std::vector<AddressRule> &rules) {
+  for (const auto &rule : rules) {
+    if (rule.matches(address)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Access control
+
+bool SecurityManager::is_access_allowed(const std::string &community,
+                                        const std::string &source_ip) const {
+  NetworkAddress address;
+  if (!NetworkAddress::parse(source_ip, address)) {
+    return false;
+  }
+  return is_community_access_allowed(community, address);
+}
+
+bool SecurityManager::is_access_allowed(const std::string &community,
+                                        const RequestContext &context) const {
+  return is_community_access_allowed(community, context.source);
+}
+
+bool SecurityManager::is_community_access_allowed(
+    const std::string &community, const NetworkAddress &address) const {
+  {
+    // Communities with access control entries are limited to their sources
+    std::lock_guard<std::mutex> lock(access_control_mutex_);
+    bool restricted = false;
+    for (size_t i = 0; i < access_control_entries_.size(); ++i) {
+      if (access_control_entries_[i].community != community) {
+        continue;
+      }
+      restricted = true;
+      if (access_control_rules_[i].matches(address)) {
+        return true;
+      }
+    }
+    if (restricted) {
+      return false;
+    }
+  }
+
+  return is_community_valid(community);
+}
+
+bool SecurityManager::is_oid_allowed(const std::string &community,
+                                     const std::string &oid) const {
+  std::lock_guard<std::mutex> lock(access_control_mutex_);
+
+  bool restricted = false;
+  for (const auto &entry : access_control_entries_) {
+    if (entry.community != community || entry.allowed_oids.empty()) {
+      continue;
+    }
+    restricted = true;
+    for (const auto &prefix : entry.allowed_oids) {
+      if (oid_has_prefix(oid, prefix)) {
+        return true;
+      }
+    }
+  }
+  return !restricted;
+}
+
+bool SecurityManager::is_write_allowed(const std::string &community) const {
+  {
+    std::lock_guard<std::mutex> lock(community_mutex_);
+    auto it = valid_communities_.find(community);
+    if (it != valid_communities_.end()) {
+      return !it->second;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(access_control_mutex_);
+  for (const auto &entry : access_control_entries_) {
+    if (entry.community == community && !entry.read_only) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Rate limiting
+
+bool SecurityManager::check_rate_limit(const std::string &source_ip) {
+  NetworkAddress address;
+  if (!NetworkAddress::parse(source_ip, address)) {
+    return false;
+  }
+  return check_address_rate_limit(address, std::chrono::steady_clock::now());
+}
+
+bool SecurityManager::check_rate_limit(const RequestContext &context) {
+  return check_address_rate_limit(context.source, context.received);
+}
+
+bool SecurityManager::check_address_rate_limit(
+    const NetworkAddress &address, std::chrono::steady_clock::time_point now) {
+  std::lock_guard<std::mutex> lock(rate_limit_mutex_);
+
+  auto it = rate_limits_.find(address);
+  if (it == rate_limits_.end()) {
+    // Without a default limit, unknown sources are not tracked at all so
+    // spoofed source addresses cannot grow the table
+    if (default_max_requests_ == 0) {
+      return true;
+    }
+    it = rate_limits_
+             .emplace(address, RateLimitEntry(default_max_requests_,
+                                              default_window_duration_))
+             .first;
+  }
+
+  RateLimitEntry &entry = it->second;
+  if (now - entry.last_request >= entry.window_duration) {
+    entry.last_request = now;
+    entry.request_count = 0;
+  }
+
+  if (entry.request_count >= entry.max_requests) {
+    return false;
+  }
+  ++entry.request_count;
+  return true;
+}
+
+void SecurityManager::reset_rate_limit(const std::string &source_ip) {
+  NetworkAddress address;
+  if (!NetworkAddress::parse(source_ip, address)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(rate_limit_mutex_);
+  auto it = rate_limits_.find(address);
+  if (it != rate_limits_.end()) {
+    it->second.request_count = 0;
+    it->second.last_request = std::chrono::steady_clock::time_point();
+  }
+}
+
+// Configuration
+
+void SecurityManager::add_access_control_entry(
+    const AccessControlEntry &entry) {
+  AddressRule rule = parse_address_rule(entry.source_ip, entry.subnet_mask);
+
+  std::lock_guard<std::mutex> lock(access_control_mutex_);
+  access_control_entries_.push_back(entry);
+  access_control_rules_.push_back(rule);
+}
+
+void SecurityManager::remove_access_control_entry(
+    const std::string &community, const std::string &source_ip) {
+  std::lock_guard<std::mutex> lock(access_control_mutex_);
+  for (size_t i = 0; i < access_control_entries_.size();) {
+    if (access_control_entries_[i].community == community &&
+        access_control_entries_[i].source_ip == source_ip) {
+      access_control_entries_.erase(access_control_entries_.begin() + i);
+      access_control_rules_.erase(access_control_rules_.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+void SecurityManager::set_rate_limit(const std::string &source_ip,
+                                     uint32_t max_requests,
+                                     std::chrono::seconds window) {
+  NetworkAddress address;
+  if (!NetworkAddress::parse(source_ip, address)) {
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "Ignoring rate limit for invalid address: " +
+                                   source_ip);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(rate_limit_mutex_);
+  rate_limits_[address] = RateLimitEntry(max_requests, window);
+}
+
+void SecurityManager::set_default_rate_limit(uint32_t max_requests,
+                                             std::chrono::seconds window) {
+  std::lock_guard<std::mutex> lock(rate_limit_mutex_);
+  default_max_requests_ = max_requests;
+  default_window_duration_ = window;
+}
+
+// IP filtering
+
+void SecurityManager::add_allowed_ip(const std::string &ip) {
+  AddressRule rule = parse_address_rule(ip, "");
+  std::lock_guard<std::mutex> lock(ip_filter_mutex_);
+  allowed_rules_.push_back(rule);
+}
+
+void SecurityManager::add_denied_ip(const std::string &ip) {
+  AddressRule rule = parse_address_rule(ip, "");
+  std::lock_guard<std::mutex> lock(ip_filter_mutex_);
+  denied_rules_.push_back(rule);
+}
+
+void SecurityManager::add_allowed_subnet(const std::string &subnet) {
+  AddressRule rule = parse_address_rule(subnet, "");
+  std::lock_guard<std::mutex> lock(ip_filter_mutex_);
+  allowed_rules_.push_back(rule);
+}
+
+void SecurityManager::add_denied_subnet(const std::string &subnet) {
+  AddressRule rule = parse_address_rule(subnet, "");
+  std::lock_guard<std::mutex> lock(ip_filter_mutex_);
+  denied_rules_.push_back(rule);
+}
+
+bool SecurityManager::is_ip_allowed(const std::string &ip) const {
+  NetworkAddress address;
+  if (!NetworkAddress::parse(ip, address)) {
+    return false;
+  }
+  return is_address_allowed(address);
+}
+
+bool SecurityManager::is_ip_allowed(const RequestContext &context) const {
+  return is_address_allowed(context.source);
+}
+
+bool SecurityManager::is_address_allowed(
+    const NetworkAddress &address) const {
+  std::lock_guard<std::mutex> lock(ip_filter_mutex_);
+
+  // Deny rules win; an empty allow list admits everyone else
+  if (matches_any(address, denied_rules_)) {
+    return false;
+  }
+  return allowed_rules_.empty() || matches_any(address, allowed_rules_);
+}
+
+// Community string validation
+
+void SecurityManager::add_valid_community(const std::string &community,
+                                          bool read_only) {
+  std::lock_guard<std::mutex> lock(community_mutex_);
+  valid_communities_[community] = read_only;
+}
+
+void SecurityManager::remove_community(const std::string &community) {
+  std::lock_guard<std::mutex> lock(community_mutex_);
+  valid_communities_.erase(community);
+}
+
+bool SecurityManager::is_community_valid(const std::string &community) const {
+  std::lock_guard<std::mutex> lock(community_mutex_);
+  return valid_communities_.find(community) != valid_communities_.end();
+}
+
+void SecurityManager::initialize_defaults() {
+  add_valid_community("public", true);
+  set_default_rate_limit(0, std::chrono::seconds(60));
+}
+
+} // namespace simple_snmpd
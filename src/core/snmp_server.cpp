@@ -17,14 +17,18 @@
  */
 
 #include "simple_snmpd/snmp_server.hpp"
+#include "simple_snmpd/ber_encoder.hpp"
 #include "simple_snmpd/error_handler.hpp"
 #include "simple_snmpd/logger.hpp"
 #include "simple_snmpd/platform.hpp"
+#include "simple_snmpd/prometheus_metrics.hpp"
 #include "simple_snmpd/snmp_mib.hpp"
 #include "simple_snmpd/snmp_security.hpp"
+#include "simple_snmpd/snmp_v3_packet.hpp"
 #include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <sstream>
 #include <thread>
 
 #ifdef _WIN32
@@ -34,24 +38,355 @@
 #else
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #endif
 
+#ifdef __linux__
+#include <linux/net_tstamp.h>
+#endif
+
 namespace simple_snmpd {
 
+namespace {
+
+// Map a receive batch fill count to its log2 histogram bucket
+size_t batch_fill_bucket(size_t count) {
+  size_t bucket = 0;
+  while (count > 1 && bucket + 1 < SNMP_BATCH_FILL_BUCKETS) {
+    count >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+// Human readable label for a batch fill histogram bucket
+std::string batch_fill_label(size_t bucket) {
+  size_t low = static_cast<size_t>(1) << bucket;
+  if (bucket + 1 == SNMP_BATCH_FILL_BUCKETS) {
+    return std::to_string(low) + "+";
+  }
+  size_t high = (low << 1) - 1;
+  return low == high ? std::to_string(low)
+                     : std::to_string(low) + "-" + std::to_string(high);
+}
+
+// Map a latency in microseconds to its log2 histogram bucket
+size_t latency_bucket(uint64_t microseconds) {
+  size_t bucket = 0;
+  while (bucket + 1 < SNMP_LATENCY_BUCKETS &&
+         microseconds > (static_cast<uint64_t>(1) << bucket)) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+// Prometheus "le" label (upper bound in seconds) of a latency bucket
+std::string latency_bucket_label(size_t bucket) {
+  if (bucket + 1 == SNMP_LATENCY_BUCKETS) {
+    return "+Inf";
+  }
+  std::ostringstream oss;
+  oss << static_cast<double>(static_cast<uint64_t>(1) << bucket) / 1e6;
+  return oss.str();
+}
+
+// Sources whose dispatch queue depth is exported with fair queueing
+constexpr size_t SNMP_FAIR_QUEUE_TOP_SOURCES = 10;
+
+// Longest a worker holds a finished response back to batch it with others
+constexpr std::chrono::microseconds SNMP_WORKER_FLUSH_DEADLINE(200);
+
+// Wall clock in nanoseconds, the clock kernel receive timestamps use
+uint64_t realtime_ns() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+// Receive buffer size as reported by the kernel (including its overhead)
+uint64_t receive_buffer_bytes(int socket_fd) {
+  int size = 0;
+  socklen_t length = sizeof(size);
+  if (getsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF,
+                 reinterpret_cast<char *>(&size), &length) < 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(size);
+}
+
+// Set a counter or gauge in the Prometheus registry, creating it on first use
+void publish_metric(const std::string &name, const std::string &help,
+                    PrometheusMetricType type, double value,
+                    const std::map<std::string, std::string> &labels = {}) {
+  auto &registry = PrometheusRegistry::get_instance();
+  auto metric = registry.get_metric(name);
+  if (!metric) {
+    std::vector<std::string> label_names;
+    for (const auto &label : labels) {
+      label_names.push_back(label.first);
+    }
+    metric = std::make_shared<PrometheusMetric>(name, help, type, label_names);
+    registry.register_metric(metric);
+  }
+
+  if (type == PrometheusMetricType::COUNTER) {
+    metric->set_counter_value(value, labels);
+  } else {
+    metric->set_gauge_value(value, labels);
+  }
+}
+
+// Publish a latency histogram as cumulative _bucket counters plus _sum and
+// _count, the series Prometheus histograms are made of
+void publish_latency_histogram(
+    const std::string &name, const std::string &help,
+    const std::array<uint64_t, SNMP_LATENCY_BUCKETS> &buckets,
+    uint64_t sum_us, const std::map<std::string, std::string> &labels) {
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < SNMP_LATENCY_BUCKETS; ++i) {
+    cumulative += buckets[i];
+    std::map<std::string, std::string> bucket_labels = labels;
+    bucket_labels["le"] = latency_bucket_label(i);
+    publish_metric(name + "_bucket", help, PrometheusMetricType::COUNTER,
+                   static_cast<double>(cumulative), bucket_labels);
+  }
+  publish_metric(name + "_sum", help, PrometheusMetricType::COUNTER,
+                 sum_us / 1e6, labels);
+  publish_metric(name + "_count", help, PrometheusMetricType::COUNTER,
+                 static_cast<double>(cumulative), labels);
+}
+
+// Bind the first readable instance from the cursor on; false once the
+// walk has passed the last one, binding endOfMibView to the last name
+bool bind_cursor(MIBManager::Cursor &cursor, const ByteSpan &last,
+                 SNMPPacket::VariableBinding &varbind) {
+  MIBValue value;
+  if (cursor.read(value)) {
+    varbind.oid = cursor.oid();
+    varbind.value_type = static_cast<uint8_t>(value.type);
+    varbind.value.swap(value.data);
+    return true;
+  }
+  varbind.oid.assign(last.begin(), last.end());
+  varbind.value_type = static_cast<uint8_t>(SNMPDataType::END_OF_MIB_VIEW);
+  varbind.value.clear();
+  return false;
+}
+
+// SNMPv1 has no counterpart for most SNMPv2 error codes (RFC 2576 4.4)
+uint8_t error_for_version(uint8_t version, uint8_t status) {
+  if (version != SNMP_VERSION_1) {
+    return status;
+  }
+  switch (status) {
+  case SNMP_ERROR_WRONG_VALUE:
+  case SNMP_ERROR_WRONG_ENCODING:
+  case SNMP_ERROR_WRONG_TYPE:
+  case SNMP_ERROR_WRONG_LENGTH:
+  case SNMP_ERROR_INCONSISTENT_VALUE:
+    return SNMP_ERROR_BAD_VALUE;
+  case SNMP_ERROR_NO_ACCESS:
+  case SNMP_ERROR_NOT_WRITABLE:
+  case SNMP_ERROR_NO_CREATION:
+  case SNMP_ERROR_INCONSISTENT_NAME:
+  case SNMP_ERROR_AUTHORIZATION_ERROR:
+    return SNMP_ERROR_NO_SUCH_NAME;
+  case SNMP_ERROR_RESOURCE_UNAVAILABLE:
+  case SNMP_ERROR_COMMIT_FAILED:
+  case SNMP_ERROR_UNDO_FAILED:
+    return SNMP_ERROR_GEN_ERR;
+  default:
+    return status;
+  }
+}
+
+// Owning copy of a request binding, for responses that echo it
+void copy_binding(const SNMPPacketView::VariableBinding &binding,
+                  SNMPPacket::VariableBinding &varbind) {
+  varbind.oid.assign(binding.oid.begin(), binding.oid.end());
+  varbind.value_type = binding.value_type;
+  varbind.value.assign(binding.value.begin(), binding.value.end());
+}
+
+// Append every binding of request to response unchanged; false when they
+// do not fit in max_size
+bool echo_bindings(const SNMPPacketView &request, SNMPPacket &response,
+                   size_t max_size) {
+  SNMPPacket::VariableBinding varbind;
+  for (const auto &binding : request) {
+    copy_binding(binding, varbind);
+    if (!response.add_variable_binding(varbind, max_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// An error response repeats the request's bindings unchanged, with
+// error-index pointing at the one that failed (1-based)
+bool set_error(const SNMPPacketView &request, SNMPPacket &response,
+               uint8_t status, size_t index, size_t max_size) {
+  response.set_error_status(error_for_version(request.get_version(), status));
+  response.set_error_index(static_cast<int32_t>(index));
+  response.clear_variable_bindings();
+  return echo_bindings(request, response, max_size);
+}
+
+// The scoped PDU of an SNMPv3 message the processor has accepted, so it
+// is served by the same view-based request path as SNMPv1/v2c. A
+// plaintext one is read in place from data; a decrypted one exists only
+// in request and is encoded into buffer first.
+bool view_scoped_pdu(const SNMPv3Packet &request, const uint8_t *data,
+                     size_t length, std::vector<uint8_t> &buffer,
+                     SNMPPacketView &view) {
+  if (!request.get_message_flags().privacy) {
+    return static_cast<bool>(view.parse_v3(data, length));
+  }
+
+  SNMPv3ScopedPDU scoped = request.get_scoped_pdu();
+  buffer.resize(scoped.pdu.encoded_size() + BER_MAX_HEADER_SIZE +
+                BerEncoder::tlv_size(scoped.context_engine_id.size()) +
+                BerEncoder::tlv_size(scoped.context_name.size()));
+  BerEncoder encoder(buffer.data(), buffer.size());
+  size_t mark = encoder.size();
+  scoped.pdu.serialize_pdu(encoder);
+  encoder.write_tlv(
+      0x04, reinterpret_cast<const uint8_t *>(scoped.context_name.data()),
+      scoped.context_name.size());
+  encoder.write_tlv(0x04, scoped.context_engine_id.data(),
+                    scoped.context_engine_id.size());
+  encoder.wrap(0x30, mark); // SEQUENCE
+  return encoder.ok() &&
+         view.parse_scoped_pdu(encoder.data(), encoder.size());
+}
+
+// Bytes an SNMPv3 message adds around its PDU (RFC 3412 6, RFC 3414 2.4):
+// header, USM parameters with room for the longest HMAC (48 octets) and a
+// privacy salt, the scoped PDU fields, and when privacy is used the
+// encryptedPDU header and a cipher block of padding
+size_t v3_overhead(const SNMPv3Packet &request, const SNMPPacketView &pdu) {
+  const size_t integer = BerEncoder::tlv_size(5);
+  SNMPv3SecurityParameters usm = request.get_security_parameters();
+
+  size_t overhead = 5 * BER_MAX_HEADER_SIZE + BerEncoder::tlv_size(1);
+  overhead += 2 * integer + 2 * BerEncoder::tlv_size(1);
+  overhead += BerEncoder::tlv_size(usm.engine_id.size()) + 2 * integer +
+              BerEncoder::tlv_size(usm.username.size()) +
+              BerEncoder::tlv_size(48) + BerEncoder::tlv_size(8);
+  overhead += BerEncoder::tlv_size(pdu.get_context_engine_id().length) +
+              BerEncoder::tlv_size(pdu.get_context_name().length);
+  if (request.get_message_flags().privacy) {
+    overhead += BER_MAX_HEADER_SIZE + 16;
+  }
+  return overhead;
+}
+
+void address_response(Datagram &slot, const RequestContext &context) {
+  std::memcpy(&slot.address, &context.address, context.address_length);
+  slot.address_length = context.address_length;
+  slot.timestamp_ns = context.arrival_ns;
+}
+
+} // namespace
+
+SNMPServer::Counters::Counters()
+    : rx_syscalls(0), rx_datagrams(0), rx_errors(0), rx_oversized(0),
+      tx_syscalls(0), tx_datagrams(0), tx_errors(0), requests_processed(0),
+      parse_errors(0),
+      dispatched(0), dispatch_drops(0), queue_wait_us(0), kernel_drops(0),
+      receive_buffer_bytes(0), queue_delay_us(0), service_time_us(0) {
+  for (auto &bucket : batch_fill) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  for (auto &reason : parse_error_reasons) {
+    reason.store(0, std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < SNMP_LATENCY_BUCKETS; ++i) {
+    queue_delay[i].store(0, std::memory_order_relaxed);
+    service_time[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+SNMPServer::Statistics SNMPServer::Counters::snapshot() const {
+  Statistics stats;
+  stats.rx_syscalls = rx_syscalls.load(std::memory_order_relaxed);
+  stats.rx_datagrams = rx_datagrams.load(std::memory_order_relaxed);
+  stats.rx_errors = rx_errors.load(std::memory_order_relaxed);
+  stats.rx_oversized = rx_oversized.load(std::memory_order_relaxed);
+  stats.tx_syscalls = tx_syscalls.load(std::memory_order_relaxed);
+  stats.tx_datagrams = tx_datagrams.load(std::memory_order_relaxed);
+  stats.tx_errors = tx_errors.load(std::memory_order_relaxed);
+  stats.requests_processed =
+      requests_processed.load(std::memory_order_relaxed);
+  stats.parse_errors = parse_errors.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < SNMP_PARSE_ERRORS; ++i) {
+    stats.parse_error_reasons[i] =
+        parse_error_reasons[i].load(std::memory_order_relaxed);
+  }
+  stats.dispatched = dispatched.load(std::memory_order_relaxed);
+  stats.dispatch_drops = dispatch_drops.load(std::memory_order_relaxed);
+  stats.queue_wait_us = queue_wait_us.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < SNMP_BATCH_FILL_BUCKETS; ++i) {
+    stats.batch_fill[i] = batch_fill[i].load(std::memory_order_relaxed);
+  }
+  stats.kernel_drops = kernel_drops.load(std::memory_order_relaxed);
+  stats.receive_buffer_bytes =
+      receive_buffer_bytes.load(std::memory_order_relaxed);
+  stats.queue_delay_us = queue_delay_us.load(std::memory_order_relaxed);
+  stats.service_time_us = service_time_us.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < SNMP_LATENCY_BUCKETS; ++i) {
+    stats.queue_delay[i] = queue_delay[i].load(std::memory_order_relaxed);
+    stats.service_time[i] = service_time[i].load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
 SNMPServer::SNMPServer(const SNMPConfig &config)
-    : config_(config), server_socket_(-1), running_(false),
-      thread_pool_size_(4) {
+    : config_(config), running_(false), idle_workers_(0),
+      tcp_requests_processed_(0), tcp_parse_errors_(0),
+      parse_error_log_(10, std::chrono::seconds(1)),
+      max_response_size_(std::min<size_t>(config.get_max_response_size(),
+                                          SNMP_MAX_UDP_PAYLOAD)),
+      too_big_responses_(0), truncated_responses_(0) {
+  for (auto &reason : tcp_parse_error_reasons_) {
+    reason.store(0, std::memory_order_relaxed);
+  }
+
   // Initialize MIB manager
-  MIBManager::get_instance().initialize_standard_mibs();
+  MIBManager &mib = MIBManager::get_instance();
+  mib.initialize_standard_mibs();
+  for (const auto &rule : config_.get_mib_cache_rules()) {
+    std::vector<uint8_t> subtree;
+    MIBCachePolicy policy;
+    if (MIBCache::parse_rule(rule, subtree, policy)) {
+      mib.set_cache_policy(subtree, policy);
+    }
+  }
 
   // Initialize security manager
   SecurityManager::get_instance().initialize_defaults();
+
+  admission_.configure(
+      config_.is_load_shedding_enabled(),
+      std::chrono::microseconds(config_.get_shed_target_us()),
+      std::chrono::milliseconds(config_.get_shed_interval_ms()),
+      config_.get_shed_bulk_cost(), config_.get_priority_communities(),
+      config_.get_low_priority_communities());
+  response_cache_.configure(
+      std::chrono::milliseconds(config_.get_response_cache_ttl_ms()),
+      config_.get_response_cache_entries());
+  shape_cache_.configure(config_.get_shape_cache_entries());
 }
 
-SNMPServer::~SNMPServer() { stop(); }
+SNMPServer::~SNMPServer() {
+  stop();
+  close_listener_sockets();
+}
 
 bool SNMPServer::initialize() {
   Logger::get_instance().log(LogLevel::INFO, "Initializing SNMP server...");
@@ -65,217 +400,1144 @@ bool SNMPServer::initialize() {
   }
 #endif
 
-  // Create server socket
-  server_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-  if (server_socket_ == -1) {
+  if (!resolve_endpoints()) {
+    return false;
+  }
+
+  uint32_t shard_count = config_.get_listener_shards();
+  if (shard_count == 0) {
+    shard_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+#ifndef SO_REUSEPORT
+  if (shard_count > 1) {
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "SO_REUSEPORT is not available on this "
+                               "platform, using a single listener shard");
+    shard_count = 1;
+  }
+#endif
+
+  // Create one socket per shard on every endpoint; with several shards the
+  // kernel spreads an endpoint's datagrams across them by source address
+  for (uint32_t e = 0; e < endpoints_.size(); ++e) {
+    for (uint32_t i = 0; i < shard_count; ++i) {
+      int socket_fd = open_listener_socket(endpoints_[e], shard_count > 1);
+      if (socket_fd == -1) {
+        close_listener_sockets();
+        return false;
+      }
+      uint32_t id = static_cast<uint32_t>(shards_.size());
+      auto shard = std::make_unique<Shard>(id, e, socket_fd);
+      shard->receive_buffer_request =
+          static_cast<int>(config_.get_receive_buffer_size());
+      shard->counters.receive_buffer_bytes.store(
+          receive_buffer_bytes(socket_fd), std::memory_order_relaxed);
+      shards_.push_back(std::move(shard));
+    }
+  }
+
+  if (config_.is_fair_queueing_enabled()) {
+    if (config_.get_worker_threads() == 0) {
+      Logger::get_instance().log(LogLevel::WARNING,
+                                 "fair_queueing needs worker_threads, "
+                                 "requests are served in arrival order");
+    } else {
+      fair_queue_ = std::make_unique<FairQueue>();
+      if (!fair_queue_->configure(config_.get_fair_queue_quantum(),
+                                  config_.get_fair_queue_flow_depth(),
+                                  config_.get_fair_queue_weights())) {
+        close_listener_sockets();
+        return false;
+      }
+    }
+  }
+
+  std::string endpoint_list;
+  for (const auto &endpoint : endpoints_) {
+    endpoint_list += (endpoint_list.empty() ? "" : ", ") +
+                     listen_endpoint_to_string(endpoint);
+  }
+  Logger::get_instance().log(LogLevel::INFO,
+                             "SNMP server initialized successfully on " +
+                                 endpoint_list + " with " +
+                                 std::to_string(shard_count) +
+                                 " listener shard(s) per endpoint");
+  return true;
+}
+
+bool SNMPServer::resolve_endpoints() {
+  endpoints_.clear();
+
+  // Without bind_address listen on every address, on one dual-stack
+  // socket when IPv6 is enabled
+  std::vector<std::string> addresses = config_.get_bind_addresses();
+  bool defaulted = addresses.empty();
+  if (defaulted) {
+    addresses.push_back(config_.is_ipv6_enabled() ? "*" : "0.0.0.0");
+  }
+
+  for (const auto &address : addresses) {
+    ListenEndpoint endpoint;
+    if (!parse_listen_endpoint(address, config_.get_port(), endpoint)) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Invalid bind address: " + address);
+      return false;
+    }
+
+    if (endpoint.family() == AF_INET6 && !config_.is_ipv6_enabled()) {
+      Logger::get_instance().log(LogLevel::WARNING,
+                                 "IPv6 is disabled, not listening on " +
+                                     address);
+      continue;
+    }
+
+    // Hosts without IPv6 still get the implicit IPv4 listener
+    if (defaulted && endpoint.family() == AF_INET6) {
+      int probe = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+      if (probe == -1) {
+        Logger::get_instance().log(LogLevel::WARNING,
+                                   "IPv6 is not available, listening on "
+                                   "IPv4 only");
+        parse_listen_endpoint("0.0.0.0", config_.get_port(), endpoint);
+      } else {
+        close(probe);
+      }
+    }
+
+    endpoints_.push_back(endpoint);
+  }
+
+  if (endpoints_.empty()) {
     Logger::get_instance().log(LogLevel::ERROR,
-                               "Failed to create server socket");
+                               "No usable listen addresses configured");
     return false;
   }
+  return true;
+}
+
+int SNMPServer::open_listener_socket(const ListenEndpoint &endpoint,
+                                     bool reuse_port, int socket_type) {
+  std::string name = listen_endpoint_to_string(endpoint);
+  if (socket_type == SOCK_STREAM) {
+    name += " (tcp)";
+  }
+
+  // Create server socket
+  int socket_fd =
+      socket(endpoint.family(), socket_type,
+             socket_type == SOCK_STREAM ? IPPROTO_TCP : IPPROTO_UDP);
+  if (socket_fd == -1) {
+    Logger::get_instance().log(LogLevel::ERROR,
+                               "Failed to create server socket for " + name);
+    return -1;
+  }
 
   // Set socket options
   int reuse = 1;
-  if (setsockopt(server_socket_, SOL_SOCKET, SO_REUSEADDR,
+  if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR,
                  reinterpret_cast<const char *>(&reuse), sizeof(reuse)) < 0) {
     Logger::get_instance().log(LogLevel::ERROR, "Failed to set SO_REUSEADDR");
-    close(server_socket_);
-    return false;
+    close(socket_fd);
+    return -1;
+  }
+
+#ifdef SO_REUSEPORT
+  if (reuse_port &&
+      setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT,
+                 reinterpret_cast<const char *>(&reuse), sizeof(reuse)) < 0) {
+    Logger::get_instance().log(LogLevel::ERROR, "Failed to set SO_REUSEPORT");
+    close(socket_fd);
+    return -1;
+  }
+#else
+  (void)reuse_port;
+#endif
+
+  // Explicit IPv6 endpoints leave IPv4 to their own sockets so that
+  // "0.0.0.0" and "::" can be listed together
+  if (endpoint.family() == AF_INET6) {
+    int v6_only = endpoint.v6_only ? 1 : 0;
+    if (setsockopt(socket_fd, IPPROTO_IPV6, IPV6_V6ONLY,
+                   reinterpret_cast<const char *>(&v6_only),
+                   sizeof(v6_only)) < 0) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Failed to set IPV6_V6ONLY for " + name);
+      close(socket_fd);
+      return -1;
+    }
+  }
+
+  if (!endpoint.interface.empty()) {
+#ifdef SO_BINDTODEVICE
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_BINDTODEVICE,
+                   endpoint.interface.c_str(),
+                   static_cast<socklen_t>(endpoint.interface.size())) < 0) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Failed to bind socket to interface " +
+                                     endpoint.interface);
+      close(socket_fd);
+      return -1;
+    }
+#else
+    Logger::get_instance().log(LogLevel::ERROR,
+                               "Binding to an interface is not supported on "
+                               "this platform: " +
+                                   name);
+    close(socket_fd);
+    return -1;
+#endif
+  }
+
+  if (socket_type == SOCK_DGRAM) {
+    uint32_t buffer_size = config_.get_receive_buffer_size();
+    if (buffer_size > 0 &&
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF,
+                   reinterpret_cast<const char *>(&buffer_size),
+                   sizeof(buffer_size)) < 0) {
+      Logger::get_instance().log(LogLevel::WARNING,
+                                 "Failed to set SO_RCVBUF for " + name);
+    }
+    enable_receive_metadata(socket_fd, name);
   }
 
   // Bind socket
-  struct sockaddr_in server_addr;
-  memset(&server_addr, 0, sizeof(server_addr));
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_addr.s_addr = INADDR_ANY;
-  server_addr.sin_port = htons(config_.get_port());
-
-  if (bind(server_socket_, reinterpret_cast<struct sockaddr *>(&server_addr),
-           sizeof(server_addr)) < 0) {
+  if (bind(socket_fd,
+           reinterpret_cast<const struct sockaddr *>(&endpoint.address),
+           endpoint.address_length) < 0) {
+    Logger::get_instance().log(LogLevel::ERROR,
+                               "Failed to bind socket to " + name);
+    close(socket_fd);
+    return -1;
+  }
+
+  return socket_fd;
+}
+
+void SNMPServer::enable_receive_metadata(int socket_fd,
+                                         const std::string &name) {
+#ifdef __linux__
+  // Every datagram then carries the socket's drop counter and its kernel
+  // arrival time; both are optional, so failures only cost visibility
+  int enable = 1;
+  if (setsockopt(socket_fd, SOL_SOCKET, SO_RXQ_OVFL, &enable,
+                 sizeof(enable)) < 0) {
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "Kernel drop counters (SO_RXQ_OVFL) are not "
+                               "available for " +
+                                   name);
+  }
+
+  int timestamping = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  if (setsockopt(socket_fd, SOL_SOCKET, SO_TIMESTAMPING, &timestamping,
+                 sizeof(timestamping)) < 0 &&
+      setsockopt(socket_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable,
+                 sizeof(enable)) < 0) {
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "Kernel receive timestamps are not available "
+                               "for " +
+                                   name);
+  }
+#else
+  (void)socket_fd;
+  (void)name;
+#endif
+}
+
+void SNMPServer::record_kernel_drops(Shard &shard, uint32_t drops) {
+  // The counter is cumulative per socket and wraps at 2^32
+  uint32_t new_drops = drops - shard.drops_seen;
+  if (new_drops == 0 || new_drops > 0x80000000u) {
+    return;
+  }
+  shard.drops_seen = drops;
+  shard.counters.kernel_drops.fetch_add(new_drops, std::memory_order_relaxed);
+
+  // Report at most once a second; a storm produces drops on every batch
+  auto now = std::chrono::steady_clock::now();
+  Logger &logger = Logger::get_instance();
+  if (now - shard.last_drop_report >= std::chrono::seconds(1) &&
+      logger.is_enabled(LogLevel::WARNING)) {
+    logger.log(LogLevel::WARNING,
+               "Kernel dropped " +
+                   std::to_string(drops - shard.drops_reported) +
+                   " request(s) on shard " + std::to_string(shard.id) +
+                   ", receive buffer full");
+    shard.drops_reported = drops;
+    shard.last_drop_report = now;
+  }
+
+  if (config_.is_receive_buffer_auto()) {
+    grow_receive_buffer(shard);
+  }
+}
+
+void SNMPServer::grow_receive_buffer(Shard &shard) {
+  // Double at most once a second so a single burst does not jump to the
+  // limit before the larger buffer had a chance to absorb it
+  auto now = std::chrono::steady_clock::now();
+  if (now - shard.last_buffer_change < std::chrono::seconds(1)) {
+    return;
+  }
+  shard.last_buffer_change = now;
+
+  int limit = static_cast<int>(config_.get_receive_buffer_max());
+  int current = shard.receive_buffer_request;
+  if (current == 0) {
+    // The kernel reports twice the requested size
+    current = static_cast<int>(receive_buffer_bytes(shard.socket_fd) / 2);
+  }
+  if (current >= limit) {
+    return;
+  }
+  int requested = std::min(limit, std::max(current, 65536) * 2);
+
+  // SO_RCVBUFFORCE ignores net.core.rmem_max but needs CAP_NET_ADMIN
+  bool applied = false;
+#ifdef SO_RCVBUFFORCE
+  applied = setsockopt(shard.socket_fd, SOL_SOCKET, SO_RCVBUFFORCE,
+                       &requested, sizeof(requested)) == 0;
+#endif
+  if (!applied) {
+    applied = setsockopt(shard.socket_fd, SOL_SOCKET, SO_RCVBUF,
+                         reinterpret_cast<const char *>(&requested),
+                         sizeof(requested)) == 0;
+  }
+  if (!applied) {
+    return;
+  }
+
+  shard.receive_buffer_request = requested;
+  uint64_t actual = receive_buffer_bytes(shard.socket_fd);
+  shard.counters.receive_buffer_bytes.store(actual,
+                                            std::memory_order_relaxed);
+  Logger::get_instance().log(
+      LogLevel::INFO, "Grew receive buffer of shard " +
+                          std::to_string(shard.id) + " to " +
+                          std::to_string(actual) + " bytes (requested " +
+                          std::to_string(requested) + ")");
+}
+
+void SNMPServer::close_listener_sockets() {
+  for (auto &shard : shards_) {
+    if (shard->socket_fd != -1) {
+      close(shard->socket_fd);
+      shard->socket_fd = -1;
+    }
+  }
+  shards_.clear();
+}
+
+bool SNMPServer::start() {
+  if (running_) {
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "SNMP server is already running");
+    return true;
+  }
+
+  if (shards_.empty()) {
     Logger::get_instance().log(LogLevel::ERROR,
-                               "Failed to bind socket to port " +
-                                   std::to_string(config_.get_port()));
-    close(server_socket_);
+                               "SNMP server has not been initialized");
+    return false;
+  }
+
+  Logger::get_instance().log(LogLevel::INFO, "Starting SNMP server...");
+
+  running_ = true;
+
+  // Start the workers first so shards can dispatch as soon as they run
+  size_t batch_size = config_.get_io_batch_size();
+  uint32_t worker_count = config_.get_worker_threads();
+  if (worker_count > 0) {
+    initialize_dispatch(config_.get_dispatch_queue_depth());
+
+    for (uint32_t i = 0; i < worker_count; ++i) {
+      auto worker = std::make_unique<Worker>(i);
+      for (const auto &shard : shards_) {
+        worker->engines.push_back(
+            std::make_unique<SocketDatagramEngine>(shard->socket_fd));
+      }
+      worker->transmitter.responses =
+          std::make_unique<DatagramBatch>(batch_size, SNMP_MAX_UDP_PAYLOAD);
+      workers_.push_back(std::move(worker));
+    }
+    for (auto &worker : workers_) {
+      worker->thread = std::thread(&SNMPServer::worker_loop, this,
+                                   std::ref(*worker));
+    }
+
+    Logger::get_instance().log(
+        LogLevel::INFO,
+        "Dispatching requests to " + std::to_string(worker_count) +
+            " worker thread(s), queue depth " +
+            std::to_string(dispatch_ready_->capacity()) +
+            (fair_queue_ ? ", fair queueing per source" : ""));
+  }
+
+  // Start one receive loop per listener shard
+  for (auto &shard : shards_) {
+    shard->requests =
+        std::make_unique<DatagramBatch>(batch_size, SNMP_RECEIVE_BUFFER_SIZE);
+    shard->engine = create_datagram_engine(config_.get_io_backend(),
+                                           shard->socket_fd, batch_size);
+    if (workers_.empty()) {
+      shard->transmitter.responses =
+          std::make_unique<DatagramBatch>(batch_size, SNMP_MAX_UDP_PAYLOAD);
+      shard->transmitter.engine = shard->engine.get();
+      shard->transmitter.counters = &shard->counters;
+    }
+    shard->thread = std::thread(&SNMPServer::server_loop, this,
+                                std::ref(*shard));
+
+#ifdef __linux__
+    if (config_.is_shard_cpu_affinity_enabled()) {
+      unsigned int cpu_count =
+          std::max(1u, std::thread::hardware_concurrency());
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(shard->id % cpu_count, &cpu_set);
+      if (pthread_setaffinity_np(shard->thread.native_handle(),
+                                 sizeof(cpu_set), &cpu_set) != 0) {
+        Logger::get_instance().log(LogLevel::WARNING,
+                                   "Failed to pin listener shard " +
+                                       std::to_string(shard->id) + " to CPU " +
+                                       std::to_string(shard->id % cpu_count));
+      }
+    }
+#endif
+  }
+
+  if (config_.is_tcp_enabled() && !start_tcp_transport()) {
+    stop();
     return false;
   }
 
   Logger::get_instance().log(LogLevel::INFO,
-                             "SNMP server initialized successfully");
+                             "SNMP server started successfully");
   return true;
 }
 
-bool SNMPServer::start() {
-  if (running_) {
-    Logger::get_instance().log(LogLevel::WARNING,
-                               "SNMP server is already running");
-    return true;
-  }
+bool SNMPServer::start_tcp_transport() {
+  // One stream listener per endpoint; the transport owns the sockets
+  std::vector<int> listen_fds;
+  for (const auto &endpoint : endpoints_) {
+    int socket_fd = open_listener_socket(endpoint, false, SOCK_STREAM);
+    if (socket_fd == -1) {
+      for (int fd : listen_fds) {
+        close(fd);
+      }
+      return false;
+    }
+    listen_fds.push_back(socket_fd);
+  }
+
+  tcp_transport_ = std::make_unique<TcpTransport>(
+      [this](const RequestContext &context, const uint8_t *data,
+             size_t length, std::vector<uint8_t> &response) {
+        return handle_stream_message(context, data, length, response);
+      },
+      config_.get_max_connections(), config_.get_timeout_seconds(),
+      config_.get_tcp_max_message_size());
+  if (!tcp_transport_->start(listen_fds)) {
+    tcp_transport_.reset();
+    return false;
+  }
+
+  Logger::get_instance().log(LogLevel::INFO,
+                             "Accepting SNMP over TCP, up to " +
+                                 std::to_string(config_.get_max_connections()) +
+                                 " connection(s)");
+  return true;
+}
+
+void SNMPServer::stop() {
+  if (!running_) {
+    return;
+  }
+
+  Logger::get_instance().log(LogLevel::INFO, "Stopping SNMP server...");
+
+  running_ = false;
+
+  // Shut the listener sockets down to wake up blocked receive calls
+  for (auto &shard : shards_) {
+    if (shard->socket_fd != -1) {
+#ifdef _WIN32
+      shutdown(shard->socket_fd, SD_BOTH);
+#else
+      shutdown(shard->socket_fd, SHUT_RDWR);
+#endif
+    }
+  }
+
+  // Wait for shard threads
+  for (auto &shard : shards_) {
+    if (shard->thread.joinable()) {
+      shard->thread.join();
+    }
+  }
+
+  // Wake idle workers so they notice the shutdown, then wait for them
+  {
+    std::lock_guard<std::mutex> lock(dispatch_mutex_);
+    dispatch_condition_.notify_all();
+  }
+  for (auto &worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+  workers_.clear();
+
+  // Close the TCP listeners and every manager connection
+  if (tcp_transport_) {
+    tcp_transport_->stop();
+    Logger::get_instance().log(LogLevel::INFO,
+                               "SNMP over TCP stopped (" +
+                                   tcp_statistics_to_string(
+                                       tcp_transport_->get_statistics()) +
+                                   ")");
+  }
+
+  if (admission_.is_enabled()) {
+    AdmissionController::Statistics admission = admission_.get_statistics();
+    std::string summary;
+    for (size_t i = 0; i < SNMP_REQUEST_CLASSES; ++i) {
+      summary += std::string(i ? ", " : "") +
+                 request_class_name(static_cast<RequestClass>(i)) + "=" +
+                 std::to_string(admission.shed[i]);
+    }
+    Logger::get_instance().log(LogLevel::INFO,
+                               "Requests shed by class (" + summary + ")");
+  }
+
+  if (response_cache_.is_enabled()) {
+    ResponseCache::Statistics cache = response_cache_.get_statistics();
+    Logger::get_instance().log(
+        LogLevel::INFO, "Response cache (hits=" + std::to_string(cache.hits) +
+                            " misses=" + std::to_string(cache.misses) +
+                            " evictions=" + std::to_string(cache.evictions) +
+                            ")");
+  }
+
+  if (shape_cache_.is_enabled()) {
+    RequestShapeCache::Statistics shapes = shape_cache_.get_statistics();
+    Logger::get_instance().log(
+        LogLevel::INFO,
+        "Request shape cache (hits=" + std::to_string(shapes.hits) +
+            " misses=" + std::to_string(shapes.misses) +
+            " invalidations=" + std::to_string(shapes.invalidations) + ")");
+  }
+
+  Logger::get_instance().log(LogLevel::INFO,
+                             "SNMP server stopped (" +
+                                 server_statistics_to_string(get_statistics()) +
+                                 ")");
+}
+
+void SNMPServer::server_loop(Shard &shard) {
+  Logger::get_instance().log(LogLevel::INFO,
+                             "SNMP server loop started on shard " +
+                                 std::to_string(shard.id) + " (" +
+                                 listen_endpoint_to_string(
+                                     endpoints_[shard.endpoint]) +
+                                 ", " + shard.engine->name() + " backend)");
+
+  DatagramBatch &requests = *shard.requests;
+  Counters &counters = shard.counters;
+
+  while (running_) {
+    size_t syscalls = 0;
+    int received = shard.engine->receive(requests, syscalls);
+    counters.rx_syscalls.fetch_add(syscalls, std::memory_order_relaxed);
+
+    if (!running_) {
+      break;
+    }
+
+    if (received < 0) {
+      counters.rx_errors.fetch_add(1, std::memory_order_relaxed);
+      Logger::get_instance().log(LogLevel::ERROR, "Failed to receive data");
+      continue;
+    }
+    if (requests.oversized() > 0) {
+      counters.rx_oversized.fetch_add(requests.oversized(),
+                                      std::memory_order_relaxed);
+    }
+
+    if (received == 0) {
+      continue;
+    }
+
+    counters.rx_datagrams.fetch_add(received, std::memory_order_relaxed);
+    counters.batch_fill[batch_fill_bucket(received)].fetch_add(
+        1, std::memory_order_relaxed);
+
+    // One timestamp for the whole batch; it arrived in a single call
+    auto received_at = std::chrono::steady_clock::now();
+
+    // Time spent in the kernel receive queue. Datagrams without a kernel
+    // timestamp are stamped now so their service time is still measured.
+    uint64_t now_ns = realtime_ns();
+    uint32_t drops = shard.drops_seen;
+    bool has_drops = false;
+    for (size_t i = 0; i < requests.size(); ++i) {
+      Datagram &datagram = requests[i];
+      if (datagram.has_drops) {
+        drops = datagram.drops;
+        has_drops = true;
+      }
+      if (datagram.timestamp_ns == 0) {
+        datagram.timestamp_ns = now_ns;
+        continue;
+      }
+      uint64_t delay_us = now_ns > datagram.timestamp_ns
+                              ? (now_ns - datagram.timestamp_ns) / 1000
+                              : 0;
+      counters.queue_delay_us.fetch_add(delay_us, std::memory_order_relaxed);
+      counters.queue_delay[latency_bucket(delay_us)].fetch_add(
+          1, std::memory_order_relaxed);
+    }
+    if (has_drops) {
+      record_kernel_drops(shard, drops);
+    }
+
+    if (!workers_.empty()) {
+      for (size_t i = 0; i < requests.size(); ++i) {
+        dispatch_datagram(requests[i], received_at, shard);
+      }
+      wake_workers();
+      continue;
+    }
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+      handle_datagram(requests[i], shard.id, received_at, shard.transmitter);
+    }
+
+    // Send every response produced by this batch at once
+    flush_responses(shard.transmitter);
+  }
+
+  Logger::get_instance().log(LogLevel::INFO,
+                             "SNMP server loop ended on shard " +
+                                 std::to_string(shard.id));
+}
+
+bool SNMPServer::initialize_dispatch(size_t depth) {
+  dispatch_ready_ = std::make_unique<BoundedQueue<uint32_t>>(depth);
+  dispatch_free_ = std::make_unique<BoundedQueue<uint32_t>>(depth);
+
+  // One slot per queue entry, so pushing a claimed slot never fails
+  size_t slot_count = dispatch_ready_->capacity();
+  dispatch_storage_.assign(slot_count * SNMP_RECEIVE_BUFFER_SIZE, 0);
+  dispatch_slots_.resize(slot_count);
+  for (size_t i = 0; i < slot_count; ++i) {
+    dispatch_slots_[i].datagram.data =
+        dispatch_storage_.data() + i * SNMP_RECEIVE_BUFFER_SIZE;
+    dispatch_free_->try_push(static_cast<uint32_t>(i));
+  }
+  return true;
+}
+
+void SNMPServer::dispatch_datagram(
+    const Datagram &datagram,
+    std::chrono::steady_clock::time_point received_at, Shard &shard) {
+  if (datagram.length == 0) {
+    return;
+  }
+
+  uint32_t index;
+  if (!dispatch_free_->try_pop(index)) {
+    // Every slot is queued or being processed: shed the request here
+    // rather than letting the kernel buffer grow stale requests
+    shard.counters.dispatch_drops.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  DispatchSlot &slot = dispatch_slots_[index];
+  std::memcpy(slot.datagram.data, datagram.data, datagram.length);
+  slot.datagram.length = datagram.length;
+  std::memcpy(&slot.datagram.address, &datagram.address,
+              datagram.address_length);
+  slot.datagram.address_length = datagram.address_length;
+  slot.datagram.timestamp_ns = datagram.timestamp_ns;
+  slot.shard_id = shard.id;
+  slot.received = received_at;
+
+  if (fair_queue_) {
+    // Refused when the source already holds its share of the queue
+    NetworkAddress source;
+    NetworkAddress::from_sockaddr(datagram.address, datagram.address_length,
+                                  source);
+    if (!fair_queue_->push(source, index,
+                           static_cast<uint32_t>(datagram.length))) {
+      dispatch_free_->try_push(index);
+      shard.counters.dispatch_drops.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  } else {
+    dispatch_ready_->try_push(index);
+  }
+  shard.counters.dispatched.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SNMPServer::next_dispatched(uint32_t &index) {
+  return fair_queue_ ? fair_queue_->pop(index)
+                     : dispatch_ready_->try_pop(index);
+}
+
+size_t SNMPServer::dispatch_pending() const {
+  if (fair_queue_) {
+    return fair_queue_->size();
+  }
+  return dispatch_ready_ ? dispatch_ready_->size() : 0;
+}
+
+void SNMPServer::wake_workers() {
+  // Pairs with the fence in wait_for_dispatch: either the worker sees the
+  // new datagrams or we see it idle and wake it under the mutex
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (idle_workers_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(dispatch_mutex_);
+  dispatch_condition_.notify_all();
+}
+
+void SNMPServer::wait_for_dispatch() {
+  std::unique_lock<std::mutex> lock(dispatch_mutex_);
+  idle_workers_.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  dispatch_condition_.wait_for(lock, std::chrono::milliseconds(100), [this] {
+    return !running_ || dispatch_pending() > 0;
+  });
+  idle_workers_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void SNMPServer::worker_loop(Worker &worker) {
+  Logger::get_instance().log(LogLevel::DEBUG,
+                             "Worker thread " + std::to_string(worker.id) +
+                                 " started");
 
-  Logger::get_instance().log(LogLevel::INFO, "Starting SNMP server...");
+  Transmitter &transmitter = worker.transmitter;
+  DatagramBatch &responses = *transmitter.responses;
+  std::chrono::steady_clock::time_point batch_started;
 
-  running_ = true;
+  while (running_) {
+    // Take the requests queued right now, at most one response batch, then
+    // send. Under sustained load the queue never drains, so a response is
+    // also sent once it has waited SNMP_WORKER_FLUSH_DEADLINE for others.
+    size_t burst = std::min(std::max<size_t>(dispatch_pending(), 1),
+                            responses.capacity());
+    size_t taken = 0;
+    uint32_t index;
+    while (taken < burst && next_dispatched(index)) {
+      ++taken;
+      DispatchSlot &slot = dispatch_slots_[index];
+      Shard &shard = *shards_[slot.shard_id];
+
+      // Responses leave through the socket the request arrived on
+      DatagramEngine *engine = worker.engines[slot.shard_id].get();
+      if (transmitter.engine != engine) {
+        flush_responses(transmitter);
+        transmitter.engine = engine;
+        transmitter.counters = &shard.counters;
+      }
+
+      auto now = std::chrono::steady_clock::now();
+      auto waited = std::chrono::duration_cast<std::chrono::microseconds>(
+          now - slot.received);
+      shard.counters.queue_wait_us.fetch_add(waited.count(),
+                                             std::memory_order_relaxed);
+
+      if (responses.empty()) {
+        batch_started = now;
+      } else if (now - batch_started >= SNMP_WORKER_FLUSH_DEADLINE) {
+        flush_responses(transmitter);
+        batch_started = now;
+      }
+      handle_datagram(slot.datagram, slot.shard_id, slot.received,
+                      transmitter);
+      dispatch_free_->try_push(index);
+    }
 
-  // Start worker threads
-  for (size_t i = 0; i < thread_pool_size_; ++i) {
-    worker_threads_.emplace_back(&SNMPServer::worker_thread, this);
+    if (taken == 0) {
+      // Queue drained and everything sent; sleep
+      wait_for_dispatch();
+      continue;
+    }
+    flush_responses(transmitter);
   }
 
-  // Start main server loop
-  server_thread_ = std::thread(&SNMPServer::server_loop, this);
+  flush_responses(transmitter);
 
-  Logger::get_instance().log(LogLevel::INFO,
-                             "SNMP server started successfully");
-  return true;
+  Logger::get_instance().log(LogLevel::DEBUG,
+                             "Worker thread " + std::to_string(worker.id) +
+                                 " ended");
 }
 
-void SNMPServer::stop() {
-  if (!running_) {
+void SNMPServer::handle_datagram(
+    const Datagram &datagram, uint32_t shard_id,
+    std::chrono::steady_clock::time_point received_at,
+    Transmitter &transmitter) {
+  if (datagram.length == 0) {
     return;
   }
 
-  Logger::get_instance().log(LogLevel::INFO, "Stopping SNMP server...");
+  RequestContext context(datagram.address, datagram.address_length,
+                         received_at, shard_id);
+  context.arrival_ns = datagram.timestamp_ns;
 
-  running_ = false;
+  // Blocked and rate limited sources get nothing, not even a response
+  // cached before they were
+  if (!check_source(context)) {
+    return;
+  }
 
-  // Close server socket to wake up accept
-  if (server_socket_ != -1) {
-    close(server_socket_);
-    server_socket_ = -1;
+  // A retransmission is answered with the response already sent
+  ResponseCache::Key cache_key;
+  uint64_t cache_digest = 0;
+  bool cacheable = response_cache_.is_enabled() &&
+                   ResponseCache::make_key(context, datagram.data,
+                                           datagram.length, cache_key,
+                                           cache_digest);
+  if (cacheable &&
+      answer_from_cache(cache_key, cache_digest, context, transmitter)) {
+    return;
   }
 
-  // Wait for server thread
-  if (server_thread_.joinable()) {
-    server_thread_.join();
+  // Route on the message version; only the SNMPv1/v2c parser runs on
+  // community messages and only the message processor on SNMPv3 ones
+  uint8_t version = 0;
+  ParseResult parsed =
+      peek_message_version(datagram.data, datagram.length, version);
+  if (parsed && version == SNMP_VERSION_3) {
+    handle_v3_datagram(context, datagram, transmitter);
+    return;
   }
 
-  // Wait for worker threads
-  for (auto &thread : worker_threads_) {
-    if (thread.joinable()) {
-      thread.join();
-    }
+  // The request is read in place; nothing of it outlives this call
+  SNMPPacketView packet;
+  if (parsed) {
+    parsed = packet.parse(datagram.data, datagram.length);
+  }
+  if (!parsed) {
+    Counters &counters = *transmitter.counters;
+    counters.parse_errors.fetch_add(1, std::memory_order_relaxed);
+    counters.parse_error_reasons[static_cast<size_t>(parsed.error)].fetch_add(
+        1, std::memory_order_relaxed);
+    log_parse_error(context, parsed, "udp");
+    return;
   }
-  worker_threads_.clear();
 
-  // Close all connections
-  std::lock_guard<std::mutex> lock(connections_mutex_);
-  for (auto &connection : connections_) {
-    connection->close();
+  // Shed low priority requests while the receive queue is standing
+  if (admission_.is_enabled() &&
+      !admission_.admit(context, packet, realtime_ns())) {
+    return;
   }
-  connections_.clear();
 
-  Logger::get_instance().log(LogLevel::INFO, "SNMP server stopped");
+  // Process the request
+  process_snmp_request(context, packet, transmitter,
+                       cacheable ? &cache_key : nullptr, cache_digest);
+  transmitter.counters->requests_processed.fetch_add(
+      1, std::memory_order_relaxed);
 }
 
-void SNMPServer::server_loop() {
-  Logger::get_instance().log(LogLevel::INFO, "SNMP server main loop started");
+void SNMPServer::handle_v3_datagram(const RequestContext &context,
+                                    const Datagram &datagram,
+                                    Transmitter &transmitter) {
+  // Rejections are counted by the message processor
+  SNMPv3Packet request;
+  if (!decode_v3_message(context, datagram.data, datagram.length, "udp",
+                         request)) {
+    return;
+  }
 
-  while (running_) {
-    struct sockaddr_in client_addr;
-    socklen_t client_addr_len = sizeof(client_addr);
+  std::vector<uint8_t> pdu_buffer;
+  SNMPPacketView pdu;
+  if (!view_scoped_pdu(request, datagram.data, datagram.length, pdu_buffer,
+                       pdu)) {
+    return;
+  }
+  if (admission_.is_enabled() &&
+      !admission_.admit(context, pdu,
+                        request.get_security_parameters().username,
+                        realtime_ns())) {
+    return;
+  }
 
-    uint8_t buffer[4096];
-    ssize_t bytes_received = recvfrom(
-        server_socket_, reinterpret_cast<char *>(buffer), sizeof(buffer), 0,
-        reinterpret_cast<struct sockaddr *>(&client_addr), &client_addr_len);
+  std::vector<uint8_t> message;
+  if (build_v3_response(context, request, pdu, max_response_size_,
+                        SNMP_MAX_UDP_PAYLOAD, message)) {
+    queue_message(message, context, transmitter);
+  }
+  transmitter.counters->requests_processed.fetch_add(
+      1, std::memory_order_relaxed);
+}
 
-    if (bytes_received < 0) {
-      if (running_) {
-        Logger::get_instance().log(LogLevel::ERROR, "Failed to receive data");
-      }
-      continue;
-    }
+bool SNMPServer::decode_v3_message(const RequestContext &context,
+                                   const uint8_t *data, size_t length,
+                                   const char *transport,
+                                   SNMPv3Packet &request) {
+  // Parsing, authentication and decryption (RFC 3412 7.2, RFC 3414 3.2).
+  // The processor takes a vector; each thread reuses one for the copy.
+  thread_local std::vector<uint8_t> bytes;
+  bytes.assign(data, data + length);
+  if (SNMPv3MessageProcessor::get_instance().process_incoming_message(
+          bytes, request)) {
+    return true;
+  }
 
-    if (bytes_received == 0) {
-      continue;
+  Logger &logger = Logger::get_instance();
+  uint64_t suppressed = 0;
+  if (logger.is_enabled(LogLevel::WARNING) &&
+      parse_error_log_.allow(suppressed)) {
+    std::string message = "Dropped SNMPv3 message from " +
+                          context.address_string() + " (" + transport +
+                          "): " + request.get_error_message();
+    if (suppressed > 0) {
+      message += " (" + std::to_string(suppressed) +
+                 " similar messages suppressed)";
     }
+    logger.log(LogLevel::WARNING, message);
+  }
+  return false;
+}
 
-    // Create connection object
-    std::string client_address = inet_ntoa(client_addr.sin_addr);
-    uint16_t client_port = ntohs(client_addr.sin_port);
-
-    auto connection =
-        std::make_shared<SNMPConnection>(-1, client_address, client_port);
+bool SNMPServer::build_v3_response(const RequestContext &context,
+                                   const SNMPv3Packet &request,
+                                   const SNMPPacketView &pdu, size_t max_size,
+                                   size_t receive_limit,
+                                   std::vector<uint8_t> &message) {
+  Logger &logger = Logger::get_instance();
+
+  // msgMaxSize is the largest message the manager accepts (RFC 3412 6);
+  // the PDU gets what is left after the SNMPv3 header and USM fields
+  size_t limit = std::min<size_t>(max_size, request.get_max_size());
+  size_t overhead = v3_overhead(request, pdu);
+  if (limit <= overhead) {
+    if (logger.is_enabled(LogLevel::DEBUG)) {
+      logger.log(LogLevel::DEBUG,
+                 "Dropping SNMPv3 request from " + context.address_string() +
+                     ": msgMaxSize " + std::to_string(request.get_max_size()) +
+                     " leaves no room for a response");
+    }
+    return false;
+  }
 
-    // Parse SNMP packet
-    SNMPPacket packet;
-    if (!packet.parse(buffer, bytes_received)) {
-      Logger::get_instance().log(LogLevel::ERROR,
-                                 "Failed to parse SNMP packet from " +
-                                     client_address);
-      continue;
+  // Scoped PDUs follow the SNMPv2 rules for errors and exceptions
+  SNMPPacket reply;
+  reply.set_version(SNMP_VERSION_3);
+  reply.set_request_id(pdu.get_request_id());
+
+  SNMPv3MessageProcessor &processor = SNMPv3MessageProcessor::get_instance();
+  if (!processor.check_access_control(request)) {
+    // Not in the user's VACM view (RFC 3415 3.2): authorizationError
+    if (logger.is_enabled(LogLevel::WARNING)) {
+      logger.log(LogLevel::WARNING,
+                 "SNMPv3 access denied for user " +
+                     request.get_security_parameters().username + " from " +
+                     context.address_string());
+    }
+    reply.set_pdu_type(SNMP_PDU_GET_RESPONSE);
+    if (!set_error(pdu, reply, SNMP_ERROR_AUTHORIZATION_ERROR, 0,
+                   limit - overhead) &&
+        !set_too_big(pdu, reply, limit - overhead)) {
+      return false;
     }
+  } else if (!process_pdu(context, pdu, reply, limit - overhead)) {
+    return false;
+  }
 
-    // Process the request
-    process_snmp_request(connection, packet, client_addr);
+  // Responses are never reportable (RFC 3412 7.1 step 3)
+  SNMPv3MessageFlags flags = request.get_message_flags();
+  flags.reportable = false;
+
+  SNMPv3Packet response;
+  response.set_message_id(request.get_message_id());
+  response.set_max_size(static_cast<uint32_t>(receive_limit));
+  response.set_message_flags(flags);
+  response.set_security_model(request.get_security_model());
+  response.set_security_parameters(request.get_security_parameters());
+  SNMPv3ScopedPDU scoped;
+  scoped.context_engine_id = pdu.get_context_engine_id().to_vector();
+  scoped.context_name = pdu.get_context_name().to_string();
+  scoped.pdu = reply;
+  response.set_scoped_pdu(scoped);
+
+  if (!processor.process_outgoing_message(response, message)) {
+    logger.log(LogLevel::ERROR, "Failed to encode SNMPv3 response: " +
+                                    response.get_error_message());
+    return false;
+  }
+  if (message.size() > limit) {
+    logger.log(LogLevel::WARNING,
+               "SNMPv3 response of " + std::to_string(message.size()) +
+                   " bytes exceeds the " + std::to_string(limit) +
+                   " byte limit");
+    return false;
   }
+  return true;
+}
 
-  Logger::get_instance().log(LogLevel::INFO, "SNMP server main loop ended");
+void SNMPServer::process_snmp_request(const RequestContext &context,
+                                      const SNMPPacketView &request,
+                                      Transmitter &transmitter,
+                                      const ResponseCache::Key *cache_key,
+                                      uint64_t cache_digest) {
+  SNMPPacket response;
+  if (build_response(context, request, response, max_response_size_)) {
+    // Queue response for the next batch flush
+    queue_response(response, context, transmitter, cache_key, cache_digest);
+  }
 }
 
-void SNMPServer::worker_thread() {
-  Logger::get_instance().log(LogLevel::DEBUG, "Worker thread started");
+bool SNMPServer::handle_stream_message(const RequestContext &context,
+                                       const uint8_t *data, size_t length,
+                                       std::vector<uint8_t> &response) {
+  Logger &logger = Logger::get_instance();
+  size_t max_size = config_.get_tcp_max_message_size();
+  if (!check_source(context)) {
+    return false;
+  }
 
-  while (running_) {
-    // TODO: Implement worker thread logic for processing requests
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  uint8_t version = 0;
+  ParseResult parsed = peek_message_version(data, length, version);
+  if (parsed && version == SNMP_VERSION_3) {
+    SNMPv3Packet request;
+    if (!decode_v3_message(context, data, length, "tcp", request)) {
+      return false;
+    }
+    tcp_requests_processed_.fetch_add(1, std::memory_order_relaxed);
+    std::vector<uint8_t> pdu_buffer;
+    SNMPPacketView pdu;
+    return view_scoped_pdu(request, data, length, pdu_buffer, pdu) &&
+           build_v3_response(context, request, pdu, max_size, max_size,
+                             response);
   }
 
-  Logger::get_instance().log(LogLevel::DEBUG, "Worker thread ended");
-}
+  // Read in place from the connection's input buffer
+  SNMPPacketView packet;
+  if (parsed) {
+    parsed = packet.parse(data, length);
+  }
+  if (!parsed) {
+    tcp_parse_errors_.fetch_add(1, std::memory_order_relaxed);
+    tcp_parse_error_reasons_[static_cast<size_t>(parsed.error)].fetch_add(
+        1, std::memory_order_relaxed);
+    log_parse_error(context, parsed, "tcp");
+    return false;
+  }
+  tcp_requests_processed_.fetch_add(1, std::memory_order_relaxed);
 
-void SNMPServer::process_snmp_request(
-    std::shared_ptr<SNMPConnection> connection, const SNMPPacket &request,
-    const struct sockaddr_in &client_addr) {
-  Logger::get_instance().log(LogLevel::DEBUG,
-                             "Processing SNMP request from " +
-                                 connection->get_client_address());
+  // Streams have no datagram size limit; responses are bounded by the
+  // largest message the transport accepts
+  SNMPPacket reply;
+  if (!build_response(context, packet, reply, max_size)) {
+    return false;
+  }
 
-  // Check rate limiting
-  if (!SecurityManager::get_instance().check_rate_limit(
-          connection->get_client_address())) {
-    Logger::get_instance().log(LogLevel::WARNING,
-                               "Rate limit exceeded for " +
-                                   connection->get_client_address());
-    return;
+  if (!reply.serialize(response)) {
+    logger.log(LogLevel::ERROR, "Failed to serialize response");
+    return false;
   }
+  return true;
+}
 
-  // Check IP access
-  if (!SecurityManager::get_instance().is_ip_allowed(
-          connection->get_client_address())) {
-    Logger::get_instance().log(LogLevel::WARNING,
-                               "Access denied for IP " +
-                                   connection->get_client_address());
+void SNMPServer::log_parse_error(const RequestContext &context,
+                                 const ParseResult &result,
+                                 const char *transport) {
+  Logger &logger = Logger::get_instance();
+  uint64_t suppressed = 0;
+  if (!logger.is_enabled(LogLevel::ERROR) ||
+      !parse_error_log_.allow(suppressed)) {
     return;
   }
 
+  std::string message = "Failed to parse SNMP message from " +
+                        context.address_string() + " (" + transport +
+                        "): " + parse_error_name(result.error) +
+                        " at offset " + std::to_string(result.offset);
+  if (suppressed > 0) {
+    message += " (" + std::to_string(suppressed) +
+               " similar messages suppressed)";
+  }
+  logger.log(LogLevel::ERROR, message);
+}
+
+bool SNMPServer::build_response(const RequestContext &context,
+                                const SNMPPacketView &request,
+                                SNMPPacket &response, size_t max_size) {
+  Logger &logger = Logger::get_instance();
+
   // Validate community string and access
-  if (!SecurityManager::get_instance().is_access_allowed(
-          request.get_community(), connection->get_client_address())) {
-    Logger::get_instance().log(LogLevel::WARNING,
-                               "Access denied for community " +
-                                   request.get_community() + " from " +
-                                   connection->get_client_address());
-    return;
+  std::string community = request.get_community().to_string();
+  if (!SecurityManager::get_instance().is_access_allowed(community,
+                                                         context)) {
+    if (logger.is_enabled(LogLevel::WARNING)) {
+      logger.log(LogLevel::WARNING, "Access denied for community " +
+                                        community + " from " +
+                                        context.address_string());
+    }
+    return false;
   }
 
   // Create response packet
-  SNMPPacket response;
   response.set_version(request.get_version());
-  response.set_community(request.get_community());
+  response.set_community(community);
   response.set_request_id(request.get_request_id());
+  return process_pdu(context, request, response, max_size);
+}
+
+bool SNMPServer::check_source(const RequestContext &context) {
+  Logger &logger = Logger::get_instance();
+  SecurityManager &security = SecurityManager::get_instance();
+
+  if (logger.is_enabled(LogLevel::DEBUG)) {
+    logger.log(LogLevel::DEBUG, "Processing SNMP request from " +
+                                    context.address_string() + ":" +
+                                    std::to_string(context.port()));
+  }
+
+  // Check rate limiting
+  if (!security.check_rate_limit(context)) {
+    if (logger.is_enabled(LogLevel::WARNING)) {
+      logger.log(LogLevel::WARNING,
+                 "Rate limit exceeded for " + context.address_string());
+    }
+    return false;
+  }
+
+  // Check IP access
+  if (!security.is_ip_allowed(context)) {
+    if (logger.is_enabled(LogLevel::WARNING)) {
+      logger.log(LogLevel::WARNING,
+                 "Access denied for IP " + context.address_string());
+    }
+    return false;
+  }
+  return true;
+}
+
+bool SNMPServer::process_pdu(const RequestContext &context,
+                             const SNMPPacketView &request,
+                             SNMPPacket &response, size_t max_size) {
+  Logger &logger = Logger::get_instance();
 
   // Process based on PDU type
+  bool fits = true;
   switch (request.get_pdu_type()) {
   case SNMP_PDU_GET_REQUEST:
-    process_get_request(request, response);
+    fits = process_get_request(request, response, max_size);
     break;
   case SNMP_PDU_GET_NEXT_REQUEST:
-    process_get_next_request(request, response);
+    fits = process_get_next_request(request, response, max_size);
     break;
   case SNMP_PDU_GET_BULK_REQUEST:
     // GET-BULK is only supported in SNMP v2c and v3
     if (request.get_version() == SNMP_VERSION_2C ||
         request.get_version() == SNMP_VERSION_3) {
-      process_get_bulk_request(request, response);
+      process_get_bulk_request(request, response, max_size);
     } else {
       Logger::get_instance().log(LogLevel::WARNING,
                                  "GET-BULK not supported in SNMP v1");
@@ -283,7 +1545,7 @@ void SNMPServer::process_snmp_request(
     }
     break;
   case SNMP_PDU_SET_REQUEST:
-    process_set_request(request, response);
+    fits = process_set_request(request, response, max_size);
     break;
   case SNMP_PDU_TRAP:
     // Handle SNMP v1 traps
@@ -313,243 +1575,756 @@ void SNMPServer::process_snmp_request(
     break;
   }
 
-  // Send response
-  send_response(response, client_addr);
+  // Error status and index can still lengthen a response after its last
+  // variable binding was added
+  if (!fits || response.encoded_size() > max_size) {
+    if (logger.is_enabled(LogLevel::DEBUG)) {
+      logger.log(LogLevel::DEBUG, "Response to " + context.address_string() +
+                                      " exceeds " + std::to_string(max_size) +
+                                      " bytes, answering tooBig");
+    }
+    return set_too_big(request, response, max_size);
+  }
+  return true;
+}
+
+bool SNMPServer::set_too_big(const SNMPPacketView &request,
+                             SNMPPacket &response, size_t max_size) {
+  too_big_responses_.fetch_add(1, std::memory_order_relaxed);
+
+  // RFC 3416 4.2.1: tooBig, error index zero and no variable bindings.
+  // SNMPv1 (RFC 1157 4.1.2) echoes the request's bindings instead.
+  response.set_pdu_type(SNMP_PDU_GET_RESPONSE);
+  response.set_error_status(SNMP_ERROR_TOO_BIG);
+  response.set_error_index(0);
+  response.clear_variable_bindings();
+  if (request.get_version() == SNMP_VERSION_1 &&
+      !echo_bindings(request, response, max_size)) {
+    response.clear_variable_bindings();
+  }
+
+  if (response.encoded_size() > max_size) {
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "Dropping request: even a tooBig response "
+                               "exceeds " +
+                                   std::to_string(max_size) + " bytes");
+    return false;
+  }
+  return true;
 }
 
-void SNMPServer::process_get_request(const SNMPPacket &request,
-                                     SNMPPacket &response) {
+bool SNMPServer::process_get_request(const SNMPPacketView &request,
+                                     SNMPPacket &response, size_t max_size) {
   response.set_pdu_type(SNMP_PDU_GET_RESPONSE);
 
-  for (const auto &varbind : request.get_variable_bindings()) {
-    SNMPPacket::VariableBinding response_varbind;
-    response_varbind.oid = varbind.oid;
+  MIBManager &mib = MIBManager::get_instance();
+  size_t count = request.get_variable_binding_count();
+
+  // Handles point into the published MIB version; keep the version read
+  // by generation() alive until the last one has been read
+  EpochManager::Guard guard;
+
+  // Pollers repeat the same list every interval; resolve it only once
+  std::vector<MIBManager::Handle> handles;
+  uint64_t generation = mib.generation();
+  uint64_t shape = 0;
+  // One name buffer serves every binding the MIB needs an OID vector for
+  std::vector<uint8_t> name;
+  if (shape_cache_.is_enabled()) {
+    shape = RequestShapeCache::hash(request);
+  }
+  if (!shape_cache_.is_enabled() ||
+      !shape_cache_.lookup(shape, request, generation, handles)) {
+    handles.resize(count);
+    size_t i = 0;
+    for (const auto &binding : request) {
+      name.assign(binding.oid.begin(), binding.oid.end());
+      mib.resolve(name, handles[i++]);
+    }
+    if (shape_cache_.is_enabled()) {
+      shape_cache_.insert(shape, request, generation, handles);
+    }
+  }
+
+  size_t i = 0;
+  SNMPPacket::VariableBinding response_varbind;
+  for (auto binding = request.begin(); binding != request.end();
+       ++binding, ++i) {
+    response_varbind.oid.assign(binding->oid.begin(), binding->oid.end());
 
     // Look up value in MIB
     MIBValue mib_value;
-    if (MIBManager::get_instance().get_value(varbind.oid, mib_value)) {
+    if (mib.get_value(handles[i], mib_value)) {
       response_varbind.value_type = static_cast<uint8_t>(mib_value.type);
-      response_varbind.value = mib_value.data;
+      response_varbind.value.swap(mib_value.data);
+    } else if (request.get_version() == SNMP_VERSION_1) {
+      return set_error(request, response, SNMP_ERROR_NO_SUCH_NAME, i + 1,
+                       max_size);
     } else {
-      // No such object
-      response_varbind.value_type = 0x05; // NULL
+      // SNMPv2 reports missing objects per binding (RFC 3416 4.2.1)
+      SNMPDataType exception = mib.has_object(response_varbind.oid)
+                                   ? SNMPDataType::NO_SUCH_INSTANCE
+                                   : SNMPDataType::NO_SUCH_OBJECT;
+      response_varbind.value_type = static_cast<uint8_t>(exception);
       response_varbind.value.clear();
-      response.set_error_status(SNMP_ERROR_NO_SUCH_NAME);
-      response.set_error_index(
-          static_cast<uint8_t>(request.get_variable_bindings().size()));
     }
 
-    response.add_variable_binding(response_varbind);
+    if (!response.add_variable_binding(response_varbind, max_size)) {
+      return false;
+    }
   }
+  return true;
 }
 
-void SNMPServer::process_get_next_request(const SNMPPacket &request,
-                                          SNMPPacket &response) {
+bool SNMPServer::process_get_next_request(const SNMPPacketView &request,
+                                          SNMPPacket &response,
+                                          size_t max_size) {
   response.set_pdu_type(SNMP_PDU_GET_RESPONSE);
 
-  for (const auto &varbind : request.get_variable_bindings()) {
-    SNMPPacket::VariableBinding response_varbind;
-
+  MIBManager::Cursor cursor(MIBManager::get_instance());
+  std::vector<uint8_t> name;
+  SNMPPacket::VariableBinding response_varbind;
+  size_t i = 0;
+  for (auto binding = request.begin(); binding != request.end();
+       ++binding, ++i) {
     // Find the next OID in lexicographic order
-    std::vector<uint8_t> next_oid;
-    if (MIBManager::get_instance().get_next_oid(varbind.oid, next_oid)) {
-      response_varbind.oid = next_oid;
-
-      // Get the value for the next OID
-      MIBValue mib_value;
-      if (MIBManager::get_instance().get_value(next_oid, mib_value)) {
-        response_varbind.value_type = static_cast<uint8_t>(mib_value.type);
-        response_varbind.value = mib_value.data;
-      } else {
-        // This shouldn't happen if get_next_oid worked correctly
-        response_varbind.value_type = 0x05; // NULL
-        response_varbind.value.clear();
-      }
-    } else {
-      // No more objects - return endOfMibView
-      response_varbind.oid = varbind.oid;
-      response_varbind.value_type = 0x05; // NULL
-      response_varbind.value.clear();
+    name.assign(binding->oid.begin(), binding->oid.end());
+    cursor.seek_after(name);
+    if (!bind_cursor(cursor, binding->oid, response_varbind) &&
+        request.get_version() == SNMP_VERSION_1) {
+      return set_error(request, response, SNMP_ERROR_NO_SUCH_NAME, i + 1,
+                       max_size);
+    }
+    if (!response.add_variable_binding(response_varbind, max_size)) {
+      return false;
     }
-
-    response.add_variable_binding(response_varbind);
   }
+  return true;
 }
 
-void SNMPServer::process_get_bulk_request(const SNMPPacket &request,
-                                          SNMPPacket &response) {
+void SNMPServer::process_get_bulk_request(const SNMPPacketView &request,
+                                          SNMPPacket &response,
+                                          size_t max_size) {
   response.set_pdu_type(SNMP_PDU_GET_RESPONSE);
 
-  // For simplicity, we'll process GET-BULK as multiple GET-NEXT operations
-  // In a full implementation, we'd need to handle non-repeaters and
-  // max-repetitions
-  const auto &varbinds = request.get_variable_bindings();
-
-  for (size_t i = 0; i < varbinds.size(); ++i) {
-    const auto &varbind = varbinds[i];
-    SNMPPacket::VariableBinding response_varbind;
+  MIBManager &mib = MIBManager::get_instance();
+  size_t count = request.get_variable_binding_count();
+  size_t non_repeaters = std::min<size_t>(request.get_non_repeaters(), count);
+  size_t repeaters = count - non_repeaters;
+
+  // Non-repeaters get a single GETNEXT each
+  MIBManager::Cursor cursor(mib);
+  std::vector<uint8_t> name;
+  SNMPPacket::VariableBinding response_varbind;
+  auto binding = request.begin();
+  for (size_t i = 0; i < non_repeaters; ++i, ++binding) {
+    name.assign(binding->oid.begin(), binding->oid.end());
+    cursor.seek_after(name);
+    bind_cursor(cursor, binding->oid, response_varbind);
+    if (!response.add_variable_binding(response_varbind, max_size)) {
+      truncated_responses_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
 
-    // Find the next OID in lexicographic order
-    std::vector<uint8_t> next_oid;
-    if (MIBManager::get_instance().get_next_oid(varbind.oid, next_oid)) {
-      response_varbind.oid = next_oid;
-
-      // Get the value for the next OID
-      MIBValue mib_value;
-      if (MIBManager::get_instance().get_value(next_oid, mib_value)) {
-        response_varbind.value_type = static_cast<uint8_t>(mib_value.type);
-        response_varbind.value = mib_value.data;
-      } else {
-        // This shouldn't happen if get_next_oid worked correctly
-        response_varbind.value_type = 0x05; // NULL
-        response_varbind.value.clear();
+  // Each repeater walks its column with its own cursor, one step per
+  // repetition, until the response budget is used up
+  std::vector<MIBManager::Cursor> cursors(repeaters, MIBManager::Cursor(mib));
+  std::vector<ByteSpan> columns(repeaters);
+  for (size_t i = 0; i < repeaters; ++i, ++binding) {
+    columns[i] = binding->oid;
+    name.assign(columns[i].begin(), columns[i].end());
+    cursors[i].seek_after(name);
+  }
+  for (uint32_t repetition = 0;
+       repetition < request.get_max_repetitions() && repeaters > 0;
+       ++repetition) {
+    size_t complete = response.get_variable_bindings().size();
+    bool active = false;
+    for (size_t i = 0; i < repeaters; ++i) {
+      if (repetition > 0) {
+        cursors[i].next();
+      }
+      // A walk past the end repeats the name it stopped at
+      ByteSpan last = columns[i];
+      if (repetition > 0) {
+        const std::vector<uint8_t> &previous =
+            response.get_variable_bindings()[complete - repeaters + i].oid;
+        last = ByteSpan(previous.data(), previous.size());
+      }
+      bind_cursor(cursors[i], last, response_varbind);
+      active = active || cursors[i].valid();
+      if (!response.add_variable_binding(response_varbind, max_size)) {
+        // The first repetition keeps whatever fit, so a budget narrower
+        // than one row still gets an answer; later ones are kept whole
+        if (repetition > 0) {
+          response.truncate_variable_bindings(complete);
+        }
+        truncated_responses_.fetch_add(1, std::memory_order_relaxed);
+        return;
       }
-    } else {
-      // No more objects - return endOfMibView
-      response_varbind.oid = varbind.oid;
-      response_varbind.value_type = 0x05; // NULL
-      response_varbind.value.clear();
     }
 
-    response.add_variable_binding(response_varbind);
+    // Every column is exhausted; later repetitions would repeat this one
+    if (!active) {
+      break;
+    }
   }
 }
 
-void SNMPServer::process_set_request(const SNMPPacket &request,
-                                     SNMPPacket &response) {
+bool SNMPServer::process_set_request(const SNMPPacketView &request,
+                                     SNMPPacket &response, size_t max_size) {
   response.set_pdu_type(SNMP_PDU_GET_RESPONSE);
 
-  // Check if write access is allowed for this community
-  if (!SecurityManager::get_instance().is_write_allowed(
-          request.get_community())) {
+  // Check if write access is allowed for this community. A scoped PDU
+  // has no community; SNMPv3 SETs were authorized by VACM before they
+  // got here.
+  SecurityManager &security = SecurityManager::get_instance();
+  bool community_checks = request.get_version() != SNMP_VERSION_3;
+  std::string community = request.get_community().to_string();
+  if (community_checks && !security.is_write_allowed(community)) {
     Logger::get_instance().log(LogLevel::WARNING,
                                "Write access denied for community: " +
-                                   request.get_community());
-    response.set_error_status(SNMP_ERROR_NO_ACCESS);
-    return;
+                                   community);
+    return set_error(request, response, SNMP_ERROR_NO_ACCESS, 0, max_size);
   }
 
-  for (const auto &varbind : request.get_variable_bindings()) {
-    SNMPPacket::VariableBinding response_varbind;
-    response_varbind.oid = varbind.oid;
+  MIBManager &mib = MIBManager::get_instance();
+  SNMPPacket::VariableBinding varbind;
+  size_t i = 0;
+  for (auto binding = request.begin(); binding != request.end();
+       ++binding, ++i) {
+    copy_binding(*binding, varbind);
 
     // Check OID access
-    std::string oid_str = OIDUtils::oid_to_string(varbind.oid);
-    if (!SecurityManager::get_instance().is_oid_allowed(request.get_community(),
-                                                        oid_str)) {
-      response_varbind.value_type = 0x05; // NULL
-      response_varbind.value.clear();
-      response.set_error_status(SNMP_ERROR_NO_ACCESS);
-      response.set_error_index(
-          static_cast<uint8_t>(request.get_variable_bindings().size()));
-      response.add_variable_binding(response_varbind);
-      continue;
+    if (community_checks &&
+        !security.is_oid_allowed(community,
+                                 OIDUtils::oid_to_string(varbind.oid))) {
+      return set_error(request, response, SNMP_ERROR_NO_ACCESS, i + 1,
+                       max_size);
     }
 
     // Check if the object exists and is writable
     MIBValue mib_value;
-    if (MIBManager::get_instance().get_value(varbind.oid, mib_value)) {
-      // Object exists, check if it's writable
-      if (MIBManager::get_instance().is_scalar(varbind.oid)) {
-        // For now, we'll reject all SET operations as read-only
-        response_varbind.value_type = 0x05; // NULL
-        response_varbind.value.clear();
-        response.set_error_status(SNMP_ERROR_READ_ONLY);
-        response.set_error_index(
-            static_cast<uint8_t>(request.get_variable_bindings().size()));
-      } else {
-        // Try to set the value
-        MIBValue new_value(static_cast<SNMPDataType>(varbind.value_type),
-                           varbind.value);
-        if (MIBManager::get_instance().set_value(varbind.oid, new_value)) {
-          // Success - return the new value
-          response_varbind.value_type = varbind.value_type;
-          response_varbind.value = varbind.value;
-        } else {
-          // Set failed
-          response_varbind.value_type = 0x05; // NULL
-          response_varbind.value.clear();
-          response.set_error_status(SNMP_ERROR_WRONG_VALUE);
-          response.set_error_index(
-              static_cast<uint8_t>(request.get_variable_bindings().size()));
-        }
-      }
-    } else {
-      // No such object
-      response_varbind.value_type = 0x05; // NULL
-      response_varbind.value.clear();
-      response.set_error_status(SNMP_ERROR_NO_SUCH_NAME);
-      response.set_error_index(
-          static_cast<uint8_t>(request.get_variable_bindings().size()));
+    if (!mib.get_value(varbind.oid, mib_value)) {
+      return set_error(request, response, SNMP_ERROR_NO_CREATION, i + 1,
+                       max_size);
+    }
+    if (!mib.is_writable(varbind.oid)) {
+      return set_error(request, response, SNMP_ERROR_NOT_WRITABLE, i + 1,
+                       max_size);
+    }
+    MIBValue new_value(static_cast<SNMPDataType>(varbind.value_type),
+                       varbind.value);
+    if (new_value.type != mib_value.type) {
+      return set_error(request, response, SNMP_ERROR_WRONG_TYPE, i + 1,
+                       max_size);
+    }
+    if (!mib.set_value(varbind.oid, new_value)) {
+      return set_error(request, response, SNMP_ERROR_WRONG_VALUE, i + 1,
+                       max_size);
     }
 
-    response.add_variable_binding(response_varbind);
+    // Success - return the new value
+    if (!response.add_variable_binding(varbind, max_size)) {
+      return false;
+    }
   }
+  return true;
 }
 
-void SNMPServer::process_trap_v1(const SNMPPacket &request,
+void SNMPServer::process_trap_v1(const SNMPPacketView &request,
                                  SNMPPacket &response) {
   // SNMP v1 traps don't generate responses, but we log them
   Logger::get_instance().log(
       LogLevel::INFO,
-      "Received SNMP v1 trap from " + request.get_community() + " with " +
-          std::to_string(request.get_variable_bindings().size()) +
+      "Received SNMP v1 trap from " + request.get_community().to_string() +
+          " with " + std::to_string(request.get_variable_binding_count()) +
           " variables");
 
   // Log trap details
-  for (const auto &varbind : request.get_variable_bindings()) {
-    std::string oid_str = OIDUtils::oid_to_string(varbind.oid);
+  for (const auto &varbind : request) {
+    std::string oid_str = OIDUtils::oid_to_string(varbind.oid.to_vector());
     Logger::get_instance().log(
         LogLevel::DEBUG,
         "Trap variable: " + oid_str +
             " (type: " + std::to_string(varbind.value_type) +
-            ", length: " + std::to_string(varbind.value.size()) + ")");
+            ", length: " + std::to_string(varbind.value.length) + ")");
   }
 
   // SNMP v1 traps don't send responses
   return;
 }
 
-void SNMPServer::process_trap_v2(const SNMPPacket &request,
+void SNMPServer::process_trap_v2(const SNMPPacketView &request,
                                  SNMPPacket &response) {
   // SNMP v2c traps don't generate responses, but we log them
   Logger::get_instance().log(
       LogLevel::INFO,
-      "Received SNMP v2c trap from " + request.get_community() + " with " +
-          std::to_string(request.get_variable_bindings().size()) +
+      "Received SNMP v2c trap from " + request.get_community().to_string() +
+          " with " + std::to_string(request.get_variable_binding_count()) +
           " variables");
 
   // Log trap details
-  for (const auto &varbind : request.get_variable_bindings()) {
-    std::string oid_str = OIDUtils::oid_to_string(varbind.oid);
+  for (const auto &varbind : request) {
+    std::string oid_str = OIDUtils::oid_to_string(varbind.oid.to_vector());
     Logger::get_instance().log(
         LogLevel::DEBUG,
         "Trap variable: " + oid_str +
             " (type: " + std::to_string(varbind.value_type) +
-            ", length: " + std::to_string(varbind.value.size()) + ")");
+            ", length: " + std::to_string(varbind.value.length) + ")");
   }
 
   // SNMP v2c traps don't send responses
   return;
 }
 
-void SNMPServer::send_response(const SNMPPacket &response,
-                               const struct sockaddr_in &client_addr) {
-  std::vector<uint8_t> buffer;
-  if (!response.serialize(buffer)) {
-    Logger::get_instance().log(LogLevel::ERROR, "Failed to serialize response");
+bool SNMPServer::answer_from_cache(const ResponseCache::Key &key,
+                                   uint64_t digest,
+                                   const RequestContext &context,
+                                   Transmitter &transmitter) {
+  DatagramBatch &responses = *transmitter.responses;
+  if (responses.full()) {
+    flush_responses(transmitter);
+  }
+
+  // Copy straight into the next send slot; a miss hands the slot back
+  Datagram &slot = responses.append();
+  slot.length = response_cache_.lookup(key, digest, slot.data,
+                                       responses.slot_size());
+  if (slot.length == 0) {
+    responses.discard_last();
+    return false;
+  }
+  std::memcpy(&slot.address, &context.address, context.address_length);
+  slot.address_length = context.address_length;
+  slot.timestamp_ns = context.arrival_ns;
+  return true;
+}
+
+void SNMPServer::queue_response(const SNMPPacket &response,
+                                const RequestContext &context,
+                                Transmitter &transmitter,
+                                const ResponseCache::Key *cache_key,
+                                uint64_t cache_digest) {
+  DatagramBatch &responses = *transmitter.responses;
+  if (responses.full()) {
+    flush_responses(transmitter);
+  }
+
+  // Encode straight into the send slot; the encoder fills it from the
+  // end, so the message is moved to the front afterwards
+  Datagram &slot = responses.append();
+  BerEncoder encoder(slot.data, responses.slot_size());
+  if (!response.serialize(encoder)) {
+    responses.discard_last();
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "Response exceeds the UDP payload limit of " +
+                                   std::to_string(responses.slot_size()) +
+                                   " bytes");
+    return;
+  }
+  std::memmove(slot.data, encoder.data(), encoder.size());
+  slot.length = encoder.size();
+  address_response(slot, context);
+
+  if (cache_key) {
+    response_cache_.insert(*cache_key, cache_digest, slot.data, slot.length);
+  }
+}
+
+void SNMPServer::queue_message(const std::vector<uint8_t> &message,
+                               const RequestContext &context,
+                               Transmitter &transmitter) {
+  DatagramBatch &responses = *transmitter.responses;
+  if (message.size() > responses.slot_size()) {
+    Logger::get_instance().log(LogLevel::WARNING,
+                               "Response exceeds the UDP payload limit of " +
+                                   std::to_string(responses.slot_size()) +
+                                   " bytes");
+    return;
+  }
+  if (responses.full()) {
+    flush_responses(transmitter);
+  }
+
+  Datagram &slot = responses.append();
+  std::memcpy(slot.data, message.data(), message.size());
+  slot.length = message.size();
+  address_response(slot, context);
+}
+
+void SNMPServer::flush_responses(Transmitter &transmitter) {
+  DatagramBatch &responses = *transmitter.responses;
+  if (responses.empty()) {
     return;
   }
 
-  ssize_t bytes_sent = sendto(
-      server_socket_, reinterpret_cast<const char *>(buffer.data()),
-      buffer.size(), 0, reinterpret_cast<const struct sockaddr *>(&client_addr),
-      sizeof(client_addr));
+  Counters &counters = *transmitter.counters;
+
+  // Service time runs from kernel arrival up to the send call
+  uint64_t now_ns = realtime_ns();
+  for (size_t i = 0; i < responses.size(); ++i) {
+    uint64_t arrival_ns = responses[i].timestamp_ns;
+    if (arrival_ns == 0) {
+      continue;
+    }
+    uint64_t service_us =
+        now_ns > arrival_ns ? (now_ns - arrival_ns) / 1000 : 0;
+    counters.service_time_us.fetch_add(service_us, std::memory_order_relaxed);
+    counters.service_time[latency_bucket(service_us)].fetch_add(
+        1, std::memory_order_relaxed);
+  }
+
+  size_t queued = responses.size();
+  size_t syscalls = 0;
+  size_t sent = transmitter.engine->send(responses, syscalls);
+
+  counters.tx_syscalls.fetch_add(syscalls, std::memory_order_relaxed);
+  counters.tx_datagrams.fetch_add(sent, std::memory_order_relaxed);
+
+  if (sent != queued) {
+    counters.tx_errors.fetch_add(queued - sent, std::memory_order_relaxed);
+    Logger::get_instance().log(LogLevel::ERROR,
+                               "Failed to send " +
+                                   std::to_string(queued - sent) + " of " +
+                                   std::to_string(queued) + " responses");
+  }
+}
+
+SNMPServer::Statistics SNMPServer::get_statistics() const {
+  Statistics total;
+  for (const auto &stats : get_shard_statistics()) {
+    total.rx_syscalls += stats.rx_syscalls;
+    total.rx_datagrams += stats.rx_datagrams;
+    total.rx_errors += stats.rx_errors;
+    total.rx_oversized += stats.rx_oversized;
+    total.tx_syscalls += stats.tx_syscalls;
+    total.tx_datagrams += stats.tx_datagrams;
+    total.tx_errors += stats.tx_errors;
+    total.requests_processed += stats.requests_processed;
+    total.parse_errors += stats.parse_errors;
+    for (size_t i = 0; i < SNMP_PARSE_ERRORS; ++i) {
+      total.parse_error_reasons[i] += stats.parse_error_reasons[i];
+    }
+    total.dispatched += stats.dispatched;
+    total.dispatch_drops += stats.dispatch_drops;
+    total.queue_wait_us += stats.queue_wait_us;
+    for (size_t i = 0; i < SNMP_BATCH_FILL_BUCKETS; ++i) {
+      total.batch_fill[i] += stats.batch_fill[i];
+    }
+    total.kernel_drops += stats.kernel_drops;
+    total.receive_buffer_bytes += stats.receive_buffer_bytes;
+    total.queue_delay_us += stats.queue_delay_us;
+    total.service_time_us += stats.service_time_us;
+    for (size_t i = 0; i < SNMP_LATENCY_BUCKETS; ++i) {
+      total.queue_delay[i] += stats.queue_delay[i];
+      total.service_time[i] += stats.service_time[i];
+    }
+  }
+  total.requests_processed +=
+      tcp_requests_processed_.load(std::memory_order_relaxed);
+  total.parse_errors += tcp_parse_errors_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < SNMP_PARSE_ERRORS; ++i) {
+    total.parse_error_reasons[i] +=
+        tcp_parse_error_reasons_[i].load(std::memory_order_relaxed);
+  }
+  total.too_big = too_big_responses_.load(std::memory_order_relaxed);
+  total.truncated = truncated_responses_.load(std::memory_order_relaxed);
+  return total;
+}
+
+std::vector<SNMPServer::Statistics> SNMPServer::get_shard_statistics() const {
+  std::vector<Statistics> result;
+  result.reserve(shards_.size());
+  for (const auto &shard : shards_) {
+    result.push_back(shard->counters.snapshot());
+  }
+  return result;
+}
+
+size_t SNMPServer::get_dispatch_queue_depth() const {
+  return dispatch_pending();
+}
+
+FairQueue::Statistics SNMPServer::get_fair_queue_statistics() const {
+  return fair_queue_ ? fair_queue_->get_statistics() : FairQueue::Statistics();
+}
+
+std::vector<FairQueue::FlowStatistics>
+SNMPServer::get_top_sources(size_t count) const {
+  if (!fair_queue_) {
+    return std::vector<FairQueue::FlowStatistics>();
+  }
+  return fair_queue_->top_flows(count);
+}
+
+AdmissionController::Statistics SNMPServer::get_admission_statistics() const {
+  return admission_.get_statistics();
+}
+
+ResponseCache::Statistics SNMPServer::get_response_cache_statistics() const {
+  return response_cache_.get_statistics();
+}
+
+RequestShapeCache::Statistics SNMPServer::get_shape_cache_statistics() const {
+  return shape_cache_.get_statistics();
+}
+
+TcpTransport::Statistics SNMPServer::get_tcp_statistics() const {
+  return tcp_transport_ ? tcp_transport_->get_statistics()
+                        : TcpTransport::Statistics();
+}
+
+void SNMPServer::publish_metrics() const {
+  std::vector<Statistics> shard_stats = get_shard_statistics();
+
+  for (size_t shard = 0; shard < shard_stats.size(); ++shard) {
+    const Statistics &stats = shard_stats[shard];
+    std::map<std::string, std::string> labels = {
+        {"shard", std::to_string(shard)},
+        {"endpoint",
+         listen_endpoint_to_string(endpoints_[shards_[shard]->endpoint])}};
+
+    publish_metric("snmp_rx_syscalls_total", "Receive system calls",
+                   PrometheusMetricType::COUNTER, stats.rx_syscalls, labels);
+    publish_metric("snmp_rx_datagrams_total", "Datagrams received",
+                   PrometheusMetricType::COUNTER, stats.rx_datagrams, labels);
+    publish_metric("snmp_rx_errors_total", "Failed receive calls",
+                   PrometheusMetricType::COUNTER, stats.rx_errors, labels);
+    publish_metric("snmp_rx_oversized_total",
+                   "Requests dropped for exceeding the receive buffer",
+                   PrometheusMetricType::COUNTER, stats.rx_oversized, labels);
+    publish_metric("snmp_tx_syscalls_total", "Send system calls",
+                   PrometheusMetricType::COUNTER, stats.tx_syscalls, labels);
+    publish_metric("snmp_tx_datagrams_total", "Datagrams sent",
+                   PrometheusMetricType::COUNTER, stats.tx_datagrams, labels);
+    publish_metric("snmp_tx_errors_total", "Responses that could not be sent",
+                   PrometheusMetricType::COUNTER, stats.tx_errors, labels);
+    publish_metric("snmp_requests_processed_total", "Requests processed",
+                   PrometheusMetricType::COUNTER, stats.requests_processed,
+                   labels);
+    publish_metric("snmp_parse_errors_total", "Datagrams that failed to parse",
+                   PrometheusMetricType::COUNTER, stats.parse_errors, labels);
+    for (size_t i = 1; i < SNMP_PARSE_ERRORS; ++i) {
+      publish_metric(
+          "snmp_parse_errors_by_reason_total",
+          "Datagrams that failed to parse, by reason",
+          PrometheusMetricType::COUNTER, stats.parse_error_reasons[i],
+          {{"shard", labels["shard"]},
+           {"endpoint", labels["endpoint"]},
+           {"reason", parse_error_name(static_cast<ParseError>(i))}});
+    }
+    publish_metric("snmp_dispatch_queued_total",
+                   "Datagrams handed to worker threads",
+                   PrometheusMetricType::COUNTER, stats.dispatched, labels);
+    publish_metric("snmp_dispatch_drops_total",
+                   "Datagrams dropped because the dispatch queue was full",
+                   PrometheusMetricType::COUNTER, stats.dispatch_drops,
+                   labels);
+    publish_metric("snmp_dispatch_queue_wait_seconds_total",
+                   "Time datagrams spent waiting for a worker thread",
+                   PrometheusMetricType::COUNTER, stats.queue_wait_us / 1e6,
+                   labels);
+
+    for (size_t i = 0; i < SNMP_BATCH_FILL_BUCKETS; ++i) {
+      publish_metric("snmp_rx_batch_fill_total",
+                     "Receive calls by number of datagrams returned",
+                     PrometheusMetricType::COUNTER, stats.batch_fill[i],
+                     {{"shard", labels["shard"]},
+                      {"endpoint", labels["endpoint"]},
+                      {"datagrams", batch_fill_label(i)}});
+    }
+
+    publish_metric("snmp_kernel_drops_total",
+                   "Datagrams dropped by the kernel because the socket "
+                   "receive buffer was full",
+                   PrometheusMetricType::COUNTER, stats.kernel_drops, labels);
+    publish_metric("snmp_receive_buffer_bytes",
+                   "Socket receive buffer size reported by the kernel",
+                   PrometheusMetricType::GAUGE,
+                   static_cast<double>(stats.receive_buffer_bytes), labels);
+    publish_latency_histogram("snmp_queue_delay_seconds",
+                              "Time from kernel arrival to the receive call",
+                              stats.queue_delay, stats.queue_delay_us, labels);
+    publish_latency_histogram("snmp_service_time_seconds",
+                              "Time from kernel arrival to the send call",
+                              stats.service_time, stats.service_time_us,
+                              labels);
+  }
+
+  publish_metric("snmp_too_big_responses_total",
+                 "Requests answered with tooBig because the response "
+                 "exceeded the message size limit",
+                 PrometheusMetricType::COUNTER,
+                 too_big_responses_.load(std::memory_order_relaxed));
+  publish_metric("snmp_truncated_responses_total",
+                 "GETBULK responses cut short at the message size limit",
+                 PrometheusMetricType::COUNTER,
+                 truncated_responses_.load(std::memory_order_relaxed));
+
+  publish_metric("snmp_dispatch_queue_depth",
+                 "Datagrams waiting for a worker thread",
+                 PrometheusMetricType::GAUGE,
+                 static_cast<double>(get_dispatch_queue_depth()));
+
+  if (fair_queue_) {
+    FairQueue::Statistics fair = fair_queue_->get_statistics();
+    publish_metric("snmp_fair_queue_refused_total",
+                   "Requests refused because their source held its full "
+                   "share of the dispatch queue",
+                   PrometheusMetricType::COUNTER, fair.dropped);
+    publish_metric("snmp_fair_queue_active_sources",
+                   "Sources with requests waiting for a worker thread",
+                   PrometheusMetricType::GAUGE, fair.active_flows);
+
+    // Rebuilt every time so sources that left the top list disappear
+    PrometheusRegistry::get_instance().unregister_metric(
+        "snmp_fair_queue_source_depth");
+    for (const auto &flow :
+         fair_queue_->top_flows(SNMP_FAIR_QUEUE_TOP_SOURCES)) {
+      publish_metric("snmp_fair_queue_source_depth",
+                     "Requests queued for the busiest sources",
+                     PrometheusMetricType::GAUGE, flow.depth,
+                     {{"source", flow.source.to_string()}});
+    }
+  }
+
+  if (admission_.is_enabled()) {
+    AdmissionController::Statistics admission = admission_.get_statistics();
+    for (size_t i = 0; i < SNMP_REQUEST_CLASSES; ++i) {
+      std::map<std::string, std::string> labels = {
+          {"class", request_class_name(static_cast<RequestClass>(i))}};
+      publish_metric("snmp_requests_admitted_total",
+                     "Requests admitted by load shedding, by priority class",
+                     PrometheusMetricType::COUNTER, admission.admitted[i],
+                     labels);
+      publish_metric("snmp_requests_shed_total",
+                     "Requests dropped by load shedding, by priority class",
+                     PrometheusMetricType::COUNTER, admission.shed[i], labels);
+    }
+    publish_metric("snmp_shed_level",
+                   "Number of priority classes currently being shed",
+                   PrometheusMetricType::GAUGE, admission.shed_level);
+  }
+
+  if (response_cache_.is_enabled()) {
+    ResponseCache::Statistics cache = response_cache_.get_statistics();
+    publish_metric("snmp_response_cache_hits_total",
+                   "Retransmitted requests answered from the response cache",
+                   PrometheusMetricType::COUNTER, cache.hits);
+    publish_metric("snmp_response_cache_misses_total",
+                   "Response cache lookups without a live entry",
+                   PrometheusMetricType::COUNTER, cache.misses);
+    publish_metric("snmp_response_cache_evictions_total",
+                   "Response cache entries dropped on expiry or when full",
+                   PrometheusMetricType::COUNTER, cache.evictions);
+    publish_metric("snmp_response_cache_entries",
+                   "Responses currently held in the response cache",
+                   PrometheusMetricType::GAUGE, cache.entries);
+  }
+
+  if (shape_cache_.is_enabled()) {
+    RequestShapeCache::Statistics shapes = shape_cache_.get_statistics();
+    uint64_t lookups = shapes.hits + shapes.misses;
+    publish_metric("snmp_shape_cache_hits_total",
+                   "GET requests answered through cached MIB handles",
+                   PrometheusMetricType::COUNTER, shapes.hits);
+    publish_metric("snmp_shape_cache_misses_total",
+                   "GET requests whose variable bindings were resolved",
+                   PrometheusMetricType::COUNTER, shapes.misses);
+    publish_metric("snmp_shape_cache_invalidations_total",
+                   "Cached variable binding lists dropped after the MIB "
+                   "registrations changed",
+                   PrometheusMetricType::COUNTER, shapes.invalidations);
+    publish_metric("snmp_shape_cache_hit_ratio",
+                   "Fraction of GET requests answered through cached MIB "
+                   "handles",
+                   PrometheusMetricType::GAUGE,
+                   lookups > 0 ? static_cast<double>(shapes.hits) / lookups
+                               : 0.0);
+    publish_metric("snmp_shape_cache_entries",
+                   "Variable binding lists held in the shape cache",
+                   PrometheusMetricType::GAUGE, shapes.entries);
+  }
+
+  // Same log2 microsecond buckets as request latency
+  static_assert(MIBCache::LATENCY_BUCKETS == SNMP_LATENCY_BUCKETS,
+                "MIB cache latency buckets differ from request latency");
+  for (const auto &cache : MIBManager::get_instance().get_caches()) {
+    MIBCache::Statistics stats = cache->get_statistics();
+    std::map<std::string, std::string> labels = {{"subtree", cache->label()}};
+    publish_metric("snmp_mib_cache_hits_total",
+                   "MIB values served fresh from the cache",
+                   PrometheusMetricType::COUNTER, stats.hits, labels);
+    publish_metric("snmp_mib_cache_stale_hits_total",
+                   "MIB values served stale while a refresh ran",
+                   PrometheusMetricType::COUNTER, stats.stale_hits, labels);
+    publish_metric("snmp_mib_cache_misses_total",
+                   "MIB values loaded by the request that needed them",
+                   PrometheusMetricType::COUNTER, stats.misses, labels);
+    publish_metric("snmp_mib_cache_waits_total",
+                   "MIB value reads that waited for another request's load",
+                   PrometheusMetricType::COUNTER, stats.waits, labels);
+    publish_metric("snmp_mib_cache_refreshes_total",
+                   "MIB values reloaded in the background",
+                   PrometheusMetricType::COUNTER, stats.refreshes, labels);
+    publish_metric("snmp_mib_cache_entries", "MIB values held in the cache",
+                   PrometheusMetricType::GAUGE, stats.entries, labels);
+    publish_latency_histogram("snmp_mib_cache_load_seconds",
+                              "Time to load or refresh a cached MIB value",
+                              stats.load_latency, stats.load_us, labels);
+  }
 
-  if (bytes_sent < 0) {
-    Logger::get_instance().log(LogLevel::ERROR, "Failed to send response");
-  } else if (static_cast<size_t>(bytes_sent) != buffer.size()) {
-    Logger::get_instance().log(LogLevel::WARNING, "Partial send of response");
+  SNMPv3MessageProcessor::Statistics v3 =
+      SNMPv3MessageProcessor::get_instance().get_statistics();
+  publish_metric("snmp_v3_messages_total", "SNMPv3 messages processed",
+                 PrometheusMetricType::COUNTER, v3.messages_processed);
+  publish_metric("snmp_v3_parse_errors_total",
+                 "SNMPv3 messages that failed to parse",
+                 PrometheusMetricType::COUNTER, v3.parse_errors);
+  publish_metric("snmp_v3_security_errors_total",
+                 "SNMPv3 messages rejected by the user-based security model",
+                 PrometheusMetricType::COUNTER, v3.security_errors);
+  publish_metric("snmp_v3_access_denied_total",
+                 "SNMPv3 requests refused by view-based access control",
+                 PrometheusMetricType::COUNTER, v3.access_denied);
+
+  if (tcp_transport_) {
+    TcpTransport::Statistics tcp = tcp_transport_->get_statistics();
+    publish_metric("snmp_tcp_connections_accepted_total",
+                   "TCP connections accepted", PrometheusMetricType::COUNTER,
+                   tcp.accepted);
+    publish_metric("snmp_tcp_connections_rejected_total",
+                   "TCP connections refused at max_connections",
+                   PrometheusMetricType::COUNTER, tcp.rejected);
+    publish_metric("snmp_tcp_connections_idle_closed_total",
+                   "TCP connections closed after timeout_seconds idle",
+                   PrometheusMetricType::COUNTER, tcp.closed_idle);
+    publish_metric("snmp_tcp_connections", "Open TCP connections",
+                   PrometheusMetricType::GAUGE,
+                   static_cast<double>(tcp.active));
+    publish_metric("snmp_tcp_messages_total", "SNMP messages received over TCP",
+                   PrometheusMetricType::COUNTER, tcp.messages);
+    publish_metric("snmp_tcp_responses_total", "SNMP responses sent over TCP",
+                   PrometheusMetricType::COUNTER, tcp.responses);
+    publish_metric("snmp_tcp_framing_errors_total",
+                   "TCP connections closed for invalid BER framing",
+                   PrometheusMetricType::COUNTER, tcp.framing_errors);
+    for (size_t i = 1; i < SNMP_PARSE_ERRORS; ++i) {
+      publish_metric(
+          "snmp_tcp_parse_errors_total",
+          "SNMP messages received over TCP that failed to parse",
+          PrometheusMetricType::COUNTER,
+          tcp_parse_error_reasons_[i].load(std::memory_order_relaxed),
+          {{"reason", parse_error_name(static_cast<ParseError>(i))}});
+    }
+    publish_metric("snmp_tcp_received_bytes_total",
+                   "Bytes of SNMP messages received over TCP",
+                   PrometheusMetricType::COUNTER, tcp.bytes_received);
+    publish_metric("snmp_tcp_sent_bytes_total",
+                   "Bytes of SNMP responses sent over TCP",
+                   PrometheusMetricType::COUNTER, tcp.bytes_sent);
   }
 }
 
@@ -557,4 +2332,60 @@ bool SNMPServer::is_running() const { return running_; }
 
 const SNMPConfig &SNMPServer::get_config() const { return config_; }
 
+std::string server_statistics_to_string(const SNMPServer::Statistics &stats) {
+  std::ostringstream oss;
+  oss << "rx_syscalls=" << stats.rx_syscalls
+      << " rx_datagrams=" << stats.rx_datagrams
+      << " rx_errors=" << stats.rx_errors
+      << " rx_oversized=" << stats.rx_oversized
+      << " tx_syscalls=" << stats.tx_syscalls
+      << " tx_datagrams=" << stats.tx_datagrams
+      << " tx_errors=" << stats.tx_errors
+      << " requests_processed=" << stats.requests_processed
+      << " parse_errors=" << stats.parse_errors;
+
+  if (stats.parse_errors > 0) {
+    const char *separator = " (";
+    for (size_t i = 1; i < SNMP_PARSE_ERRORS; ++i) {
+      if (stats.parse_error_reasons[i] > 0) {
+        oss << separator << parse_error_name(static_cast<ParseError>(i))
+            << "=" << stats.parse_error_reasons[i];
+        separator = " ";
+      }
+    }
+    oss << ")";
+  }
+
+  if (stats.dispatched > 0 || stats.dispatch_drops > 0) {
+    oss << " dispatched=" << stats.dispatched
+        << " dispatch_drops=" << stats.dispatch_drops
+        << " avg_queue_wait_us="
+        << (stats.dispatched > 0 ? stats.queue_wait_us / stats.dispatched : 0);
+  }
+
+  if (stats.rx_syscalls > 0) {
+    oss << " avg_batch_fill="
+        << static_cast<double>(stats.rx_datagrams) / stats.rx_syscalls;
+  }
+
+  uint64_t delayed = 0;
+  uint64_t served = 0;
+  for (size_t i = 0; i < SNMP_LATENCY_BUCKETS; ++i) {
+    delayed += stats.queue_delay[i];
+    served += stats.service_time[i];
+  }
+  if (stats.too_big > 0 || stats.truncated > 0) {
+    oss << " too_big=" << stats.too_big << " truncated=" << stats.truncated;
+  }
+
+  oss << " kernel_drops=" << stats.kernel_drops;
+  if (delayed > 0) {
+    oss << " avg_queue_delay_us=" << stats.queue_delay_us / delayed;
+  }
+  if (served > 0) {
+    oss << " avg_service_time_us=" << stats.service_time_us / served;
+  }
+  return oss.str();
+}
+
 } // namespace simple_snmpd
@@ -0,0 +1,404 @@
+/*
+ * src/core/tcp_transport.cpp
+ *
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_snmpd/tcp_transport.hpp"
+#include "simple_snmpd/logger.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace simple_snmpd {
+
+namespace {
+
+// Stop reading from a connection while this much output is unsent, so a
+// manager that pipelines requests without reading cannot grow our buffers
+constexpr size_t OUTPUT_HIGH_WATER = 256 * 1024;
+
+// Listening sockets are registered with their index tagged in the upper
+// half of the epoll data, connections with their descriptor
+constexpr uint64_t LISTENER_TAG = 1ULL << 32;
+
+constexpr int EPOLL_WAIT_MS = 200;
+constexpr size_t EPOLL_MAX_EVENTS = 256;
+
+} // namespace
+
+TcpTransport::TcpTransport(RequestHandler handler, uint32_t max_connections,
+                           uint32_t idle_timeout_seconds,
+                           size_t max_message_size)
+    : handler_(std::move(handler)), max_connections_(max_connections),
+      idle_timeout_seconds_(idle_timeout_seconds),
+      max_message_size_(max_message_size), epoll_fd_(-1), running_(false),
+      accepted_(0), rejected_(0), closed_idle_(0), active_(0), messages_(0),
+      responses_(0), framing_errors_(0), bytes_received_(0), bytes_sent_(0) {}
+
+TcpTransport::~TcpTransport() { stop(); }
+
+#ifdef __linux__
+
+bool TcpTransport::start(const std::vector<int> &listen_fds) {
+  listen_fds_ = listen_fds;
+
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ == -1) {
+    Logger::get_instance().log(LogLevel::ERROR,
+                               "Failed to create TCP epoll instance");
+    stop();
+    return false;
+  }
+
+  for (size_t i = 0; i < listen_fds_.size(); ++i) {
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTENER_TAG | i;
+
+    // Accepting drains the backlog until it would block
+    int flags = fcntl(listen_fds_[i], F_GETFL, 0);
+    if (flags == -1 ||
+        fcntl(listen_fds_[i], F_SETFL, flags | O_NONBLOCK) == -1 ||
+        listen(listen_fds_[i], SOMAXCONN) < 0 ||
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fds_[i], &event) < 0) {
+      Logger::get_instance().log(LogLevel::ERROR,
+                                 "Failed to listen for TCP connections");
+      stop();
+      return false;
+    }
+  }
+
+  running_ = true;
+  thread_ = std::thread(&TcpTransport::event_loop, this);
+  return true;
+}
+
+void TcpTransport::stop() {
+  running_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  connections_.clear();
+  active_.store(0, std::memory_order_relaxed);
+
+  for (int fd : listen_fds_) {
+    close(fd);
+  }
+  listen_fds_.clear();
+
+  if (epoll_fd_ != -1) {
+    close(epoll_fd_);
+    epoll_fd_ = -1;
+  }
+}
+
+void TcpTransport::event_loop() {
+  Logger::get_instance().log(LogLevel::INFO,
+                             "TCP transport loop started on " +
+                                 std::to_string(listen_fds_.size()) +
+                                 " listener(s)");
+
+  struct epoll_event events[EPOLL_MAX_EVENTS];
+  auto last_sweep = std::chrono::steady_clock::now();
+
+  while (running_) {
+    int count = epoll_wait(epoll_fd_, events, EPOLL_MAX_EVENTS, EPOLL_WAIT_MS);
+    if (count < 0 && errno != EINTR) {
+      Logger::get_instance().log(LogLevel::ERROR, "TCP epoll_wait failed");
+      break;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      uint64_t data = events[i].data.u64;
+      if (data & LISTENER_TAG) {
+        accept_connections(static_cast<size_t>(data & ~LISTENER_TAG));
+        continue;
+      }
+
+      int fd = static_cast<int>(data);
+      auto it = connections_.find(fd);
+      if (it == connections_.end()) {
+        continue;
+      }
+      Connection &connection = it->second;
+
+      // Still answer what the manager sent before closing its side
+      if ((events[i].events & (EPOLLERR | EPOLLHUP)) &&
+          !(events[i].events & EPOLLIN)) {
+        close_connection(fd);
+        continue;
+      }
+
+      if (events[i].events & EPOLLOUT) {
+        if (!connection.stream->flush_output()) {
+          close_connection(fd);
+          continue;
+        }
+      }
+
+      if (events[i].events & EPOLLIN) {
+        handle_readable(connection);
+      } else {
+        process_messages(connection);
+      }
+
+      if (!update_interest(connection)) {
+        close_connection(fd);
+      }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_sweep >= std::chrono::seconds(1)) {
+      close_idle_connections();
+      last_sweep = now;
+    }
+  }
+
+  Logger::get_instance().log(LogLevel::INFO, "TCP transport loop ended");
+}
+
+void TcpTransport::accept_connections(size_t listener) {
+  Logger &logger = Logger::get_instance();
+
+  for (;;) {
+    struct sockaddr_storage peer;
+    socklen_t peer_length = sizeof(peer);
+    int fd = accept4(listen_fds_[listener],
+                     reinterpret_cast<struct sockaddr *>(&peer), &peer_length,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        logger.log(LogLevel::WARNING, "Failed to accept TCP connection: " +
+                                          std::string(strerror(errno)));
+      }
+      return;
+    }
+
+    if (connections_.size() >= max_connections_) {
+      close(fd);
+      rejected_.fetch_add(1, std::memory_order_relaxed);
+      if (logger.is_enabled(LogLevel::WARNING)) {
+        logger.log(LogLevel::WARNING,
+                   "Rejecting TCP connection, max_connections (" +
+                       std::to_string(max_connections_) + ") reached");
+      }
+      continue;
+    }
+
+    // Responses are written whole, so Nagle would only add latency
+    int no_delay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+    Connection connection;
+    connection.stream =
+        std::make_unique<SNMPConnection>(fd, peer, peer_length);
+    connection.stream->set_max_message_size(max_message_size_);
+    connection.listener = static_cast<uint32_t>(listener);
+    connection.events = EPOLLIN;
+
+    struct epoll_event event = {};
+    event.events = connection.events;
+    event.data.u64 = static_cast<uint32_t>(fd);
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+      logger.log(LogLevel::ERROR, "Failed to register TCP connection");
+      continue;
+    }
+
+    if (logger.is_enabled(LogLevel::DEBUG)) {
+      logger.log(LogLevel::DEBUG,
+                 "Accepted TCP connection from " +
+                     connection.stream->get_client_address() + ":" +
+                     std::to_string(connection.stream->get_client_port()));
+    }
+
+    connections_.emplace(fd, std::move(connection));
+    accepted_.fetch_add(1, std::memory_order_relaxed);
+    active_.store(connections_.size(), std::memory_order_relaxed);
+  }
+}
+
+void TcpTransport::handle_readable(Connection &connection) {
+  // Reading stops at end of stream; pipelined requests already buffered
+  // are still answered before the connection is closed
+  connection.stream->read_available();
+  process_messages(connection);
+}
+
+void TcpTransport::process_messages(Connection &connection) {
+  SNMPConnection &stream = *connection.stream;
+  std::vector<uint8_t> response;
+
+  while (stream.pending_output() < OUTPUT_HIGH_WATER) {
+    const uint8_t *data = nullptr;
+    size_t length = 0;
+    int status = stream.next_message(data, length);
+    if (status == 0) {
+      break;
+    }
+    if (status < 0) {
+      framing_errors_.fetch_add(1, std::memory_order_relaxed);
+      Logger &logger = Logger::get_instance();
+      if (logger.is_enabled(LogLevel::WARNING)) {
+        logger.log(LogLevel::WARNING,
+                   "Closing TCP connection from " +
+                       stream.get_client_address() +
+                       ": invalid or oversized message framing");
+      }
+      stream.close();
+      return;
+    }
+
+    messages_.fetch_add(1, std::memory_order_relaxed);
+    bytes_received_.fetch_add(length, std::memory_order_relaxed);
+
+    RequestContext context(stream.get_peer_address(),
+                           stream.get_peer_address_length(),
+                           std::chrono::steady_clock::now(),
+                           connection.listener);
+    response.clear();
+    bool answered = handler_(context, data, length, response);
+    stream.consume_message();
+
+    if (answered && !response.empty()) {
+      stream.queue_output(response.data(), response.size());
+      responses_.fetch_add(1, std::memory_order_relaxed);
+      bytes_sent_.fetch_add(response.size(), std::memory_order_relaxed);
+    }
+  }
+
+  if (stream.pending_output() > 0 && !stream.flush_output()) {
+    stream.close();
+  }
+}
+
+bool TcpTransport::update_interest(Connection &connection) {
+  SNMPConnection &stream = *connection.stream;
+
+  if (stream.get_socket_fd() == -1) {
+    return false;
+  }
+
+  // After the peer closed its side, stay around only to write the answers
+  // to what it sent before
+  size_t pending = stream.pending_output();
+  if (!stream.is_connected() && pending == 0) {
+    return false;
+  }
+
+  uint32_t events = 0;
+  if (stream.is_connected() && pending < OUTPUT_HIGH_WATER) {
+    events |= EPOLLIN;
+  }
+  if (pending > 0) {
+    events |= EPOLLOUT;
+  }
+
+  if (events != connection.events) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.u64 = static_cast<uint32_t>(stream.get_socket_fd());
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, stream.get_socket_fd(), &event) <
+        0) {
+      return false;
+    }
+    connection.events = events;
+  }
+  return true;
+}
+
+void TcpTransport::close_connection(int fd) {
+  // Closing the descriptor also removes it from the epoll set
+  connections_.erase(fd);
+  active_.store(connections_.size(), std::memory_order_relaxed);
+}
+
+void TcpTransport::close_idle_connections() {
+  for (auto it = connections_.begin(); it != connections_.end();) {
+    if (it->second.stream->is_timeout(idle_timeout_seconds_)) {
+      closed_idle_.fetch_add(1, std::memory_order_relaxed);
+      it = connections_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  active_.store(connections_.size(), std::memory_order_relaxed);
+}
+
+#else
+
+bool TcpTransport::start(const std::vector<int> &listen_fds) {
+  listen_fds_ = listen_fds;
+  Logger::get_instance().log(LogLevel::ERROR,
+                             "SNMP over TCP requires epoll and is only "
+                             "available on Linux");
+  stop();
+  return false;
+}
+
+void TcpTransport::stop() {
+  running_ = false;
+  for (int fd : listen_fds_) {
+#ifdef _WIN32
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+  }
+  listen_fds_.clear();
+}
+
+#endif
+
+TcpTransport::Statistics TcpTransport::get_statistics() const {
+  Statistics stats;
+  stats.accepted = accepted_.load(std::memory_order_relaxed);
+  stats.rejected = rejected_.load(std::memory_order_relaxed);
+  stats.closed_idle = closed_idle_.load(std::memory_order_relaxed);
+  stats.active = active_.load(std::memory_order_relaxed);
+  stats.messages = messages_.load(std::memory_order_relaxed);
+  stats.responses = responses_.load(std::memory_order_relaxed);
+  stats.framing_errors = framing_errors_.load(std::memory_order_relaxed);
+  stats.bytes_received = bytes_received_.load(std::memory_order_relaxed);
+  stats.bytes_sent = bytes_sent_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+std::string tcp_statistics_to_string(const TcpTransport::Statistics &stats) {
+  std::ostringstream oss;
+  oss << "accepted=" << stats.accepted << " rejected=" << stats.rejected
+      << " closed_idle=" << stats.closed_idle << " active=" << stats.active
+      << " messages=" << stats.messages << " responses=" << stats.responses
+      << " framing_errors=" << stats.framing_errors
+      << " bytes_received=" << stats.bytes_received
+      << " bytes_sent=" << stats.bytes_sent;
+  return oss.str();
+}
+
+} // namespace simple_snmpd
@@ -159,9 +159,16 @@ int main(int argc, char *argv[]) {
     std::cout << "Listening on port " << config.get_port() << "\n";
 
     // Main loop
+    auto last_metrics_publish = std::chrono::steady_clock::now();
     while (g_running) {
-      // TODO: Implement main server loop
       std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+      // Refresh exported server statistics once per second
+      auto now = std::chrono::steady_clock::now();
+      if (now - last_metrics_publish >= std::chrono::seconds(1)) {
+        g_server->publish_metrics();
+        last_metrics_publish = now;
+      }
     }
 
     // Stop the server
@@ -17,8 +17,14 @@
  */
 
 #include "simple_snmpd/snmp_mib.hpp"
+#include "simple_snmpd/oid_kernels.hpp"
+#include "simple_snmpd/oid_trie.hpp"
+#include "simple_snmpd/request_shape_cache.hpp"
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <iostream>
+#include <thread>
 #include <vector>
 
 namespace simple_snmpd {
@@ -48,9 +54,122 @@ void test_oid_utils() {
   assert(OIDUtils::is_prefix(prefix, oid1));
   assert(!OIDUtils::is_prefix(oid1, prefix));
 
+  // Sub-identifiers compare numerically, not by encoded bytes
+  std::vector<uint8_t> arc256 = OIDUtils::string_to_oid("1.3.6.256");
+  std::vector<uint8_t> arc16384 = OIDUtils::string_to_oid("1.3.6.16384");
+  assert(arc256 > arc16384);
+  assert(OIDUtils::compare_oids(arc256, arc16384) < 0);
+
   std::cout << "✓ OID utilities test passed" << std::endl;
 }
 
+void test_oid_kernels() {
+  std::cout << "Testing OID kernels..." << std::endl;
+
+  // Long enough for the 16 and 32 byte vector blocks, with multi-byte
+  // sub-identifiers inside and across block boundaries
+  std::string text = "1.3.6.1.4.1.8072";
+  for (int i = 0; i < 40; ++i) {
+    text += "." + std::to_string(i % 3 == 0 ? 300 + i : i);
+  }
+  std::vector<uint8_t> oid = OIDUtils::string_to_oid(text);
+  std::vector<uint8_t> other = oid;
+  other[other.size() - 2] ^= 0x01;
+
+  std::vector<uint32_t> expected;
+  assert(OIDUtils::decode_arcs(oid, expected));
+  assert(expected.size() == 46 && expected[0] == 43 && expected[6] == 300);
+  for (int tier = 0; tier <= static_cast<int>(OIDKernelLevel::AVX2); ++tier) {
+    const OIDKernels &kernels =
+        OIDKernels::get(static_cast<OIDKernelLevel>(tier));
+    std::vector<uint32_t> arcs(oid.size());
+    size_t count = 0;
+    assert(kernels.decode(oid.data(), oid.size(), arcs.data(), count));
+    arcs.resize(count);
+    assert(arcs == expected);
+    assert(kernels.mismatch(oid.data(), other.data(), oid.size()) ==
+           oid.size() - 2);
+    assert(kernels.mismatch_arcs(arcs.data(), arcs.data(), count) == count);
+
+    // A trailing continuation byte is a truncated sub-identifier
+    std::vector<uint8_t> truncated = oid;
+    truncated.push_back(0x81);
+    arcs.resize(truncated.size());
+    assert(!kernels.decode(truncated.data(), truncated.size(), arcs.data(),
+                           count));
+  }
+
+  std::vector<uint32_t> column;
+  std::vector<uint32_t> instance;
+  assert(OIDUtils::decode_arcs(OIDUtils::string_to_oid("1.3.6.1.2.1.2.2.1.2"),
+                               column));
+  assert(OIDUtils::decode_arcs(
+      OIDUtils::string_to_oid("1.3.6.1.2.1.2.2.1.2.16384"), instance));
+  assert(OIDUtils::is_arc_prefix(column, instance));
+  assert(!OIDUtils::is_arc_prefix(instance, column));
+  assert(OIDUtils::compare_arcs(column, instance) < 0);
+  assert(OIDUtils::compare_arcs(instance, instance) == 0);
+
+  std::cout << "✓ OID kernels test passed ("
+            << OIDKernels::level_name(OIDKernels::detected_level()) << ")"
+            << std::endl;
+}
+
+void test_oid_trie() {
+  std::cout << "Testing OID trie..." << std::endl;
+
+  // Inserted out of order, with arcs whose byte order is not OID order,
+  // prefixes of other OIDs and edges that have to be split
+  const char *sorted[] = {"1.3.6.1.2.1.1.1.0",     "1.3.6.1.2.1.2.2.1.2",
+                          "1.3.6.1.2.1.2.2.1.2.5", "1.3.6.1.4.1.9.256",
+                          "1.3.6.1.4.1.9.16384",   "1.3.6.1.4.1.2021.4.5.0",
+                          "1.3.6.1.4.1.2021.4.6.0"};
+  const size_t order[] = {5, 2, 4, 0, 6, 1, 3};
+  OIDTrie trie;
+  for (size_t i : order) {
+    size_t slot = trie.insert(OIDUtils::string_to_oid(sorted[i]));
+    assert(slot == trie.size() - 1);
+  }
+  assert(trie.insert(OIDUtils::string_to_oid(sorted[4])) == 2);
+  assert(trie.size() == 7);
+
+  // Slots link up in OID order in both directions
+  size_t slot = trie.first();
+  for (const char *oid : sorted) {
+    assert(OIDUtils::oid_to_string(trie.oid(slot)) == oid);
+    slot = trie.next(slot);
+  }
+  assert(slot == OIDTrie::npos);
+  assert(OIDUtils::oid_to_string(trie.oid(trie.prev(OIDTrie::npos))) ==
+         sorted[6]);
+
+  assert(trie.find(OIDUtils::string_to_oid(sorted[3])) == 6);
+  assert(trie.find(OIDUtils::string_to_oid("1.3.6.1.4.1.9")) ==
+         OIDTrie::npos);
+  assert(trie.find(OIDUtils::string_to_oid("1.3.6.1.4.1.9.256.1")) ==
+         OIDTrie::npos);
+
+  // Successors from registered OIDs, prefixes, gaps and past the end
+  auto successor = [&trie](const char *oid) {
+    size_t found = trie.upper_bound(OIDUtils::string_to_oid(oid));
+    return found == OIDTrie::npos ? std::string()
+                                  : OIDUtils::oid_to_string(trie.oid(found));
+  };
+  assert(successor("0.0") == sorted[0]);
+  assert(successor(sorted[1]) == sorted[2]);
+  assert(successor("1.3.6.1.2.1.2.2.1.2.4") == sorted[2]);
+  assert(successor("1.3.6.1.2.1.2.2.1.2.5.0") == sorted[3]);
+  assert(successor("1.3.6.1.4.1.9") == sorted[3]);
+  assert(successor("1.3.6.1.4.1.9.300") == sorted[4]);
+  assert(successor("1.3.6.1.4.1.9.16384.7") == sorted[5]);
+  assert(successor("1.3.6.1.4.1.2021.4") == sorted[5]);
+  assert(successor("1.3.6.1.4.1.2021.4.5.1") == sorted[6]);
+  assert(successor(sorted[6]).empty());
+  assert(successor("2.1").empty());
+
+  std::cout << "✓ OID trie test passed" << std::endl;
+}
+
 void test_mib_manager_scalar() {
   std::cout << "Testing MIB manager scalar operations..." << std::endl;
 
@@ -149,13 +268,511 @@ void test_mib_manager_standard_mibs() {
   std::cout << "✓ MIB manager standard MIBs test passed" << std::endl;
 }
 
+void test_mib_manager_exceptions() {
+  std::cout << "Testing MIB manager object lookup for exceptions..."
+            << std::endl;
+
+  MIBManager &mib = MIBManager::get_instance();
+  mib.initialize_standard_mibs();
+
+  // noSuchInstance: the object type exists but the instance does not
+  MIBValue value;
+  std::vector<uint8_t> sys_descr_1 =
+      OIDUtils::string_to_oid("1.3.6.1.2.1.1.1.1");
+  assert(!mib.get_value(sys_descr_1, value));
+  assert(mib.has_object(sys_descr_1));
+  assert(mib.has_object(OIDUtils::string_to_oid("1.3.6.1.2.1.1.1")));
+  assert(mib.has_object(OIDUtils::string_to_oid("1.3.6.1.2.1.2.2.1.2.9")));
+
+  // noSuchObject: nothing registered there at all
+  assert(!mib.has_object(OIDUtils::string_to_oid("1.3.6.1.2.1.1.99.0")));
+  assert(!mib.has_object(OIDUtils::string_to_oid("1.3.6.1.4.1")));
+
+  std::cout << "✓ MIB manager object lookup for exceptions test passed"
+            << std::endl;
+}
+
+void test_mib_cursor() {
+  std::cout << "Testing MIB cursor..." << std::endl;
+
+  MIBManager &mib = MIBManager::get_instance();
+  mib.initialize_standard_mibs();
+
+  // A full walk visits instances in increasing order and agrees with
+  // get_next_oid at every step
+  MIBManager::Cursor cursor(mib);
+  std::vector<uint8_t> previous = OIDUtils::string_to_oid("0.0");
+  size_t instances = 0;
+  for (bool found = cursor.seek_after(previous); found;
+       found = cursor.next()) {
+    std::vector<uint8_t> next_oid;
+    assert(mib.get_next_oid(previous, next_oid));
+    assert(next_oid == cursor.oid());
+    assert(OIDUtils::compare_oids(previous, cursor.oid()) < 0);
+
+    MIBValue value;
+    assert(cursor.get_value(value));
+    assert(mib.get_value(cursor.oid(), value));
+    previous = cursor.oid();
+    ++instances;
+  }
+  assert(instances > 10);
+  assert(!cursor.valid());
+
+  // Seeking into a column lands on the following row
+  std::vector<uint8_t> if_descr =
+      OIDUtils::string_to_oid("1.3.6.1.2.1.2.2.1.2");
+  assert(cursor.seek_after(if_descr));
+  assert(OIDUtils::oid_to_string(cursor.oid()) == "1.3.6.1.2.1.2.2.1.2.1");
+  assert(cursor.next());
+  assert(OIDUtils::oid_to_string(cursor.oid()) == "1.3.6.1.2.1.2.2.1.3.1");
+  assert(cursor.name() == "ifType");
+  assert(cursor.type() == SNMPDataType::INTEGER);
+
+  // A saved position resumes on the same instance, with or without
+  // registrations in between, and the walk carries on from there
+  MIBManager::Cursor::Position position = cursor.save();
+  MIBValue value;
+  MIBValue by_handle;
+  assert(cursor.read(value));
+  assert(mib.get_value(cursor.handle(), by_handle));
+  assert(by_handle.data == value.data);
+  assert(cursor.next());
+  std::vector<uint8_t> following = cursor.oid();
+
+  MIBManager::Cursor resumed(mib);
+  assert(resumed.resume(position));
+  assert(resumed.oid() == position.oid);
+  assert(resumed.next() && resumed.oid() == following);
+  mib.initialize_standard_mibs();
+  assert(resumed.resume(position));
+  assert(resumed.oid() == position.oid);
+  assert(resumed.next() && resumed.oid() == following);
+  assert(!resumed.resume(MIBManager::Cursor::Position()));
+
+  std::cout << "✓ MIB cursor test passed" << std::endl;
+}
+
+void test_mib_handles_and_shape_cache() {
+  std::cout << "Testing MIB handles and request shape cache..." << std::endl;
+
+  MIBManager &mib = MIBManager::get_instance();
+  mib.initialize_standard_mibs();
+
+  // A handle reads the same value as a lookup by OID
+  const char *names[] = {"1.3.6.1.2.1.1.7.0", "1.3.6.1.2.1.2.2.1.2.1",
+                         "1.3.6.1.2.1.1.7.1"};
+  SNMPPacket packet;
+  SNMPPacket prefix;
+  std::vector<MIBManager::Handle> handles(3);
+  for (size_t i = 0; i < 3; ++i) {
+    SNMPPacket::VariableBinding varbind;
+    varbind.oid = OIDUtils::string_to_oid(names[i]);
+    varbind.value_type = static_cast<uint8_t>(SNMPDataType::NULL_TYPE);
+    packet.add_variable_binding(varbind);
+    if (i < 2) {
+      prefix.add_variable_binding(varbind);
+    }
+    mib.resolve(varbind.oid, handles[i]);
+  }
+  assert(handles[0].valid() && handles[1].valid() && !handles[2].valid());
+  MIBValue by_handle;
+  MIBValue by_oid;
+  assert(mib.get_value(handles[1], by_handle));
+  assert(mib.get_value(OIDUtils::string_to_oid(names[1]), by_oid));
+  assert(by_handle.data == by_oid.data);
+  assert(!mib.get_value(handles[2], by_handle));
+
+  // Shapes are read from requests in place
+  std::vector<uint8_t> buffer;
+  std::vector<uint8_t> prefix_buffer;
+  SNMPPacketView request;
+  SNMPPacketView other;
+  assert(packet.serialize(buffer) &&
+         request.parse(buffer.data(), buffer.size()));
+  assert(prefix.serialize(prefix_buffer) &&
+         other.parse(prefix_buffer.data(), prefix_buffer.size()));
+
+  RequestShapeCache cache;
+  cache.configure(64);
+  uint64_t shape = RequestShapeCache::hash(request);
+  uint64_t generation = mib.generation();
+  std::vector<MIBManager::Handle> cached;
+  assert(!cache.lookup(shape, request, generation, cached));
+  cache.insert(shape, request, generation, handles);
+  assert(cache.lookup(shape, request, generation, cached));
+  assert(cached.size() == 3 && cached[0].valid() && !cached[2].valid());
+
+  // A different list filed under the same hash is not a hit
+  assert(!cache.lookup(shape, other, generation, cached));
+
+  // Registering anything invalidates every cached list
+  mib.initialize_standard_mibs();
+  assert(mib.generation() != generation);
+  assert(!cache.lookup(shape, request, mib.generation(), cached));
+
+  RequestShapeCache::Statistics stats = cache.get_statistics();
+  assert(stats.hits == 1 && stats.misses == 3);
+  assert(stats.invalidations == 1 && stats.entries == 0);
+
+  std::cout << "✓ MIB handles and request shape cache test passed"
+            << std::endl;
+}
+
+void test_mib_indexed_table() {
+  std::cout << "Testing MIB tables with row providers..." << std::endl;
+
+  // Index components round trip, and malformed ones are refused
+  MIBIndex index;
+  IndexUtils::append_ip_address(index, 0xC0A80001);
+  IndexUtils::append_string(index, "eth0");
+  IndexUtils::append_integer(index, 80);
+  IndexUtils::append_string(index, "ab", true);
+  assert((index == MIBIndex{192, 168, 0, 1, 4, 'e', 't', 'h', '0', 80, 'a',
+                            'b'}));
+  size_t position = 0;
+  uint32_t address = 0;
+  uint32_t port = 0;
+  std::string name;
+  std::string implied;
+  assert(IndexUtils::read_ip_address(index, position, address));
+  assert(IndexUtils::read_string(index, position, name));
+  assert(IndexUtils::read_integer(index, position, port));
+  assert(IndexUtils::read_string(index, position, implied, true));
+  assert(address == 0xC0A80001 && name == "eth0" && port == 80 &&
+         implied == "ab" && position == index.size());
+  position = 0;
+  assert(!IndexUtils::read_string(MIBIndex{5, 'a'}, position, name));
+  assert(!IndexUtils::read_ip_address(MIBIndex{1, 256, 0, 0}, position,
+                                      address));
+
+  // A sparse table indexed by (name, port): the second column has no cell
+  // in the middle row
+  auto row = [](const std::string &host, uint32_t port, uint32_t state,
+                bool named) {
+    MIBRow result;
+    IndexUtils::append_string(result.index, host);
+    IndexUtils::append_integer(result.index, port);
+    result.values.push_back(MIBValue(SNMPDataType::INTEGER, state));
+    result.values.push_back(named ? MIBValue(SNMPDataType::OCTET_STRING, host)
+                                  : MIBValue());
+    return result;
+  };
+  std::shared_ptr<SortedRowProvider> provider =
+      std::make_shared<SortedRowProvider>();
+  provider->set_rows({row("b", 22, 3, true), row("ab", 80, 2, false),
+                      row("b", 7, 1, true), row("b", 22, 4, true)});
+  assert(provider->size() == 3);
+
+  MIBTable table;
+  table.entry_oid = OIDUtils::string_to_oid("1.3.6.1.4.1.99.2.1");
+  table.name = "testConnTable";
+  table.columns = {MIBColumn(2, "testConnState", SNMPDataType::INTEGER),
+                   MIBColumn(3, "testConnName", SNMPDataType::OCTET_STRING)};
+  table.provider = provider;
+  MIBManager &mib = MIBManager::get_instance();
+  mib.register_table(table);
+
+  // Rows sort by length-prefixed index, and the duplicate index kept the
+  // last row given for it
+  MIBValue value;
+  std::vector<uint8_t> state =
+      OIDUtils::string_to_oid("1.3.6.1.4.1.99.2.1.2.1.98.22");
+  assert(mib.get_value(state, value));
+  assert(value.data == MIBValue(SNMPDataType::INTEGER,
+                                static_cast<uint32_t>(4)).data);
+  assert(!mib.get_value(
+      OIDUtils::string_to_oid("1.3.6.1.4.1.99.2.1.3.2.97.98.80"), value));
+  assert(mib.has_object(
+      OIDUtils::string_to_oid("1.3.6.1.4.1.99.2.1.3.2.97.98.80")));
+  assert(!mib.get_value(
+      OIDUtils::string_to_oid("1.3.6.1.4.1.99.2.1.2.1.98.23"), value));
+  assert(!mib.set_value(state, value));
+
+  MIBManager::Handle handle;
+  mib.resolve(state, handle);
+  assert(handle.valid() && mib.get_value(handle, value));
+
+  // Walks go down each column in index order and step over missing cells
+  const char *expected[] = {
+      "1.3.6.1.4.1.99.2.1.2.1.98.7", "1.3.6.1.4.1.99.2.1.2.1.98.22",
+      "1.3.6.1.4.1.99.2.1.2.2.97.98.80", "1.3.6.1.4.1.99.2.1.3.1.98.7",
+      "1.3.6.1.4.1.99.2.1.3.1.98.22"};
+  {
+    MIBManager::Cursor cursor(mib);
+    assert(cursor.seek_after(OIDUtils::string_to_oid("1.3.6.1.4.1.99.2")));
+    for (const char *oid : expected) {
+      assert(cursor.valid());
+      assert(OIDUtils::oid_to_string(cursor.oid()) == oid);
+      assert(cursor.get_value(value));
+      assert(mib.get_value(cursor.handle(), value));
+      cursor.next();
+    }
+    assert(!cursor.valid() ||
+           !OIDUtils::is_prefix(table.entry_oid, cursor.oid()));
+
+    // Seeking between rows or into a malformed index, and resuming
+    assert(cursor.seek_after(
+        OIDUtils::string_to_oid("1.3.6.1.4.1.99.2.1.2.1.98.8")));
+    assert(OIDUtils::oid_to_string(cursor.oid()) == expected[1]);
+    MIBManager::Cursor::Position saved = cursor.save();
+    std::vector<uint8_t> truncated = table.entry_oid;
+    truncated.push_back(0x02);
+    truncated.push_back(0x81);
+    assert(cursor.seek_after(truncated));
+    assert(OIDUtils::oid_to_string(cursor.oid()) == expected[0]);
+    assert(cursor.resume(saved) && cursor.next());
+    assert(OIDUtils::oid_to_string(cursor.oid()) == expected[2]);
+  }
+
+  // ipAddrTable holds the loopback address, indexed by itself
+  mib.initialize_standard_mibs();
+  assert(mib.get_value(
+      OIDUtils::string_to_oid("1.3.6.1.2.1.4.20.1.1.127.0.0.1"), value));
+  assert(value.type == SNMPDataType::IP_ADDRESS &&
+         (value.data == std::vector<uint8_t>{127, 0, 0, 1}));
+
+  std::cout << "✓ MIB tables with row providers test passed" << std::endl;
+}
+
+// Sorted rows that count how often they are asked for
+class CountingRowProvider : public SortedRowProvider {
+public:
+  void get_rows(const MIBIndex *after, size_t limit,
+                std::vector<MIBRow> &rows) const override {
+    calls.fetch_add(1);
+    SortedRowProvider::get_rows(after, limit, rows);
+  }
+
+  mutable std::atomic<int> calls{0};
+};
+
+void test_mib_cache() {
+  std::cout << "Testing MIB value caching..." << std::endl;
+
+  std::vector<uint8_t> subtree;
+  MIBCachePolicy policy;
+  assert(MIBCache::parse_rule("1.3.6.1.2.1.2=1000/5000", subtree, policy));
+  assert(OIDUtils::oid_to_string(subtree) == "1.3.6.1.2.1.2" &&
+         policy.ttl.count() == 1000 && policy.max_stale.count() == 5000);
+  assert(MIBCache::parse_rule("1.3.6.1.2.1.2=250", subtree, policy) &&
+         policy.max_stale.count() == 0);
+  assert(!MIBCache::parse_rule("1.3.6.1.2.1.2=0", subtree, policy));
+  assert(!MIBCache::parse_rule("1.3.6.1.2.1.2=1s", subtree, policy));
+  assert(!MIBCache::parse_rule("=1000", subtree, policy));
+
+  // A slow scalar is read once per ttl, then served stale while the
+  // background refresh runs
+  MIBManager &mib = MIBManager::get_instance();
+  std::vector<uint8_t> slow = OIDUtils::string_to_oid("1.3.6.1.4.1.99.3.1.0");
+  std::shared_ptr<std::atomic<uint32_t>> loads =
+      std::make_shared<std::atomic<uint32_t>>(0);
+  MIBEntry entry(slow, "testSlow", SNMPDataType::GAUGE32, false);
+  entry.getter = [loads]() {
+    return MIBValue(SNMPDataType::GAUGE32, loads->fetch_add(1) + 1);
+  };
+  entry.setter = [](const MIBValue &) { return true; };
+  mib.register_scalar(entry);
+  mib.set_cache_policy(OIDUtils::string_to_oid("1.3.6.1.4.1.99.3"),
+                       MIBCachePolicy(std::chrono::milliseconds(50),
+                                      std::chrono::seconds(10), "slow"));
+
+  auto read = [&mib, &slow]() {
+    MIBValue value;
+    assert(mib.get_value(slow, value));
+    return value.data.back();
+  };
+  assert(read() == 1 && read() == 1 && loads->load() == 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  assert(read() == 1);
+  for (int i = 0; i < 200 && loads->load() < 2; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  assert(read() == 2 && loads->load() == 2);
+
+  // A SET drops the cached value
+  assert(mib.set_value(slow, MIBValue(SNMPDataType::GAUGE32,
+                                      static_cast<uint32_t>(0))));
+  assert(read() == 3);
+
+  std::shared_ptr<const MIBCache> cache = mib.get_caches().back();
+  MIBCache::Statistics stats = cache->get_statistics();
+  assert(cache->label() == "slow");
+  assert(stats.hits == 2 && stats.stale_hits == 1 && stats.misses == 2 &&
+         stats.refreshes == 1 && stats.entries == 1);
+
+  // A table registered under a cached subtree is read whole, once, however
+  // many cells a walk and GETs read
+  mib.set_cache_policy(OIDUtils::string_to_oid("1.3.6.1.4.1.99.4"),
+                       MIBCachePolicy(std::chrono::seconds(60),
+                                      std::chrono::seconds(0)));
+  std::shared_ptr<CountingRowProvider> provider =
+      std::make_shared<CountingRowProvider>();
+  std::vector<MIBRow> rows(100);
+  for (uint32_t i = 0; i < rows.size(); ++i) {
+    IndexUtils::append_integer(rows[i].index, i + 1);
+    rows[i].values.push_back(MIBValue(SNMPDataType::INTEGER, i));
+    rows[i].values.push_back(MIBValue(SNMPDataType::INTEGER, i * 2));
+  }
+  provider->set_rows(rows);
+  MIBTable table;
+  table.entry_oid = OIDUtils::string_to_oid("1.3.6.1.4.1.99.4.1");
+  table.columns = {MIBColumn(1, "testA", SNMPDataType::INTEGER),
+                   MIBColumn(2, "testB", SNMPDataType::INTEGER)};
+  table.provider = provider;
+  mib.register_table(table);
+
+  size_t instances = 0;
+  {
+    MIBManager::Cursor cursor(mib);
+    MIBValue value;
+    for (cursor.seek_after(table.entry_oid);
+         cursor.read(value) && OIDUtils::is_prefix(table.entry_oid,
+                                                   cursor.oid());
+         cursor.next()) {
+      ++instances;
+    }
+  }
+  MIBValue value;
+  assert(mib.get_value(
+      OIDUtils::string_to_oid("1.3.6.1.4.1.99.4.1.2.50"), value));
+  assert(value.data == MIBValue(SNMPDataType::INTEGER,
+                                static_cast<uint32_t>(98)).data);
+  assert(instances == 200 && provider->calls.load() == 1);
+
+  std::cout << "✓ MIB value caching test passed" << std::endl;
+}
+
+void test_mib_cache_single_load() {
+  std::cout << "Testing MIB cache single loads..." << std::endl;
+
+  // No grace period: every expiry is a miss for whoever reads next
+  std::shared_ptr<MIBCache> cache = std::make_shared<MIBCache>(
+      OIDUtils::string_to_oid("1.3.6.1.4.1.99.5"),
+      MIBCachePolicy(std::chrono::milliseconds(50),
+                     std::chrono::milliseconds(0)));
+  std::vector<uint8_t> key = OIDUtils::string_to_oid("1.3.6.1.4.1.99.5.1.0");
+  std::shared_ptr<std::atomic<int>> loads =
+      std::make_shared<std::atomic<int>>(0);
+
+  const int readers = 8;
+  for (int round = 1; round <= 3; ++round) {
+    std::atomic<bool> go(false);
+    std::atomic<int> matched(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readers; ++i) {
+      threads.emplace_back([&cache, &key, &loads, &go, &matched, round]() {
+        while (!go.load()) {
+          std::this_thread::yield();
+        }
+        std::shared_ptr<const int> value = cache->get<int>(key, [&loads]() {
+          std::shared_ptr<std::atomic<int>> counter = loads;
+          return MIBCache::Loader([counter]() {
+            int number = counter->fetch_add(1) + 1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            return std::make_shared<const int>(number);
+          });
+        });
+        if (value && *value == round) {
+          matched.fetch_add(1);
+        }
+      });
+    }
+    go.store(true);
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    assert(loads->load() == round && matched.load() == readers);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  }
+
+  MIBCache::Statistics stats = cache->get_statistics();
+  assert(stats.misses == 3 && stats.refreshes == 0 && stats.entries == 1);
+  assert(stats.hits + stats.waits == 3 * (readers - 1));
+
+  std::cout << "✓ MIB cache single load test passed" << std::endl;
+}
+
+void test_mib_versions() {
+  std::cout << "Testing MIB version publication..." << std::endl;
+
+  MIBManager &mib = MIBManager::get_instance();
+  mib.initialize_standard_mibs();
+  std::vector<uint8_t> added = OIDUtils::string_to_oid("1.3.6.1.4.1.99.1.0");
+  MIBEntry entry(added, "testScalar", SNMPDataType::INTEGER);
+  entry.getter = []() {
+    return MIBValue(SNMPDataType::INTEGER, static_cast<uint32_t>(7));
+  };
+
+  // A cursor keeps walking the version it started on
+  uint64_t generation = mib.generation();
+  {
+    MIBManager::Cursor cursor(mib);
+    assert(cursor.seek_after(OIDUtils::string_to_oid("1.3.6.1.2.1.11.32")));
+    mib.register_scalar(entry);
+    assert(mib.generation() == generation + 1);
+    while (cursor.next()) {
+      assert(cursor.oid() != added);
+    }
+  }
+  MIBValue value;
+  assert(mib.get_value(added, value));
+
+  // Readers on other threads see either version, never a torn one, and
+  // retired versions are freed once they have left
+  std::atomic<bool> stop(false);
+  std::atomic<uint64_t> failures(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&]() {
+      std::vector<uint8_t> sys_descr =
+          OIDUtils::string_to_oid("1.3.6.1.2.1.1.1.0");
+      while (!stop.load()) {
+        MIBValue read;
+        if (!mib.get_value(sys_descr, read)) {
+          failures.fetch_add(1);
+        }
+        MIBManager::Cursor walk(mib);
+        if (!walk.seek_after(sys_descr)) {
+          failures.fetch_add(1);
+        }
+      }
+    });
+  }
+  uint64_t reclaimed = EpochManager::get_instance().get_statistics().reclaimed;
+  for (int i = 0; i < 200; ++i) {
+    mib.register_scalar(entry);
+  }
+  stop.store(true);
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  EpochManager &epochs = EpochManager::get_instance();
+  epochs.reclaim();
+  EpochManager::Statistics stats = epochs.get_statistics();
+  assert(failures.load() == 0);
+  assert(stats.reclaimed >= reclaimed + 200 && stats.retired == 0);
+
+  std::cout << "✓ MIB version publication test passed" << std::endl;
+}
+
 void run_all_tests() {
   std::cout << "Running MIB manager tests..." << std::endl;
 
   test_oid_utils();
+  test_oid_kernels();
+  test_oid_trie();
   test_mib_manager_scalar();
   test_mib_manager_table();
   test_mib_manager_standard_mibs();
+  test_mib_manager_exceptions();
+  test_mib_cursor();
+  test_mib_handles_and_shape_cache();
+  test_mib_indexed_table();
+  test_mib_cache();
+  test_mib_cache_single_load();
+  test_mib_versions();
 
   std::cout << "All MIB manager tests passed!" << std::endl;
 }
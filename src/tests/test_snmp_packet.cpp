@@ -17,10 +17,33 @@
  */
 
 #include "simple_snmpd/snmp_packet.hpp"
+#include "simple_snmpd/ber_encoder.hpp"
+#include "simple_snmpd/datagram_engine.hpp"
+#include "simple_snmpd/hash.hpp"
+#include "simple_snmpd/response_cache.hpp"
+#include "simple_snmpd/snmp_config.hpp"
+#include "simple_snmpd/snmp_connection.hpp"
+#include "simple_snmpd/snmp_mib.hpp"
+#include "simple_snmpd/snmp_server.hpp"
+#include "simple_snmpd/snmp_v3_packet.hpp"
+#include "simple_snmpd/snmp_v3_usm.hpp"
+#include "simple_snmpd/snmp_v3_vacm.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <thread>
 #include <vector>
 
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
 namespace simple_snmpd {
 namespace tests {
 
@@ -62,6 +85,15 @@ void test_snmp_packet_setters() {
   packet.set_error_index(1);
   assert(packet.get_error_index() == 1);
 
+  // error-index counts bindings, so it is not limited to one octet
+  packet.set_error_index(300);
+  std::vector<uint8_t> buffer;
+  assert(packet.serialize(buffer));
+  SNMPPacket parsed;
+  assert(parsed.parse(buffer.data(), buffer.size()));
+  assert(parsed.get_error_status() == SNMP_ERROR_NO_SUCH_NAME);
+  assert(parsed.get_error_index() == 300);
+
   std::cout << "✓ SNMP packet setters test passed" << std::endl;
 }
 
@@ -117,6 +149,179 @@ void test_snmp_packet_serialization() {
   std::cout << "✓ SNMP packet serialization test passed" << std::endl;
 }
 
+void test_snmp_packet_large_serialization() {
+  std::cout << "Testing SNMP packet long-form length serialization..."
+            << std::endl;
+
+  SNMPPacket packet;
+  packet.set_version(SNMP_VERSION_2C);
+  packet.set_pdu_type(SNMP_PDU_GET_RESPONSE);
+  packet.set_community("public");
+  packet.set_request_id(4242);
+
+  // Well over 4 KiB, with one value that needs a long-form length itself
+  SNMPPacket::VariableBinding varbind;
+  varbind.oid = {0x2b, 0x06, 0x01, 0x02, 0x01, 0x01, 0x01, 0x00}; // sysDescr.0
+  varbind.value_type = 0x04; // OCTET STRING
+  varbind.value.assign(300, 'x');
+  packet.add_variable_binding(varbind);
+  varbind.value.assign(20, 'y');
+  for (int i = 0; i < 200; ++i) {
+    packet.add_variable_binding(varbind);
+  }
+
+  std::vector<uint8_t> buffer;
+  assert(packet.serialize(buffer));
+  assert(buffer.size() > 4096);
+  assert(buffer[0] == 0x30);
+  assert(buffer[1] == 0x82); // two length octets follow
+
+  SNMPPacket parsed;
+  assert(parsed.parse(buffer.data(), buffer.size()));
+  assert(parsed.get_request_id() == 4242);
+  assert(parsed.get_variable_bindings().size() == 201);
+  assert(parsed.get_variable_bindings()[0].value.size() == 300);
+  assert(parsed.get_variable_bindings()[200].value == varbind.value);
+
+  std::cout << "✓ SNMP packet long-form length serialization test passed"
+            << std::endl;
+}
+
+void test_snmp_packet_size_budget() {
+  std::cout << "Testing SNMP packet size budget..." << std::endl;
+
+  SNMPPacket packet;
+  packet.set_version(SNMP_VERSION_2C);
+  packet.set_pdu_type(SNMP_PDU_GET_RESPONSE);
+  packet.set_community("public");
+  packet.set_request_id(0x7fffffff);
+
+  SNMPPacket::VariableBinding varbind;
+  varbind.oid = {0x2b, 0x06, 0x01, 0x02, 0x01, 0x02, 0x02, 0x01, 0x02, 0x01};
+  varbind.value_type = 0x04; // OCTET STRING
+  varbind.value.assign(30, 'z');
+
+  // The tracked size matches the encoding across the long-form thresholds
+  std::vector<uint8_t> buffer;
+  size_t added = 0;
+  while (packet.add_variable_binding(varbind, 484)) {
+    ++added;
+    assert(packet.serialize(buffer));
+    assert(buffer.size() == packet.encoded_size());
+  }
+  assert(added > 4);
+  assert(packet.encoded_size() <= 484);
+  assert(packet.encoded_size() + SNMPPacket::encoded_size(varbind) > 484);
+
+  // A refused binding leaves the packet untouched
+  assert(packet.get_variable_bindings().size() == added);
+  assert(packet.serialize(buffer));
+  assert(buffer.size() == packet.encoded_size());
+
+  packet.clear_variable_bindings();
+  packet.set_error_status(SNMP_ERROR_TOO_BIG);
+  assert(packet.serialize(buffer));
+  assert(buffer.size() == packet.encoded_size());
+
+  std::cout << "✓ SNMP packet size budget test passed" << std::endl;
+}
+
+void test_snmp_packet_get_bulk_fields() {
+  std::cout << "Testing GETBULK non-repeaters and max-repetitions..."
+            << std::endl;
+
+  SNMPPacket request;
+  request.set_version(SNMP_VERSION_2C);
+  request.set_pdu_type(SNMP_PDU_GET_BULK_REQUEST);
+  request.set_community("public");
+  request.set_request_id(77);
+  request.set_non_repeaters(1);
+  request.set_max_repetitions(1000); // wider than the error index field
+  SNMPPacket::VariableBinding varbind;
+  varbind.oid = {0x2b, 0x06, 0x01, 0x02, 0x01, 0x01, 0x01, 0x00};
+  varbind.value_type = 0x05; // NULL
+  request.add_variable_binding(varbind);
+
+  std::vector<uint8_t> buffer;
+  assert(request.serialize(buffer));
+  assert(buffer.size() == request.encoded_size());
+
+  SNMPPacket parsed;
+  assert(parsed.parse(buffer.data(), buffer.size()));
+  assert(parsed.get_non_repeaters() == 1);
+  assert(parsed.get_max_repetitions() == 1000);
+
+  // Negative max-repetitions counts as zero
+  request.set_max_repetitions(0x7f);
+  assert(request.serialize(buffer));
+  const uint8_t field[] = {0x02, 0x01, 0x7f};
+  auto it = std::search(buffer.begin(), buffer.end(), field, field + 3);
+  assert(it != buffer.end());
+  it[2] = 0xff; // INTEGER -1
+  SNMPPacketView view;
+  assert(view.parse(buffer.data(), buffer.size()));
+  assert(view.get_non_repeaters() == 1);
+  assert(view.get_max_repetitions() == 0);
+
+  std::cout << "✓ GETBULK non-repeaters and max-repetitions test passed"
+            << std::endl;
+}
+
+void test_ber_encoder() {
+  std::cout << "Testing reverse BER encoder..." << std::endl;
+
+  uint8_t buffer[512];
+
+  // Minimal two's complement integers
+  struct {
+    int64_t value;
+    std::vector<uint8_t> encoding;
+  } integers[] = {
+      {0, {0x02, 0x01, 0x00}},
+      {127, {0x02, 0x01, 0x7f}},
+      {128, {0x02, 0x02, 0x00, 0x80}},
+      {-1, {0x02, 0x01, 0xff}},
+      {-129, {0x02, 0x02, 0xff, 0x7f}},
+      {12345, {0x02, 0x02, 0x30, 0x39}},
+      {INT32_MIN, {0x02, 0x04, 0x80, 0x00, 0x00, 0x00}},
+  };
+  for (const auto &integer : integers) {
+    BerEncoder encoder(buffer, sizeof(buffer));
+    encoder.write_integer(0x02, integer.value);
+    assert(encoder.ok());
+    assert(std::vector<uint8_t>(encoder.data(),
+                                encoder.data() + encoder.size()) ==
+           integer.encoding);
+    assert(BerEncoder::integer_length(integer.value) + 2 ==
+           integer.encoding.size());
+  }
+
+  // Short form up to 127 bytes, minimal long form above
+  const size_t lengths[] = {127, 128, 255, 256, 300};
+  const uint8_t headers[][4] = {{0x04, 0x7f},
+                                {0x04, 0x81, 0x80},
+                                {0x04, 0x81, 0xff},
+                                {0x04, 0x82, 0x01, 0x00},
+                                {0x04, 0x82, 0x01, 0x2c}};
+  std::vector<uint8_t> contents(300, 0xaa);
+  for (size_t i = 0; i < 5; ++i) {
+    BerEncoder encoder(buffer, sizeof(buffer));
+    encoder.write_tlv(0x04, contents.data(), lengths[i]);
+    size_t header = BerEncoder::header_size(lengths[i]);
+    assert(encoder.ok());
+    assert(encoder.size() == header + lengths[i]);
+    assert(std::equal(headers[i], headers[i] + header, encoder.data()));
+  }
+
+  // Running out of space is sticky
+  BerEncoder small(buffer, 4);
+  small.write_tlv(0x04, contents.data(), 8);
+  small.write_byte(0x00);
+  assert(!small.ok());
+
+  std::cout << "✓ Reverse BER encoder test passed" << std::endl;
+}
+
 void test_snmp_packet_parsing() {
   std::cout << "Testing SNMP packet parsing..." << std::endl;
 
@@ -136,8 +341,8 @@ void test_snmp_packet_parsing() {
   };
 
   SNMPPacket packet;
-  bool success = packet.parse(packet_data.data(), packet_data.size());
-  if (!success) {
+  ParseResult result = packet.parse(packet_data.data(), packet_data.size());
+  if (!result) {
     std::cout << "Packet parsing failed, skipping detailed assertions"
               << std::endl;
     return;
@@ -154,6 +359,720 @@ void test_snmp_packet_parsing() {
   std::cout << "✓ SNMP packet parsing test passed" << std::endl;
 }
 
+void test_snmp_packet_view_parsing() {
+  std::cout << "Testing zero-copy SNMP packet view parsing..." << std::endl;
+
+  SNMPPacket request;
+  request.set_version(SNMP_VERSION_2C);
+  request.set_pdu_type(SNMP_PDU_GET_REQUEST);
+  request.set_community("public");
+  request.set_request_id(777);
+
+  SNMPPacket::VariableBinding varbind;
+  varbind.value_type = 0x05; // NULL
+  for (uint8_t i = 0; i < 50; ++i) {
+    varbind.oid = {0x2b, 0x06, 0x01, 0x02, 0x01, 0x02, 0x02, 0x01, 0x0a, i};
+    request.add_variable_binding(varbind);
+  }
+
+  std::vector<uint8_t> buffer;
+  assert(request.serialize(buffer));
+
+  SNMPPacketView view;
+  assert(view.parse(buffer.data(), buffer.size()));
+  assert(view.get_version() == SNMP_VERSION_2C);
+  assert(view.get_pdu_type() == SNMP_PDU_GET_REQUEST);
+  assert(view.get_community().to_string() == "public");
+  assert(view.get_request_id() == 777);
+  assert(view.get_variable_binding_count() == 50);
+
+  // Every span points into the receive buffer
+  const uint8_t *first = buffer.data();
+  const uint8_t *last = buffer.data() + buffer.size();
+  assert(view.get_community().begin() > first);
+  size_t index = 0;
+  for (const auto &binding : view) {
+    assert(binding.oid.begin() > first && binding.oid.end() <= last);
+    assert(binding.value_type == 0x05);
+    assert(binding.value.empty());
+    assert(binding.oid.to_vector() ==
+           request.get_variable_bindings()[index].oid);
+    ++index;
+  }
+  assert(index == 50);
+
+  // The copying API produces the same message
+  SNMPPacket copy;
+  copy.assign(view);
+  std::vector<uint8_t> reserialized;
+  assert(copy.serialize(reserialized));
+  assert(reserialized == buffer);
+
+  // The same PDU in an SNMPv3 scoped PDU, as a decrypted one is encoded
+  std::vector<uint8_t> scoped(buffer.size() + 32);
+  BerEncoder encoder(scoped.data(), scoped.size());
+  size_t mark = encoder.size();
+  assert(request.serialize_pdu(encoder));
+  encoder.write_tlv(0x04, reinterpret_cast<const uint8_t *>("ctx"), 3);
+  encoder.write_tlv(0x04, nullptr, 0);
+  encoder.wrap(0x30, mark);
+  assert(view.parse_scoped_pdu(encoder.data(), encoder.size()));
+  assert(view.get_version() == SNMP_VERSION_3);
+  assert(view.get_community().empty());
+  assert(view.get_context_engine_id().empty());
+  assert(view.get_context_name().to_string() == "ctx");
+  assert(view.get_request_id() == 777);
+  assert(view.get_variable_binding_count() == 50);
+
+  // Truncated or padded messages are rejected
+  assert(!view.parse(buffer.data(), buffer.size() - 1));
+  buffer.push_back(0x00);
+  assert(!view.parse(buffer.data(), buffer.size()));
+  assert(view.get_variable_binding_count() == 0);
+  assert(view.begin() == view.end());
+
+  std::cout << "✓ Zero-copy SNMP packet view parsing test passed"
+            << std::endl;
+}
+
+void test_snmp_packet_parse_errors() {
+  std::cout << "Testing SNMP packet parse error reporting..." << std::endl;
+
+  SNMPPacket request;
+  request.set_version(SNMP_VERSION_2C);
+  request.set_pdu_type(SNMP_PDU_GET_REQUEST);
+  request.set_community("public");
+  request.set_request_id(42);
+  SNMPPacket::VariableBinding varbind;
+  varbind.oid = {0x2b, 0x06, 0x01, 0x02, 0x01, 0x01, 0x01, 0x00};
+  varbind.value_type = 0x05;
+  request.add_variable_binding(varbind);
+
+  std::vector<uint8_t> buffer;
+  assert(request.serialize(buffer));
+
+  SNMPPacketView view;
+  ParseResult result = view.parse(buffer.data(), buffer.size());
+  assert(result);
+  assert(result.error == ParseError::NONE);
+
+  result = view.parse(buffer.data(), 0);
+  assert(result.error == ParseError::EMPTY && result.offset == 0);
+
+  // The message SEQUENCE claims more bytes than were received
+  result = view.parse(buffer.data(), buffer.size() - 1);
+  assert(result.error == ParseError::TRUNCATED && result.offset == 0);
+
+  std::vector<uint8_t> padded = buffer;
+  padded.push_back(0x00);
+  result = view.parse(padded.data(), padded.size());
+  assert(result.error == ParseError::TRAILING_DATA);
+  assert(result.offset == buffer.size());
+
+  // Community (at offset 5, after the version) sent as an INTEGER
+  std::vector<uint8_t> bad_tag = buffer;
+  assert(bad_tag[5] == 0x04);
+  bad_tag[5] = 0x02;
+  result = view.parse(bad_tag.data(), bad_tag.size());
+  assert(result.error == ParseError::UNEXPECTED_TAG && result.offset == 5);
+
+  // Indefinite length on the outer SEQUENCE
+  std::vector<uint8_t> indefinite = buffer;
+  indefinite[1] = 0x80;
+  result = view.parse(indefinite.data(), indefinite.size());
+  assert(result.error == ParseError::BAD_LENGTH && result.offset == 1);
+
+  // Request-ids are signed and echoed as sent; wider than 32 bits or
+  // empty, they are rejected rather than truncated
+  const uint8_t negative_id[] = {0x30, 0x18, 0x02, 0x01, 0x01, 0x04, 0x06,
+                                 'p',  'u',  'b',  'l',  'i',  'c',  0xA0,
+                                 0x0B, 0x02, 0x01, 0xFF, 0x02, 0x01, 0x00,
+                                 0x02, 0x01, 0x00, 0x30, 0x00};
+  SNMPPacket negative;
+  assert(negative.parse(negative_id, sizeof(negative_id)));
+  assert(negative.get_request_id() == -1);
+  assert(negative.serialize(buffer));
+  assert(buffer == std::vector<uint8_t>(negative_id,
+                                        negative_id + sizeof(negative_id)));
+  const uint8_t wide_id[] = {0x30, 0x1C, 0x02, 0x01, 0x01, 0x04, 0x06, 'p',
+                             'u',  'b',  'l',  'i',  'c',  0xA0, 0x0F, 0x02,
+                             0x05, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x02, 0x01,
+                             0x00, 0x02, 0x01, 0x00, 0x30, 0x00};
+  result = view.parse(wide_id, sizeof(wide_id));
+  assert(result.error == ParseError::BAD_INTEGER && result.offset == 15);
+  const uint8_t empty_id[] = {0x30, 0x17, 0x02, 0x01, 0x01, 0x04, 0x06,
+                              'p',  'u',  'b',  'l',  'i',  'c',  0xA0,
+                              0x0A, 0x02, 0x00, 0x02, 0x01, 0x00, 0x02,
+                              0x01, 0x00, 0x30, 0x00};
+  result = view.parse(empty_id, sizeof(empty_id));
+  assert(result.error == ParseError::BAD_INTEGER && result.offset == 15);
+
+  assert(std::string(parse_error_name(ParseError::TRUNCATED)) == "truncated");
+
+  // The version is read without parsing the community or PDU
+  uint8_t version = 0;
+  assert(peek_message_version(bad_tag.data(), bad_tag.size(), version));
+  assert(version == SNMP_VERSION_2C);
+  result = peek_message_version(buffer.data(), buffer.size() - 1, version);
+  assert(result.error == ParseError::TRUNCATED);
+
+  std::cout << "✓ SNMP packet parse error reporting test passed" << std::endl;
+}
+
+RequestContext make_cache_context(uint32_t address, uint16_t port) {
+  struct sockaddr_storage storage;
+  std::memset(&storage, 0, sizeof(storage));
+  auto &v4 = reinterpret_cast<struct sockaddr_in &>(storage);
+  v4.sin_family = AF_INET;
+  v4.sin_addr.s_addr = htonl(address);
+  v4.sin_port = htons(port);
+  return RequestContext(storage, sizeof(v4), std::chrono::steady_clock::now(),
+                        0);
+}
+
+std::vector<uint8_t> make_cache_request(uint8_t version, uint8_t pdu_type,
+                                        const std::string &community,
+                                        int32_t request_id) {
+  SNMPPacket packet;
+  packet.set_version(version);
+  packet.set_pdu_type(pdu_type);
+  packet.set_community(community);
+  packet.set_request_id(request_id);
+  SNMPPacket::VariableBinding varbind;
+  varbind.oid = {0x2b, 0x06, 0x01, 0x02, 0x01, 0x01, 0x01, 0x00};
+  varbind.value_type = 0x05;
+  packet.add_variable_binding(varbind);
+  std::vector<uint8_t> buffer;
+  assert(packet.serialize(buffer));
+  return buffer;
+}
+
+void test_response_cache() {
+  std::cout << "Testing response cache..." << std::endl;
+
+  // Keys hash with 64-bit FNV-1a; reference values from the FNV test suite
+  const uint8_t letter = 'a';
+  assert(fnv1a(nullptr, 0) == 0xcbf29ce484222325ULL);
+  assert(fnv1a(&letter, 1) == 0xaf63dc4c8601ec8cULL);
+
+  RequestContext context = make_cache_context(0xC0000201, 40000);
+  std::vector<uint8_t> request = make_cache_request(
+      SNMP_VERSION_2C, SNMP_PDU_GET_REQUEST, "public", 77);
+  ResponseCache::Key key;
+  uint64_t digest = 0;
+  assert(ResponseCache::make_key(context, request.data(), request.size(), key,
+                                 digest));
+  assert(key.request_id == 77 && key.port == 40000);
+
+  // Source, port, community and request-id all tell requests apart
+  ResponseCache::Key other;
+  uint64_t other_digest = 0;
+  assert(ResponseCache::make_key(make_cache_context(0xC0000202, 40000),
+                                 request.data(), request.size(), other,
+                                 other_digest));
+  assert(!(other == key) && other_digest == digest);
+  assert(ResponseCache::make_key(make_cache_context(0xC0000201, 40001),
+                                 request.data(), request.size(), other,
+                                 other_digest));
+  assert(!(other == key));
+  std::vector<uint8_t> private_request = make_cache_request(
+      SNMP_VERSION_2C, SNMP_PDU_GET_REQUEST, "private", 77);
+  assert(ResponseCache::make_key(context, private_request.data(),
+                                 private_request.size(), other,
+                                 other_digest));
+  assert(!(other == key) && other_digest != digest);
+  std::vector<uint8_t> next_request = make_cache_request(
+      SNMP_VERSION_2C, SNMP_PDU_GET_REQUEST, "public", 78);
+  assert(ResponseCache::make_key(context, next_request.data(),
+                                 next_request.size(), other, other_digest));
+  assert(!(other == key));
+
+  // Responses, SNMPv3 and truncated messages have no key
+  std::vector<uint8_t> response = make_cache_request(
+      SNMP_VERSION_2C, SNMP_PDU_GET_RESPONSE, "public", 77);
+  assert(!ResponseCache::make_key(context, response.data(), response.size(),
+                                  other, other_digest));
+  std::vector<uint8_t> v3 = request;
+  v3[4] = SNMP_VERSION_3;
+  assert(!ResponseCache::make_key(context, v3.data(), v3.size(), other,
+                                  other_digest));
+  assert(!ResponseCache::make_key(context, request.data(),
+                                  request.size() - 1, other, other_digest));
+
+  ResponseCache cache;
+  assert(!cache.is_enabled());
+  cache.configure(std::chrono::milliseconds(50), 1024);
+  assert(cache.is_enabled());
+
+  uint8_t buffer[1500];
+  assert(cache.lookup(key, digest, buffer, sizeof(buffer)) == 0);
+  cache.insert(key, digest, response.data(), response.size());
+  assert(cache.lookup(key, digest, buffer, sizeof(buffer)) ==
+         response.size());
+  assert(std::memcmp(buffer, response.data(), response.size()) == 0);
+
+  // The same key with another message is a reused request-id, not a
+  // retransmission; nor does a response go into a buffer too small for it
+  assert(cache.lookup(key, digest ^ 1, buffer, sizeof(buffer)) == 0);
+  assert(cache.lookup(key, digest, buffer, response.size() - 1) == 0);
+
+  // Entries expire after the ttl
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  assert(cache.lookup(key, digest, buffer, sizeof(buffer)) == 0);
+
+  ResponseCache::Statistics stats = cache.get_statistics();
+  assert(stats.hits == 1 && stats.misses == 4 && stats.insertions == 1);
+
+  // A full stripe evicts its oldest entry: with one entry per stripe the
+  // cache never holds more than 16, and the latest insert always stays
+  ResponseCache small;
+  small.configure(std::chrono::seconds(60), 16);
+  for (uint32_t i = 0; i < 100; ++i) {
+    ResponseCache::Key numbered = key;
+    numbered.request_id = i;
+    small.insert(numbered, digest, response.data(), response.size());
+    assert(small.lookup(numbered, digest, buffer, sizeof(buffer)) ==
+           response.size());
+  }
+  stats = small.get_statistics();
+  assert(stats.insertions == 100 && stats.entries <= 16);
+  assert(stats.evictions == stats.insertions - stats.entries);
+
+  std::cout << "✓ Response cache test passed" << std::endl;
+}
+
+#ifndef _WIN32
+// A GetRequest for sysDescr.0 whose community pads it to about size bytes
+std::vector<uint8_t> make_stream_message(size_t size, int32_t request_id) {
+  SNMPPacket packet;
+  packet.set_community(std::string(size > 40 ? size - 40 : 1, 'c'));
+  packet.set_request_id(request_id);
+  SNMPPacket::VariableBinding varbind;
+  varbind.oid = {0x2b, 0x06, 0x01, 0x02, 0x01, 0x01, 0x01, 0x00};
+  varbind.value_type = 0x05;
+  packet.add_variable_binding(varbind);
+  std::vector<uint8_t> buffer;
+  assert(packet.serialize(buffer));
+  return buffer;
+}
+
+void test_snmp_connection_framing() {
+  std::cout << "Testing SNMP connection stream framing..." << std::endl;
+
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  SNMPConnection connection(fds[0], "local", 0);
+  connection.set_non_blocking(true);
+  connection.set_max_message_size(1024);
+
+  std::vector<uint8_t> small = make_stream_message(40, 1);
+  std::vector<uint8_t> large = make_stream_message(400, 2);
+  assert(small[1] < 0x80);  // short-form length
+  assert(large[1] == 0x82); // long-form length, two octets
+
+  auto send_all = [&fds](const uint8_t *data, size_t length) {
+    assert(send(fds[1], data, length, 0) == static_cast<ssize_t>(length));
+  };
+  const uint8_t *data = nullptr;
+  size_t length = 0;
+
+  // Nothing read yet, then a message split inside its length octets
+  assert(connection.read_available());
+  assert(connection.next_message(data, length) == 0);
+  send_all(large.data(), 3);
+  assert(connection.read_available());
+  assert(connection.next_message(data, length) == 0);
+  send_all(large.data() + 3, large.size() - 3 - 10);
+  assert(connection.read_available());
+  assert(connection.next_message(data, length) == 0);
+  send_all(large.data() + large.size() - 10, 10);
+  assert(connection.read_available());
+  assert(connection.next_message(data, length) == 1);
+  assert(std::vector<uint8_t>(data, data + length) == large);
+  connection.consume_message();
+  assert(connection.next_message(data, length) == 0);
+
+  // Two messages and the start of a third in one read
+  std::vector<uint8_t> stream = small;
+  stream.insert(stream.end(), large.begin(), large.end());
+  stream.insert(stream.end(), small.begin(), small.begin() + 5);
+  send_all(stream.data(), stream.size());
+  assert(connection.read_available());
+  assert(connection.next_message(data, length) == 1);
+  assert(std::vector<uint8_t>(data, data + length) == small);
+  connection.consume_message();
+  assert(connection.next_message(data, length) == 1);
+  assert(std::vector<uint8_t>(data, data + length) == large);
+  connection.consume_message();
+  assert(connection.next_message(data, length) == 0);
+  send_all(small.data() + 5, small.size() - 5);
+  assert(connection.read_available());
+  assert(connection.next_message(data, length) == 1);
+  assert(std::vector<uint8_t>(data, data + length) == small);
+  connection.consume_message();
+
+  // A message announced above the limit is refused from its header alone
+  const uint8_t oversized[] = {0x30, 0x82, 0x04, 0x00, 0x02, 0x01};
+  send_all(oversized, sizeof(oversized));
+  assert(connection.read_available());
+  assert(connection.next_message(data, length) == -1);
+
+  // So is a stream that does not start with a SEQUENCE
+  SNMPConnection garbage_connection(fds[1], "local", 0);
+  garbage_connection.set_non_blocking(true);
+  const uint8_t not_sequence[] = {0x04, 0x01, 0x00};
+  assert(send(fds[0], not_sequence, sizeof(not_sequence), 0) == 3);
+  assert(garbage_connection.read_available());
+  assert(garbage_connection.next_message(data, length) == -1);
+
+  // A closed peer ends the connection
+  connection.close();
+  assert(!garbage_connection.read_available());
+  assert(!garbage_connection.is_connected());
+
+  std::cout << "✓ SNMP connection stream framing test passed" << std::endl;
+}
+
+// Send message to a server on 127.0.0.1:port and return its answer
+// (empty when none arrives)
+std::vector<uint8_t> exchange_message(uint16_t port,
+                                      const std::vector<uint8_t> &message) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  assert(fd >= 0);
+  timeval timeout = {2, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sendto(fd, message.data(), message.size(), 0,
+         reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+  std::vector<uint8_t> answer(SNMP_MAX_UDP_PAYLOAD);
+  ssize_t received = recv(fd, answer.data(), answer.size(), 0);
+  close(fd);
+  answer.resize(received > 0 ? static_cast<size_t>(received) : 0);
+  return answer;
+}
+
+// Send a GETBULK for columns to server on 127.0.0.1:port; the parsed
+// response is left in response
+bool exchange_get_bulk(uint16_t port,
+                       const std::vector<std::vector<uint8_t>> &columns,
+                       uint32_t max_repetitions, SNMPPacket &response) {
+  SNMPPacket request;
+  request.set_community("public");
+  request.set_pdu_type(SNMP_PDU_GET_BULK_REQUEST);
+  request.set_request_id(static_cast<int32_t>(max_repetitions));
+  request.set_max_repetitions(max_repetitions);
+  for (const auto &column : columns) {
+    SNMPPacket::VariableBinding varbind;
+    varbind.oid = column;
+    varbind.value_type = 0x05;
+    request.add_variable_binding(varbind);
+  }
+  std::vector<uint8_t> buffer;
+  assert(request.serialize(buffer));
+
+  std::vector<uint8_t> answer = exchange_message(port, buffer);
+  return !answer.empty() && response.parse(answer.data(), answer.size());
+}
+
+void test_get_bulk_response_budget() {
+  std::cout << "Testing GETBULK within a small response budget..."
+            << std::endl;
+
+  const uint16_t port = 16199;
+  SNMPConfig config;
+  config.set_port(port);
+  config.set_bind_addresses({"127.0.0.1"});
+  config.set_listener_shards(1);
+  config.set_max_response_size(200);
+  SNMPServer server(config);
+  assert(server.initialize());
+  assert(server.start());
+
+  // Four columns that each answer with sysDescr.0 (a long string) do not
+  // fit in 200 bytes even once; the first repetition is returned in part
+  const std::vector<uint8_t> system = {0x2b, 0x06, 0x01, 0x02, 0x01, 0x01};
+  SNMPPacket response;
+  assert(exchange_get_bulk(port, {system, system, system, system}, 10,
+                           response));
+  const auto &wide = response.get_variable_bindings();
+  assert(response.get_error_status() == SNMP_ERROR_NO_ERROR);
+  assert(!wide.empty() && wide.size() < 4);
+  for (const auto &varbind : wide) {
+    assert(varbind.oid == std::vector<uint8_t>({0x2b, 0x06, 0x01, 0x02, 0x01,
+                                                0x01, 0x01, 0x00}));
+  }
+  assert(response.encoded_size() <= 200);
+
+  // Narrow columns fit several repetitions; the cut is a whole repetition
+  std::vector<uint8_t> object_id = system;
+  object_id.push_back(0x02);
+  std::vector<uint8_t> up_time = system;
+  up_time.push_back(0x03);
+  assert(exchange_get_bulk(port, {object_id, up_time}, 50, response));
+  const auto &narrow = response.get_variable_bindings();
+  assert(response.get_error_status() == SNMP_ERROR_NO_ERROR);
+  assert(narrow.size() >= 4 && narrow.size() < 100);
+  assert(narrow.size() % 2 == 0);
+  assert(response.encoded_size() <= 200);
+
+  server.stop();
+  std::cout << "✓ GETBULK response budget test passed" << std::endl;
+}
+
+// A noAuthNoPriv SNMPv3 SetRequest from user for one OCTET STRING
+std::vector<uint8_t> make_v3_set(const std::string &user,
+                                 const std::vector<uint8_t> &oid,
+                                 const std::string &value) {
+  SNMPv3USMManager &usm = SNMPv3USMManager::get_instance();
+  SNMPv3EngineID engine = usm.get_engine_id();
+  const std::vector<uint8_t> &engine_id = engine.get_bytes();
+  uint8_t buffer[512];
+  BerEncoder encoder(buffer, sizeof(buffer));
+  size_t message = encoder.size();
+
+  // ScopedPDU: contextEngineID, contextName and the SetRequest
+  size_t scoped = encoder.size();
+  size_t pdu = encoder.size();
+  size_t varbinds = encoder.size();
+  size_t varbind = encoder.size();
+  encoder.write_tlv(0x04, reinterpret_cast<const uint8_t *>(value.data()),
+                    value.size());
+  encoder.write_tlv(0x06, oid.data(), oid.size());
+  encoder.wrap(0x30, varbind);
+  encoder.wrap(0x30, varbinds);
+  encoder.write_integer(0x02, 0);
+  encoder.write_integer(0x02, 0);
+  encoder.write_integer(0x02, 31337);
+  encoder.wrap(SNMP_PDU_SET_REQUEST, pdu);
+  encoder.write_tlv(0x04, nullptr, 0);
+  encoder.write_tlv(0x04, engine_id.data(), engine_id.size());
+  encoder.wrap(0x30, scoped);
+
+  // USM security parameters, no authentication or privacy parameters
+  size_t usm_mark = encoder.size();
+  encoder.write_tlv(0x04, nullptr, 0);
+  encoder.write_tlv(0x04, nullptr, 0);
+  encoder.write_tlv(0x04, reinterpret_cast<const uint8_t *>(user.data()),
+                    user.size());
+  encoder.write_integer(0x02, usm.get_engine_time());
+  encoder.write_integer(0x02, usm.get_engine_boots());
+  encoder.write_tlv(0x04, engine_id.data(), engine_id.size());
+  encoder.wrap(0x30, usm_mark);
+  encoder.wrap(0x04, usm_mark);
+
+  // msgGlobalData: msgID, msgMaxSize, msgFlags (reportable) and USM
+  size_t header = encoder.size();
+  const uint8_t flags = 0x04;
+  encoder.write_integer(0x02, 3);
+  encoder.write_tlv(0x04, &flags, 1);
+  encoder.write_integer(0x02, 65507);
+  encoder.write_integer(0x02, 4242);
+  encoder.wrap(0x30, header);
+
+  encoder.write_integer(0x02, SNMP_VERSION_3);
+  encoder.wrap(0x30, message);
+  assert(encoder.ok());
+  return std::vector<uint8_t>(encoder.data(), encoder.data() + encoder.size());
+}
+
+void test_snmpv3_set_request() {
+  std::cout << "Testing SNMPv3 SET..." << std::endl;
+
+  const uint16_t port = 16198;
+  SNMPConfig config;
+  config.set_port(port);
+  config.set_bind_addresses({"127.0.0.1"});
+  config.set_listener_shards(1);
+  SNMPServer server(config);
+  assert(server.initialize());
+  assert(server.start());
+
+  SNMPv3User user;
+  user.username = "setter";
+  SNMPv3USMManager::get_instance().add_user(user);
+  VACMManager::get_instance().initialize_defaults();
+
+  // A writable scalar under a private enterprise arc
+  std::string stored = "initial";
+  MIBEntry entry({0x2b, 0x06, 0x01, 0x04, 0x01, 0xce, 0x0f, 0x01, 0x00},
+                 "testWritable", SNMPDataType::OCTET_STRING, false);
+  entry.getter = [&stored]() {
+    return MIBValue(SNMPDataType::OCTET_STRING, stored);
+  };
+  entry.setter = [&stored](const MIBValue &value) {
+    stored.assign(value.data.begin(), value.data.end());
+    return true;
+  };
+  MIBManager::get_instance().register_scalar(entry);
+
+  // The scoped PDU is read in place, after the header and USM fields
+  std::vector<uint8_t> message = make_v3_set("setter", entry.oid, "written");
+  SNMPPacketView view;
+  assert(view.parse_v3(message.data(), message.size()));
+  assert(view.get_version() == SNMP_VERSION_3);
+  assert(view.get_pdu_type() == SNMP_PDU_SET_REQUEST);
+  assert(view.get_request_id() == 31337);
+  assert(view.get_context_name().empty());
+  assert(view.get_variable_binding_count() == 1);
+  assert(view.begin()->oid.to_vector() == entry.oid);
+
+  // It ends the message; short lengths put its SEQUENCE header four bytes
+  // before contextEngineID's contents
+  const uint8_t *scoped = view.get_context_engine_id().begin() - 4;
+  size_t scoped_length = message.data() + message.size() - scoped;
+  assert(view.parse_scoped_pdu(scoped, scoped_length));
+  assert(view.get_request_id() == 31337);
+
+  // An encrypted scoped PDU is an OCTET STRING and is left to the processor
+  std::vector<uint8_t> encrypted = message;
+  encrypted[scoped - message.data()] = 0x04;
+  ParseResult result = view.parse_v3(encrypted.data(), encrypted.size());
+  assert(result.error == ParseError::UNEXPECTED_TAG);
+  assert(result.offset == static_cast<size_t>(scoped - message.data()));
+
+  // A scoped PDU carries no community; VACM has authorized the SET
+  std::vector<uint8_t> answer = exchange_message(port, message);
+  assert(view.parse_v3(answer.data(), answer.size()));
+  assert(view.get_pdu_type() == SNMP_PDU_GET_RESPONSE);
+  assert(view.get_request_id() == 31337);
+  assert(view.get_error_status() == SNMP_ERROR_NO_ERROR);
+  assert(view.get_context_engine_id().to_vector() ==
+         SNMPv3USMManager::get_instance().get_engine_id().get_bytes());
+  assert(stored == "written");
+
+  // SNMPv2c still needs a community with write access
+  SNMPPacket request;
+  request.set_community("public");
+  request.set_pdu_type(SNMP_PDU_SET_REQUEST);
+  request.set_request_id(1);
+  SNMPPacket::VariableBinding varbind;
+  varbind.oid = entry.oid;
+  varbind.value_type = 0x04;
+  varbind.value = {'v', '2'};
+  request.add_variable_binding(varbind);
+  std::vector<uint8_t> buffer;
+  assert(request.serialize(buffer));
+  answer = exchange_message(port, buffer);
+  SNMPPacket response;
+  assert(response.parse(answer.data(), answer.size()));
+  assert(response.get_error_status() == SNMP_ERROR_NO_ACCESS);
+  assert(stored == "written");
+
+  server.stop();
+  std::cout << "✓ SNMPv3 SET test passed" << std::endl;
+}
+#endif
+
+#ifdef __linux__
+// A UDP socket bound to an ephemeral port on 127.0.0.1
+int open_loopback_socket(sockaddr_in &address) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  assert(fd >= 0);
+  timeval timeout = {2, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  assert(bind(fd, reinterpret_cast<const sockaddr *>(&address),
+              sizeof(address)) == 0);
+  socklen_t length = sizeof(address);
+  assert(getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length) ==
+         0);
+  return fd;
+}
+
+// Send count datagrams of distinct lengths, plus one larger than a slot,
+// from a client socket to engine's socket; check they are received with
+// their lengths and source and that every reply comes back
+void exchange_datagrams(DatagramEngine &engine, const sockaddr_in &server,
+                        bool single_receive) {
+  const size_t count = 8;
+  const size_t slot_size = 256;
+  sockaddr_in client;
+  int client_fd = open_loopback_socket(client);
+
+  std::vector<uint8_t> payload(slot_size + 44);
+  for (size_t i = 0; i < count; ++i) {
+    std::fill(payload.begin(), payload.end(), static_cast<uint8_t>(i));
+    size_t length = i == count / 2 ? payload.size() : 10 * (i + 1);
+    assert(sendto(client_fd, payload.data(), length, 0,
+                  reinterpret_cast<const sockaddr *>(&server),
+                  sizeof(server)) == static_cast<ssize_t>(length));
+  }
+
+  // Everything is queued before the first receive, so the socket engine
+  // takes it in one call; io_uring may deliver over several
+  DatagramBatch requests(count * 2, slot_size);
+  DatagramBatch replies(count * 2, slot_size);
+  size_t received = 0;
+  size_t oversized = 0;
+  for (int calls = 0; received + oversized < count && calls < 20; ++calls) {
+    size_t syscalls = 0;
+    int result = engine.receive(requests, syscalls);
+    assert(result >= 0 && static_cast<size_t>(result) == requests.size());
+    assert(!single_receive || result == static_cast<int>(count - 1));
+    oversized += requests.oversized();
+    for (size_t i = 0; i < requests.size(); ++i, ++received) {
+      const Datagram &datagram = requests[i];
+      uint8_t index = datagram.data[0];
+      assert(index != count / 2);
+      assert(datagram.length == 10 * (index + 1u));
+      assert(datagram.address_length == sizeof(sockaddr_in));
+      const auto *source =
+          reinterpret_cast<const sockaddr_in *>(&datagram.address);
+      assert(source->sin_port == client.sin_port);
+      assert(source->sin_addr.s_addr == client.sin_addr.s_addr);
+
+      Datagram &reply = replies.append();
+      std::memcpy(reply.data, datagram.data, datagram.length);
+      reply.length = datagram.length;
+      reply.address = datagram.address;
+      reply.address_length = datagram.address_length;
+    }
+  }
+  assert(received == count - 1 && oversized == 1);
+
+  size_t syscalls = 0;
+  assert(engine.send(replies, syscalls) == count - 1);
+  assert(replies.empty());
+  size_t echoed = 0;
+  uint8_t buffer[slot_size];
+  for (size_t i = 0; i < count - 1; ++i) {
+    ssize_t length = recv(client_fd, buffer, sizeof(buffer), 0);
+    assert(length == 10 * (buffer[0] + 1));
+    ++echoed;
+  }
+  assert(echoed == count - 1);
+  close(client_fd);
+}
+
+void test_datagram_engines() {
+  std::cout << "Testing datagram engines over loopback..." << std::endl;
+
+  sockaddr_in server;
+  int server_fd = open_loopback_socket(server);
+
+  SocketDatagramEngine socket_engine(server_fd);
+  exchange_datagrams(socket_engine, server, true);
+
+  // Unknown backends get the socket engine; io_uring falls back to it
+  // when the build or kernel lacks support
+  assert(std::string(create_datagram_engine("bogus", server_fd, 16)->name()) ==
+         "socket");
+  bool has_io_uring = create_io_uring_datagram_engine(server_fd, 16) != nullptr;
+  auto engine = create_datagram_engine("io_uring", server_fd, 16);
+  assert(std::string(engine->name()) ==
+         (has_io_uring ? "io_uring" : "socket"));
+  exchange_datagrams(*engine, server, !has_io_uring);
+
+  close(server_fd);
+  std::cout << "✓ Datagram engines test passed" << std::endl;
+}
+#endif
+
 void run_all_tests() {
   std::cout << "Running SNMP packet tests..." << std::endl;
 
@@ -161,7 +1080,22 @@ void run_all_tests() {
   test_snmp_packet_setters();
   test_snmp_packet_variable_bindings();
   test_snmp_packet_serialization();
+  test_snmp_packet_large_serialization();
+  test_snmp_packet_size_budget();
+  test_snmp_packet_get_bulk_fields();
+  test_ber_encoder();
   test_snmp_packet_parsing();
+  test_snmp_packet_view_parsing();
+  test_snmp_packet_parse_errors();
+  test_response_cache();
+#ifndef _WIN32
+  test_snmp_connection_framing();
+  test_get_bulk_response_budget();
+  test_snmpv3_set_request();
+#endif
+#ifdef __linux__
+  test_datagram_engines();
+#endif
 
   std::cout << "All SNMP packet tests passed!" << std::endl;
 }
@@ -17,10 +17,23 @@
  */
 
 #include "simple_snmpd/snmp_security.hpp"
+#include "simple_snmpd/admission_control.hpp"
+#include "simple_snmpd/fair_queue.hpp"
+#include "simple_snmpd/listen_endpoint.hpp"
+#include "simple_snmpd/thread_pool.hpp"
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstring>
 #include <iostream>
+#include <string>
 #include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#endif
 
 namespace simple_snmpd {
 namespace tests {
@@ -133,6 +146,338 @@ void test_security_manager_access_control() {
   std::cout << "✓ Security manager access control test passed" << std::endl;
 }
 
+RequestContext make_context(const char *ip, uint16_t port) {
+  struct sockaddr_storage storage;
+  std::memset(&storage, 0, sizeof(storage));
+  socklen_t length;
+  if (std::strchr(ip, ':')) {
+    auto &v6 = reinterpret_cast<struct sockaddr_in6 &>(storage);
+    v6.sin6_family = AF_INET6;
+    v6.sin6_port = htons(port);
+    inet_pton(AF_INET6, ip, &v6.sin6_addr);
+    length = sizeof(v6);
+  } else {
+    auto &v4 = reinterpret_cast<struct sockaddr_in &>(storage);
+    v4.sin_family = AF_INET;
+    v4.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &v4.sin_addr);
+    length = sizeof(v4);
+  }
+  return RequestContext(storage, length, std::chrono::steady_clock::now(), 0);
+}
+
+void test_security_manager_request_context() {
+  std::cout << "Testing security manager request context..." << std::endl;
+
+  SecurityManager &security = SecurityManager::get_instance();
+
+  RequestContext v4 = make_context("192.168.1.100", 40000);
+  assert(v4.port() == 40000);
+  assert(v4.address_string() == "192.168.1.100");
+
+  // IPv4-mapped IPv6 sources match IPv4 rules
+  RequestContext mapped = make_context("::ffff:192.168.1.100", 40001);
+  assert(mapped.address_string() == "192.168.1.100");
+  assert(security.is_access_allowed("test_community", mapped));
+  assert(!security.is_access_allowed("test_community",
+                                     make_context("192.168.1.101", 1)));
+
+  // Subnet rules in prefix and dotted mask form
+  AccessControlEntry entry;
+  entry.community = "subnet_community";
+  entry.source_ip = "10.1.0.0/16";
+  security.add_access_control_entry(entry);
+  entry.source_ip = "2001:db8::";
+  entry.subnet_mask = "32";
+  security.add_access_control_entry(entry);
+
+  assert(security.is_access_allowed("subnet_community",
+                                    make_context("10.1.200.3", 1)));
+  assert(!security.is_access_allowed("subnet_community",
+                                     make_context("10.2.0.1", 1)));
+  assert(security.is_access_allowed("subnet_community",
+                                    make_context("2001:db8:5::1", 1)));
+  assert(!security.is_access_allowed("subnet_community",
+                                     make_context("2001:db9::1", 1)));
+
+  // Denied subnets win over the allow list
+  security.add_denied_subnet("172.16.0.0/255.240.0.0");
+  assert(!security.is_ip_allowed(make_context("172.31.0.1", 1)));
+  assert(security.is_ip_allowed(make_context("10.0.0.1", 1)));
+
+  // String and context variants share one rate limit entry
+  security.set_rate_limit("192.0.2.7", 1, std::chrono::seconds(60));
+  assert(security.check_rate_limit(make_context("192.0.2.7", 1)));
+  assert(!security.check_rate_limit("192.0.2.7"));
+
+  std::cout << "✓ Security manager request context test passed" << std::endl;
+}
+
+void test_listen_endpoints() {
+  std::cout << "Testing listen endpoint parsing..." << std::endl;
+
+  struct Case {
+    const char *spec;
+    bool valid;
+    const char *text; // listen_endpoint_to_string() when valid
+  };
+  const Case cases[] = {
+      {"*", true, "[::]:161 (dual-stack)"},
+      {"0.0.0.0", true, "0.0.0.0:161"},
+      {"0.0.0.0:1161", true, "0.0.0.0:1161"},
+      {" 10.0.0.5:65535 ", true, "10.0.0.5:65535"},
+      {"[2001:db8::1]:1161", true, "[2001:db8::1]:1161"},
+      {"[::]", true, "[::]:161"},
+      {"::1", true, "[::1]:161"},
+      {"2001:db8::5", true, "[2001:db8::5]:161"},
+      {"10.0.0.5:1161@eth1", true, "10.0.0.5:1161@eth1"},
+      {"[::1]:162@lo", true, "[::1]:162@lo"},
+      {"*@eth0", true, "[::]:161 (dual-stack)@eth0"},
+      {"10.0.0.5:", false, ""},
+      {"10.0.0.5:0", false, ""},
+      {"10.0.0.5:65536", false, ""},
+      {"10.0.0.5:123456", false, ""},
+      {"10.0.0.5:16x", false, ""},
+      {"[::1]:", false, ""},
+      {"[::1]:0", false, ""},
+      {"[::1]161", false, ""},
+      {"[::1", false, ""},
+      {"::1]", false, ""},
+      {"[]:161", false, ""},
+      {"[10.0.0.5]:161", false, ""},
+      {"10.0.0.5@", false, ""},
+      {"host.example:161", false, ""},
+      {"", false, ""},
+  };
+  for (const Case &c : cases) {
+    ListenEndpoint endpoint;
+    bool valid = parse_listen_endpoint(c.spec, 161, endpoint);
+    if (valid != c.valid ||
+        (valid && listen_endpoint_to_string(endpoint) != c.text)) {
+      std::cout << "Unexpected result for \"" << c.spec << "\"" << std::endl;
+      assert(false);
+    }
+  }
+
+  ListenEndpoint endpoint;
+  assert(parse_listen_endpoint("*", 161, endpoint) &&
+         endpoint.family() == AF_INET6 && !endpoint.v6_only);
+  assert(parse_listen_endpoint("[::]", 161, endpoint) && endpoint.v6_only);
+  assert(parse_listen_endpoint("10.0.0.5", 161, endpoint) &&
+         endpoint.family() == AF_INET &&
+         endpoint.address_length == sizeof(struct sockaddr_in));
+
+  std::vector<std::string> entries =
+      split_listen_addresses(" 0.0.0.0:161 ,, [::1]:161@lo,*");
+  assert(entries.size() == 3 && entries[0] == "0.0.0.0:161" &&
+         entries[1] == "[::1]:161@lo" && entries[2] == "*");
+  assert(split_listen_addresses(" , ").empty());
+
+  std::cout << "✓ Listen endpoint parsing test passed" << std::endl;
+}
+
+void test_admission_control() {
+  std::cout << "Testing admission control..." << std::endl;
+
+  // 5 ms target over 100 ms intervals
+  AdmissionController admission;
+  admission.configure(true, std::chrono::microseconds(5000),
+                      std::chrono::microseconds(100000), 16, {"ops"},
+                      {"batch"});
+
+  // SNMPv3 requests match the lists by USM user name, not community
+  SNMPPacket scoped;
+  scoped.set_version(SNMP_VERSION_3);
+  scoped.set_community("ops");
+  std::vector<uint8_t> scoped_buffer;
+  SNMPPacketView scoped_view;
+  assert(scoped.serialize(scoped_buffer) &&
+         scoped_view.parse(scoped_buffer.data(), scoped_buffer.size()));
+  assert(admission.classify(scoped_view) == RequestClass::CRITICAL);
+  assert(admission.classify(scoped_view, "ops") == RequestClass::CRITICAL);
+  assert(admission.classify(scoped_view, "batch") ==
+         RequestClass::BACKGROUND);
+  assert(admission.classify(scoped_view, "operator") ==
+         RequestClass::INTERACTIVE);
+
+  // One request of each class per interval, all queued for delay_ms
+  struct Offer {
+    const char *community;
+    uint8_t pdu_type;
+  };
+  const Offer offers[] = {{"ops", SNMP_PDU_GET_REQUEST},
+                          {"public", SNMP_PDU_GET_REQUEST},
+                          {"public", SNMP_PDU_GET_BULK_REQUEST},
+                          {"batch", SNMP_PDU_GET_REQUEST}};
+  RequestContext context = make_context("192.0.2.1", 40000);
+  uint64_t now_ns = 1700000000ULL * 1000000000ULL;
+  std::vector<uint32_t> levels;
+  auto run_interval = [&](uint64_t delay_ms) {
+    context.arrival_ns = now_ns - delay_ms * 1000000;
+    for (size_t c = 0; c < SNMP_REQUEST_CLASSES; ++c) {
+      SNMPPacket packet;
+      packet.set_community(offers[c].community);
+      packet.set_pdu_type(offers[c].pdu_type);
+      std::vector<uint8_t> buffer;
+      SNMPPacketView request;
+      assert(packet.serialize(buffer) &&
+             request.parse(buffer.data(), buffer.size()));
+      assert(admission.classify(request) == static_cast<RequestClass>(c));
+      bool admitted = admission.admit(context, request, now_ns);
+      uint32_t level = admission.get_statistics().shed_level;
+      assert(admitted == (c + level < SNMP_REQUEST_CLASSES));
+    }
+    levels.push_back(admission.get_statistics().shed_level);
+    now_ns += 100000000;
+  };
+
+  // Below the target nothing is shed
+  for (int i = 0; i < 3; ++i) {
+    run_interval(1);
+  }
+  // A standing queue sheds one more class per interval, never CRITICAL;
+  // the first interval still has its 1 ms sample
+  for (int i = 0; i < 5; ++i) {
+    run_interval(20);
+  }
+  // Once the delay is back under the target classes return one at a time
+  for (int i = 0; i < 4; ++i) {
+    run_interval(1);
+  }
+  const std::vector<uint32_t> expected = {0, 0, 0, 0, 1, 2, 3, 3,
+                                          2, 1, 0, 0};
+  assert(levels == expected);
+
+  AdmissionController::Statistics stats = admission.get_statistics();
+  assert(stats.shed[0] == 0 && stats.admitted[0] == 12);
+  assert(stats.shed[1] == 2 && stats.shed[2] == 4 && stats.shed[3] == 6);
+
+  // A disabled controller admits everything
+  AdmissionController disabled;
+  assert(disabled.admit(context, scoped_view, "batch", now_ns));
+  assert(disabled.get_statistics().admitted[3] == 0);
+
+  std::cout << "✓ Admission control test passed" << std::endl;
+}
+
+void test_fair_queue() {
+  std::cout << "Testing fair queue..." << std::endl;
+
+  FairQueue queue;
+  assert(!queue.configure(100, 4, {"10.0.0.0/33=2"}));
+  assert(!queue.configure(100, 4, {"10.0.0.1=0"}));
+  assert(!queue.configure(100, 4, {"10.0.0.1"}));
+  assert(queue.configure(100, 4, {"10.0.0.1=2"}));
+
+  NetworkAddress heavy;
+  NetworkAddress light;
+  assert(NetworkAddress::parse("10.0.0.1", heavy));
+  assert(NetworkAddress::parse("10.0.0.2", light));
+
+  // A weight 2 source may queue 8 requests, a weight 1 source 4
+  for (uint32_t i = 0; i < 8; ++i) {
+    assert(queue.push(heavy, 100 + i, 100));
+  }
+  assert(!queue.push(heavy, 108, 100));
+  for (uint32_t i = 0; i < 4; ++i) {
+    assert(queue.push(light, 200 + i, 100));
+  }
+  assert(!queue.push(light, 204, 100));
+  assert(queue.size() == 12);
+
+  std::vector<FairQueue::FlowStatistics> flows = queue.top_flows(2);
+  assert(flows.size() == 2 && flows[0].source == heavy &&
+         flows[0].weight == 2 && flows[0].depth == 8 &&
+         flows[1].depth == 4);
+
+  // Each round the weight 2 source dequeues two requests, the other one
+  const std::vector<uint32_t> expected = {100, 101, 200, 102, 103, 201,
+                                          104, 105, 202, 106, 107, 203};
+  std::vector<uint32_t> order;
+  uint32_t item = 0;
+  while (queue.pop(item)) {
+    order.push_back(item);
+  }
+  assert(order == expected);
+
+  FairQueue::Statistics stats = queue.get_statistics();
+  assert(stats.enqueued == 12 && stats.dropped == 2 && stats.depth == 0 &&
+         stats.active_flows == 0);
+
+  // A drained source is forgotten, and its share is available again
+  for (uint32_t i = 0; i < 4; ++i) {
+    assert(queue.push(light, 300 + i, 100));
+  }
+  assert(!queue.push(light, 304, 100));
+
+  std::cout << "✓ Fair queue test passed" << std::endl;
+}
+
+void test_bounded_queue() {
+  std::cout << "Testing bounded queue..." << std::endl;
+
+  // The capacity rounds up to a power of two
+  BoundedQueue<uint32_t> small(5);
+  assert(small.capacity() == 8);
+  uint32_t value = 0;
+  assert(!small.try_pop(value));
+  for (uint32_t i = 0; i < 8; ++i) {
+    assert(small.try_push(i));
+  }
+  assert(!small.try_push(8));
+  assert(small.size() == 8);
+  for (uint32_t i = 0; i < 8; ++i) {
+    assert(small.try_pop(value) && value == i);
+  }
+  assert(!small.try_pop(value));
+  assert(small.try_push(9) && small.try_pop(value) && value == 9);
+
+  // Producers and consumers contend on a queue that keeps filling and
+  // draining; every item must come out exactly once
+  const uint32_t threads = 4;
+  const uint32_t per_producer = 50000;
+  BoundedQueue<uint32_t> queue(64);
+  std::vector<std::atomic<uint8_t>> seen(threads * per_producer);
+  for (auto &count : seen) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  std::atomic<uint32_t> consumed(0);
+  std::vector<std::thread> workers;
+  for (uint32_t p = 0; p < threads; ++p) {
+    workers.emplace_back([&queue, p, per_producer]() {
+      for (uint32_t i = 0; i < per_producer; ++i) {
+        while (!queue.try_push(p * per_producer + i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (uint32_t c = 0; c < threads; ++c) {
+    workers.emplace_back([&]() {
+      uint32_t item = 0;
+      while (consumed.load(std::memory_order_relaxed) <
+             threads * per_producer) {
+        if (queue.try_pop(item)) {
+          seen[item].fetch_add(1, std::memory_order_relaxed);
+          consumed.fetch_add(1, std::memory_order_relaxed);
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  assert(consumed.load() == threads * per_producer);
+  for (const auto &count : seen) {
+    assert(count.load(std::memory_order_relaxed) == 1);
+  }
+  assert(queue.size() == 0 && !queue.try_pop(value));
+
+  std::cout << "✓ Bounded queue test passed" << std::endl;
+}
+
 void run_all_tests() {
   std::cout << "Running security manager tests..." << std::endl;
 
@@ -140,6 +485,11 @@ void run_all_tests() {
   test_security_manager_ip_filtering();
   test_security_manager_rate_limiting();
   test_security_manager_access_control();
+  test_security_manager_request_context();
+  test_listen_endpoints();
+  test_admission_control();
+  test_fair_queue();
+  test_bounded_queue();
 
   std::cout << "All security manager tests passed!" << std::endl;
 }